@@ -0,0 +1,328 @@
+#include "Animation.h"
+#include "Parallel.h"
+#include "QuaternionBatch.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+namespace Math3D {
+	namespace {
+		using simd::float4;
+		using quat4 = simd::float4xN<4>;
+
+		// Tracks per parallel_for chunk. A character has a few hundred at most, so only very large clips are
+		// split.
+		constexpr size_t AnimationGrain = 1024;
+
+		// Characters per parallel_for chunk in sample_animations
+		constexpr size_t JobGrain = 4;
+
+		// Keys stepped forward from the cached one before falling back to a binary search
+		constexpr uint32_t ForwardSteps = 4;
+
+		template <size_t Width>
+		void append_track(KeyframeTracks<Width>& tracks, [[maybe_unused]] size_t joint_count, size_t joint, span<const float> times, Interpolation mode) {
+			assert(joint < joint_count && !times.empty());
+			assert(std::find(tracks.targets.begin(), tracks.targets.end(), uint32_t(joint)) == tracks.targets.end());
+			assert(std::adjacent_find(times.begin(), times.end(), std::greater_equal<float>()) == times.end());
+			tracks.targets.push_back(uint32_t(joint));
+			tracks.modes.push_back(mode);
+			tracks.times.insert(tracks.times.end(), times.begin(), times.end());
+			tracks.offsets.push_back(uint32_t(tracks.times.size()));
+		}
+
+		// Appends a key's value and tangent, moving the padding float of Vec3f streams to the new end
+		template <size_t Width>
+		void append_key(KeyframeTracks<Width>& tracks, const float* value, const float* tangent) {
+			for (auto* stream : { &tracks.values, &tracks.tangents }) {
+				if (Width == 3 && !stream->empty()) stream->pop_back();
+				const float* p = stream == &tracks.values ? value : tangent;
+				stream->insert(stream->end(), p, p + Width);
+				if (Width == 3) stream->push_back(0.0f);
+			}
+		}
+
+		void append_vec3_keys(Vec3Tracks& tracks, span<const float> times, span<const Vec3f> values,
+			Interpolation mode, span<const Vec3f> tangents) {
+			assert(values.size() == times.size() && (tangents.empty() || tangents.size() == times.size()));
+			size_t n = times.size();
+			for (size_t k = 0; k < n; ++k) {
+				Vec3f m(0.0f, 0.0f, 0.0f);
+				if (mode == Interpolation::Cubic && !tangents.empty()) {
+					m = tangents[k];
+				}
+				else if (mode == Interpolation::Cubic && n > 1) {
+					size_t a = k > 0 ? k - 1 : k, b = k + 1 < n ? k + 1 : k;
+					m = (values[b] - values[a]) / (times[b] - times[a]);
+				}
+				append_key(tracks, values[k].arr.data(), m.arr.data());
+			}
+		}
+
+		// log of a unit quaternion and exp of a pure one, for the squad control points
+		Quaternion log_unit(const Quaternion& q) {
+			float v = std::sqrt(q.i * q.i + q.j * q.j + q.k * q.k);
+			float s = v > 1e-7f ? std::atan2(v, q.r) / v : 1.0f;
+			return Quaternion(q.i * s, q.j * s, q.k * s, 0.0f);
+		}
+
+		Quaternion exp_pure(const Quaternion& q) {
+			float angle = std::sqrt(q.i * q.i + q.j * q.j + q.k * q.k);
+			float s = angle > 1e-7f ? std::sin(angle) / angle : 1.0f;
+			return Quaternion(q.i * s, q.j * s, q.k * s, std::cos(angle));
+		}
+
+		// Key k of the track in [first, last] with times[k] <= time < times[k + 1], clamped to the ends
+		uint32_t find_key(const float* times, uint32_t first, uint32_t last, uint32_t cached, float time) {
+			uint32_t k = cached >= first && cached <= last ? cached : first;
+			if (time >= times[k]) {
+				for (uint32_t step = 0; step < ForwardSteps; ++step, ++k) {
+					if (k == last || time < times[k + 1]) return k;
+				}
+				return uint32_t(std::upper_bound(times + k, times + last + 1, time) - times) - 1;
+			}
+			uint32_t after = uint32_t(std::upper_bound(times + first, times + k, time) - times);
+			return after > first ? after - 1 : first;
+		}
+
+		// Points a track's cursor at the segment around time
+		template <size_t Width>
+		void seek(const KeyframeTracks<Width>& tracks, TrackCursors& cursors, size_t track, float time) {
+			const float* times = tracks.times.data();
+			uint32_t first = tracks.offsets[track], last = tracks.offsets[track + 1] - 1;
+			uint32_t k = find_key(times, first, last, cursors.keys[track], time);
+			bool step = tracks.modes[track] == Interpolation::Step;
+
+			cursors.keys[track] = k;
+			cursors.next[track] = k;
+			cursors.duration[track] = 0.0f;
+			if (time < times[first]) {
+				cursors.begin[track] = std::numeric_limits<float>::lowest();
+				cursors.end[track] = times[first];
+			}
+			else if (k == last) {
+				cursors.begin[track] = times[k];
+				cursors.end[track] = std::numeric_limits<float>::infinity();
+			}
+			else {
+				cursors.begin[track] = times[k];
+				cursors.end[track] = times[k + 1];
+				if (!step) {
+					cursors.next[track] = k + 1;
+					cursors.duration[track] = times[k + 1] - times[k];
+				}
+			}
+		}
+
+		// Sized for the tracks with every segment empty, so the first sample seeks each track; the padding
+		// lanes cover every time and never do
+		void reset_cursors(TrackCursors& cursors, size_t tracks) {
+			size_t padded = (tracks + 3) & ~size_t(3);
+			cursors.keys.assign(padded, 0);
+			cursors.next.assign(padded, 0);
+			cursors.duration.assign(padded, 0.0f);
+			cursors.begin.assign(padded, std::numeric_limits<float>::lowest());
+			cursors.end.assign(padded, std::numeric_limits<float>::infinity());
+			std::fill_n(cursors.begin.begin(), tracks, std::numeric_limits<float>::infinity());
+			std::fill_n(cursors.end.begin(), tracks, std::numeric_limits<float>::lowest());
+		}
+
+		// Four tracks at a time: their keys and the parameter s in [0, 1] between each key and the next
+		struct Segments {
+			const uint32_t* key;
+			const uint32_t* next;
+			float4 s, duration, cubic;
+			bool any_cubic = false;
+		};
+
+		template <size_t Width>
+		Segments find_segments(const KeyframeTracks<Width>& tracks, TrackCursors& cursors, size_t first, size_t lanes, float time) {
+			float4 t = simd::set1(time);
+			float4 begin = simd::load(cursors.begin.data() + first);
+			float4 inside = simd::bit_and(simd::cmple(begin, t), simd::cmplt(t, simd::load(cursors.end.data() + first)));
+			if (unsigned moved = ~simd::movemask(inside) & 0xFu) {
+				for (size_t lane = 0; lane < lanes; ++lane) {
+					if (moved & (1u << lane)) seek(tracks, cursors, first + lane, time);
+				}
+				begin = simd::load(cursors.begin.data() + first);
+			}
+
+			Segments seg;
+			seg.key = cursors.keys.data() + first;
+			seg.next = cursors.next.data() + first;
+			seg.duration = simd::load(cursors.duration.data() + first);
+
+			float4 zero = simd::zero(), one = simd::set1(1.0f);
+			float4 moving = simd::cmplt(zero, seg.duration);
+			float4 s = simd::div(simd::sub(t, begin), simd::select(moving, seg.duration, one));
+			seg.s = simd::select(moving, simd::min(s, one), zero);
+
+			float cubic[4] = {};
+			for (size_t lane = 0; lane < lanes; ++lane) {
+				bool is_cubic = tracks.modes[first + lane] == Interpolation::Cubic;
+				cubic[lane] = is_cubic ? 1.0f : 0.0f;
+				seg.any_cubic |= is_cubic;
+			}
+			seg.cubic = simd::cmplt(zero, simd::load(cubic));
+			return seg;
+		}
+
+		// The keys of four lanes as component lanes, one load per lane; for Width 3 the fourth is unspecified.
+		// Padding lanes read the first lane's key.
+		template <size_t Width>
+		quat4 gather(const float* stream, const uint32_t* keys, size_t lanes) {
+			quat4 v;
+			for (size_t lane = 0; lane < 4; ++lane) v[lane] = simd::load(stream + keys[lane < lanes ? lane : 0] * Width);
+			simd::transpose(v[0], v[1], v[2], v[3]);
+			return v;
+		}
+
+		// Tracks added in joint order land on consecutive elements, which take a plain store
+		template <size_t N>
+		void scatter(const simd::float4xN<N>& v, const uint32_t* targets, size_t lanes, array<aligned_vector<float>, N>& streams) {
+			if (lanes == 4 && targets[1] == targets[0] + 1 && targets[2] == targets[0] + 2 && targets[3] == targets[0] + 3) {
+				for (size_t c = 0; c < N; ++c) simd::store(streams[c].data() + targets[0], v[c]);
+				return;
+			}
+			for (size_t c = 0; c < N; ++c) {
+				float scratch[4];
+				simd::store(scratch, v[c]);
+				for (size_t lane = 0; lane < lanes; ++lane) streams[c][targets[lane]] = scratch[lane];
+			}
+		}
+
+		// Linear lanes blend by s; cubic ones by the Hermite basis, with the tangents scaled to the segment
+		void sample_vec3(const Vec3Tracks& tracks, TrackCursors& cursors, size_t first, size_t lanes, float time, Vec3fSoA& out) {
+			Segments seg = find_segments(tracks, cursors, first, lanes, time);
+			quat4 p0 = gather<3>(tracks.values.data(), seg.key, lanes);
+			quat4 p1 = gather<3>(tracks.values.data(), seg.next, lanes);
+
+			float4 s = seg.s;
+			float4 w1 = s;
+			quat4 m0 {}, m1 {};
+			float4 wm0 = simd::zero(), wm1 = simd::zero();
+			if (seg.any_cubic) {
+				// h01 = 3s^2 - 2s^3, h10 = s^3 - 2s^2 + s, h11 = s^3 - s^2
+				float4 s2 = simd::mul(s, s), s3 = simd::mul(s2, s);
+				float4 h01 = simd::madd(simd::set1(-2.0f), s3, simd::mul(simd::set1(3.0f), s2));
+				float4 h10 = simd::add(simd::madd(simd::set1(-2.0f), s2, s3), s);
+				float4 h11 = simd::sub(s3, s2);
+				w1 = simd::select(seg.cubic, h01, s);
+				wm0 = simd::select(seg.cubic, simd::mul(h10, seg.duration), simd::zero());
+				wm1 = simd::select(seg.cubic, simd::mul(h11, seg.duration), simd::zero());
+				m0 = gather<3>(tracks.tangents.data(), seg.key, lanes);
+				m1 = gather<3>(tracks.tangents.data(), seg.next, lanes);
+			}
+			float4 w0 = simd::sub(simd::set1(1.0f), w1);
+
+			simd::float4xN<3> v;
+			for (size_t c = 0; c < 3; ++c) {
+				v[c] = simd::madd(w0, p0[c], simd::mul(w1, p1[c]));
+				if (seg.any_cubic) v[c] = simd::madd(wm0, m0[c], simd::madd(wm1, m1[c], v[c]));
+			}
+			scatter(v, tracks.targets.data() + first, lanes, out.streams);
+		}
+
+		// Squad: slerp(slerp(q0, q1, s), slerp(c0, c1, s), 2s(1 - s)) over the keys and their control points.
+		// Linear and Step lanes stop after the first slerp, which returns q0 exactly at s = 0.
+		void sample_rotations(const QuaternionTracks& tracks, TrackCursors& cursors, size_t first, size_t lanes, float time, QuaternionBatch& out) {
+			Segments seg = find_segments(tracks, cursors, first, lanes, time);
+			quat4 q = slerp4(gather<4>(tracks.values.data(), seg.key, lanes), gather<4>(tracks.values.data(), seg.next, lanes), seg.s);
+			if (seg.any_cubic) {
+				quat4 c = slerp4(gather<4>(tracks.tangents.data(), seg.key, lanes), gather<4>(tracks.tangents.data(), seg.next, lanes), seg.s);
+				float4 h = simd::mul(simd::add(seg.s, seg.s), simd::sub(simd::set1(1.0f), seg.s));
+				q = slerp4(q, c, simd::select(seg.cubic, h, simd::zero()));
+			}
+			scatter(q, tracks.targets.data() + first, lanes, out.streams);
+		}
+
+		// Calls kernel(first, lanes) for each group of four tracks, keeping a cursor per track
+		template <size_t Width, class Kernel>
+		void sample_tracks(const KeyframeTracks<Width>& tracks, TrackCursors& cursors, Kernel&& kernel) {
+			parallel_for(tracks.size(), AnimationGrain, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i += 4) kernel(cursors, i, std::min<size_t>(end - i, 4));
+			});
+		}
+	}
+
+	void AnimationClip::add_translation(size_t joint, span<const float> times, span<const Vec3f> values, Interpolation mode,
+		span<const Vec3f> tangents) {
+		append_track(translations, joint_count, joint, times, mode);
+		append_vec3_keys(translations, times, values, mode, tangents);
+		end_time = std::max(end_time, times.back());
+	}
+
+	void AnimationClip::add_scale(size_t joint, span<const float> times, span<const Vec3f> values, Interpolation mode,
+		span<const Vec3f> tangents) {
+		append_track(scales, joint_count, joint, times, mode);
+		append_vec3_keys(scales, times, values, mode, tangents);
+		end_time = std::max(end_time, times.back());
+	}
+
+	void AnimationClip::add_rotation(size_t joint, span<const float> times, span<const Quaternion> values, Interpolation mode) {
+		assert(values.size() == times.size());
+		append_track(rotations, joint_count, joint, times, mode);
+
+		vector<Quaternion> keys(values.begin(), values.end());
+		for (size_t k = 0; k < keys.size(); ++k) {
+			keys[k] = keys[k].Normalize();
+			if (k > 0 && keys[k].Dot(keys[k - 1]) < 0.0f) keys[k] *= -1.0f;
+		}
+
+		// s_k = q_k exp(-(log(q_k^-1 q_k+1) + log(q_k^-1 q_k-1)) / 4), the ends being their own control points
+		for (size_t k = 0; k < keys.size(); ++k) {
+			Quaternion control = keys[k];
+			if (mode == Interpolation::Cubic && k > 0 && k + 1 < keys.size()) {
+				Quaternion inverse = keys[k].Conjugate();
+				Quaternion sum = log_unit(inverse * keys[k + 1]) + log_unit(inverse * keys[k - 1]);
+				control = (keys[k] * exp_pure(sum * -0.25f)).Normalize();
+			}
+			append_key(rotations, keys[k].vals, control.vals);
+		}
+		end_time = std::max(end_time, times.back());
+	}
+
+	void AnimationSampler::sample(const AnimationClip& clip, float time, TRSBatch& out) {
+		MATH_INSTRUMENT(Animation);
+		if (out.size() != clip.joint_count) out.resize(clip.joint_count);
+		if (current != &clip) {
+			reset_cursors(translations, clip.translations.size());
+			reset_cursors(rotations, clip.rotations.size());
+			reset_cursors(scales, clip.scales.size());
+			current = &clip;
+		}
+
+		// Channels that don't drive every joint start from the identity
+		if (clip.translations.size() < clip.joint_count) {
+			for (auto& s : out.translation.streams) std::fill(s.begin(), s.end(), 0.0f);
+		}
+		if (clip.rotations.size() < clip.joint_count) {
+			for (size_t k = 0; k < 4; ++k) std::fill(out.rotation.streams[k].begin(), out.rotation.streams[k].end(), k == 3 ? 1.0f : 0.0f);
+		}
+		if (clip.scales.size() < clip.joint_count) {
+			for (auto& s : out.scale.streams) std::fill(s.begin(), s.end(), 1.0f);
+		}
+
+		sample_tracks(clip.translations, translations, [&](TrackCursors& cursors, size_t first, size_t lanes) {
+			sample_vec3(clip.translations, cursors, first, lanes, time, out.translation);
+		});
+		sample_tracks(clip.rotations, rotations, [&](TrackCursors& cursors, size_t first, size_t lanes) {
+			sample_rotations(clip.rotations, cursors, first, lanes, time, out.rotation);
+		});
+		sample_tracks(clip.scales, scales, [&](TrackCursors& cursors, size_t first, size_t lanes) {
+			sample_vec3(clip.scales, cursors, first, lanes, time, out.scale);
+		});
+	}
+
+	void sample_animations(span<const AnimationJob> jobs) {
+		parallel_for(jobs.size(), JobGrain, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				const AnimationJob& job = jobs[i];
+				job.sampler->sample(*job.clip, job.time, *job.out);
+			}
+		});
+	}
+}
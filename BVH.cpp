@@ -0,0 +1,666 @@
+#include "BVH.h"
+#include "Parallel.h"
+#include "SIMD.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+
+namespace Math3D {
+	namespace {
+		// Deep enough for any tree the builder produces; it turns a node into a leaf before exceeding it
+		constexpr size_t MaxDepth = 96;
+		constexpr float Infinity = numeric_limits<float>::infinity();
+
+		// Left uninitialized by default so the per-node bin arrays cost nothing to declare
+		struct Bounds {
+			float lo[3];
+			float hi[3];
+
+			static Bounds empty() {
+				return { { Infinity, Infinity, Infinity }, { -Infinity, -Infinity, -Infinity } };
+			}
+
+			void grow(const float* p) {
+				for (int a = 0; a < 3; ++a) {
+					lo[a] = std::min(lo[a], p[a]);
+					hi[a] = std::max(hi[a], p[a]);
+				}
+			}
+
+			void grow(const Bounds& b) {
+				for (int a = 0; a < 3; ++a) {
+					lo[a] = std::min(lo[a], b.lo[a]);
+					hi[a] = std::max(hi[a], b.hi[a]);
+				}
+			}
+
+			// Half the surface area, which is all SAH needs
+			float area() const {
+				float dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+				return dx < 0.0f ? 0.0f : dx * dy + dy * dz + dz * dx;
+			}
+		};
+
+		Bounds bounds_of(const Vec3f& lo, const Vec3f& hi) {
+			Bounds b;
+			for (int a = 0; a < 3; ++a) {
+				b.lo[a] = lo[a];
+				b.hi[a] = hi[a];
+			}
+			return b;
+		}
+
+		struct RayData {
+			float origin[3];
+			simd::float4 origin4;
+			simd::float4 inv_dir4;
+			// Set in the lanes where the ray runs towards -inf, which enter a box through its max face
+			simd::float4 negative4;
+
+			explicit RayData(const Ray& ray) {
+				for (int a = 0; a < 3; ++a) origin[a] = ray.point[a];
+				origin4 = simd::set(ray.point[0], ray.point[1], ray.point[2], 0.0f);
+				inv_dir4 = simd::set(1.0f / ray.dir[0], 1.0f / ray.dir[1], 1.0f / ray.dir[2], 0.0f);
+				negative4 = simd::cmplt(inv_dir4, simd::zero());
+			}
+		};
+
+		// Entry distance of the ray into the node's box, clipped to [0, t_max]. Subtract before scaling so
+		// axis-parallel rays get +-inf rather than inf - inf. The entry and exit planes come from the
+		// direction's sign, as in RayAABB, and the reduction only takes a lane that compares, so the NaN slab
+		// of a ray lying in a face plane leaves the interval alone instead of rejecting the box.
+		bool slab(const BVHNode& node, const RayData& ray, float t_max, float& t_entry) {
+			using namespace simd;
+			// load3 leaves out the first/count word stored after each corner
+			float4 lo = load3(node.min), hi = load3(node.max);
+			float4 near4 = mul(sub(select(ray.negative4, hi, lo), ray.origin4), ray.inv_dir4);
+			float4 far4 = mul(sub(select(ray.negative4, lo, hi), ray.origin4), ray.inv_dir4);
+
+			// Lane 0 gathers axes 0-2 in turn
+			float4 near_t = zero(), far_t = set1(t_max);
+			float4 near_axes[3] = { near4, shuffle<1, 2, 0, 3>(near4, near4), shuffle<2, 0, 1, 3>(near4, near4) };
+			float4 far_axes[3] = { far4, shuffle<1, 2, 0, 3>(far4, far4), shuffle<2, 0, 1, 3>(far4, far4) };
+			for (int a = 0; a < 3; ++a) {
+				near_t = select(cmplt(near_t, near_axes[a]), near_axes[a], near_t);
+				far_t = select(cmplt(far_axes[a], far_t), far_axes[a], far_t);
+			}
+			t_entry = lane<0>(near_t);
+			return t_entry <= lane<0>(far_t);
+		}
+
+		struct StackEntry {
+			uint32_t node;
+			float t;
+		};
+
+		struct BuildTask {
+			uint32_t node;
+			uint32_t begin, end;
+			uint32_t depth;
+		};
+
+		// Partitioned in place during the build so every pass over a range reads memory sequentially
+		struct BuildPrim {
+			Bounds bounds;
+			float centroid[3];
+			uint32_t id;
+		};
+
+		struct Builder {
+			vector<BuildPrim> prims;
+			span<BVHNode> nodes;
+			const BVH::BuildOptions& options;
+			// Slot 1 is left unused so every sibling pair starts on an even index and shares a cache line
+			std::atomic<uint32_t> node_count { 2 };
+
+			Builder(vector<BuildPrim>&& _prims, span<BVHNode> _nodes, const BVH::BuildOptions& _options)
+				: prims(std::move(_prims)), nodes(_nodes), options(_options) {}
+
+			void make_leaf(const BuildTask& task) {
+				nodes[task.node].first = task.begin;
+				nodes[task.node].count = task.end - task.begin;
+			}
+
+			// Sets the node's bounds and either makes it a leaf or splits its range in place, returning
+			// the two child tasks. Returns false for a leaf.
+			bool split(const BuildTask& task, BuildTask& left, BuildTask& right) {
+				Bounds node_bounds = Bounds::empty(), centroid_bounds = Bounds::empty();
+				for (uint32_t n = task.begin; n < task.end; ++n) {
+					node_bounds.grow(prims[n].bounds);
+					centroid_bounds.grow(prims[n].centroid);
+				}
+
+				BVHNode& node = nodes[task.node];
+				for (int a = 0; a < 3; ++a) {
+					node.min[a] = node_bounds.lo[a];
+					node.max[a] = node_bounds.hi[a];
+				}
+
+				uint32_t count = task.end - task.begin;
+				if (count == 1 || task.depth + 1 >= MaxDepth) {
+					make_leaf(task);
+					return false;
+				}
+
+				// Binned SAH on all three axes in one pass over the range
+				constexpr uint32_t MaxBins = 32;
+				// Small ranges get one bin per primitive; sweeping empty bins is most of the cost near the leaves
+				const uint32_t bin_count = std::clamp(std::min(options.bins, count), 2u, MaxBins);
+				Bounds bins[3][MaxBins];
+				uint32_t bin_prims[3][MaxBins];
+				float scale[3];
+				for (int a = 0; a < 3; ++a) {
+					float extent = centroid_bounds.hi[a] - centroid_bounds.lo[a];
+					scale[a] = extent > 0.0f ? bin_count / extent : 0.0f;
+					for (uint32_t b = 0; b < bin_count; ++b) {
+						bins[a][b] = Bounds::empty();
+						bin_prims[a][b] = 0;
+					}
+				}
+
+				for (uint32_t n = task.begin; n < task.end; ++n) {
+					const BuildPrim& prim = prims[n];
+					for (int a = 0; a < 3; ++a) {
+						uint32_t b = std::min(bin_count - 1, uint32_t((prim.centroid[a] - centroid_bounds.lo[a]) * scale[a]));
+						bins[a][b].grow(prim.bounds);
+						++bin_prims[a][b];
+					}
+				}
+
+				int best_axis = -1;
+				uint32_t best_bin = 0;
+				float best_cost = Infinity;
+				for (int a = 0; a < 3; ++a) {
+					if (scale[a] == 0.0f) continue;
+
+					// Right to left sweep first, then score each split plane on the way back
+					float right_area[MaxBins];
+					uint32_t right_prims[MaxBins];
+					Bounds sweep = Bounds::empty();
+					uint32_t swept = 0;
+					for (uint32_t b = bin_count - 1; b > 0; --b) {
+						sweep.grow(bins[a][b]);
+						swept += bin_prims[a][b];
+						right_area[b] = sweep.area();
+						right_prims[b] = swept;
+					}
+
+					sweep = Bounds::empty();
+					swept = 0;
+					for (uint32_t b = 0; b + 1 < bin_count; ++b) {
+						sweep.grow(bins[a][b]);
+						swept += bin_prims[a][b];
+						if (swept == 0 || right_prims[b + 1] == 0) continue;
+
+						float cost = sweep.area() * swept + right_area[b + 1] * right_prims[b + 1];
+						if (cost < best_cost) {
+							best_cost = cost;
+							best_axis = a;
+							best_bin = b;
+						}
+					}
+				}
+
+				// Unit traversal and intersection costs: splitting costs one box test plus the children
+				float leaf_cost = float(count);
+				float split_cost = 1.0f + best_cost / std::max(node_bounds.area(), numeric_limits<float>::min());
+				if (count <= options.max_leaf_size && (best_axis < 0 || leaf_cost <= split_cost)) {
+					make_leaf(task);
+					return false;
+				}
+
+				BuildPrim* first = prims.data() + task.begin;
+				BuildPrim* last = prims.data() + task.end;
+				BuildPrim* middle = first;
+				if (best_axis >= 0) {
+					float lo = centroid_bounds.lo[best_axis];
+					float axis_scale = scale[best_axis];
+					middle = std::partition(first, last, [&](const BuildPrim& prim) {
+						return std::min(bin_count - 1, uint32_t((prim.centroid[best_axis] - lo) * axis_scale)) <= best_bin;
+					});
+				}
+
+				// Coincident centroids: halve the range
+				if (middle == first || middle == last) {
+					middle = first + count / 2;
+				}
+
+				uint32_t mid = uint32_t(middle - prims.data());
+				uint32_t child = node_count.fetch_add(2, std::memory_order_relaxed);
+				node.first = child;
+				node.count = 0;
+
+				left = { child, task.begin, mid, task.depth + 1 };
+				right = { child + 1, mid, task.end, task.depth + 1 };
+				return true;
+			}
+
+			void build_subtree(const BuildTask& root) {
+				BuildTask stack[MaxDepth + 1];
+				size_t top = 0;
+				stack[top++] = root;
+				while (top) {
+					BuildTask task = stack[--top], left, right;
+					if (split(task, left, right)) {
+						stack[top++] = right;
+						stack[top++] = left;
+					}
+				}
+			}
+
+			void build(uint32_t count) {
+				BuildTask root { 0, 0, count, 0 };
+				if (!options.parallel) {
+					build_subtree(root);
+					return;
+				}
+
+				// Split breadth-first until there are enough independent subtrees to keep every thread busy
+				vector<BuildTask> tasks { root }, next;
+				size_t wanted = parallel_thread_count() * 4;
+				while (tasks.size() < wanted && !tasks.empty()) {
+					next.clear();
+					bool split_any = false;
+					for (const BuildTask& task : tasks) {
+						BuildTask left, right;
+						if (task.end - task.begin > options.max_leaf_size * 64 && split(task, left, right)) {
+							next.push_back(left);
+							next.push_back(right);
+							split_any = true;
+						}
+						else {
+							next.push_back(task);
+						}
+					}
+					tasks.swap(next);
+					if (!split_any) break;
+				}
+
+				parallel_for(tasks.size(), 1, [&](size_t begin, size_t end) {
+					for (size_t t = begin; t < end; ++t) build_subtree(tasks[t]);
+				});
+			}
+		};
+
+		bool intersect(const RayData& ray, const Vec3f& dir, const Vec3f& v0, const Vec3f& e1, const Vec3f& e2, float t_max, float& t, float& u, float& v) {
+			Vec3f p = dir.cross(e2);
+			float det = e1.dot(p);
+			if (std::fabs(det) < numeric_limits<float>::min()) return false;
+
+			float inv_det = 1.0f / det;
+			Vec3f s(ray.origin[0] - v0[0], ray.origin[1] - v0[1], ray.origin[2] - v0[2]);
+			u = s.dot(p) * inv_det;
+			if (u < 0.0f || u > 1.0f) return false;
+
+			Vec3f q = s.cross(e1);
+			v = dir.dot(q) * inv_det;
+			if (v < 0.0f || u + v > 1.0f) return false;
+
+			t = e2.dot(q) * inv_det;
+			return t >= 0.0f && t <= t_max;
+		}
+	}
+
+	void BVH::build(span<const Tri3d> input, const BuildOptions& options) {
+		vector<Box> bounds(input.size());
+		for (size_t n = 0; n < input.size(); ++n) {
+			const Tri3d& tri = input[n];
+			for (size_t a = 0; a < 3; ++a) {
+				bounds[n].min[a] = std::min({ tri.verts[0].pos[a], tri.verts[1].pos[a], tri.verts[2].pos[a] });
+				bounds[n].max[a] = std::max({ tri.verts[0].pos[a], tri.verts[1].pos[a], tri.verts[2].pos[a] });
+			}
+		}
+
+		boxes.clear();
+		build_nodes(bounds, options);
+		triangles.resize(input.size());
+		refit(input);
+	}
+
+	void BVH::build(span<const AABB> input, const BuildOptions& options) {
+		vector<Box> bounds(input.size());
+		for (size_t n = 0; n < input.size(); ++n) {
+			for (size_t a = 0; a < 3; ++a) {
+				bounds[n].min[a] = input[n].center[a] - input[n].halfwidths[a];
+				bounds[n].max[a] = input[n].center[a] + input[n].halfwidths[a];
+			}
+		}
+
+		triangles.clear();
+		build_nodes(bounds, options);
+		boxes.resize(input.size());
+		refit(input);
+	}
+
+	void BVH::build_nodes(span<const Box> input, const BuildOptions& options) {
+		node_array.clear();
+		primitive_ids.resize(input.size());
+		if (input.empty()) return;
+
+		vector<BuildPrim> prims(input.size());
+		for (size_t n = 0; n < input.size(); ++n) {
+			prims[n].bounds = bounds_of(input[n].min, input[n].max);
+			for (int a = 0; a < 3; ++a) {
+				prims[n].centroid[a] = (prims[n].bounds.lo[a] + prims[n].bounds.hi[a]) * 0.5f;
+			}
+			prims[n].id = uint32_t(n);
+		}
+
+		node_array.assign(input.size() * 2, BVHNode {});
+		Builder builder(std::move(prims), node_array, options);
+		builder.build(uint32_t(input.size()));
+		node_array.resize(builder.node_count.load());
+		for (size_t n = 0; n < input.size(); ++n) {
+			primitive_ids[n] = builder.prims[n].id;
+		}
+	}
+
+	void BVH::refit(span<const Tri3d> input) {
+		assert(input.size() == triangles.size() && boxes.empty());
+		for (size_t n = 0; n < triangles.size(); ++n) {
+			const Tri3d& tri = input[primitive_ids[n]];
+			triangles[n] = { tri.verts[0].pos, tri.verts[1].pos - tri.verts[0].pos, tri.verts[2].pos - tri.verts[0].pos };
+		}
+		refit_nodes();
+	}
+
+	void BVH::refit(span<const AABB> input) {
+		assert(input.size() == boxes.size() && triangles.empty());
+		for (size_t n = 0; n < boxes.size(); ++n) {
+			const AABB& box = input[primitive_ids[n]];
+			for (size_t a = 0; a < 3; ++a) {
+				boxes[n].min[a] = box.center[a] - box.halfwidths[a];
+				boxes[n].max[a] = box.center[a] + box.halfwidths[a];
+			}
+		}
+		refit_nodes();
+	}
+
+	// Children always sit after their parent, so one reverse pass sees every child before its parent
+	void BVH::refit_nodes() {
+		for (size_t n = node_array.size(); n-- > 0;) {
+			if (n == 1) continue;
+
+			BVHNode& node = node_array[n];
+			Bounds b = Bounds::empty();
+			if (node.is_leaf()) {
+				for (uint32_t p = node.first; p < node.first + node.count; ++p) {
+					if (!triangles.empty()) {
+						const Triangle& tri = triangles[p];
+						Vec3f v1 = tri.v0 + tri.e1, v2 = tri.v0 + tri.e2;
+						b.grow(tri.v0.arr.data());
+						b.grow(v1.arr.data());
+						b.grow(v2.arr.data());
+					}
+					else {
+						b.grow(boxes[p].min.arr.data());
+						b.grow(boxes[p].max.arr.data());
+					}
+				}
+			}
+			else {
+				for (const BVHNode& child : { node_array[node.first], node_array[node.first + 1] }) {
+					b.grow(child.min);
+					b.grow(child.max);
+				}
+			}
+
+			for (int a = 0; a < 3; ++a) {
+				node.min[a] = b.lo[a];
+				node.max[a] = b.hi[a];
+			}
+		}
+	}
+
+	bool BVH::closest_hit(const Ray& ray, Hit& hit, float t_max) const {
+		if (node_array.empty()) return false;
+
+		RayData data(ray);
+		float t_root;
+		if (!slab(node_array[0], data, t_max, t_root)) return false;
+
+		StackEntry stack[MaxDepth + 1];
+		size_t top = 0;
+		stack[top++] = { 0, t_root };
+		bool found = false;
+
+		while (top) {
+			StackEntry entry = stack[--top];
+			if (entry.t > t_max) continue;
+
+			const BVHNode& node = node_array[entry.node];
+			if (node.is_leaf()) {
+				for (uint32_t p = node.first; p < node.first + node.count; ++p) {
+					float t, u = 0.0f, v = 0.0f;
+					if (!triangles.empty()) {
+						const Triangle& tri = triangles[p];
+						if (!intersect(data, ray.dir, tri.v0, tri.e1, tri.e2, t_max, t, u, v)) continue;
+					}
+					else {
+						BVHNode box {};
+						for (int a = 0; a < 3; ++a) {
+							box.min[a] = boxes[p].min[a];
+							box.max[a] = boxes[p].max[a];
+						}
+						if (!slab(box, data, t_max, t)) continue;
+					}
+
+					t_max = t;
+					hit = { t, primitive_ids[p], u, v };
+					found = true;
+				}
+				continue;
+			}
+
+			// Visit the nearer child first
+			float t_left, t_right;
+			bool left = slab(node_array[node.first], data, t_max, t_left);
+			bool right = slab(node_array[node.first + 1], data, t_max, t_right);
+			if (left && right) {
+				bool left_first = t_left <= t_right;
+				stack[top++] = { left_first ? node.first + 1 : node.first, left_first ? t_right : t_left };
+				stack[top++] = { left_first ? node.first : node.first + 1, left_first ? t_left : t_right };
+			}
+			else if (left) {
+				stack[top++] = { node.first, t_left };
+			}
+			else if (right) {
+				stack[top++] = { node.first + 1, t_right };
+			}
+		}
+
+		return found;
+	}
+
+	bool BVH::any_hit(const Ray& ray, float t_max) const {
+		if (node_array.empty()) return false;
+
+		RayData data(ray);
+		uint32_t stack[MaxDepth + 1];
+		size_t top = 0;
+		stack[top++] = 0;
+
+		while (top) {
+			const BVHNode& node = node_array[stack[--top]];
+			float t;
+			if (!slab(node, data, t_max, t)) continue;
+
+			if (!node.is_leaf()) {
+				stack[top++] = node.first + 1;
+				stack[top++] = node.first;
+				continue;
+			}
+
+			for (uint32_t p = node.first; p < node.first + node.count; ++p) {
+				if (!triangles.empty()) {
+					float u, v;
+					const Triangle& tri = triangles[p];
+					if (intersect(data, ray.dir, tri.v0, tri.e1, tri.e2, t_max, t, u, v)) return true;
+				}
+				else {
+					BVHNode box {};
+					for (int a = 0; a < 3; ++a) {
+						box.min[a] = boxes[p].min[a];
+						box.max[a] = boxes[p].max[a];
+					}
+					if (slab(box, data, t_max, t)) return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	template <size_t N>
+	uint32_t BVH::closest_hit(const RayPacket<N>& rays, PacketHit<N>& hit) const {
+		uint32_t active = rays.active();
+		if (node_array.empty() || !active) return 0;
+
+		alignas(64) float t_max[N], t_entry[N], t[N], u[N], v[N];
+		std::copy(rays.t_max, rays.t_max + N, t_max);
+
+		uint32_t stack[MaxDepth + 1];
+		size_t top = 0;
+		stack[top++] = 0;
+		uint32_t found = 0;
+
+		while (top) {
+			const BVHNode& node = node_array[stack[--top]];
+			uint32_t mask = packet_detail::slab(rays, node.min, node.max, t_max, t_entry) & active;
+			if (!mask) continue;
+
+			if (!node.is_leaf()) {
+				// Nearer child first, judged along the first live lane's direction
+				const BVHNode& left = node_array[node.first];
+				const BVHNode& right = node_array[node.first + 1];
+				int lane = std::countr_zero(mask);
+				float ahead = 0.0f;
+				for (int a = 0; a < 3; ++a) {
+					ahead += (right.min[a] + right.max[a] - left.min[a] - left.max[a]) * rays.dir[a][lane];
+				}
+				stack[top++] = ahead >= 0.0f ? node.first + 1 : node.first;
+				stack[top++] = ahead >= 0.0f ? node.first : node.first + 1;
+				continue;
+			}
+
+			for (uint32_t p = node.first; p < node.first + node.count; ++p) {
+				uint32_t hits;
+				if (!triangles.empty()) {
+					const Triangle& tri = triangles[p];
+					hits = packet_detail::triangle(rays, tri.v0, tri.e1, tri.e2, t_max, t, u, v) & mask;
+				}
+				else {
+					hits = packet_detail::slab(rays, boxes[p].min.arr.data(), boxes[p].max.arr.data(), t_max, t) & mask;
+					std::fill(u, u + N, 0.0f);
+					std::fill(v, v + N, 0.0f);
+				}
+
+				found |= hits;
+				for (; hits; hits &= hits - 1) {
+					int lane = std::countr_zero(hits);
+					t_max[lane] = t[lane];
+					hit.t[lane] = t[lane];
+					hit.primitive[lane] = primitive_ids[p];
+					hit.u[lane] = u[lane];
+					hit.v[lane] = v[lane];
+				}
+			}
+		}
+
+		return found;
+	}
+
+	template <size_t N>
+	uint32_t BVH::any_hit(const RayPacket<N>& rays) const {
+		uint32_t active = rays.active();
+		if (node_array.empty() || !active) return 0;
+
+		alignas(64) float t_entry[N], t[N], u[N], v[N];
+		uint32_t stack[MaxDepth + 1];
+		size_t top = 0;
+		stack[top++] = 0;
+		uint32_t occluded = 0;
+
+		// Lanes drop out as they hit; the traversal ends when none are left
+		while (top && active) {
+			const BVHNode& node = node_array[stack[--top]];
+			uint32_t mask = packet_detail::slab(rays, node.min, node.max, rays.t_max, t_entry) & active;
+			if (!mask) continue;
+
+			if (!node.is_leaf()) {
+				stack[top++] = node.first + 1;
+				stack[top++] = node.first;
+				continue;
+			}
+
+			for (uint32_t p = node.first; p < node.first + node.count && mask; ++p) {
+				uint32_t hits;
+				if (!triangles.empty()) {
+					const Triangle& tri = triangles[p];
+					hits = packet_detail::triangle(rays, tri.v0, tri.e1, tri.e2, rays.t_max, t, u, v) & mask;
+				}
+				else {
+					hits = packet_detail::slab(rays, boxes[p].min.arr.data(), boxes[p].max.arr.data(), rays.t_max, t) & mask;
+				}
+
+				occluded |= hits;
+				active &= ~hits;
+				mask &= ~hits;
+			}
+		}
+
+		return occluded;
+	}
+
+	template uint32_t BVH::closest_hit(const RayPacket<4>&, PacketHit<4>&) const;
+	template uint32_t BVH::closest_hit(const RayPacket<8>&, PacketHit<8>&) const;
+	template uint32_t BVH::closest_hit(const RayPacket<16>&, PacketHit<16>&) const;
+	template uint32_t BVH::any_hit(const RayPacket<4>&) const;
+	template uint32_t BVH::any_hit(const RayPacket<8>&) const;
+	template uint32_t BVH::any_hit(const RayPacket<16>&) const;
+
+	void BVH::overlaps(const AABB& box, vector<uint32_t>& out) const {
+		if (node_array.empty()) return;
+
+		float lo[3], hi[3];
+		for (int a = 0; a < 3; ++a) {
+			lo[a] = box.center[a] - box.halfwidths[a];
+			hi[a] = box.center[a] + box.halfwidths[a];
+		}
+		auto overlap = [&](const float* min, const float* max) {
+			return lo[0] <= max[0] && hi[0] >= min[0] && lo[1] <= max[1] && hi[1] >= min[1] && lo[2] <= max[2] && hi[2] >= min[2];
+		};
+
+		uint32_t stack[MaxDepth + 1];
+		size_t top = 0;
+		stack[top++] = 0;
+
+		while (top) {
+			const BVHNode& node = node_array[stack[--top]];
+			if (!overlap(node.min, node.max)) continue;
+
+			if (!node.is_leaf()) {
+				stack[top++] = node.first + 1;
+				stack[top++] = node.first;
+				continue;
+			}
+
+			for (uint32_t p = node.first; p < node.first + node.count; ++p) {
+				Bounds b = Bounds::empty();
+				if (!triangles.empty()) {
+					const Triangle& tri = triangles[p];
+					Vec3f v1 = tri.v0 + tri.e1, v2 = tri.v0 + tri.e2;
+					b.grow(tri.v0.arr.data());
+					b.grow(v1.arr.data());
+					b.grow(v2.arr.data());
+				}
+				else {
+					b = bounds_of(boxes[p].min, boxes[p].max);
+				}
+
+				if (overlap(b.lo, b.hi)) out.push_back(primitive_ids[p]);
+			}
+		}
+	}
+}
@@ -0,0 +1,270 @@
+#include "BinaryFormat.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace Math3D {
+	namespace {
+		constexpr char Magic[4] = { 'M', '3', 'D', 'B' };
+		constexpr uint32_t SwappedByteOrderMark = 0x04030201u;
+		constexpr size_t NameCapacity = sizeof(SectionEntry::name);
+
+		constexpr uint32_t element_size(ElementType type) {
+			switch (type) {
+			case ElementType::Float: return sizeof(float);
+			case ElementType::Uint32: return sizeof(uint32_t);
+			case ElementType::Vec2f: return sizeof(Vec2f);
+			case ElementType::Vec3f: return sizeof(Vec3f);
+			case ElementType::Vec4f: return sizeof(Vec4f);
+			case ElementType::Quaternion: return sizeof(Quaternion);
+			case ElementType::Xformf: return sizeof(Xformf);
+			case ElementType::Vert3d: return sizeof(Vert3d);
+			case ElementType::AABB: return sizeof(AABB);
+			}
+			return 0;
+		}
+
+		constexpr uint64_t round_up(uint64_t n, uint64_t alignment) {
+			return (n + alignment - 1) / alignment * alignment;
+		}
+
+		// Every offset and size comes from the file, so the bounds checks are written not to overflow
+		bool fits(uint64_t offset, uint64_t bytes, uint64_t size) {
+			return offset <= size && bytes <= size - offset;
+		}
+
+		FormatError check_section(const SectionEntry& entry, uint64_t size) {
+			uint32_t expected = element_size(entry.type);
+			if (expected == 0 || entry.element_size != expected || entry.offset % SectionAlignment != 0) {
+				return FormatError::Layout;
+			}
+			if (!memchr(entry.name, 0, NameCapacity) || entry.name[0] == 0) return FormatError::Layout;
+			if (entry.count > size / expected) return FormatError::Truncated;
+
+			uint64_t stream_bytes = entry.count * expected;
+			if (entry.components == 1) {
+				return entry.stride == 0 && fits(entry.offset, stream_bytes, size) ? FormatError::None : FormatError::Truncated;
+			}
+
+			// VecSoA sections: float streams at a fixed stride, the last one ending inside the file
+			if (entry.type != ElementType::Float || entry.components < 2 || entry.components > 4) return FormatError::Layout;
+			if (entry.stride % SectionAlignment != 0 || entry.stride < stream_bytes) return FormatError::Layout;
+			if (entry.stride > size) return FormatError::Truncated;
+			uint64_t last = entry.offset + (entry.components - 1) * entry.stride;
+			return entry.offset <= size && fits(last, stream_bytes, size) ? FormatError::None : FormatError::Truncated;
+		}
+	}
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept {
+		*this = std::move(other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+		if (this != &other) {
+			close();
+			base = std::exchange(other.base, nullptr);
+			length = std::exchange(other.length, 0);
+#ifdef _WIN32
+			mapping = std::exchange(other.mapping, nullptr);
+#endif
+		}
+		return *this;
+	}
+
+#ifdef _WIN32
+	bool MappedFile::open(const char* path) {
+		close();
+		HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (handle == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER size;
+		bool ok = GetFileSizeEx(handle, &size) != 0;
+		if (ok && size.QuadPart > 0) {
+			// The mapping keeps the file open, so the handle can go once it exists
+			mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			base = mapping ? static_cast<const byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+			length = base ? size_t(size.QuadPart) : 0;
+			ok = base != nullptr;
+		}
+		CloseHandle(handle);
+		if (!ok) close();
+		return ok;
+	}
+
+	void MappedFile::close() {
+		if (base) UnmapViewOfFile(base);
+		if (mapping) CloseHandle(mapping);
+		base = nullptr;
+		mapping = nullptr;
+		length = 0;
+	}
+#else
+	bool MappedFile::open(const char* path) {
+		close();
+		int fd = ::open(path, O_RDONLY);
+		if (fd < 0) return false;
+
+		// The mapping holds its own reference to the file, so the descriptor can go once it exists
+		struct stat info;
+		bool ok = fstat(fd, &info) == 0;
+		if (ok && info.st_size > 0) {
+			void* mapped = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			ok = mapped != MAP_FAILED;
+			if (ok) {
+				base = static_cast<const byte*>(mapped);
+				length = size_t(info.st_size);
+			}
+		}
+		::close(fd);
+		return ok;
+	}
+
+	void MappedFile::close() {
+		if (base) munmap(const_cast<byte*>(base), length);
+		base = nullptr;
+		length = 0;
+	}
+#endif
+
+	FormatError BinaryFile::open(const char* path) {
+		data = {};
+		table = {};
+		if (!file.open(path)) return FormatError::Open;
+		return view(file.bytes());
+	}
+
+	FormatError BinaryFile::view(span<const byte> bytes) {
+		data = {};
+		table = {};
+		if (bytes.size() < sizeof(FileHeader)) return FormatError::Truncated;
+		if (reinterpret_cast<uintptr_t>(bytes.data()) % SectionAlignment != 0) return FormatError::Layout;
+
+		FileHeader header;
+		memcpy(&header, bytes.data(), sizeof(header));
+		if (memcmp(header.magic, Magic, sizeof(Magic)) != 0) return FormatError::Magic;
+		if (header.byte_order == SwappedByteOrderMark) return FormatError::ByteOrder;
+		if (header.byte_order != ByteOrderMark) return FormatError::Layout;
+		if (header.version != FormatVersion) return FormatError::Version;
+
+		uint64_t size = bytes.size();
+		if (header.file_size != size) return FormatError::Truncated;
+		if (header.table_offset % alignof(SectionEntry) != 0) return FormatError::Layout;
+		if (!fits(header.table_offset, uint64_t(header.section_count) * sizeof(SectionEntry), size)) return FormatError::Truncated;
+
+		span<const SectionEntry> entries(reinterpret_cast<const SectionEntry*>(bytes.data() + header.table_offset), header.section_count);
+		for (const SectionEntry& entry : entries) {
+			FormatError error = check_section(entry, size);
+			if (error != FormatError::None) return error;
+		}
+
+		data = bytes;
+		table = entries;
+		return FormatError::None;
+	}
+
+	const SectionEntry* BinaryFile::find(string_view name) const {
+		for (const SectionEntry& entry : table) {
+			if (name == entry.name) return &entry;
+		}
+		return nullptr;
+	}
+
+	BinaryWriter::~BinaryWriter() {
+		if (file) fclose(file);
+	}
+
+	bool BinaryWriter::open(const char* path) {
+		if (file) fclose(file);
+		file = fopen(path, "wb");
+		position = 0;
+		failed = !file;
+		open_section = false;
+		table.clear();
+
+		// Zeros until finish() writes the real header, so the magic is only there once the table is
+		FileHeader placeholder = {};
+		return write(&placeholder, sizeof(placeholder));
+	}
+
+	bool BinaryWriter::begin_section(string_view name, ElementType type, uint32_t element_size) {
+		if (failed || !file || open_section || name.empty() || name.size() >= NameCapacity) return false;
+		if (std::any_of(table.begin(), table.end(), [&](const SectionEntry& entry) { return name == entry.name; })) return false;
+		if (!pad_to(SectionAlignment)) return false;
+
+		current = {};
+		memcpy(current.name, name.data(), name.size());
+		current.type = type;
+		current.element_size = element_size;
+		current.components = 1;
+		current.offset = position;
+		open_section = true;
+		return true;
+	}
+
+	bool BinaryWriter::end() {
+		if (failed || !open_section) return false;
+		current.count = (position - current.offset) / current.element_size;
+		table.push_back(current);
+		open_section = false;
+		return true;
+	}
+
+	bool BinaryWriter::add_soa(string_view name, const float* const* streams, uint32_t components, size_t count) {
+		if (!begin_section(name, ElementType::Float, sizeof(float))) return false;
+		current.components = components;
+		current.count = count;
+		current.stride = round_up(count * sizeof(float), SectionAlignment);
+		for (uint32_t k = 0; k < components; ++k) {
+			if (!pad_to(SectionAlignment) || !write(streams[k], count * sizeof(float))) return false;
+		}
+		table.push_back(current);
+		open_section = false;
+		return true;
+	}
+
+	bool BinaryWriter::finish() {
+		if (failed || !file || open_section || !pad_to(alignof(SectionEntry))) return false;
+
+		FileHeader header = {};
+		memcpy(header.magic, Magic, sizeof(Magic));
+		header.byte_order = ByteOrderMark;
+		header.version = FormatVersion;
+		header.section_count = uint32_t(table.size());
+		header.table_offset = position;
+		header.file_size = position + table.size() * sizeof(SectionEntry);
+
+		bool ok = write(table.data(), table.size() * sizeof(SectionEntry)) && fseek(file, 0, SEEK_SET) == 0 &&
+			fwrite(&header, sizeof(header), 1, file) == 1;
+		ok = fclose(file) == 0 && ok;
+		file = nullptr;
+		failed = !ok;
+		return ok;
+	}
+
+	bool BinaryWriter::write(const void* bytes, size_t size) {
+		if (failed || !file) return false;
+		if (size > 0 && fwrite(bytes, 1, size, file) != size) {
+			failed = true;
+			return false;
+		}
+		position += size;
+		return true;
+	}
+
+	bool BinaryWriter::pad_to(size_t alignment) {
+		static constexpr byte Zeros[SectionAlignment] = {};
+		return write(Zeros, size_t(round_up(position, alignment) - position));
+	}
+}
@@ -0,0 +1,344 @@
+#include "BroadPhase.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+
+namespace Math3D {
+	namespace {
+		template <class Bounds>
+		Bounds bounds_of(const AABB& box) {
+			Bounds b;
+			for (size_t a = 0; a < 3; ++a) {
+				b.lo[a] = box.center[a] - box.halfwidths[a];
+				b.hi[a] = box.center[a] + box.halfwidths[a];
+			}
+			return b;
+		}
+
+		template <class Bounds>
+		bool overlap(const Bounds& a, const Bounds& b) {
+			return a.lo[0] <= b.hi[0] && b.lo[0] <= a.hi[0]
+				&& a.lo[1] <= b.hi[1] && b.lo[1] <= a.hi[1]
+				&& a.lo[2] <= b.hi[2] && b.lo[2] <= a.hi[2];
+		}
+
+		OverlapPair ordered(uint32_t a, uint32_t b) {
+			return a < b ? OverlapPair { a, b } : OverlapPair { b, a };
+		}
+
+		// Min endpoints sort before max endpoints at the same value so touching boxes overlap, as in OverlapAABB
+		bool endpoint_less(float value_a, uint32_t tag_a, float value_b, uint32_t tag_b) {
+			return value_a < value_b || (value_a == value_b && (tag_a & 1) < (tag_b & 1));
+		}
+	}
+
+	SweepAndPrune::Handle SweepAndPrune::add(const AABB& box) {
+		Handle body;
+		if (!free_handles.empty()) {
+			body = free_handles.back();
+			free_handles.pop_back();
+			bounds[body] = bounds_of<Bounds>(box);
+			alive[body] = 1;
+		}
+		else {
+			body = Handle(bounds.size());
+			bounds.push_back(bounds_of<Bounds>(box));
+			alive.push_back(1);
+		}
+
+		// Appended past every other endpoint, which matches the body starting with no pairs; sorting it into
+		// place then finds its overlaps like any other move
+		for (size_t a = 0; a < 3; ++a) {
+			endpoints[a].push_back({ bounds[body].lo[a], body << 1 });
+			endpoints[a].push_back({ bounds[body].hi[a], body << 1 | 1 });
+		}
+		++added_since_sort;
+		return body;
+	}
+
+	void SweepAndPrune::remove(Handle body) {
+		assert(body < alive.size() && alive[body]);
+		alive[body] = 0;
+		free_handles.push_back(body);
+		for (auto& list : endpoints) {
+			std::erase_if(list, [body](const Endpoint& e) { return e.tag >> 1 == body; });
+		}
+
+		for (size_t n = pair_list.size(); n-- > 0;) {
+			OverlapPair pair = pair_list[n];
+			if (pair.a == body || pair.b == body) remove_pair(pair.a, pair.b);
+		}
+	}
+
+	void SweepAndPrune::update(Handle body, const AABB& box) {
+		assert(body < alive.size() && alive[body]);
+		bounds[body] = bounds_of<Bounds>(box);
+	}
+
+	void SweepAndPrune::add_pair(uint32_t a, uint32_t b) {
+		OverlapPair pair = ordered(a, b);
+		uint64_t key = uint64_t(pair.a) << 32 | pair.b;
+		if (pair_index.find(key)) return;
+
+		pair_index.insert(key, uint32_t(pair_list.size()));
+		pair_list.push_back(pair);
+	}
+
+	void SweepAndPrune::remove_pair(uint32_t a, uint32_t b) {
+		OverlapPair pair = ordered(a, b);
+		uint64_t key = uint64_t(pair.a) << 32 | pair.b;
+		uint32_t* at = pair_index.find(key);
+		if (!at) return;
+
+		uint32_t index = *at;
+		OverlapPair last = pair_list.back();
+		pair_list[index] = last;
+		*pair_index.find(uint64_t(last.a) << 32 | last.b) = index;
+		pair_list.pop_back();
+		pair_index.erase(key);
+	}
+
+	void SweepAndPrune::sort_axis(size_t axis) {
+		auto& list = endpoints[axis];
+		for (Endpoint& e : list) {
+			const Bounds& b = bounds[e.tag >> 1];
+			e.value = (e.tag & 1) ? b.hi[axis] : b.lo[axis];
+		}
+
+		for (size_t i = 1; i < list.size(); ++i) {
+			Endpoint e = list[i];
+			size_t j = i;
+			for (; j > 0 && endpoint_less(e.value, e.tag, list[j - 1].value, list[j - 1].tag); --j) {
+				const Endpoint& passed = list[j - 1];
+				uint32_t body = e.tag >> 1, other = passed.tag >> 1;
+				bool is_max = e.tag & 1, passed_max = passed.tag & 1;
+
+				// A min moving below a max starts an overlap on this axis; the pair exists if the boxes now
+				// overlap on the others too. A max moving below a min ends one.
+				if (!is_max && passed_max) {
+					if (overlap(bounds[body], bounds[other])) add_pair(body, other);
+				}
+				else if (is_max && !passed_max && body != other) {
+					remove_pair(body, other);
+				}
+				list[j] = passed;
+			}
+			list[j] = e;
+		}
+	}
+
+	// Full sort of every axis and a single sweep along x to find the pairs from scratch
+	void SweepAndPrune::rebuild() {
+		for (size_t a = 0; a < 3; ++a) {
+			auto& list = endpoints[a];
+			for (Endpoint& e : list) {
+				const Bounds& b = bounds[e.tag >> 1];
+				e.value = (e.tag & 1) ? b.hi[a] : b.lo[a];
+			}
+			std::sort(list.begin(), list.end(), [](const Endpoint& l, const Endpoint& r) {
+				return endpoint_less(l.value, l.tag, r.value, r.tag);
+			});
+		}
+
+		pair_list.clear();
+		pair_index.clear();
+		open.clear();
+		open_slot.resize(bounds.size());
+		for (const Endpoint& e : endpoints[0]) {
+			uint32_t body = e.tag >> 1;
+			if (e.tag & 1) {
+				uint32_t slot = open_slot[body];
+				uint32_t last = open.back();
+				open[slot] = last;
+				open_slot[last] = slot;
+				open.pop_back();
+				continue;
+			}
+
+			for (uint32_t other : open) {
+				if (overlap(bounds[body], bounds[other])) add_pair(body, other);
+			}
+			open_slot[body] = uint32_t(open.size());
+			open.push_back(body);
+		}
+	}
+
+	void SweepAndPrune::find_pairs(vector<OverlapPair>& pairs) {
+		// Insertion sorting a bulk load would be quadratic
+		if (added_since_sort > 32) {
+			rebuild();
+		}
+		else {
+			for (size_t a = 0; a < 3; ++a) sort_axis(a);
+		}
+		added_since_sort = 0;
+		pairs.assign(pair_list.begin(), pair_list.end());
+	}
+
+	size_t SweepAndPrune::PairIndex::home(uint64_t key) const {
+		// Fibonacci hashing; the table size is a power of two
+		return size_t((key * 0x9E3779B97F4A7C15ull) >> 32) & (slots.size() - 1);
+	}
+
+	uint32_t* SweepAndPrune::PairIndex::find(uint64_t key) {
+		if (slots.empty()) return nullptr;
+
+		for (size_t i = home(key);; i = (i + 1) & (slots.size() - 1)) {
+			if (slots[i].key == key) return &slots[i].index;
+			if (slots[i].key == Empty) return nullptr;
+		}
+	}
+
+	void SweepAndPrune::PairIndex::insert(uint64_t key, uint32_t index) {
+		// Kept at most half full so probe runs stay short
+		if ((count + 1) * 2 > slots.size()) {
+			vector<Slot> old = std::move(slots);
+			slots.assign(std::max<size_t>(old.size() * 2, 64), Slot { Empty, 0 });
+			count = 0;
+			for (const Slot& slot : old) {
+				if (slot.key != Empty) insert(slot.key, slot.index);
+			}
+		}
+
+		size_t i = home(key);
+		while (slots[i].key != Empty) i = (i + 1) & (slots.size() - 1);
+		slots[i] = { key, index };
+		++count;
+	}
+
+	// Backward-shift deletion: pull later entries of the probe run into the hole so lookups never need
+	// tombstones
+	void SweepAndPrune::PairIndex::erase(uint64_t key) {
+		size_t mask = slots.size() - 1;
+		size_t hole = home(key);
+		while (slots[hole].key != key) hole = (hole + 1) & mask;
+
+		for (size_t i = (hole + 1) & mask; slots[i].key != Empty; i = (i + 1) & mask) {
+			// Move the entry back if its home is not cyclically within (hole, i]
+			size_t h = home(slots[i].key);
+			if (((i - h) & mask) >= ((i - hole) & mask)) {
+				slots[hole] = slots[i];
+				hole = i;
+			}
+		}
+		slots[hole].key = Empty;
+		--count;
+	}
+
+	void SweepAndPrune::PairIndex::clear() {
+		std::fill(slots.begin(), slots.end(), Slot { Empty, 0 });
+		count = 0;
+	}
+
+	float SpatialHashGrid::tune_cell_size(span<const AABB> bounds) {
+		double total = 0.0;
+		for (const AABB& box : bounds) {
+			total += 2.0 * std::max({ box.halfwidths[0], box.halfwidths[1], box.halfwidths[2] });
+		}
+
+		float mean = bounds.empty() ? 0.0f : float(total / bounds.size());
+		return mean > 0.0f ? mean : 1.0f;
+	}
+
+	void SpatialHashGrid::find_pairs(span<const AABB> bounds, vector<OverlapPair>& pairs) {
+		boxes.resize(bounds.size());
+		for (size_t n = 0; n < bounds.size(); ++n) {
+			boxes[n] = bounds_of<Bounds>(bounds[n]);
+		}
+		find_pairs(pairs);
+	}
+
+	void SpatialHashGrid::find_pairs(span<const Sphere> spheres, vector<OverlapPair>& pairs) {
+		boxes.resize(spheres.size());
+		for (size_t n = 0; n < spheres.size(); ++n) {
+			boxes[n] = bounds_of<Bounds>(BoundingBox(spheres[n]));
+		}
+		find_pairs(pairs);
+	}
+
+	void SpatialHashGrid::find_pairs(vector<OverlapPair>& pairs) {
+		pairs.clear();
+		entries.clear();
+		oversized.clear();
+		is_oversized.assign(boxes.size(), 0);
+
+		const float inv_size = 1.0f / size;
+		auto cell_of = [inv_size](float x) {
+			return int32_t(std::clamp(std::floor(x * inv_size), -1073741824.0f, 1073741823.0f));
+		};
+
+		for (uint32_t body = 0; body < boxes.size(); ++body) {
+			const Bounds& b = boxes[body];
+			int32_t lo[3], hi[3];
+			int64_t cells = 1;
+			for (size_t a = 0; a < 3; ++a) {
+				lo[a] = cell_of(b.lo[a]);
+				hi[a] = cell_of(b.hi[a]);
+				cells *= int64_t(hi[a]) - lo[a] + 1;
+			}
+
+			if (cells > int64_t(MaxCellsPerBody)) {
+				oversized.push_back(body);
+				is_oversized[body] = 1;
+				continue;
+			}
+
+			for (int32_t z = lo[2]; z <= hi[2]; ++z) {
+				for (int32_t y = lo[1]; y <= hi[1]; ++y) {
+					for (int32_t x = lo[0]; x <= hi[0]; ++x) {
+						entries.push_back({ { x, y, z }, body });
+					}
+				}
+			}
+		}
+
+		// Counting sort of the entries into a power of two table at most half full. bucket_start[h] ends up
+		// one past bucket h, so bucket h spans [bucket_start[h - 1], bucket_start[h]).
+		const size_t table = std::bit_ceil(std::max<size_t>(entries.size() * 2, 1));
+		auto bucket = [mask = uint32_t(table - 1)](const Entry& e) {
+			return (uint32_t(e.cell[0]) * 73856093u ^ uint32_t(e.cell[1]) * 19349663u ^ uint32_t(e.cell[2]) * 83492791u) & mask;
+		};
+
+		bucket_start.assign(table + 1, 0);
+		for (const Entry& e : entries) ++bucket_start[bucket(e) + 1];
+		for (size_t h = 0; h < table; ++h) bucket_start[h + 1] += bucket_start[h];
+		by_bucket.resize(entries.size());
+		for (const Entry& e : entries) by_bucket[bucket_start[bucket(e)]++] = e;
+
+		uint32_t begin = 0;
+		for (size_t h = 0; h < table; ++h) {
+			uint32_t end = bucket_start[h];
+			for (uint32_t i = begin; i < end; ++i) {
+				const Entry& a = by_bucket[i];
+				for (uint32_t j = i + 1; j < end; ++j) {
+					const Entry& b = by_bucket[j];
+
+					// Skip hash collisions between different cells
+					if (a.cell[0] != b.cell[0] || a.cell[1] != b.cell[1] || a.cell[2] != b.cell[2]) continue;
+
+					const Bounds& ba = boxes[a.body];
+					const Bounds& bb = boxes[b.body];
+					if (!overlap(ba, bb)) continue;
+
+					// Report from the one shared cell that holds the intersection's low corner
+					bool owner = true;
+					for (size_t k = 0; k < 3; ++k) {
+						owner = owner && cell_of(std::max(ba.lo[k], bb.lo[k])) == a.cell[k];
+					}
+					if (owner) pairs.push_back(ordered(a.body, b.body));
+				}
+			}
+			begin = end;
+		}
+
+		// Oversized bodies against everything; a pair of two of them comes from the lower one
+		for (uint32_t big : oversized) {
+			for (uint32_t body = 0; body < boxes.size(); ++body) {
+				if (body == big || (is_oversized[body] && body < big)) continue;
+				if (overlap(boxes[big], boxes[body])) pairs.push_back(ordered(big, body));
+			}
+		}
+	}
+}
@@ -1,7 +1,150 @@
 #include "GeometricPrimitives.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 namespace Math3D {
 	float HalfSpace3D(const Point& lhs, const Plane& rhs) {
 		return lhs.dot(rhs.n) - rhs.d;
 	}
-}
\ No newline at end of file
+
+	bool RayAABB(const Ray& ray, const AABB& box, float& t) {
+		float t_min = 0.0f;
+		float t_max = std::numeric_limits<float>::infinity();
+		for (size_t a = 0; a < 3; ++a) {
+			float inv = 1.0f / ray.dir[a];
+			float t0 = (box.center[a] - box.halfwidths[a] - ray.point[a]) * inv;
+			float t1 = (box.center[a] + box.halfwidths[a] - ray.point[a]) * inv;
+			if (inv < 0.0f) std::swap(t0, t1);
+
+			// Written so a NaN slab (origin on the slab plane of a parallel ray) leaves the interval alone
+			t_min = t0 > t_min ? t0 : t_min;
+			t_max = t1 < t_max ? t1 : t_max;
+		}
+
+		t = t_min;
+		return t_min <= t_max;
+	}
+
+	bool RayTriangle(const Ray& ray, const Tri3d& tri, float& t, float& u, float& v) {
+		Vec3f e1 = tri.verts[1].pos - tri.verts[0].pos;
+		Vec3f e2 = tri.verts[2].pos - tri.verts[0].pos;
+		Vec3f p = ray.dir.cross(e2);
+		float det = e1.dot(p);
+		if (std::fabs(det) < std::numeric_limits<float>::min()) {
+			return false;
+		}
+
+		float inv_det = 1.0f / det;
+		Vec3f s = ray.point - tri.verts[0].pos;
+		u = s.dot(p) * inv_det;
+		if (u < 0.0f || u > 1.0f) {
+			return false;
+		}
+
+		Vec3f q = s.cross(e1);
+		v = ray.dir.dot(q) * inv_det;
+		if (v < 0.0f || u + v > 1.0f) {
+			return false;
+		}
+
+		t = e2.dot(q) * inv_det;
+		return t >= 0.0f;
+	}
+
+	bool OverlapAABB(const AABB& a, const AABB& b) {
+		for (size_t i = 0; i < 3; ++i) {
+			if (std::fabs(a.center[i] - b.center[i]) > a.halfwidths[i] + b.halfwidths[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool OverlapSphere(const Sphere& a, const Sphere& b) {
+		Vec3f d = a.center - b.center;
+		float r = a.radius + b.radius;
+		return d.dot(d) <= r * r;
+	}
+
+	bool OverlapSphereAABB(const Sphere& sphere, const AABB& box) {
+		// Squared distance from the center to the closest point of the box
+		float distance = 0.0f;
+		for (size_t i = 0; i < 3; ++i) {
+			float excess = std::fabs(sphere.center[i] - box.center[i]) - box.halfwidths[i];
+			if (excess > 0.0f) {
+				distance += excess * excess;
+			}
+		}
+		return distance <= sphere.radius * sphere.radius;
+	}
+
+	AABB BoundingBox(const Sphere& sphere) {
+		return { sphere.center, { sphere.radius, sphere.radius, sphere.radius } };
+	}
+
+	AABB BoundingBox(const Capsule& capsule) {
+		AABB box { (capsule.axis.start + capsule.axis.end) * 0.5f, {} };
+		for (size_t i = 0; i < 3; ++i) {
+			box.halfwidths[i] = std::fabs(capsule.axis.end[i] - capsule.axis.start[i]) * 0.5f + capsule.radius;
+		}
+		return box;
+	}
+
+	Point ClosestPoint(const Segment& segment, const Point& point) {
+		Vec3f d = segment.end - segment.start;
+		float length_sq = d.dot(d);
+		if (length_sq <= std::numeric_limits<float>::min()) {
+			return segment.start;
+		}
+
+		float t = std::clamp((point - segment.start).dot(d) / length_sq, 0.0f, 1.0f);
+		return segment.start + d * t;
+	}
+
+	// Ericson, Real-Time Collision Detection 5.1.9: minimize over s with t following, clamping both to [0, 1]
+	void ClosestPoints(const Segment& a, const Segment& b, Point& on_a, Point& on_b) {
+		constexpr float Tiny = std::numeric_limits<float>::min();
+		Vec3f d1 = a.end - a.start;
+		Vec3f d2 = b.end - b.start;
+		Vec3f r = a.start - b.start;
+		float aa = d1.dot(d1), ee = d2.dot(d2), f = d2.dot(r);
+
+		float s = 0.0f, t = 0.0f;
+		if (aa <= Tiny && ee <= Tiny) {
+			on_a = a.start;
+			on_b = b.start;
+			return;
+		}
+
+		if (aa <= Tiny) {
+			t = std::clamp(f / ee, 0.0f, 1.0f);
+		}
+		else {
+			float c = d1.dot(r);
+			if (ee <= Tiny) {
+				s = std::clamp(-c / aa, 0.0f, 1.0f);
+			}
+			else {
+				float bb = d1.dot(d2);
+				float denom = aa * ee - bb * bb;
+
+				// Parallel segments have no unique closest pair; start from s = 0
+				s = denom > Tiny ? std::clamp((bb * f - c * ee) / denom, 0.0f, 1.0f) : 0.0f;
+				t = (bb * s + f) / ee;
+				if (t < 0.0f) {
+					t = 0.0f;
+					s = std::clamp(-c / aa, 0.0f, 1.0f);
+				}
+				else if (t > 1.0f) {
+					t = 1.0f;
+					s = std::clamp((bb - c) / aa, 0.0f, 1.0f);
+				}
+			}
+		}
+
+		on_a = a.start + d1 * s;
+		on_b = b.start + d2 * t;
+	}
+}
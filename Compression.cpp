@@ -0,0 +1,503 @@
+#include "Compression.h"
+#include "Parallel.h"
+#include "TRSBatch.h"
+#include "Transforms.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numbers>
+
+// AVX2 machines all have F16C; MSVC doesn't define __F16C__ but allows the intrinsics under /arch:AVX2
+#if defined(MATH3D_SIMD_SSE) && (defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__)))
+	#define MATH3D_F16C 1
+#endif
+
+namespace Math3D {
+	namespace {
+		using simd::float4;
+
+		// Elements per parallel_for chunk. Every kernel here costs a few nanoseconds per element, so the
+		// chunks are larger than the transform kernels'.
+		constexpr size_t CompressGrain = 16384;
+
+		// Adding 1.5 * 2^23 to a non-negative float below 2^22 rounds it to nearest even and leaves the
+		// integer in the low mantissa bits, without a branchy per-lane conversion
+		constexpr float RoundingBias = 12582912.0f;
+
+		// Calls fn(first, lanes) for each group of up to four in [0, count), split over parallel_for
+		template <class Fn>
+		void for_each_group(size_t count, Fn&& fn) {
+			parallel_for(count, CompressGrain, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i += 4) fn(i, std::min<size_t>(end - i, 4));
+			});
+		}
+
+		// Padding lanes are zero
+		float4 load_lanes(const float* p, size_t lanes) {
+			if (lanes == 4) return simd::load(p);
+			float scratch[4] = {};
+			std::copy(p, p + lanes, scratch);
+			return simd::load(scratch);
+		}
+
+		void store_lanes(float* p, size_t lanes, float4 v) {
+			if (lanes == 4) {
+				simd::store(p, v);
+				return;
+			}
+			float scratch[4];
+			simd::store(scratch, v);
+			std::copy(scratch, scratch + lanes, p);
+		}
+
+		// [-1, 1] to the nearest of 0 ... max, clamped
+		void quantize4(float4 v, float max, uint32_t (&out)[4]) {
+			float4 half = simd::set1(0.5f);
+			float4 unit = simd::min(simd::max(simd::madd(v, half, half), simd::zero()), simd::set1(1.0f));
+			float biased[4];
+			simd::store(biased, simd::madd(unit, simd::set1(max), simd::set1(RoundingBias)));
+			for (size_t lane = 0; lane < 4; ++lane) out[lane] = std::bit_cast<uint32_t>(biased[lane]) & 0x3FFFFFu;
+		}
+
+		float4 dequantize4(const uint32_t (&in)[4], float max) {
+			float f[4];
+			for (size_t lane = 0; lane < 4; ++lane) f[lane] = float(int32_t(in[lane]));
+			return simd::sub(simd::mul(simd::load(f), simd::set1(2.0f / max)), simd::set1(1.0f));
+		}
+
+		// Four normals onto the octahedron, the lower hemisphere folded over the diagonals of the square
+		template <class T>
+		void encode_oct4(const float4 (&n)[3], OctNormal<T>* out, size_t lanes) {
+			float4 zero = simd::zero(), one = simd::set1(1.0f);
+			float4 l1 = simd::add(simd::add(simd::abs(n[0]), simd::abs(n[1])), simd::abs(n[2]));
+			float4 inv = simd::select(simd::cmplt(zero, l1), simd::div(one, l1), zero);
+			float4 u = simd::mul(n[0], inv), v = simd::mul(n[1], inv);
+
+			float4 lower = simd::cmplt(n[2], zero);
+			float4 folded_u = simd::flip_sign(simd::sub(one, simd::abs(v)), u);
+			float4 folded_v = simd::flip_sign(simd::sub(one, simd::abs(u)), v);
+			u = simd::select(lower, folded_u, u);
+			v = simd::select(lower, folded_v, v);
+
+			uint32_t qu[4], qv[4];
+			quantize4(u, float(OctNormal<T>::Max), qu);
+			quantize4(v, float(OctNormal<T>::Max), qv);
+			for (size_t lane = 0; lane < lanes; ++lane) {
+				out[lane].x = T(qu[lane]);
+				out[lane].y = T(qv[lane]);
+			}
+		}
+
+		template <class T>
+		void decode_oct4(const OctNormal<T>* in, size_t lanes, float4 (&n)[3]) {
+			uint32_t qu[4] = {}, qv[4] = {};
+			for (size_t lane = 0; lane < lanes; ++lane) {
+				qu[lane] = in[lane].x;
+				qv[lane] = in[lane].y;
+			}
+			float4 u = dequantize4(qu, float(OctNormal<T>::Max)), v = dequantize4(qv, float(OctNormal<T>::Max));
+			float4 z = simd::sub(simd::sub(simd::set1(1.0f), simd::abs(u)), simd::abs(v));
+
+			// Unfold the lower hemisphere: move each coordinate back toward zero by the overshoot -z
+			float4 t = simd::max(simd::sub(simd::zero(), z), simd::zero());
+			u = simd::sub(u, simd::flip_sign(t, u));
+			v = simd::sub(v, simd::flip_sign(t, v));
+
+			float4 inv = simd::div(simd::set1(1.0f), simd::sqrt(simd::madd(z, z, simd::madd(v, v, simd::mul(u, u)))));
+			n[0] = simd::mul(u, inv);
+			n[1] = simd::mul(v, inv);
+			n[2] = simd::mul(z, inv);
+		}
+
+		// The box as an offset and scale onto [-1, 1]; flat axes quantize to the middle
+		struct PositionScale {
+			explicit PositionScale(const AABB& bounds) {
+				for (size_t k = 0; k < 3; ++k) {
+					center[k] = bounds.center[k];
+					halfwidth[k] = bounds.halfwidths[k];
+					scale[k] = bounds.halfwidths[k] > 0.0f ? 1.0f / bounds.halfwidths[k] : 0.0f;
+				}
+			}
+
+			float center[3], halfwidth[3], scale[3];
+		};
+
+		void quantize_positions4(const PositionScale& box, const float4 (&p)[3], QuantizedPosition* out, size_t lanes) {
+			uint32_t q[3][4];
+			for (size_t k = 0; k < 3; ++k) {
+				quantize4(simd::mul(simd::sub(p[k], simd::set1(box.center[k])), simd::set1(box.scale[k])), 65535.0f, q[k]);
+			}
+			for (size_t lane = 0; lane < lanes; ++lane) {
+				out[lane].x = uint16_t(q[0][lane]);
+				out[lane].y = uint16_t(q[1][lane]);
+				out[lane].z = uint16_t(q[2][lane]);
+			}
+		}
+
+		void dequantize_positions4(const PositionScale& box, const QuantizedPosition* in, size_t lanes, float4 (&p)[3]) {
+			uint32_t q[3][4] = {};
+			for (size_t lane = 0; lane < lanes; ++lane) {
+				q[0][lane] = in[lane].x;
+				q[1][lane] = in[lane].y;
+				q[2][lane] = in[lane].z;
+			}
+			for (size_t k = 0; k < 3; ++k) {
+				p[k] = simd::madd(dequantize4(q[k], 65535.0f), simd::set1(box.halfwidth[k]), simd::set1(box.center[k]));
+			}
+		}
+
+		// Smallest three on four quaternions as (i, j, k, r) component lanes, Bits per stored component
+		template <uint32_t Bits>
+		struct SmallestThree {
+			static constexpr float Max = float((1u << Bits) - 1);
+
+			// The index of each lane's largest component, ties going to the first, and the other three in
+			// order, negated along with q when the largest is negative
+			static void encode(const float4 (&c)[4], uint32_t (&largest)[4], uint32_t (&rest)[3][4]) {
+				float4 best = simd::abs(c[0]), value = c[0], index = simd::zero();
+				for (size_t k = 1; k < 4; ++k) {
+					float4 magnitude = simd::abs(c[k]);
+					float4 larger = simd::cmplt(best, magnitude);
+					best = simd::select(larger, magnitude, best);
+					value = simd::select(larger, c[k], value);
+					index = simd::select(larger, simd::set1(float(k)), index);
+				}
+
+				// Stored component n is c[n] below the largest and c[n + 1] from it on
+				float4 scale = simd::flip_sign(simd::set1(std::numbers::sqrt2_v<float>), value);
+				for (size_t n = 0; n < 3; ++n) {
+					float4 below = simd::cmplt(simd::set1(float(n)), index);
+					quantize4(simd::mul(simd::select(below, c[n], c[n + 1]), scale), Max, rest[n]);
+				}
+
+				float indices[4];
+				simd::store(indices, index);
+				for (size_t lane = 0; lane < 4; ++lane) largest[lane] = uint32_t(int32_t(indices[lane]));
+			}
+
+			static void decode(const uint32_t (&largest)[4], const uint32_t (&rest)[3][4], float4 (&c)[4]) {
+				float4 r[3], sum = simd::zero();
+				for (size_t n = 0; n < 3; ++n) {
+					r[n] = simd::mul(dequantize4(rest[n], Max), simd::set1(0.5f * std::numbers::sqrt2_v<float>));
+					sum = simd::madd(r[n], r[n], sum);
+				}
+				float4 dropped = simd::sqrt(simd::max(simd::sub(simd::set1(1.0f), sum), simd::zero()));
+
+				float indices[4];
+				for (size_t lane = 0; lane < 4; ++lane) indices[lane] = float(int32_t(largest[lane]));
+				float4 index = simd::load(indices);
+				for (size_t k = 0; k < 4; ++k) {
+					float4 v = dropped;
+					if (k > 0) v = simd::select(simd::cmplt(index, simd::set1(float(k))), r[k - 1], v);
+					if (k < 3) v = simd::select(simd::cmplt(simd::set1(float(k)), index), r[k], v);
+					c[k] = v;
+				}
+			}
+		};
+
+		// Largest index in the top two bits, then 10 bits per component
+		struct Layout32 {
+			using Packed = PackedQuaternion32;
+			using Code = SmallestThree<10>;
+
+			static void pack(uint32_t largest, const uint32_t (&rest)[3], Packed& out) {
+				out.bits = largest << 30 | rest[0] << 20 | rest[1] << 10 | rest[2];
+			}
+
+			static void unpack(const Packed& in, uint32_t& largest, uint32_t (&rest)[3]) {
+				largest = in.bits >> 30;
+				rest[0] = (in.bits >> 20) & 0x3FFu;
+				rest[1] = (in.bits >> 10) & 0x3FFu;
+				rest[2] = in.bits & 0x3FFu;
+			}
+		};
+
+		// Largest index in the low two bits of a 48-bit word, then 15 bits per component, stored low word first
+		struct Layout48 {
+			using Packed = PackedQuaternion48;
+			using Code = SmallestThree<15>;
+
+			static void pack(uint32_t largest, const uint32_t (&rest)[3], Packed& out) {
+				uint64_t word = uint64_t(largest) | uint64_t(rest[0]) << 2 | uint64_t(rest[1]) << 17 | uint64_t(rest[2]) << 32;
+				for (size_t w = 0; w < 3; ++w) out.bits[w] = uint16_t(word >> (16 * w));
+			}
+
+			static void unpack(const Packed& in, uint32_t& largest, uint32_t (&rest)[3]) {
+				uint64_t word = uint64_t(in.bits[0]) | uint64_t(in.bits[1]) << 16 | uint64_t(in.bits[2]) << 32;
+				largest = uint32_t(word) & 3u;
+				rest[0] = uint32_t(word >> 2) & 0x7FFFu;
+				rest[1] = uint32_t(word >> 17) & 0x7FFFu;
+				rest[2] = uint32_t(word >> 32) & 0x7FFFu;
+			}
+		};
+
+		// Packs the component lanes c into lanes quaternions; packed(lane) names the destination of each
+		template <class Layout, class Packed>
+		void encode_quaternions4(const float4 (&c)[4], size_t lanes, Packed&& packed) {
+			uint32_t largest[4], rest[3][4];
+			Layout::Code::encode(c, largest, rest);
+			for (size_t lane = 0; lane < lanes; ++lane) {
+				Layout::pack(largest[lane], { rest[0][lane], rest[1][lane], rest[2][lane] }, packed(lane));
+			}
+		}
+
+		// Padding lanes decode to garbage for the caller to drop
+		template <class Layout, class Packed>
+		void decode_quaternions4(size_t lanes, Packed&& packed, float4 (&c)[4]) {
+			uint32_t largest[4] = {}, rest[3][4] = {};
+			for (size_t lane = 0; lane < lanes; ++lane) {
+				uint32_t r[3];
+				Layout::unpack(packed(lane), largest[lane], r);
+				for (size_t n = 0; n < 3; ++n) rest[n][lane] = r[n];
+			}
+			Layout::Code::decode(largest, rest, c);
+		}
+
+		// AoS quaternions to component lanes and back; padding lanes repeat the first
+		void load_quaternions(const Quaternion* in, size_t lanes, float4 (&c)[4]) {
+			for (size_t lane = 0; lane < 4; ++lane) c[lane] = simd::load(in[lane < lanes ? lane : 0].vals);
+			simd::transpose(c[0], c[1], c[2], c[3]);
+		}
+
+		void store_quaternions(float4 (&c)[4], Quaternion* out, size_t lanes) {
+			simd::transpose(c[0], c[1], c[2], c[3]);
+			for (size_t lane = 0; lane < lanes; ++lane) simd::store(out[lane].vals, c[lane]);
+		}
+
+		template <class Layout>
+		void encode_quaternions_impl(span<const Quaternion> in, span<typename Layout::Packed> out) {
+			MATH_INSTRUMENT(Compression);
+			assert(out.size() >= in.size());
+			for_each_group(in.size(), [&](size_t first, size_t lanes) {
+				float4 c[4];
+				load_quaternions(in.data() + first, lanes, c);
+				encode_quaternions4<Layout>(c, lanes, [&](size_t lane) -> auto& { return out[first + lane]; });
+			});
+		}
+
+		template <class Layout>
+		void decode_quaternions_impl(span<const typename Layout::Packed> in, span<Quaternion> out) {
+			MATH_INSTRUMENT(Compression);
+			assert(out.size() >= in.size());
+			for_each_group(in.size(), [&](size_t first, size_t lanes) {
+				float4 c[4];
+				decode_quaternions4<Layout>(lanes, [&](size_t lane) -> auto& { return in[first + lane]; }, c);
+				store_quaternions(c, out.data() + first, lanes);
+			});
+		}
+
+		template <class T>
+		void encode_normals_impl(const Vec3fSoA& normals, span<OctNormal<T>> out) {
+			MATH_INSTRUMENT(Compression);
+			assert(out.size() >= normals.size());
+			for_each_group(normals.size(), [&](size_t first, size_t lanes) {
+				float4 n[3];
+				for (size_t k = 0; k < 3; ++k) n[k] = load_lanes(normals.streams[k].data() + first, lanes);
+				encode_oct4(n, out.data() + first, lanes);
+			});
+		}
+
+		template <class T>
+		void decode_normals_impl(span<const OctNormal<T>> in, Vec3fSoA& out) {
+			MATH_INSTRUMENT(Compression);
+			if (out.size() != in.size()) out.resize(in.size());
+			for_each_group(in.size(), [&](size_t first, size_t lanes) {
+				float4 n[3];
+				decode_oct4(in.data() + first, lanes, n);
+				for (size_t k = 0; k < 3; ++k) store_lanes(out.streams[k].data() + first, lanes, n[k]);
+			});
+		}
+	}
+
+	// The single element codecs run the batch kernels on one lane, so both give the same codes
+
+	template <class T>
+	OctNormal<T>::OctNormal(const Vec3f& n) {
+		float4 lanes[3] = { simd::set1(n[0]), simd::set1(n[1]), simd::set1(n[2]) };
+		encode_oct4(lanes, this, 1);
+	}
+
+	template <class T>
+	Vec3f OctNormal<T>::decode() const {
+		float4 n[3];
+		decode_oct4(this, 1, n);
+		return Vec3f(simd::lane<0>(n[0]), simd::lane<0>(n[1]), simd::lane<0>(n[2]));
+	}
+
+	template struct OctNormal<uint16_t>;
+	template struct OctNormal<uint8_t>;
+
+	QuantizedPosition::QuantizedPosition(const Vec3f& p, const AABB& bounds) {
+		float4 lanes[3] = { simd::set1(p[0]), simd::set1(p[1]), simd::set1(p[2]) };
+		quantize_positions4(PositionScale(bounds), lanes, this, 1);
+	}
+
+	Vec3f QuantizedPosition::decode(const AABB& bounds) const {
+		float4 p[3];
+		dequantize_positions4(PositionScale(bounds), this, 1, p);
+		return Vec3f(simd::lane<0>(p[0]), simd::lane<0>(p[1]), simd::lane<0>(p[2]));
+	}
+
+	PackedQuaternion32::PackedQuaternion32(const Quaternion& q) {
+		float4 c[4];
+		load_quaternions(&q, 1, c);
+		encode_quaternions4<Layout32>(c, 1, [this](size_t) -> auto& { return *this; });
+	}
+
+	Quaternion PackedQuaternion32::decode() const {
+		float4 c[4];
+		decode_quaternions4<Layout32>(1, [this](size_t) -> auto& { return *this; }, c);
+		Quaternion q;
+		store_quaternions(c, &q, 1);
+		return q;
+	}
+
+	PackedQuaternion48::PackedQuaternion48(const Quaternion& q) {
+		float4 c[4];
+		load_quaternions(&q, 1, c);
+		encode_quaternions4<Layout48>(c, 1, [this](size_t) -> auto& { return *this; });
+	}
+
+	Quaternion PackedQuaternion48::decode() const {
+		float4 c[4];
+		decode_quaternions4<Layout48>(1, [this](size_t) -> auto& { return *this; }, c);
+		Quaternion q;
+		store_quaternions(c, &q, 1);
+		return q;
+	}
+
+	PackedTRS::PackedTRS(const Xformf& xform) {
+		Quaternion r;
+		Vec3f t, s;
+		decompose(xform, r, t, s);
+		for (size_t k = 0; k < 3; ++k) {
+			translation[k] = t[k];
+			scale[k] = to_half(s[k]);
+		}
+		rotation = PackedQuaternion48(r);
+	}
+
+	Xformf PackedTRS::decode() const {
+		return compose(rotation.decode(), Vec3f(translation[0], translation[1], translation[2]),
+			Vec3f(from_half(scale[0]), from_half(scale[1]), from_half(scale[2])));
+	}
+
+	void encode_normals(const Vec3fSoA& normals, span<OctNormal32> out) { encode_normals_impl(normals, out); }
+	void encode_normals(const Vec3fSoA& normals, span<OctNormal16> out) { encode_normals_impl(normals, out); }
+	void decode_normals(span<const OctNormal32> in, Vec3fSoA& out) { decode_normals_impl(in, out); }
+	void decode_normals(span<const OctNormal16> in, Vec3fSoA& out) { decode_normals_impl(in, out); }
+
+	void encode_uvs(const Vec2fSoA& uvs, span<HalfUV> out) {
+		MATH_INSTRUMENT(Compression);
+		assert(out.size() >= uvs.size());
+		const float* u = uvs.streams[0].data();
+		const float* v = uvs.streams[1].data();
+		parallel_for(uvs.size(), CompressGrain, [&](size_t begin, size_t end) {
+			size_t i = begin;
+#if defined(MATH3D_F16C)
+			// Four u and four v halves interleaved into one 16-byte store
+			for (; i + 4 <= end; i += 4) {
+				__m128i hu = _mm_cvtps_ph(_mm_loadu_ps(u + i), _MM_FROUND_TO_NEAREST_INT);
+				__m128i hv = _mm_cvtps_ph(_mm_loadu_ps(v + i), _MM_FROUND_TO_NEAREST_INT);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out.data() + i), _mm_unpacklo_epi16(hu, hv));
+			}
+#endif
+			for (; i < end; ++i) out[i] = HalfUV(Vec2f(u[i], v[i]));
+		});
+	}
+
+	void decode_uvs(span<const HalfUV> in, Vec2fSoA& out) {
+		MATH_INSTRUMENT(Compression);
+		if (out.size() != in.size()) out.resize(in.size());
+		float* u = out.streams[0].data();
+		float* v = out.streams[1].data();
+		parallel_for(in.size(), CompressGrain, [&](size_t begin, size_t end) {
+			size_t i = begin;
+#if defined(MATH3D_F16C)
+			for (; i + 4 <= end; i += 4) {
+				__m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in.data() + i));
+				__m128 lo = _mm_cvtph_ps(h), hi = _mm_cvtph_ps(_mm_unpackhi_epi64(h, h));
+				_mm_storeu_ps(u + i, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+				_mm_storeu_ps(v + i, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+			}
+#endif
+			for (; i < end; ++i) {
+				u[i] = from_half(in[i].u);
+				v[i] = from_half(in[i].v);
+			}
+		});
+	}
+
+	void quantize_positions(const AABB& bounds, const Vec3fSoA& positions, span<QuantizedPosition> out) {
+		MATH_INSTRUMENT(Compression);
+		assert(out.size() >= positions.size());
+		PositionScale box(bounds);
+		for_each_group(positions.size(), [&](size_t first, size_t lanes) {
+			float4 p[3];
+			for (size_t k = 0; k < 3; ++k) p[k] = load_lanes(positions.streams[k].data() + first, lanes);
+			quantize_positions4(box, p, out.data() + first, lanes);
+		});
+	}
+
+	void dequantize_positions(const AABB& bounds, span<const QuantizedPosition> in, Vec3fSoA& out) {
+		MATH_INSTRUMENT(Compression);
+		if (out.size() != in.size()) out.resize(in.size());
+		PositionScale box(bounds);
+		for_each_group(in.size(), [&](size_t first, size_t lanes) {
+			float4 p[3];
+			dequantize_positions4(box, in.data() + first, lanes, p);
+			for (size_t k = 0; k < 3; ++k) store_lanes(out.streams[k].data() + first, lanes, p[k]);
+		});
+	}
+
+	void encode_quaternions(span<const Quaternion> in, span<PackedQuaternion32> out) { encode_quaternions_impl<Layout32>(in, out); }
+	void encode_quaternions(span<const Quaternion> in, span<PackedQuaternion48> out) { encode_quaternions_impl<Layout48>(in, out); }
+	void decode_quaternions(span<const PackedQuaternion32> in, span<Quaternion> out) { decode_quaternions_impl<Layout32>(in, out); }
+	void decode_quaternions(span<const PackedQuaternion48> in, span<Quaternion> out) { decode_quaternions_impl<Layout48>(in, out); }
+
+	// Each chunk goes through a TRSBatch so decompose and compose run four at a time, and the rotations are
+	// packed straight from its component streams
+	void encode_transforms(span<const Xformf> in, span<PackedTRS> out) {
+		MATH_INSTRUMENT(Compression);
+		assert(out.size() >= in.size());
+		parallel_for(in.size(), CompressGrain, [&](size_t begin, size_t end) {
+			TRSBatch trs;
+			decompose(in.subspan(begin, end - begin), trs);
+			PackedTRS* packed = out.data() + begin;
+			for (size_t first = 0; first < trs.size(); first += 4) {
+				size_t lanes = std::min<size_t>(trs.size() - first, 4);
+				float4 c[4];
+				for (size_t k = 0; k < 4; ++k) c[k] = load_lanes(trs.rotation.streams[k].data() + first, lanes);
+				encode_quaternions4<Layout48>(c, lanes, [&](size_t lane) -> auto& { return packed[first + lane].rotation; });
+			}
+			for (size_t i = 0; i < trs.size(); ++i) {
+				for (size_t k = 0; k < 3; ++k) {
+					packed[i].translation[k] = trs.translation.streams[k][i];
+					packed[i].scale[k] = to_half(trs.scale.streams[k][i]);
+				}
+			}
+		});
+	}
+
+	void decode_transforms(span<const PackedTRS> in, span<Xformf> out) {
+		MATH_INSTRUMENT(Compression);
+		assert(out.size() >= in.size());
+		parallel_for(in.size(), CompressGrain, [&](size_t begin, size_t end) {
+			TRSBatch trs(end - begin);
+			const PackedTRS* packed = in.data() + begin;
+			for (size_t first = 0; first < trs.size(); first += 4) {
+				size_t lanes = std::min<size_t>(trs.size() - first, 4);
+				float4 c[4];
+				decode_quaternions4<Layout48>(lanes, [&](size_t lane) -> auto& { return packed[first + lane].rotation; }, c);
+				for (size_t k = 0; k < 4; ++k) store_lanes(trs.rotation.streams[k].data() + first, lanes, c[k]);
+			}
+			for (size_t i = 0; i < trs.size(); ++i) {
+				for (size_t k = 0; k < 3; ++k) {
+					trs.translation.streams[k][i] = packed[i].translation[k];
+					trs.scale.streams[k][i] = from_half(packed[i].scale[k]);
+				}
+			}
+			compose(trs, out.subspan(begin, end - begin));
+		});
+	}
+}
@@ -0,0 +1,41 @@
+#include "DualQuaternion.h"
+#include "Transforms.h"
+
+namespace Math3D {
+	DualQuaternion::DualQuaternion(const Quaternion& rotation, const Vec3f& translation)
+		: real(rotation), dual(rotation * Quaternion(translation[0], translation[1], translation[2], 0.0f) * 0.5f) {}
+
+	DualQuaternion::DualQuaternion(const Xformf& xform) {
+		Vec3f translation, scale_factors;
+		decompose(xform, real, translation, scale_factors);
+		*this = DualQuaternion(real, translation);
+	}
+
+	DualQuaternion DualQuaternion::operator*(const DualQuaternion& q) const {
+		return DualQuaternion(real * q.real, real * q.dual + dual * q.real);
+	}
+
+	DualQuaternion DualQuaternion::Normalize() const {
+		float inv = 1.0f / real.Mag();
+		return DualQuaternion(real * inv, dual * inv);
+	}
+
+	// 2 conj(real) dual, the inverse of the constructor's dual = real (t, 0) / 2
+	Vec3f DualQuaternion::Translation() const {
+		Quaternion t = real.Conjugate() * dual;
+		return Vec3f(t.i, t.j, t.k) * 2.0f;
+	}
+
+	Xformf DualQuaternion::ToXform() const {
+		return compose(real, Translation(), Vec3f(1.0f, 1.0f, 1.0f));
+	}
+
+	Vec3f DualQuaternion::TransformPoint(const Vec3f& p) const {
+		return TransformVector(p) + Translation();
+	}
+
+	Vec3f DualQuaternion::TransformVector(const Vec3f& v) const {
+		Xformf rot = real.ToRot();
+		return Vec3f(rot[0]) * v[0] + Vec3f(rot[1]) * v[1] + Vec3f(rot[2]) * v[2];
+	}
+}
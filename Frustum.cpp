@@ -0,0 +1,180 @@
+#include "Frustum.h"
+#include "Parallel.h"
+#include "SIMD.h"
+
+#include <cassert>
+#include <cmath>
+
+namespace Math3D {
+	namespace {
+		// Objects per parallel_for chunk, a multiple of 64 so chunks never share a mask word
+		constexpr size_t CullGrain = 16384;
+
+		// A frustum plane broadcast across lanes, with |n| for box extents
+		struct PlaneLanes {
+			simd::float4 nx, ny, nz, d;
+			simd::float4 ax, ay, az;
+		};
+
+		void broadcast(const Frustum& frustum, PlaneLanes (&lanes)[Frustum::Sides]) {
+			using namespace simd;
+			for (size_t p = 0; p < Frustum::Sides; ++p) {
+				const Plane& plane = frustum.planes[p];
+				lanes[p] = { set1(plane.n[0]), set1(plane.n[1]), set1(plane.n[2]), set1(plane.d),
+					set1(std::fabs(plane.n[0])), set1(std::fabs(plane.n[1])), set1(std::fabs(plane.n[2])) };
+			}
+		}
+
+		// Spheres and boxes differ only in how far they reach towards a plane
+		struct SphereReach {
+			simd::float4 r;
+			simd::float4 operator()(const PlaneLanes&) const { return r; }
+		};
+
+		struct BoxReach {
+			simd::float4 hx, hy, hz;
+			simd::float4 operator()(const PlaneLanes& p) const {
+				return simd::add(simd::add(simd::mul(p.ax, hx), simd::mul(p.ay, hy)), simd::mul(p.az, hz));
+			}
+		};
+
+		template <class Reach>
+		simd::float4 outside_plane(const PlaneLanes& plane, simd::float4 cx, simd::float4 cy, simd::float4 cz, const Reach& reach) {
+			using namespace simd;
+			float4 projected = add(add(mul(plane.nx, cx), mul(plane.ny, cy)), mul(plane.nz, cz));
+			return cmplt(add(projected, reach(plane)), plane.d);
+		}
+
+		// Visible lanes of one group of four. The cached plane is tried alone first, since it usually rejects
+		// the group again; otherwise all six planes are tested without branching, and one that rejects all
+		// four lanes by itself goes back into the cache.
+		template <class Reach>
+		uint32_t cull_group(const PlaneLanes (&planes)[Frustum::Sides], simd::float4 cx, simd::float4 cy, simd::float4 cz,
+			const Reach& reach, uint8_t* cache) {
+			using namespace simd;
+			if (cache && movemask(outside_plane(planes[*cache % Frustum::Sides], cx, cy, cz, reach)) == 0xF) return 0;
+
+			float4 outside = zero();
+			uint32_t rejected_by = 0;
+			for (size_t p = 0; p < Frustum::Sides; ++p) {
+				float4 out = outside_plane(planes[p], cx, cy, cz, reach);
+				outside = bit_or(outside, out);
+				if (cache) rejected_by = movemask(out) == 0xF ? uint32_t(p) : rejected_by;
+			}
+			uint32_t visible = ~movemask(outside) & 0xF;
+			if (cache && !visible) *cache = uint8_t(rejected_by);
+			return visible;
+		}
+
+		// Shared driver for spheres (3 center streams plus radius) and boxes (3 center plus 3 halfwidth
+		// streams). Works through [begin, end) one view at a time so the chunk stays in cache across views.
+		template <size_t Streams>
+		void cull_range(span<const Frustum> frustums, const array<const float*, Streams>& streams, size_t count,
+			size_t begin, size_t end, span<uint64_t> visible, span<uint8_t> plane_cache) {
+			using namespace simd;
+			const size_t words = VisibilityWords(count), groups = PlaneCacheSize(count);
+
+			for (size_t v = 0; v < frustums.size(); ++v) {
+				PlaneLanes planes[Frustum::Sides];
+				broadcast(frustums[v], planes);
+				uint64_t* mask = visible.data() + v * words;
+				uint8_t* cache = plane_cache.empty() ? nullptr : plane_cache.data() + v * groups;
+
+				for (size_t i = begin; i < end; i += 4) {
+					float4xN<Streams> in;
+					if (i + 4 <= count) {
+						for (size_t k = 0; k < Streams; ++k) in[k] = load(streams[k] + i);
+					}
+					else {
+						// Tail lanes are padded with zeros and masked off below
+						float scratch[4] = {};
+						for (size_t k = 0; k < Streams; ++k) {
+							for (size_t j = 0; i + j < count; ++j) scratch[j] = streams[k][i + j];
+							in[k] = load(scratch);
+						}
+					}
+
+					uint8_t* group_cache = cache ? cache + i / 4 : nullptr;
+					uint32_t lanes;
+					if constexpr (Streams == 4) lanes = cull_group(planes, in[0], in[1], in[2], SphereReach { in[3] }, group_cache);
+					else lanes = cull_group(planes, in[0], in[1], in[2], BoxReach { in[3], in[4], in[5] }, group_cache);
+
+					if (i % 64 == 0) mask[i / 64] = 0;
+					mask[i / 64] |= uint64_t(lanes) << (i % 64);
+				}
+
+				if (end == count && count % 64) mask[words - 1] &= (uint64_t(1) << (count % 64)) - 1;
+			}
+		}
+
+		template <size_t Streams>
+		void cull(span<const Frustum> frustums, const array<const float*, Streams>& streams, size_t count,
+			span<uint64_t> visible, span<uint8_t> plane_cache) {
+			MATH_INSTRUMENT(FrustumCull);
+			assert(visible.size() >= frustums.size() * VisibilityWords(count));
+			assert(plane_cache.empty() || plane_cache.size() >= frustums.size() * PlaneCacheSize(count));
+			parallel_for(count, CullGrain, [&](size_t begin, size_t end) {
+				cull_range(frustums, streams, count, begin, end, visible, plane_cache);
+			});
+		}
+
+		array<const float*, 4> streams_of(const SphereSoA& spheres) {
+			return { spheres.center.streams[0].data(), spheres.center.streams[1].data(), spheres.center.streams[2].data(), spheres.radius.data() };
+		}
+
+		array<const float*, 6> streams_of(const AABBSoA& boxes) {
+			return { boxes.center.streams[0].data(), boxes.center.streams[1].data(), boxes.center.streams[2].data(),
+				boxes.halfwidths.streams[0].data(), boxes.halfwidths.streams[1].data(), boxes.halfwidths.streams[2].data() };
+		}
+	}
+
+	Frustum ExtractFrustum(const Mat4f& view_projection) {
+		// Column j of the matrix maps a point to clip coordinate j, so each clip inequality is a plane
+		auto column = [&](size_t j) { return Vec4f(view_projection[0][j], view_projection[1][j], view_projection[2][j], view_projection[3][j]); };
+		Vec4f x = column(0), y = column(1), z = column(2), w = column(3);
+
+		// -w <= x <= w, -w <= y <= w, 0 <= z <= w
+		const Vec4f sides[Frustum::Sides] = { w + x, w - x, w + y, w - y, z, w - z };
+
+		Frustum frustum;
+		for (size_t p = 0; p < Frustum::Sides; ++p) {
+			Vec3f n(sides[p][0], sides[p][1], sides[p][2]);
+			float inv_length = 1.0f / n.length();
+			frustum.planes[p] = { n * inv_length, -sides[p][3] * inv_length };
+		}
+		return frustum;
+	}
+
+	// Written as n.c + reach < d, operation for operation what the batch kernels do, so both agree on
+	// objects touching a plane
+	bool OverlapFrustumSphere(const Frustum& frustum, const Sphere& sphere) {
+		for (const Plane& plane : frustum.planes) {
+			if (sphere.center.dot(plane.n) + sphere.radius < plane.d) return false;
+		}
+		return true;
+	}
+
+	bool OverlapFrustumAABB(const Frustum& frustum, const AABB& box) {
+		for (const Plane& plane : frustum.planes) {
+			float reach = std::fabs(plane.n[0]) * box.halfwidths[0] + std::fabs(plane.n[1]) * box.halfwidths[1] + std::fabs(plane.n[2]) * box.halfwidths[2];
+			if (box.center.dot(plane.n) + reach < plane.d) return false;
+		}
+		return true;
+	}
+
+	void CullSpheres(const Frustum& frustum, const SphereSoA& spheres, span<uint64_t> visible, span<uint8_t> plane_cache) {
+		cull(span<const Frustum>(&frustum, 1), streams_of(spheres), spheres.size(), visible, plane_cache);
+	}
+
+	void CullAABBs(const Frustum& frustum, const AABBSoA& boxes, span<uint64_t> visible, span<uint8_t> plane_cache) {
+		cull(span<const Frustum>(&frustum, 1), streams_of(boxes), boxes.size(), visible, plane_cache);
+	}
+
+	void CullSpheres(span<const Frustum> frustums, const SphereSoA& spheres, span<uint64_t> visible, span<uint8_t> plane_cache) {
+		cull(frustums, streams_of(spheres), spheres.size(), visible, plane_cache);
+	}
+
+	void CullAABBs(span<const Frustum> frustums, const AABBSoA& boxes, span<uint64_t> visible, span<uint8_t> plane_cache) {
+		cull(frustums, streams_of(boxes), boxes.size(), visible, plane_cache);
+	}
+}
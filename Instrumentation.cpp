@@ -0,0 +1,131 @@
+#include "Instrumentation.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+namespace Math3D::instrumentation {
+	namespace {
+		constexpr const char* Names[] = {
+			"MatrixMultiply",
+			"MatrixMultiplySIMD",
+			"MatrixDeterminant",
+			"MatrixDeterminantGeneric",
+			"MatrixAdjoint",
+			"MatrixAdjointGeneric",
+			"MatrixInverse",
+			"MatrixInverseGeneric",
+			"QuaternionFromMatrix",
+			"QuaternionToMatrix",
+			"QuaternionSlerp",
+			"Compose",
+			"Decompose",
+			"TransformPoints",
+			"TransformVectors",
+			"TransformNormals",
+			"ProjectPoints",
+			"QuaternionBatch",
+			"FrustumCull",
+			"ViewSpace",
+			"Skinning",
+			"Mesh",
+			"Compression",
+			"Animation",
+		};
+		static_assert(std::size(Names) == size_t(Counter::Count));
+
+#if defined(MATH_ENABLE_INSTRUMENTATION)
+		// Live threads' counters, plus the totals of threads that have exited
+		struct Registry {
+			std::mutex mutex;
+			std::vector<ThreadCounters*> live;
+			Stats retired[size_t(Counter::Count)];
+		};
+
+		// Never destroyed, so threads exiting during static destruction can still retire their counts
+		Registry& registry() {
+			static Registry* r = new Registry;
+			return *r;
+		}
+#endif
+	}
+
+#if defined(MATH_ENABLE_INSTRUMENTATION)
+	ThreadCounters::ThreadCounters() {
+		Registry& r = registry();
+		std::lock_guard lock(r.mutex);
+		r.live.push_back(this);
+	}
+
+	ThreadCounters::~ThreadCounters() {
+		Registry& r = registry();
+		std::lock_guard lock(r.mutex);
+		for (size_t c = 0; c < size_t(Counter::Count); ++c) {
+			r.retired[c].calls += slots[c].calls.load(std::memory_order_relaxed) - slots[c].reset_calls;
+			r.retired[c].cycles += slots[c].cycles.load(std::memory_order_relaxed) - slots[c].reset_cycles;
+		}
+		r.live.erase(std::find(r.live.begin(), r.live.end(), this));
+	}
+#endif
+
+	const char* name(Counter counter) {
+		return size_t(counter) < size_t(Counter::Count) ? Names[size_t(counter)] : "Unknown";
+	}
+
+	Stats stats(Counter counter) {
+		Stats total;
+#if defined(MATH_ENABLE_INSTRUMENTATION)
+		Registry& r = registry();
+		std::lock_guard lock(r.mutex);
+		total = r.retired[size_t(counter)];
+		for (const ThreadCounters* t : r.live) {
+			const ThreadCounters::Slot& slot = t->slots[size_t(counter)];
+			total.calls += slot.calls.load(std::memory_order_relaxed) - slot.reset_calls;
+			total.cycles += slot.cycles.load(std::memory_order_relaxed) - slot.reset_cycles;
+		}
+#else
+		(void)counter;
+#endif
+		return total;
+	}
+
+	void reset() {
+#if defined(MATH_ENABLE_INSTRUMENTATION)
+		Registry& r = registry();
+		std::lock_guard lock(r.mutex);
+		for (size_t c = 0; c < size_t(Counter::Count); ++c) {
+			r.retired[c] = {};
+			for (ThreadCounters* t : r.live) {
+				ThreadCounters::Slot& slot = t->slots[c];
+				slot.reset_calls = slot.calls.load(std::memory_order_relaxed);
+				slot.reset_cycles = slot.cycles.load(std::memory_order_relaxed);
+			}
+		}
+#endif
+	}
+
+	std::string to_json() {
+		std::string json = std::string("{\"enabled\": ") + (enabled ? "true" : "false") + ", \"counters\": {";
+		for (size_t c = 0; c < size_t(Counter::Count); ++c) {
+			Stats s = stats(Counter(c));
+			char entry[160];
+			std::snprintf(entry, sizeof(entry), "%s\"%s\": {\"calls\": %llu, \"cycles\": %llu}", c ? ", " : "", Names[c],
+				(unsigned long long)s.calls, (unsigned long long)s.cycles);
+			json += entry;
+		}
+		return json + "}}";
+	}
+
+	bool dump_json(const char* path) {
+		FILE* f = std::fopen(path, "w");
+		if (!f) {
+			return false;
+		}
+
+		std::string json = to_json();
+		bool ok = std::fwrite(json.data(), 1, json.size(), f) == json.size();
+		return std::fclose(f) == 0 && ok;
+	}
+}
@@ -0,0 +1,437 @@
+#include "Mesh.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace Math3D {
+	namespace {
+		using simd::float4;
+
+		// Triangles or vertices per parallel_for chunk. The bounds reductions combine per-chunk results, so
+		// they come out the same on any number of threads.
+		constexpr size_t MeshGrain = 4096;
+
+		size_t chunk_count(size_t count) { return (count + MeshGrain - 1) / MeshGrain; }
+
+		// Calls fn(first, lanes) for the groups of four in [begin, end); the last one may have fewer lanes
+		template <class Fn>
+		void for_each_group(size_t begin, size_t end, Fn&& fn) {
+			size_t n = begin;
+			for (; n + 4 <= end; n += 4) fn(n, size_t(4));
+			if (n < end) fn(n, end - n);
+		}
+
+		// Loads lanes elements from stream + first; padding lanes repeat element first
+		float4 load_lanes(const float* stream, size_t first, size_t lanes) {
+			if (lanes == 4) return simd::load(stream + first);
+			float scratch[4];
+			for (size_t lane = 0; lane < 4; ++lane) scratch[lane] = stream[first + (lane < lanes ? lane : 0)];
+			return simd::load(scratch);
+		}
+
+		void store_lanes(float* stream, size_t first, size_t lanes, float4 v) {
+			if (lanes == 4) {
+				simd::store(stream + first, v);
+				return;
+			}
+			float scratch[4];
+			simd::store(scratch, v);
+			for (size_t lane = 0; lane < lanes; ++lane) stream[first + lane] = scratch[lane];
+		}
+
+		float4 gather(const float* stream, const uint32_t (&idx)[4]) {
+			return simd::set(stream[idx[0]], stream[idx[1]], stream[idx[2]], stream[idx[3]]);
+		}
+
+		using simd::dot3;
+
+		void cross3(const float4 (&a)[3], const float4 (&b)[3], float4 (&out)[3]) {
+			out[0] = simd::sub(simd::mul(a[1], b[2]), simd::mul(a[2], b[1]));
+			out[1] = simd::sub(simd::mul(a[2], b[0]), simd::mul(a[0], b[2]));
+			out[2] = simd::sub(simd::mul(a[0], b[1]), simd::mul(a[1], b[0]));
+		}
+
+		// 1 / |v| per lane, zero where v is zero
+		float4 inverse_length(const float4 (&v)[3]) {
+			float4 length_sq = dot3(v, v);
+			return simd::select(simd::cmplt(simd::zero(), length_sq), simd::div(simd::set1(1.0f), simd::sqrt(length_sq)), simd::zero());
+		}
+
+		// The vertices of four triangles from first, corner by corner; padding lanes repeat triangle first
+		struct TriangleGroup {
+			uint32_t idx[3][4];
+
+			TriangleGroup(span<const uint32_t> indices, size_t first, size_t lanes) {
+				for (size_t lane = 0; lane < 4; ++lane) {
+					size_t t = first + (lane < lanes ? lane : 0);
+					for (size_t c = 0; c < 3; ++c) idx[c][lane] = indices[3 * t + c];
+				}
+			}
+
+			template <size_t W>
+			void load(const VecSoA<float, W>& attribute, float4 (&out)[3][W]) const {
+				for (size_t c = 0; c < 3; ++c) {
+					for (size_t k = 0; k < W; ++k) out[c][k] = gather(attribute.streams[k].data(), idx[c]);
+				}
+			}
+		};
+
+		// cross(p1 - p0, p2 - p0), twice the area in length
+		void area_normals(const float4 (&p)[3][3], float4 (&out)[3]) {
+			float4 e1[3], e2[3];
+			for (size_t k = 0; k < 3; ++k) {
+				e1[k] = simd::sub(p[1][k], p[0][k]);
+				e2[k] = simd::sub(p[2][k], p[0][k]);
+			}
+			cross3(e1, e2, out);
+		}
+
+		template <bool Normalize>
+		void face_normal_range(const Vec3fSoA& positions, span<const uint32_t> indices, Vec3fSoA& out, size_t begin, size_t end) {
+			for_each_group(begin, end, [&](size_t first, size_t lanes) {
+				float4 p[3][3], n[3];
+				TriangleGroup(indices, first, lanes).load(positions, p);
+				area_normals(p, n);
+				if constexpr (Normalize) {
+					float4 inv = inverse_length(n);
+					for (float4& v : n) v = simd::mul(v, inv);
+				}
+				for (size_t k = 0; k < 3; ++k) store_lanes(out.streams[k].data(), first, lanes, n[k]);
+			});
+		}
+
+		// Adds attribute over the triangles around each of four vertices, in adjacency order
+		template <size_t W>
+		void sum_around(const VertexTriangles& adjacency, const VecSoA<float, W>& attribute, size_t first, size_t lanes, float4 (&out)[W]) {
+			float sums[W][4] = {};
+			for (size_t lane = 0; lane < lanes; ++lane) {
+				for (uint32_t t : adjacency.around(first + lane)) {
+					for (size_t k = 0; k < W; ++k) sums[k][lane] += attribute.streams[k][t];
+				}
+			}
+			for (size_t k = 0; k < W; ++k) out[k] = simd::load(sums[k]);
+		}
+
+		void check_mesh(span<const uint32_t> indices, const VertexTriangles& adjacency, size_t vertex_count) {
+			assert(indices.size() % 3 == 0);
+			assert(adjacency.vertex_count() == vertex_count);
+			assert(adjacency.triangles.size() == indices.size());
+			(void)indices; (void)adjacency; (void)vertex_count;
+		}
+
+		// Points extreme along x, y and z: lo[a][k] is component k of the point with the least component a
+		struct Extremes {
+			Vec3f lo[3], hi[3];
+
+			// Strict comparisons keep the earlier point on ties
+			void merge(const Extremes& e) {
+				for (size_t a = 0; a < 3; ++a) {
+					if (e.lo[a][a] < lo[a][a]) lo[a] = e.lo[a];
+					if (hi[a][a] < e.hi[a][a]) hi[a] = e.hi[a];
+				}
+			}
+		};
+
+		Extremes extremes_range(const Vec3fSoA& positions, size_t begin, size_t end) {
+			float4 lo[3][3], hi[3][3];
+			for (size_t k = 0; k < 3; ++k) {
+				float4 p = load_lanes(positions.streams[k].data(), begin, std::min<size_t>(end - begin, 4));
+				for (size_t a = 0; a < 3; ++a) lo[a][k] = hi[a][k] = p;
+			}
+
+			for_each_group(begin, end, [&](size_t first, size_t lanes) {
+				float4 p[3];
+				for (size_t k = 0; k < 3; ++k) p[k] = load_lanes(positions.streams[k].data(), first, lanes);
+				for (size_t a = 0; a < 3; ++a) {
+					float4 below = simd::cmplt(p[a], lo[a][a]);
+					float4 above = simd::cmplt(hi[a][a], p[a]);
+					for (size_t k = 0; k < 3; ++k) {
+						lo[a][k] = simd::select(below, p[k], lo[a][k]);
+						hi[a][k] = simd::select(above, p[k], hi[a][k]);
+					}
+				}
+			});
+
+			// Ties between lanes go to the lower lane: not always the earlier point, but the same on every run
+			float lanes_lo[3][3][4], lanes_hi[3][3][4];
+			for (size_t a = 0; a < 3; ++a) {
+				for (size_t k = 0; k < 3; ++k) {
+					simd::store(lanes_lo[a][k], lo[a][k]);
+					simd::store(lanes_hi[a][k], hi[a][k]);
+				}
+			}
+
+			Extremes result;
+			for (size_t lane = 0; lane < 4; ++lane) {
+				Extremes e;
+				for (size_t a = 0; a < 3; ++a) {
+					e.lo[a] = Vec3f(lanes_lo[a][0][lane], lanes_lo[a][1][lane], lanes_lo[a][2][lane]);
+					e.hi[a] = Vec3f(lanes_hi[a][0][lane], lanes_hi[a][1][lane], lanes_hi[a][2][lane]);
+				}
+				if (lane == 0) result = e;
+				else result.merge(e);
+			}
+			return result;
+		}
+
+		// Ritter's step: the smallest sphere holding sphere and point
+		void grow(Sphere& sphere, const Vec3f& point) {
+			Vec3f d = point - sphere.center;
+			float dist = d.length();
+			if (dist <= sphere.radius) return;
+			float radius = (sphere.radius + dist) * 0.5f;
+			sphere.center = sphere.center + d * ((radius - sphere.radius) / dist);
+			sphere.radius = radius;
+		}
+
+		// The smallest sphere holding both
+		Sphere enclose(const Sphere& a, const Sphere& b) {
+			Vec3f d = b.center - a.center;
+			float dist = d.length();
+			if (dist + b.radius <= a.radius) return a;
+			if (dist + a.radius <= b.radius) return b;
+			float radius = (dist + a.radius + b.radius) * 0.5f;
+			return { a.center + d * ((radius - a.radius) / dist), radius };
+		}
+
+		// Four points are tested against the sphere at once and the rare outside ones grow it in order
+		Sphere grow_range(const Vec3fSoA& positions, Sphere sphere, size_t begin, size_t end) {
+			float4 center[3], radius_sq;
+			auto splat = [&] {
+				for (size_t k = 0; k < 3; ++k) center[k] = simd::set1(sphere.center[k]);
+				radius_sq = simd::set1(sphere.radius * sphere.radius);
+			};
+			splat();
+
+			for_each_group(begin, end, [&](size_t first, size_t lanes) {
+				float4 d[3];
+				for (size_t k = 0; k < 3; ++k) d[k] = simd::sub(load_lanes(positions.streams[k].data(), first, lanes), center[k]);
+				unsigned outside = simd::movemask(simd::cmplt(radius_sq, dot3(d, d))) & ((1u << lanes) - 1);
+				if (!outside) return;
+				for (size_t lane = 0; lane < lanes; ++lane) {
+					if (outside & (1u << lane)) grow(sphere, positions.get(first + lane));
+				}
+				splat();
+			});
+			return sphere;
+		}
+	}
+
+	void VertexTriangles::build(span<const uint32_t> indices, size_t vertex_count) {
+		MATH_INSTRUMENT(Mesh);
+		assert(indices.size() % 3 == 0);
+
+		// Counting sort by vertex. Filling moves each start up to the next vertex's start, so the offsets
+		// shift back by one afterwards.
+		offsets.assign(vertex_count + 1, 0);
+		for (uint32_t v : indices) {
+			assert(v < vertex_count);
+			++offsets[v + 1];
+		}
+		for (size_t v = 1; v <= vertex_count; ++v) offsets[v] += offsets[v - 1];
+
+		triangles.resize(indices.size());
+		for (size_t i = 0; i < indices.size(); ++i) triangles[offsets[indices[i]]++] = uint32_t(i / 3);
+
+		for (size_t v = vertex_count; v > 0; --v) offsets[v] = offsets[v - 1];
+		offsets[0] = 0;
+	}
+
+	void face_normals(const Vec3fSoA& positions, span<const uint32_t> indices, Vec3fSoA& out_normals) {
+		MATH_INSTRUMENT(Mesh);
+		assert(indices.size() % 3 == 0);
+		size_t triangle_count = indices.size() / 3;
+		if (out_normals.size() != triangle_count) out_normals.resize(triangle_count);
+		parallel_for(triangle_count, MeshGrain, [&](size_t begin, size_t end) {
+			face_normal_range<true>(positions, indices, out_normals, begin, end);
+		});
+	}
+
+	void vertex_normals(const Vec3fSoA& positions, span<const uint32_t> indices, Vec3fSoA& out_normals) {
+		VertexTriangles adjacency;
+		adjacency.build(indices, positions.size());
+		vertex_normals(positions, indices, adjacency, out_normals);
+	}
+
+	void vertex_normals(const Vec3fSoA& positions, span<const uint32_t> indices, const VertexTriangles& adjacency, Vec3fSoA& out_normals) {
+		MATH_INSTRUMENT(Mesh);
+		check_mesh(indices, adjacency, positions.size());
+
+		// Unnormalized face normals are already weighted by area
+		Vec3fSoA faces(indices.size() / 3);
+		parallel_for(faces.size(), MeshGrain, [&](size_t begin, size_t end) {
+			face_normal_range<false>(positions, indices, faces, begin, end);
+		});
+
+		if (out_normals.size() != positions.size()) out_normals.resize(positions.size());
+		parallel_for(positions.size(), MeshGrain, [&](size_t begin, size_t end) {
+			for_each_group(begin, end, [&](size_t first, size_t lanes) {
+				float4 n[3];
+				sum_around(adjacency, faces, first, lanes, n);
+				float4 inv = inverse_length(n);
+				for (size_t k = 0; k < 3; ++k) store_lanes(out_normals.streams[k].data(), first, lanes, simd::mul(n[k], inv));
+			});
+		});
+	}
+
+	void vertex_tangents(const Vert3dSoA& mesh, span<const uint32_t> indices, Vec4fSoA& out_tangents) {
+		VertexTriangles adjacency;
+		adjacency.build(indices, mesh.size());
+		vertex_tangents(mesh, indices, adjacency, out_tangents);
+	}
+
+	void vertex_tangents(const Vert3dSoA& mesh, span<const uint32_t> indices, const VertexTriangles& adjacency, Vec4fSoA& out_tangents) {
+		MATH_INSTRUMENT(Mesh);
+		check_mesh(indices, adjacency, mesh.size());
+
+		// Per triangle, the directions of +u and +v solved from the position and uv edges, each scaled to the
+		// triangle's area
+		Vec3fSoA face_u(indices.size() / 3), face_v(indices.size() / 3);
+		parallel_for(face_u.size(), MeshGrain, [&](size_t begin, size_t end) {
+			for_each_group(begin, end, [&](size_t first, size_t lanes) {
+				TriangleGroup tri(indices, first, lanes);
+				float4 p[3][3], uv[3][2];
+				tri.load(mesh.pos, p);
+				tri.load(mesh.uv, uv);
+
+				float4 e1[3], e2[3];
+				for (size_t k = 0; k < 3; ++k) {
+					e1[k] = simd::sub(p[1][k], p[0][k]);
+					e2[k] = simd::sub(p[2][k], p[0][k]);
+				}
+				float4 du1 = simd::sub(uv[1][0], uv[0][0]), dv1 = simd::sub(uv[1][1], uv[0][1]);
+				float4 du2 = simd::sub(uv[2][0], uv[0][0]), dv2 = simd::sub(uv[2][1], uv[0][1]);
+
+				// Dividing by the uv determinant only scales, so just its sign is applied
+				float4 det = simd::sub(simd::mul(du1, dv2), simd::mul(du2, dv1));
+				float4 t[3], b[3];
+				for (size_t k = 0; k < 3; ++k) {
+					t[k] = simd::flip_sign(simd::sub(simd::mul(e1[k], dv2), simd::mul(e2[k], dv1)), det);
+					b[k] = simd::flip_sign(simd::sub(simd::mul(e2[k], du1), simd::mul(e1[k], du2)), det);
+				}
+
+				float4 n[3];
+				cross3(e1, e2, n);
+				float4 area = simd::sqrt(dot3(n, n));
+				float4 mapped = simd::cmplt(simd::zero(), simd::abs(det));
+				float4 t_scale = simd::bit_and(mapped, simd::mul(area, inverse_length(t)));
+				float4 b_scale = simd::bit_and(mapped, simd::mul(area, inverse_length(b)));
+				for (size_t k = 0; k < 3; ++k) {
+					store_lanes(face_u.streams[k].data(), first, lanes, simd::mul(t[k], t_scale));
+					store_lanes(face_v.streams[k].data(), first, lanes, simd::mul(b[k], b_scale));
+				}
+			});
+		});
+
+		if (out_tangents.size() != mesh.size()) out_tangents.resize(mesh.size());
+		parallel_for(mesh.size(), MeshGrain, [&](size_t begin, size_t end) {
+			for_each_group(begin, end, [&](size_t first, size_t lanes) {
+				float4 t[3], b[3], n[3];
+				sum_around(adjacency, face_u, first, lanes, t);
+				sum_around(adjacency, face_v, first, lanes, b);
+				for (size_t k = 0; k < 3; ++k) n[k] = load_lanes(mesh.norm.streams[k].data(), first, lanes);
+
+				// Gram-Schmidt against the normal
+				float4 along = dot3(n, t);
+				for (size_t k = 0; k < 3; ++k) t[k] = simd::sub(t[k], simd::mul(n[k], along));
+				float4 t_length_sq = dot3(t, t);
+
+				// Without a tangent, cross the normal with whichever of x and y it is further from
+				float4 zero = simd::zero();
+				float4 use_x = simd::cmplt(simd::abs(n[0]), simd::set1(0.9f));
+				float4 fallback[3] = {
+					simd::select(use_x, zero, simd::sub(zero, n[2])),
+					simd::select(use_x, n[2], zero),
+					simd::select(use_x, simd::sub(zero, n[1]), n[0]),
+				};
+				float4 has_tangent = simd::cmplt(zero, t_length_sq);
+				for (size_t k = 0; k < 3; ++k) t[k] = simd::select(has_tangent, t[k], fallback[k]);
+				float4 inv = inverse_length(t);
+				for (size_t k = 0; k < 3; ++k) t[k] = simd::mul(t[k], inv);
+
+				float4 bitangent[3];
+				cross3(n, t, bitangent);
+				float4 w = simd::select(simd::cmplt(dot3(bitangent, b), zero), simd::set1(-1.0f), simd::set1(1.0f));
+
+				for (size_t k = 0; k < 3; ++k) store_lanes(out_tangents.streams[k].data(), first, lanes, t[k]);
+				store_lanes(out_tangents.streams[3].data(), first, lanes, w);
+			});
+		});
+	}
+
+	AABB bounding_box(const Vec3fSoA& positions) {
+		MATH_INSTRUMENT(Mesh);
+		if (positions.empty()) return { Vec3f(0.0f, 0.0f, 0.0f), { 0.0f, 0.0f, 0.0f } };
+
+		// min and max are exact, so the chunks only need merging. Each chunk leaves its four lanes of lows and
+		// highs per axis.
+		size_t chunk_total = chunk_count(positions.size());
+		aligned_vector<float> chunks(24 * chunk_total);
+		parallel_for(positions.size(), MeshGrain, [&](size_t begin, size_t end) {
+			float4 lo[3], hi[3];
+			for (size_t k = 0; k < 3; ++k) lo[k] = hi[k] = load_lanes(positions.streams[k].data(), begin, std::min<size_t>(end - begin, 4));
+			for_each_group(begin, end, [&](size_t first, size_t lanes) {
+				for (size_t k = 0; k < 3; ++k) {
+					float4 p = load_lanes(positions.streams[k].data(), first, lanes);
+					lo[k] = simd::min(lo[k], p);
+					hi[k] = simd::max(hi[k], p);
+				}
+			});
+			float* out = &chunks[24 * (begin / MeshGrain)];
+			for (size_t k = 0; k < 3; ++k) {
+				simd::store(out + 4 * k, lo[k]);
+				simd::store(out + 12 + 4 * k, hi[k]);
+			}
+		});
+
+		float lo[3], hi[3];
+		for (size_t k = 0; k < 3; ++k) {
+			lo[k] = chunks[4 * k];
+			hi[k] = chunks[12 + 4 * k];
+			for (size_t c = 0; c < chunk_total; ++c) {
+				for (size_t lane = 0; lane < 4; ++lane) {
+					lo[k] = std::min(lo[k], chunks[24 * c + 4 * k + lane]);
+					hi[k] = std::max(hi[k], chunks[24 * c + 12 + 4 * k + lane]);
+				}
+			}
+		}
+
+		return {
+			Vec3f((lo[0] + hi[0]) * 0.5f, (lo[1] + hi[1]) * 0.5f, (lo[2] + hi[2]) * 0.5f),
+			{ (hi[0] - lo[0]) * 0.5f, (hi[1] - lo[1]) * 0.5f, (hi[2] - lo[2]) * 0.5f },
+		};
+	}
+
+	Sphere bounding_sphere(const Vec3fSoA& positions) {
+		MATH_INSTRUMENT(Mesh);
+		if (positions.empty()) return { Vec3f(0.0f, 0.0f, 0.0f), 0.0f };
+
+		size_t chunk_total = chunk_count(positions.size());
+		vector<Extremes> extremes(chunk_total);
+		parallel_for(positions.size(), MeshGrain, [&](size_t begin, size_t end) {
+			extremes[begin / MeshGrain] = extremes_range(positions, begin, end);
+		});
+		Extremes all = extremes[0];
+		for (size_t c = 1; c < chunk_total; ++c) all.merge(extremes[c]);
+
+		size_t axis = 0;
+		float best = -1.0f;
+		for (size_t a = 0; a < 3; ++a) {
+			Vec3f d = all.hi[a] - all.lo[a];
+			if (float dist_sq = d.dot(d); dist_sq > best) {
+				best = dist_sq;
+				axis = a;
+			}
+		}
+		Sphere seed { (all.lo[axis] + all.hi[axis]) * 0.5f, std::sqrt(best) * 0.5f };
+
+		vector<Sphere> spheres(chunk_total);
+		parallel_for(positions.size(), MeshGrain, [&](size_t begin, size_t end) {
+			spheres[begin / MeshGrain] = grow_range(positions, seed, begin, end);
+		});
+		Sphere result = spheres[0];
+		for (size_t c = 1; c < chunk_total; ++c) result = enclose(result, spheres[c]);
+		return result;
+	}
+}
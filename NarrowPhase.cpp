@@ -0,0 +1,574 @@
+#include "NarrowPhase.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Math3D {
+	namespace {
+		constexpr float Tiny = std::numeric_limits<float>::min();
+		constexpr uint32_t MaxIterations = 64;
+
+		// Below this the cores are taken to touch, and EPA decides the depth
+		constexpr float OverlapDistance = 1e-6f;
+
+		// GJK stops once |v|^2 - v.w is this fraction of |v|^2, i.e. when a new support point gets no closer
+		constexpr float RelativeTolerance = 1e-6f;
+
+		// EPA stops once the support point along the closest face's normal is this close to the face
+		constexpr float EPATolerance = 1e-4f;
+
+		constexpr uint32_t MaxPolytopeVertices = 4 + MaxIterations;
+		constexpr uint32_t MaxPolytopeFaces = 2 * MaxPolytopeVertices;
+
+		// A point w = a - b of the Minkowski difference, the points on each shape that made it and the
+		// direction it was searched along
+		struct SupportPoint {
+			Vec3f w;
+			Point a, b;
+			Vec3f dir;
+		};
+
+		struct Simplex {
+			SupportPoint v[4];
+			float weight[4];
+			uint32_t count = 0;
+		};
+
+		SupportPoint core_support(const ConvexShape& a, const ConvexShape& b, const Vec3f& dir) {
+			Point pa = a.core_support(dir);
+			Point pb = b.core_support(dir * -1.0f);
+			return { pa - pb, pa, pb, dir };
+		}
+
+		SupportPoint full_support(const ConvexShape& a, const ConvexShape& b, const Vec3f& dir) {
+			SupportPoint p = core_support(a, b, dir);
+			float length = dir.length();
+			if (length > Tiny && (a.margin > 0.0f || b.margin > 0.0f)) {
+				Vec3f n = dir / length;
+				p.a = p.a + n * a.margin;
+				p.b = p.b - n * b.margin;
+				p.w = p.a - p.b;
+			}
+			return p;
+		}
+
+		const Point& capsule_end(const Segment& axis, const Vec3f& dir) {
+			return dir.dot(axis.end - axis.start) >= 0.0f ? axis.end : axis.start;
+		}
+
+		Simplex simplex_of(const SupportPoint& p) {
+			Simplex s;
+			s.v[0] = p;
+			s.weight[0] = 1.0f;
+			s.count = 1;
+			return s;
+		}
+
+		Simplex simplex_of(const SupportPoint& p, const SupportPoint& q, float t) {
+			Simplex s;
+			s.v[0] = p;
+			s.v[1] = q;
+			s.weight[0] = 1.0f - t;
+			s.weight[1] = t;
+			s.count = 2;
+			return s;
+		}
+
+		Simplex simplex_of(const SupportPoint& p, const SupportPoint& q, const SupportPoint& r, float u, float v) {
+			Simplex s;
+			s.v[0] = p;
+			s.v[1] = q;
+			s.v[2] = r;
+			s.weight[0] = 1.0f - u - v;
+			s.weight[1] = u;
+			s.weight[2] = v;
+			s.count = 3;
+			return s;
+		}
+
+		Vec3f closest(const Simplex& s) {
+			Vec3f v;
+			for (uint32_t i = 0; i < s.count; ++i) v = v + s.v[i].w * s.weight[i];
+			return v;
+		}
+
+		float length_sq(const Vec3f& v) {
+			return v.dot(v);
+		}
+
+		// The sub-simplex nearest the origin, weighted so closest() gives the nearest point
+		Simplex closest_segment(const SupportPoint& p, const SupportPoint& q) {
+			Vec3f d = q.w - p.w;
+			float dd = d.dot(d);
+			float t = dd > Tiny ? -p.w.dot(d) / dd : 0.0f;
+			if (t <= 0.0f) return simplex_of(p);
+			if (t >= 1.0f) return simplex_of(q);
+			return simplex_of(p, q, t);
+		}
+
+		// Ericson, Real-Time Collision Detection 5.1.5, with the origin as the query point
+		Simplex closest_triangle(const SupportPoint& a, const SupportPoint& b, const SupportPoint& c) {
+			Vec3f ab = b.w - a.w, ac = c.w - a.w;
+			float d1 = -ab.dot(a.w), d2 = -ac.dot(a.w);
+			if (d1 <= 0.0f && d2 <= 0.0f) return simplex_of(a);
+
+			float d3 = -ab.dot(b.w), d4 = -ac.dot(b.w);
+			if (d3 >= 0.0f && d4 <= d3) return simplex_of(b);
+
+			float vc = d1 * d4 - d3 * d2;
+			if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f && d1 - d3 > Tiny) return simplex_of(a, b, d1 / (d1 - d3));
+
+			float d5 = -ab.dot(c.w), d6 = -ac.dot(c.w);
+			if (d6 >= 0.0f && d5 <= d6) return simplex_of(c);
+
+			float vb = d5 * d2 - d1 * d6;
+			if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f && d2 - d6 > Tiny) return simplex_of(a, c, d2 / (d2 - d6));
+
+			float va = d3 * d6 - d5 * d4;
+			float e = d4 - d3, f = d5 - d6;
+			if (va <= 0.0f && e >= 0.0f && f >= 0.0f && e + f > Tiny) return simplex_of(b, c, e / (e + f));
+
+			float sum = va + vb + vc;
+			if (sum <= Tiny) {
+				// Collinear points: the nearest of the three edges
+				Simplex best = closest_segment(a, b);
+				for (Simplex s : { closest_segment(a, c), closest_segment(b, c) }) {
+					if (length_sq(closest(s)) < length_sq(closest(best))) best = s;
+				}
+				return best;
+			}
+			return simplex_of(a, b, c, vb / sum, vc / sum);
+		}
+
+		// True when the origin is on the far side of face pqr from s. A flat tetrahedron counts as outside
+		// every face so the nearest face is always searched.
+		bool outside_face(const Vec3f& p, const Vec3f& q, const Vec3f& r, const Vec3f& s) {
+			Vec3f n = (q - p).cross(r - p);
+			float origin_side = -p.dot(n);
+			float s_side = (s - p).dot(n);
+			return s_side == 0.0f || (origin_side > 0.0f) != (s_side > 0.0f);
+		}
+
+		Simplex closest_tetrahedron(const SupportPoint& a, const SupportPoint& b, const SupportPoint& c, const SupportPoint& d) {
+			const SupportPoint* faces[4][4] = { { &a, &b, &c, &d }, { &a, &c, &d, &b }, { &a, &d, &b, &c }, { &b, &d, &c, &a } };
+
+			Simplex best;
+			float best_dist = std::numeric_limits<float>::infinity();
+			for (auto& face : faces) {
+				if (!outside_face(face[0]->w, face[1]->w, face[2]->w, face[3]->w)) continue;
+				Simplex s = closest_triangle(*face[0], *face[1], *face[2]);
+				float dist = length_sq(closest(s));
+				if (dist < best_dist) {
+					best = s;
+					best_dist = dist;
+				}
+			}
+
+			// Enclosed; the weights are unused from here on
+			if (best.count == 0) {
+				best.v[0] = a;
+				best.v[1] = b;
+				best.v[2] = c;
+				best.v[3] = d;
+				std::fill_n(best.weight, 4, 0.0f);
+				best.count = 4;
+			}
+			return best;
+		}
+
+		Simplex reduce(const Simplex& s) {
+			switch (s.count) {
+			case 1: return simplex_of(s.v[0]);
+			case 2: return closest_segment(s.v[0], s.v[1]);
+			case 3: return closest_triangle(s.v[0], s.v[1], s.v[2]);
+			case 4: return closest_tetrahedron(s.v[0], s.v[1], s.v[2], s.v[3]);
+			default: return s;
+			}
+		}
+
+		bool contains(const Simplex& s, const Vec3f& w) {
+			for (uint32_t i = 0; i < s.count; ++i) {
+				if (length_sq(s.v[i].w - w) <= OverlapDistance * OverlapDistance) return true;
+			}
+			return false;
+		}
+
+		void add(Simplex& s, const SupportPoint& p) {
+			s.v[s.count] = p;
+			s.weight[s.count] = 0.0f;
+			++s.count;
+		}
+
+		struct GJKResult {
+			Simplex simplex;
+			Vec3f v;
+			bool overlap;
+		};
+
+		// GJK on the cores. Stops early once the distance is known to be more than stop_distance.
+		GJKResult gjk(const ConvexShape& a, const ConvexShape& b, GJKCache* cache,
+			float stop_distance = std::numeric_limits<float>::infinity()) {
+			GJKResult result { {}, {}, false };
+			Simplex& simplex = result.simplex;
+
+			if (cache) {
+				for (uint32_t i = 0; i < cache->count && i < 4; ++i) {
+					SupportPoint p = core_support(a, b, cache->dirs[i]);
+					if (!contains(simplex, p.w)) add(simplex, p);
+				}
+			}
+			if (simplex.count == 0) {
+				add(simplex, core_support(a, b, Vec3f(1.0f, 0.0f, 0.0f)));
+			}
+
+			for (uint32_t iteration = 0; iteration < MaxIterations; ++iteration) {
+				simplex = reduce(simplex);
+				result.v = closest(simplex);
+				float vv = length_sq(result.v);
+				if (simplex.count == 4 || vv <= OverlapDistance * OverlapDistance) {
+					result.overlap = true;
+					break;
+				}
+
+				SupportPoint p = core_support(a, b, result.v * -1.0f);
+				float vw = result.v.dot(p.w);
+
+				// v.w / |v| is a lower bound on the distance
+				if (vw > 0.0f && vw * vw > stop_distance * stop_distance * vv) break;
+				if (vv - vw <= RelativeTolerance * vv || contains(simplex, p.w)) break;
+				add(simplex, p);
+			}
+
+			if (cache) {
+				cache->count = simplex.count;
+				for (uint32_t i = 0; i < simplex.count; ++i) cache->dirs[i] = simplex.v[i].dir;
+			}
+			return result;
+		}
+
+		void witness_points(const Simplex& s, Point& on_a, Point& on_b) {
+			on_a = on_b = Point();
+			for (uint32_t i = 0; i < s.count; ++i) {
+				on_a = on_a + s.v[i].a * s.weight[i];
+				on_b = on_b + s.v[i].b * s.weight[i];
+			}
+		}
+
+		// Contact of two balls, used for spheres and for the closest core points of rounded shapes
+		bool ball_contact(const Point& ca, float ra, const Point& cb, float rb, Contact& contact) {
+			Vec3f d = cb - ca;
+			float dist_sq = d.dot(d), r = ra + rb;
+			if (dist_sq > r * r) return false;
+
+			// Concentric balls have no preferred direction
+			float dist = std::sqrt(dist_sq);
+			Vec3f n = dist > Tiny ? d / dist : Vec3f(0.0f, 1.0f, 0.0f);
+			contact = { n, r - dist, ca + n * ra, cb - n * rb };
+			return true;
+		}
+
+		void flip(Contact& contact) {
+			contact.normal = contact.normal * -1.0f;
+			std::swap(contact.on_a, contact.on_b);
+		}
+
+		struct Face {
+			uint32_t v[3];
+			Vec3f normal;
+			float distance;
+		};
+
+		struct Edge {
+			uint32_t a, b;
+		};
+
+		class Polytope {
+		public:
+			SupportPoint verts[MaxPolytopeVertices];
+			Face faces[MaxPolytopeFaces];
+			uint32_t vert_count = 0, face_count = 0;
+
+			// Degenerate faces never become the closest face
+			void add_face(uint32_t i, uint32_t j, uint32_t k) {
+				Face& f = faces[face_count++];
+				f.v[0] = i;
+				f.v[1] = j;
+				f.v[2] = k;
+				Vec3f n = (verts[j].w - verts[i].w).cross(verts[k].w - verts[i].w);
+				float length = n.length();
+				if (length > Tiny) {
+					f.normal = n / length;
+					f.distance = f.normal.dot(verts[i].w);
+				}
+				else {
+					f.normal = Vec3f();
+					f.distance = std::numeric_limits<float>::infinity();
+				}
+			}
+
+			uint32_t closest_face() const {
+				uint32_t best = 0;
+				for (uint32_t i = 1; i < face_count; ++i) {
+					if (faces[i].distance < faces[best].distance) best = i;
+				}
+				return best;
+			}
+		};
+
+		// Grows a GJK simplex that touches or encloses the origin into a tetrahedron. Each vertex added lies
+		// off the span of the others; fails only when the Minkowski difference itself is flat.
+		bool make_tetrahedron(const ConvexShape& a, const ConvexShape& b, Simplex& s) {
+			constexpr float Eps = 1e-10f;
+			const Vec3f axes[3] = { Vec3f(1.0f, 0.0f, 0.0f), Vec3f(0.0f, 1.0f, 0.0f), Vec3f(0.0f, 0.0f, 1.0f) };
+
+			if (s.count == 1) {
+				for (const Vec3f& axis : axes) {
+					for (float sign : { 1.0f, -1.0f }) {
+						SupportPoint p = full_support(a, b, axis * sign);
+						if (s.count == 1 && length_sq(p.w - s.v[0].w) > Eps) add(s, p);
+					}
+				}
+				if (s.count == 1) return false;
+			}
+
+			if (s.count == 2) {
+				Vec3f d = s.v[1].w - s.v[0].w;
+				size_t least = 0;
+				for (size_t i = 1; i < 3; ++i) {
+					if (std::fabs(d[i]) < std::fabs(d[least])) least = i;
+				}
+				Vec3f e1 = d.cross(axes[least]);
+				Vec3f e2 = d.cross(e1);
+				for (const Vec3f& dir : { e1, e1 * -1.0f, e2, e2 * -1.0f }) {
+					SupportPoint p = full_support(a, b, dir);
+					if (s.count == 2 && length_sq(d.cross(p.w - s.v[0].w)) > Eps) add(s, p);
+				}
+				if (s.count == 2) return false;
+			}
+
+			if (s.count == 3) {
+				Vec3f n = (s.v[1].w - s.v[0].w).cross(s.v[2].w - s.v[0].w);
+				for (const Vec3f& dir : { n, n * -1.0f }) {
+					SupportPoint p = full_support(a, b, dir);
+					float side = n.dot(p.w - s.v[0].w);
+					if (s.count == 3 && side * side > Eps * length_sq(n)) add(s, p);
+				}
+				if (s.count == 3) return false;
+			}
+			return true;
+		}
+
+		// Expanding polytope: repeatedly push out the face nearest the origin along its normal until the
+		// boundary of the Minkowski difference is reached
+		bool epa(const ConvexShape& a, const ConvexShape& b, Simplex simplex, Contact& contact) {
+			if (!make_tetrahedron(a, b, simplex)) return false;
+
+			Polytope poly;
+			for (uint32_t i = 0; i < 4; ++i) poly.verts[i] = simplex.v[i];
+			poly.vert_count = 4;
+
+			// The origin may lie on the tetrahedron's boundary, so orient the faces with the centroid instead
+			Vec3f centroid = (simplex.v[0].w + simplex.v[1].w + simplex.v[2].w + simplex.v[3].w) * 0.25f;
+			const uint32_t tetrahedron[4][3] = { { 0, 1, 2 }, { 0, 3, 1 }, { 0, 2, 3 }, { 1, 3, 2 } };
+			for (auto& f : tetrahedron) {
+				Vec3f n = (poly.verts[f[1]].w - poly.verts[f[0]].w).cross(poly.verts[f[2]].w - poly.verts[f[0]].w);
+				if (n.dot(poly.verts[f[0]].w - centroid) < 0.0f) poly.add_face(f[0], f[2], f[1]);
+				else poly.add_face(f[0], f[1], f[2]);
+			}
+
+			Edge horizon[MaxPolytopeFaces * 3 / 2];
+			uint32_t nearest = poly.closest_face();
+			for (uint32_t iteration = 0; iteration < MaxIterations && poly.vert_count < MaxPolytopeVertices; ++iteration) {
+				const Face& face = poly.faces[nearest];
+				SupportPoint p = full_support(a, b, face.normal);
+				if (p.w.dot(face.normal) - face.distance <= EPATolerance * std::max(1.0f, face.distance)) break;
+
+				uint32_t w = poly.vert_count++;
+				poly.verts[w] = p;
+
+				// Remove every face the new point sees; edges shared by two removed faces cancel, leaving the horizon
+				uint32_t edge_count = 0;
+				for (uint32_t i = 0; i < poly.face_count;) {
+					const Face& f = poly.faces[i];
+					if (f.normal.dot(p.w - poly.verts[f.v[0]].w) <= 0.0f) {
+						++i;
+						continue;
+					}
+					for (uint32_t e = 0; e < 3; ++e) {
+						Edge edge { f.v[e], f.v[(e + 1) % 3] };
+						uint32_t k = 0;
+						while (k < edge_count && !(horizon[k].a == edge.b && horizon[k].b == edge.a)) ++k;
+						if (k < edge_count) horizon[k] = horizon[--edge_count];
+						else horizon[edge_count++] = edge;
+					}
+					poly.faces[i] = poly.faces[--poly.face_count];
+				}
+
+				if (poly.face_count + edge_count > MaxPolytopeFaces) break;
+				for (uint32_t e = 0; e < edge_count; ++e) poly.add_face(horizon[e].a, horizon[e].b, w);
+				nearest = poly.closest_face();
+			}
+
+			const Face& face = poly.faces[nearest];
+			if (!std::isfinite(face.distance)) return false;
+
+			// Barycentric weights of the origin's projection onto the face give the witness points
+			const SupportPoint& p0 = poly.verts[face.v[0]];
+			const SupportPoint& p1 = poly.verts[face.v[1]];
+			const SupportPoint& p2 = poly.verts[face.v[2]];
+			Vec3f e0 = p1.w - p0.w, e1 = p2.w - p0.w, r = face.normal * face.distance - p0.w;
+			float d00 = e0.dot(e0), d01 = e0.dot(e1), d11 = e1.dot(e1), d20 = r.dot(e0), d21 = r.dot(e1);
+			float denom = d00 * d11 - d01 * d01;
+			float u = 0.0f, v = 0.0f;
+			if (denom > Tiny) {
+				u = (d11 * d20 - d01 * d21) / denom;
+				v = (d00 * d21 - d01 * d20) / denom;
+			}
+
+			contact.normal = face.normal;
+			contact.depth = std::max(face.distance, 0.0f);
+			contact.on_a = p0.a * (1.0f - u - v) + p1.a * u + p2.a * v;
+			contact.on_b = p0.b * (1.0f - u - v) + p1.b * u + p2.b * v;
+			return true;
+		}
+	}
+
+	Point Support(const Sphere& sphere, const Vec3f& dir) {
+		float length = dir.length();
+		return length > Tiny ? sphere.center + dir * (sphere.radius / length) : sphere.center;
+	}
+
+	Point Support(const Capsule& capsule, const Vec3f& dir) {
+		return Support(Sphere { capsule_end(capsule.axis, dir), capsule.radius }, dir);
+	}
+
+	Point Support(const Cylinder& cylinder, const Vec3f& dir) {
+		Vec3f axis = cylinder.axis.end - cylinder.axis.start;
+		float along = dir.dot(axis);
+		Point cap = along >= 0.0f ? cylinder.axis.end : cylinder.axis.start;
+
+		float axis_sq = axis.dot(axis);
+		Vec3f radial = axis_sq > Tiny ? dir - axis * (along / axis_sq) : dir;
+		float radial_length = radial.length();
+		return radial_length > Tiny ? cap + radial * (cylinder.radius / radial_length) : cap;
+	}
+
+	Point Support(const AABB& box, const Vec3f& dir) {
+		Point p = box.center;
+		for (size_t a = 0; a < 3; ++a) {
+			p[a] += dir[a] >= 0.0f ? box.halfwidths[a] : -box.halfwidths[a];
+		}
+		return p;
+	}
+
+	Point Support(const ConvexHull& hull, const Vec3f& dir) {
+		size_t best = 0;
+		float best_dot = hull.points[0].dot(dir);
+		for (size_t i = 1; i < hull.points.size(); ++i) {
+			float d = hull.points[i].dot(dir);
+			if (d > best_dot) {
+				best = i;
+				best_dot = d;
+			}
+		}
+		return hull.points[best];
+	}
+
+	Point ConvexShape::capsule_core(const void* shape, const Vec3f& dir) {
+		return capsule_end(static_cast<const Capsule*>(shape)->axis, dir);
+	}
+
+	bool GJKDistance(const ConvexShape& a, const ConvexShape& b, Separation& result, GJKCache* cache) {
+		GJKResult gjk_result = gjk(a, b, cache);
+		if (gjk_result.overlap) return false;
+
+		float core_distance = gjk_result.v.length();
+		float distance = core_distance - a.margin - b.margin;
+		if (distance <= 0.0f) return false;
+
+		Point on_a, on_b;
+		witness_points(gjk_result.simplex, on_a, on_b);
+
+		// v = on_a - on_b, so a to b is -v
+		Vec3f n = gjk_result.v * (-1.0f / core_distance);
+		result = { distance, on_a + n * a.margin, on_b - n * b.margin };
+		return true;
+	}
+
+	bool GJKIntersect(const ConvexShape& a, const ConvexShape& b, GJKCache* cache) {
+		float margins = a.margin + b.margin;
+		GJKResult gjk_result = gjk(a, b, cache, margins);
+		return gjk_result.overlap || length_sq(gjk_result.v) <= margins * margins;
+	}
+
+	bool Penetration(const ConvexShape& a, const ConvexShape& b, Contact& contact, GJKCache* cache) {
+		using Kind = ConvexShape::Kind;
+		auto as = [](const ConvexShape& shape, auto* type) { return static_cast<decltype(type)>(shape.shape); };
+		const Sphere* sphere = nullptr;
+		const Capsule* capsule = nullptr;
+		const AABB* box = nullptr;
+
+		if (a.kind == Kind::Sphere && b.kind == Kind::Sphere) return Penetration(*as(a, sphere), *as(b, sphere), contact);
+		if (a.kind == Kind::Sphere && b.kind == Kind::Capsule) return Penetration(*as(a, sphere), *as(b, capsule), contact);
+		if (a.kind == Kind::Capsule && b.kind == Kind::Sphere) {
+			if (!Penetration(*as(b, sphere), *as(a, capsule), contact)) return false;
+			flip(contact);
+			return true;
+		}
+		if (a.kind == Kind::Capsule && b.kind == Kind::Capsule) return Penetration(*as(a, capsule), *as(b, capsule), contact);
+		if (a.kind == Kind::AABB && b.kind == Kind::AABB) return Penetration(*as(a, box), *as(b, box), contact);
+
+		GJKResult gjk_result = gjk(a, b, cache);
+		if (!gjk_result.overlap) {
+			Point on_a, on_b;
+			witness_points(gjk_result.simplex, on_a, on_b);
+			return ball_contact(on_a, a.margin, on_b, b.margin, contact);
+		}
+		return epa(a, b, gjk_result.simplex, contact);
+	}
+
+	bool Penetration(const Sphere& a, const Sphere& b, Contact& contact) {
+		return ball_contact(a.center, a.radius, b.center, b.radius, contact);
+	}
+
+	bool Penetration(const Sphere& a, const Capsule& b, Contact& contact) {
+		return ball_contact(a.center, a.radius, ClosestPoint(b.axis, a.center), b.radius, contact);
+	}
+
+	bool Penetration(const Capsule& a, const Capsule& b, Contact& contact) {
+		Point on_a, on_b;
+		ClosestPoints(a.axis, b.axis, on_a, on_b);
+		return ball_contact(on_a, a.radius, on_b, b.radius, contact);
+	}
+
+	// Separating axis test on the three box axes; the contact is along the axis of least overlap
+	bool Penetration(const AABB& a, const AABB& b, Contact& contact) {
+		float depth = std::numeric_limits<float>::infinity();
+		size_t axis = 0;
+		for (size_t i = 0; i < 3; ++i) {
+			float overlap = a.halfwidths[i] + b.halfwidths[i] - std::fabs(b.center[i] - a.center[i]);
+			if (overlap < 0.0f) return false;
+			if (overlap < depth) {
+				depth = overlap;
+				axis = i;
+			}
+		}
+
+		// Off the contact axis both points sit in the middle of the overlap
+		Point on_a, on_b;
+		for (size_t i = 0; i < 3; ++i) {
+			float lo = std::max(a.center[i] - a.halfwidths[i], b.center[i] - b.halfwidths[i]);
+			float hi = std::min(a.center[i] + a.halfwidths[i], b.center[i] + b.halfwidths[i]);
+			on_a[i] = on_b[i] = (lo + hi) * 0.5f;
+		}
+		float sign = b.center[axis] >= a.center[axis] ? 1.0f : -1.0f;
+		on_a[axis] = a.center[axis] + sign * a.halfwidths[axis];
+		on_b[axis] = b.center[axis] - sign * b.halfwidths[axis];
+
+		Vec3f normal;
+		normal[axis] = sign;
+		contact = { normal, depth, on_a, on_b };
+		return true;
+	}
+}
@@ -0,0 +1,353 @@
+#include "Parallel.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Math3D {
+	namespace {
+		using job_detail::Job;
+
+		// Rounds of failed stealing before a worker sleeps, each ending in a yield
+		constexpr size_t SpinRounds = 64;
+
+		// Deques for threads calling in from outside the pool. Past this many at once, calls run inline.
+		constexpr size_t OutsideSlots = 8;
+
+		// parallel_for calls up to this many chunks reuse their thread's piece arrays; larger ones allocate
+		constexpr size_t CachedPieces = 4096;
+
+		// Chase-Lev deque over a fixed ring, with the orderings of Le et al., "Correct and Efficient
+		// Work-Stealing for Weak Memory Models". The owner pushes and pops at the bottom, thieves take from the
+		// top. A push onto a full ring fails and the caller runs the job itself.
+		class Deque {
+		public:
+			static constexpr size_t Capacity = 1024;
+
+			bool push(Job* job) {
+				int64_t b = bottom.load(std::memory_order_relaxed);
+				int64_t t = top.load(std::memory_order_acquire);
+				if (b - t >= int64_t(Capacity)) return false;
+
+				slots[size_t(b) & (Capacity - 1)].store(job, std::memory_order_relaxed);
+				bottom.store(b + 1, std::memory_order_release);
+				return true;
+			}
+
+			Job* pop() {
+				int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+				bottom.store(b, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t t = top.load(std::memory_order_relaxed);
+				if (t > b) {
+					bottom.store(b + 1, std::memory_order_relaxed);
+					return nullptr;
+				}
+
+				Job* job = slots[size_t(b) & (Capacity - 1)].load(std::memory_order_relaxed);
+				if (t == b) {
+					// The last job: race the thieves for it
+					if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) job = nullptr;
+					bottom.store(b + 1, std::memory_order_relaxed);
+				}
+				return job;
+			}
+
+			Job* steal() {
+				int64_t t = top.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t b = bottom.load(std::memory_order_acquire);
+				if (t >= b) return nullptr;
+
+				Job* job = slots[size_t(t) & (Capacity - 1)].load(std::memory_order_relaxed);
+				if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+				return job;
+			}
+
+		private:
+			alignas(64) std::atomic<int64_t> top { 0 };
+			alignas(64) std::atomic<int64_t> bottom { 0 };
+			alignas(64) std::atomic<Job*> slots[Capacity] {};
+		};
+
+		// A piece [lo, hi) of a parallel_for's chunks, left in a deque for a thief. Each piece starts at a
+		// different chunk, so the pieces live in an array indexed by their first chunk.
+		struct ForState;
+
+		struct RangeJob : Job {
+			ForState* range;
+			size_t lo, hi;
+		};
+
+		struct ForState {
+			JobSystem* system;
+			void (*fn)(void*, size_t, size_t);
+			void* ctx;
+			size_t count, grain;
+			std::atomic<size_t> remaining;
+			RangeJob* pieces;
+		};
+
+		// The systems this thread has a deque in: a worker's own for good, and the ones it called into from
+		// outside, counted so that calls and task groups can finish in any order
+		struct Seat {
+			JobSystem* system;
+			size_t index;
+			size_t count;
+		};
+
+		thread_local std::vector<Seat> seats;
+		thread_local JobSystem* scoped = nullptr;
+
+		Seat* find_seat(const JobSystem* system) {
+			for (Seat& seat : seats) {
+				if (seat.system == system) return &seat;
+			}
+			return nullptr;
+		}
+
+		// Piece arrays by parallel_for nesting depth on this thread. A call's array is busy until it returns,
+		// and whatever it runs meanwhile, including stolen work, calls in one level deeper.
+		struct PieceBlock {
+			std::unique_ptr<RangeJob[]> pieces;
+			size_t capacity = 0;
+		};
+
+		thread_local std::vector<PieceBlock> piece_blocks;
+		thread_local size_t piece_depth = 0;
+	}
+
+	struct JobSystem::State {
+		// The first OutsideSlots deques go to threads calling in from outside, claimed while they have a call
+		// or task group open; the workers own the rest
+		std::vector<std::unique_ptr<Deque>> deques;
+		std::vector<std::thread> threads;
+		std::atomic<bool> claimed[OutsideSlots] {};
+
+		std::mutex sleep_mutex;
+		std::condition_variable wake;
+		std::atomic<uint64_t> epoch { 0 };
+		std::atomic<size_t> sleepers { 0 };
+		std::atomic<bool> stop { false };
+
+		// Wakes a sleeping worker after a push. Sleepers count themselves before checking epoch and
+		// pushers bump epoch before checking for sleepers, so one of the two sees the other.
+		void notify() {
+			epoch.fetch_add(1);
+			if (sleepers.load() > 0) {
+				std::lock_guard<std::mutex> lock(sleep_mutex);
+				wake.notify_one();
+			}
+		}
+
+		// Our own deque first, newest job first, then the oldest job of the others from a random start
+		Job* find_work(size_t index) {
+			if (Job* job = deques[index]->pop()) return job;
+
+			thread_local uint32_t seed = 0x9E3779B9u ^ uint32_t(index + 1);
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+			size_t n = deques.size(), start = seed % n;
+			for (size_t k = 0; k < n; ++k) {
+				size_t victim = (start + k) % n;
+				if (victim == index) continue;
+				if (Job* job = deques[victim]->steal()) return job;
+			}
+			return nullptr;
+		}
+
+		void push(size_t index, Job* job) {
+			if (deques[index]->push(job)) notify();
+			else job->run(job);
+		}
+
+		// Halves [lo, hi) until one chunk is left, leaving the upper halves to be stolen, then runs it
+		void run_range(ForState& range, size_t index, size_t lo, size_t hi) {
+			while (hi - lo > 1) {
+				size_t mid = lo + (hi - lo) / 2;
+				RangeJob& piece = range.pieces[mid];
+				piece.run = &run_piece;
+				piece.range = &range;
+				piece.lo = mid;
+				piece.hi = hi;
+				if (!deques[index]->push(&piece)) break;
+				notify();
+				hi = mid;
+			}
+
+			for (size_t chunk = lo; chunk < hi; ++chunk) {
+				size_t begin = chunk * range.grain;
+				range.fn(range.ctx, begin, std::min(begin + range.grain, range.count));
+			}
+			range.remaining.fetch_sub(hi - lo, std::memory_order_release);
+		}
+
+		// Runs on the thief, which has a seat in the same system
+		static void run_piece(Job* job) {
+			RangeJob* piece = static_cast<RangeJob*>(job);
+			JobSystem* system = piece->range->system;
+			system->state->run_range(*piece->range, find_seat(system)->index, piece->lo, piece->hi);
+		}
+
+		void wait_for(size_t index, const std::atomic<size_t>& pending) {
+			while (pending.load(std::memory_order_acquire) != 0) {
+				if (Job* job = find_work(index)) job->run(job);
+				else std::this_thread::yield();
+			}
+		}
+
+		void worker(JobSystem* system, size_t index) {
+			seats.push_back({ system, index, 1 });
+			size_t idle = 0;
+			while (!stop.load(std::memory_order_relaxed)) {
+				uint64_t seen = epoch.load();
+				if (Job* job = find_work(index)) {
+					job->run(job);
+					idle = 0;
+					continue;
+				}
+				if (++idle < SpinRounds) {
+					std::this_thread::yield();
+					continue;
+				}
+
+				std::unique_lock<std::mutex> lock(sleep_mutex);
+				sleepers.fetch_add(1);
+				wake.wait(lock, [&] { return stop.load() || epoch.load() != seen; });
+				sleepers.fetch_sub(1);
+				idle = 0;
+			}
+		}
+	};
+
+	JobSystem::JobSystem(size_t threads) : state(std::make_unique<State>()) {
+		if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+		for (size_t n = 0; n < OutsideSlots + threads - 1; ++n) {
+			state->deques.push_back(std::make_unique<Deque>());
+		}
+		for (size_t n = OutsideSlots; n < state->deques.size(); ++n) {
+			state->threads.emplace_back([this, n] { state->worker(this, n); });
+		}
+	}
+
+	JobSystem::~JobSystem() {
+		{
+			std::lock_guard<std::mutex> lock(state->sleep_mutex);
+			state->stop = true;
+		}
+		state->wake.notify_all();
+		for (auto& t : state->threads) t.join();
+	}
+
+	size_t JobSystem::thread_count() const {
+		return state->threads.size() + 1;
+	}
+
+	JobSystem& JobSystem::shared() {
+		static JobSystem instance;
+		return instance;
+	}
+
+	JobSystem& JobSystem::current() {
+		if (scoped) return *scoped;
+		if (!seats.empty()) return *seats.back().system;
+		return shared();
+	}
+
+	JobSystem::Scope::Scope(JobSystem& system) : previous(scoped) {
+		scoped = &system;
+	}
+
+	JobSystem::Scope::~Scope() {
+		scoped = previous;
+	}
+
+	bool JobSystem::enter() {
+		if (Seat* seat = find_seat(this)) {
+			++seat->count;
+			return true;
+		}
+		for (size_t slot = 0; slot < OutsideSlots; ++slot) {
+			bool free = false;
+			if (state->claimed[slot].compare_exchange_strong(free, true, std::memory_order_acquire)) {
+				seats.push_back({ this, slot, 1 });
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void JobSystem::leave() {
+		Seat* seat = find_seat(this);
+		assert(seat && seat->count > 0);
+		if (--seat->count == 0) {
+			// Everything pushed from the slot has run, so it goes back empty
+			state->claimed[seat->index].store(false, std::memory_order_release);
+			seats.erase(seats.begin() + (seat - seats.data()));
+		}
+	}
+
+	void JobSystem::submit(Job* job) {
+		if (Seat* seat = find_seat(this)) state->push(seat->index, job);
+		else job->run(job);
+	}
+
+	void JobSystem::wait_for(const std::atomic<size_t>& pending) {
+		Seat* seat = find_seat(this);
+		assert(seat);
+		state->wait_for(seat->index, pending);
+	}
+
+	void JobSystem::parallel_for_impl(size_t count, size_t grain, void (*fn)(void*, size_t, size_t), void* ctx) {
+		size_t chunks = (count + grain - 1) / grain;
+		if (thread_count() == 1 || !enter()) {
+			for (size_t begin = 0; begin < count; begin += grain) {
+				fn(ctx, begin, std::min(begin + grain, count));
+			}
+			return;
+		}
+
+		std::unique_ptr<RangeJob[]> uncached;
+		RangeJob* pieces;
+		if (chunks <= CachedPieces) {
+			if (piece_blocks.size() <= piece_depth) piece_blocks.resize(piece_depth + 1);
+			PieceBlock& block = piece_blocks[piece_depth];
+			if (block.capacity < chunks) {
+				block.capacity = std::bit_ceil(chunks);
+				block.pieces = std::make_unique<RangeJob[]>(block.capacity);
+			}
+			pieces = block.pieces.get();
+		}
+		else {
+			uncached = std::make_unique<RangeJob[]>(chunks);
+			pieces = uncached.get();
+		}
+
+		size_t index = find_seat(this)->index;
+		ForState range { this, fn, ctx, count, grain, chunks, pieces };
+		++piece_depth;
+		state->run_range(range, index, 0, chunks);
+		state->wait_for(index, range.remaining);
+		--piece_depth;
+		leave();
+	}
+
+	void TaskGroup::wait() {
+		if (!entered) return;
+		if (seated) {
+			system.wait_for(pending);
+			system.leave();
+		}
+		entered = seated = false;
+	}
+
+	size_t parallel_thread_count() {
+		return JobSystem::current().thread_count();
+	}
+}
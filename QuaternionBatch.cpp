@@ -0,0 +1,244 @@
+#include "QuaternionBatch.h"
+
+namespace Math3D {
+	static_assert(sizeof(Quaternion) == 4 * sizeof(float));
+
+	using simd::float4;
+	using quat4 = simd::float4xN<4>;
+
+	namespace {
+		array<const float*, 4> streams_of(const QuaternionBatch& q) {
+			return { q.streams[0].data(), q.streams[1].data(), q.streams[2].data(), q.streams[3].data() };
+		}
+
+		array<float*, 4> streams_of(QuaternionBatch& q) {
+			return { q.streams[0].data(), q.streams[1].data(), q.streams[2].data(), q.streams[3].data() };
+		}
+
+		array<const float*, 8> streams_of(const QuaternionBatch& a, const QuaternionBatch& b) {
+			return {
+				a.streams[0].data(), a.streams[1].data(), a.streams[2].data(), a.streams[3].data(),
+				b.streams[0].data(), b.streams[1].data(), b.streams[2].data(), b.streams[3].data(),
+			};
+		}
+
+		void resize_like(QuaternionBatch& out, size_t count) {
+			if (out.size() != count) out.resize(count);
+		}
+
+		float4 dot4(const float4* a, const float4* b) {
+			return simd::madd(a[3], b[3], simd::madd(a[2], b[2], simd::madd(a[1], b[1], simd::mul(a[0], b[0]))));
+		}
+
+		quat4 scale4(const float4* q, float4 s) {
+			return { simd::mul(q[0], s), simd::mul(q[1], s), simd::mul(q[2], s), simd::mul(q[3], s) };
+		}
+
+		quat4 normalize4(const quat4& q) {
+			return scale4(q.v, simd::div(simd::set1(1.0f), simd::sqrt(dot4(q.v, q.v))));
+		}
+
+		// ca * a + cb * b with b flipped onto a's hemisphere
+		quat4 blend4(const float4* a, const float4* b, float4 ca, float4 cb, float4 sign) {
+			cb = simd::flip_sign(cb, sign);
+			return {
+				simd::madd(a[0], ca, simd::mul(b[0], cb)),
+				simd::madd(a[1], ca, simd::mul(b[1], cb)),
+				simd::madd(a[2], ca, simd::mul(b[2], cb)),
+				simd::madd(a[3], ca, simd::mul(b[3], cb)),
+			};
+		}
+
+		// sin(t theta) / sin(theta) as a polynomial in x - 1 = cos(theta) - 1. The series is truncated after
+		// eight terms and the last one is scaled by OnePlusMu, which minimizes the error over x in [0, 1].
+		struct SlerpWeight {
+			static constexpr int Terms = 8;
+			static constexpr float OnePlusMu = 1.85301137f;
+
+			explicit SlerpWeight(float t) : SlerpWeight(simd::set1(t)) {}
+
+			// A t per lane
+			explicit SlerpWeight(float4 t) : scale(t) {
+				float4 tt = simd::mul(t, t);
+				for (int n = 1; n <= Terms; ++n) {
+					float inv = (n == Terms ? OnePlusMu : 1.0f) / float(n * (2 * n + 1));
+					coeff[n - 1] = simd::mul(simd::sub(tt, simd::set1(float(n * n))), simd::set1(inv));
+				}
+			}
+
+			float4 operator()(float4 x_minus_1) const {
+				float4 one = simd::set1(1.0f);
+				float4 f = one;
+				for (int n = Terms - 1; n >= 0; --n) {
+					f = simd::madd(simd::mul(coeff[n], x_minus_1), f, one);
+				}
+				return simd::mul(scale, f);
+			}
+
+			float4 scale;
+			float4 coeff[Terms];
+		};
+	}
+
+	void multiply(const QuaternionBatch& a, const QuaternionBatch& b, QuaternionBatch& out) {
+		MATH_INSTRUMENT(QuaternionBatch);
+		assert(a.size() == b.size());
+		resize_like(out, a.size());
+		soa_detail::for_each_float4<8, 4>(a.size(), streams_of(a, b), streams_of(out), [](const auto& v) {
+			const float4 &i = v[0], &j = v[1], &k = v[2], &r = v[3];
+			const float4 &qi = v[4], &qj = v[5], &qk = v[6], &qr = v[7];
+			return quat4 {
+				simd::sub(simd::madd(r, qi, simd::madd(i, qr, simd::mul(j, qk))), simd::mul(k, qj)),
+				simd::madd(k, qi, simd::madd(j, qr, simd::sub(simd::mul(r, qj), simd::mul(i, qk)))),
+				simd::madd(k, qr, simd::sub(simd::madd(r, qk, simd::mul(i, qj)), simd::mul(j, qi))),
+				simd::sub(simd::sub(simd::mul(r, qr), simd::mul(i, qi)), simd::madd(j, qj, simd::mul(k, qk))),
+			};
+		});
+	}
+
+	void conjugate(const QuaternionBatch& a, QuaternionBatch& out) {
+		MATH_INSTRUMENT(QuaternionBatch);
+		resize_like(out, a.size());
+		soa_detail::for_each_float4<4, 4>(a.size(), streams_of(a), streams_of(out), [](const auto& v) {
+			float4 zero = simd::zero();
+			return quat4 { simd::sub(zero, v[0]), simd::sub(zero, v[1]), simd::sub(zero, v[2]), v[3] };
+		});
+	}
+
+	void normalize(const QuaternionBatch& a, QuaternionBatch& out) {
+		MATH_INSTRUMENT(QuaternionBatch);
+		resize_like(out, a.size());
+		soa_detail::for_each_float4<4, 4>(a.size(), streams_of(a), streams_of(out), [](const auto& v) {
+			return normalize4(v);
+		});
+	}
+
+	void dot(const QuaternionBatch& a, const QuaternionBatch& b, span<float> out) {
+		MATH_INSTRUMENT(QuaternionBatch);
+		assert(a.size() == b.size() && out.size() >= a.size());
+		soa_detail::for_each_float4<8, 1>(a.size(), streams_of(a, b), {out.data()}, [](const auto& v) {
+			return simd::float4xN<1> { dot4(v.v, v.v + 4) };
+		});
+	}
+
+	void nlerp(const QuaternionBatch& a, const QuaternionBatch& b, float t, QuaternionBatch& out) {
+		MATH_INSTRUMENT(QuaternionBatch);
+		assert(a.size() == b.size());
+		resize_like(out, a.size());
+		float4 ca = simd::set1(1.0f - t), cb = simd::set1(t);
+		soa_detail::for_each_float4<8, 4>(a.size(), streams_of(a, b), streams_of(out), [ca, cb](const auto& v) {
+			return normalize4(blend4(v.v, v.v + 4, ca, cb, dot4(v.v, v.v + 4)));
+		});
+	}
+
+	void slerp(const QuaternionBatch& a, const QuaternionBatch& b, float t, QuaternionBatch& out) {
+		MATH_INSTRUMENT(QuaternionBatch);
+		assert(a.size() == b.size());
+		resize_like(out, a.size());
+		SlerpWeight weight_a(1.0f - t), weight_b(t);
+		soa_detail::for_each_float4<8, 4>(a.size(), streams_of(a, b), streams_of(out), [&](const auto& v) {
+			float4 d = dot4(v.v, v.v + 4);
+			float4 x_minus_1 = simd::sub(simd::abs(d), simd::set1(1.0f));
+			return blend4(v.v, v.v + 4, weight_a(x_minus_1), weight_b(x_minus_1), d);
+		});
+	}
+
+	quat4 slerp4(const quat4& a, const quat4& b, float4 t) {
+		SlerpWeight weight_a(simd::sub(simd::set1(1.0f), t)), weight_b(t);
+		float4 d = dot4(a.v, b.v);
+		float4 x_minus_1 = simd::sub(simd::abs(d), simd::set1(1.0f));
+		return blend4(a.v, b.v, weight_a(x_minus_1), weight_b(x_minus_1), d);
+	}
+
+	template <class Trig>
+	void from_axis_angle(const Vec3fSoA& axes, span<const float> angles, QuaternionBatch& out) {
+		MATH_INSTRUMENT(QuaternionBatch);
+		assert(angles.size() >= axes.size());
+		resize_like(out, axes.size());
+		array<const float*, 4> in = { axes.streams[0].data(), axes.streams[1].data(), axes.streams[2].data(), angles.data() };
+		soa_detail::for_each_float4<4, 4>(axes.size(), in, streams_of(out), [](const auto& v) {
+			float4 s, c;
+			Trig::sincos(simd::mul(v[3], simd::set1(0.5f)), s, c);
+			float4 length_sq = simd::madd(v[2], v[2], simd::madd(v[1], v[1], simd::mul(v[0], v[0])));
+			s = simd::div(s, simd::sqrt(length_sq));
+			return quat4 { simd::mul(v[0], s), simd::mul(v[1], s), simd::mul(v[2], s), c };
+		});
+	}
+
+	template void from_axis_angle<trig::Precise>(const Vec3fSoA&, span<const float>, QuaternionBatch&);
+	template void from_axis_angle<trig::Fast>(const Vec3fSoA&, span<const float>, QuaternionBatch&);
+	template void from_axis_angle<trig::Std>(const Vec3fSoA&, span<const float>, QuaternionBatch&);
+
+	void to_rot(const QuaternionBatch& q, span<Xformf> out) {
+		MATH_INSTRUMENT(QuaternionBatch);
+		assert(out.size() >= q.size());
+		float* dst = reinterpret_cast<float*>(out.data());
+
+		// The rotation terms are formed per lane, then three transposes turn them into four Xformf rows
+		auto rows = [](const float4 (&v)[4], float4 (&row)[3][4]) {
+			float4 m[3][3];
+			simd::to_rot4(v, m);
+			for (int r = 0; r < 3; ++r) {
+				row[r][0] = m[r][0]; row[r][1] = m[r][1]; row[r][2] = m[r][2]; row[r][3] = simd::zero();
+				simd::transpose(row[r][0], row[r][1], row[r][2], row[r][3]);
+			}
+		};
+
+		auto streams = streams_of(q);
+		size_t n = 0;
+		for (; n + 4 <= q.size(); n += 4) {
+			float4 v[4] = { simd::load(streams[0] + n), simd::load(streams[1] + n), simd::load(streams[2] + n), simd::load(streams[3] + n) };
+			float4 row[3][4];
+			rows(v, row);
+			for (size_t lane = 0; lane < 4; ++lane) {
+				simd::store_xform(dst + (n + lane) * 12, row[0][lane], row[1][lane], row[2][lane], simd::zero());
+			}
+		}
+
+		for (; n < q.size(); ++n) {
+			out[n] = q.get(n).ToRot();
+		}
+	}
+
+	void to_soa(span<const Quaternion> in, QuaternionBatch& out) {
+		MATH_INSTRUMENT(QuaternionBatch);
+		out.resize(in.size());
+		const float* src = reinterpret_cast<const float*>(in.data());
+		auto dst = streams_of(out);
+
+		size_t n = 0;
+		for (; n + 4 <= in.size(); n += 4) {
+			float4 r0 = simd::load(src + n * 4), r1 = simd::load(src + n * 4 + 4), r2 = simd::load(src + n * 4 + 8), r3 = simd::load(src + n * 4 + 12);
+			simd::transpose(r0, r1, r2, r3);
+			simd::store(dst[0] + n, r0);
+			simd::store(dst[1] + n, r1);
+			simd::store(dst[2] + n, r2);
+			simd::store(dst[3] + n, r3);
+		}
+
+		for (; n < in.size(); ++n) {
+			out.set(n, in[n]);
+		}
+	}
+
+	void to_aos(const QuaternionBatch& in, span<Quaternion> out) {
+		MATH_INSTRUMENT(QuaternionBatch);
+		assert(out.size() >= in.size());
+		float* dst = reinterpret_cast<float*>(out.data());
+		auto src = streams_of(in);
+
+		size_t n = 0;
+		for (; n + 4 <= in.size(); n += 4) {
+			float4 r0 = simd::load(src[0] + n), r1 = simd::load(src[1] + n), r2 = simd::load(src[2] + n), r3 = simd::load(src[3] + n);
+			simd::transpose(r0, r1, r2, r3);
+			simd::store(dst + n * 4, r0);
+			simd::store(dst + n * 4 + 4, r1);
+			simd::store(dst + n * 4 + 8, r2);
+			simd::store(dst + n * 4 + 12, r3);
+		}
+
+		for (; n < in.size(); ++n) {
+			out[n] = in.get(n);
+		}
+	}
+}
@@ -0,0 +1,188 @@
+#include "Skinning.h"
+#include "Parallel.h"
+
+#include <cassert>
+
+namespace Math3D {
+	static_assert(sizeof(DualQuaternion) == 8 * sizeof(float));
+	static_assert(sizeof(Xformf) == 12 * sizeof(float));
+
+	namespace {
+		using simd::float4;
+
+		// Vertices per parallel_for chunk
+		constexpr size_t SkinGrain = 4096;
+
+		// One group of four vertices, lane n being vertex first + n. Padding lanes have zero weights.
+		struct VertexGroup {
+			float4 pos[3], norm[3];
+			float weights[SkinInfluences::Slots][4];
+			uint16_t bones[SkinInfluences::Slots][4];
+		};
+
+		bool any_weight(const float (&w)[4]) {
+			return (w[0] != 0.0f) | (w[1] != 0.0f) | (w[2] != 0.0f) | (w[3] != 0.0f);
+		}
+
+		using simd::dot3;
+
+		// v * m for lanes of 3x3 matrices
+		void mul3(const float4 (&v)[3], const float4 (&m)[3][3], float4 (&out)[3]) {
+			for (size_t c = 0; c < 3; ++c) {
+				out[c] = simd::madd(v[2], m[2][c], simd::madd(v[1], m[1][c], simd::mul(v[0], m[0][c])));
+			}
+		}
+
+		// Each lane's bones are blended in their packed layout, a few madds per influence, and only the
+		// four results are transposed into lanes
+		struct LinearKernel {
+			const Xformf* bones;
+
+			void operator()(const VertexGroup& g, float4 (&pos)[3], float4 (&norm)[3]) const {
+				float4 packed[3][4];
+				for (size_t lane = 0; lane < 4; ++lane) {
+					for (size_t p = 0; p < 3; ++p) packed[p][lane] = simd::zero();
+				}
+
+				for (size_t k = 0; k < SkinInfluences::Slots; ++k) {
+					if (!any_weight(g.weights[k])) continue;
+					for (size_t lane = 0; lane < 4; ++lane) {
+						const float* m = bones[g.bones[k][lane]].arr.data();
+						float4 w = simd::set1(g.weights[k][lane]);
+						for (size_t p = 0; p < 3; ++p) packed[p][lane] = simd::madd(w, simd::load(m + 4 * p), packed[p][lane]);
+					}
+				}
+
+				// Element e of the 12 packed floats is row e / 3, column e % 3
+				float4 m[12];
+				for (size_t p = 0; p < 3; ++p) {
+					simd::transpose(packed[p][0], packed[p][1], packed[p][2], packed[p][3]);
+					for (size_t e = 0; e < 4; ++e) m[4 * p + e] = packed[p][e];
+				}
+
+				const float4 linear[3][3] = { { m[0], m[1], m[2] }, { m[3], m[4], m[5] }, { m[6], m[7], m[8] } };
+				mul3(g.pos, linear, pos);
+				for (size_t c = 0; c < 3; ++c) pos[c] = simd::add(pos[c], m[9 + c]);
+
+				mul3(g.norm, linear, norm);
+				float4 inv_length = simd::div(simd::set1(1.0f), simd::sqrt(dot3(norm, norm)));
+				for (float4& v : norm) v = simd::mul(v, inv_length);
+			}
+		};
+
+		struct DualQuaternionKernel {
+			const DualQuaternion* bones;
+
+			void operator()(const VertexGroup& g, float4 (&pos)[3], float4 (&norm)[3]) const {
+				float4 real[4], dual[4];
+				const Quaternion* pivot[4];
+				for (size_t lane = 0; lane < 4; ++lane) {
+					real[lane] = dual[lane] = simd::zero();
+					pivot[lane] = &bones[g.bones[0][lane]].real;
+				}
+
+				for (size_t k = 0; k < SkinInfluences::Slots; ++k) {
+					if (!any_weight(g.weights[k])) continue;
+					for (size_t lane = 0; lane < 4; ++lane) {
+						// Antipodal rotations are the same rotation; blend every bone on the first one's side
+						const DualQuaternion& bone = bones[g.bones[k][lane]];
+						float w = bone.real.Dot(*pivot[lane]) < 0.0f ? -g.weights[k][lane] : g.weights[k][lane];
+						real[lane] = simd::madd(simd::set1(w), simd::load(bone.real.vals), real[lane]);
+						dual[lane] = simd::madd(simd::set1(w), simd::load(bone.dual.vals), dual[lane]);
+					}
+				}
+				simd::transpose(real[0], real[1], real[2], real[3]);
+				simd::transpose(dual[0], dual[1], dual[2], dual[3]);
+
+				float4 length_sq = simd::madd(real[3], real[3], simd::madd(real[2], real[2], simd::madd(real[1], real[1], simd::mul(real[0], real[0]))));
+				float4 inv = simd::div(simd::set1(1.0f), simd::sqrt(length_sq));
+				for (size_t c = 0; c < 4; ++c) {
+					real[c] = simd::mul(real[c], inv);
+					dual[c] = simd::mul(dual[c], inv);
+				}
+
+				float4 rot[3][3];
+				simd::to_rot4(real, rot);
+
+				// Translation 2 conj(real) dual, vector part only
+				const float4 &i = real[0], &j = real[1], &k = real[2], &r = real[3];
+				const float4 &di = dual[0], &dj = dual[1], &dk = dual[2], &dr = dual[3];
+				const float4 t[3] = {
+					simd::sub(simd::sub(simd::mul(r, di), simd::mul(i, dr)), simd::sub(simd::mul(j, dk), simd::mul(k, dj))),
+					simd::sub(simd::add(simd::mul(r, dj), simd::mul(i, dk)), simd::add(simd::mul(j, dr), simd::mul(k, di))),
+					simd::sub(simd::sub(simd::mul(r, dk), simd::mul(i, dj)), simd::sub(simd::mul(k, dr), simd::mul(j, di))),
+				};
+
+				mul3(g.pos, rot, pos);
+				for (size_t c = 0; c < 3; ++c) pos[c] = simd::madd(t[c], simd::set1(2.0f), pos[c]);
+				mul3(g.norm, rot, norm);
+			}
+		};
+
+		template <class Kernel>
+		void skin_range(const Kernel& kernel, const Vert3dSoA& in, const SkinInfluences& influences,
+			Vec3fSoA& out_positions, Vec3fSoA& out_normals, size_t begin, size_t end) {
+			auto run = [&](size_t first, size_t lanes) {
+				VertexGroup g;
+				float scratch[4] = {};
+				auto gather = [&](const float* stream) {
+					if (lanes == 4) return simd::load(stream + first);
+					for (size_t lane = 0; lane < lanes; ++lane) scratch[lane] = stream[first + lane];
+					return simd::load(scratch);
+				};
+
+				for (size_t c = 0; c < 3; ++c) {
+					g.pos[c] = gather(in.pos.streams[c].data());
+					g.norm[c] = gather(in.norm.streams[c].data());
+				}
+				for (size_t k = 0; k < SkinInfluences::Slots; ++k) {
+					for (size_t lane = 0; lane < 4; ++lane) {
+						bool used = lane < lanes;
+						g.weights[k][lane] = used ? influences.weights[k][first + lane] : 0.0f;
+						g.bones[k][lane] = influences.bones[k][used ? first + lane : first];
+					}
+				}
+
+				float4 pos[3], norm[3];
+				kernel(g, pos, norm);
+
+				for (size_t c = 0; c < 3; ++c) {
+					if (lanes == 4) {
+						simd::store(out_positions.streams[c].data() + first, pos[c]);
+						simd::store(out_normals.streams[c].data() + first, norm[c]);
+						continue;
+					}
+					simd::store(scratch, pos[c]);
+					for (size_t lane = 0; lane < lanes; ++lane) out_positions.streams[c][first + lane] = scratch[lane];
+					simd::store(scratch, norm[c]);
+					for (size_t lane = 0; lane < lanes; ++lane) out_normals.streams[c][first + lane] = scratch[lane];
+				}
+			};
+
+			size_t n = begin;
+			for (; n + 4 <= end; n += 4) run(n, 4);
+			if (n < end) run(n, end - n);
+		}
+
+		template <class Kernel>
+		void skin(const Kernel& kernel, const Vert3dSoA& in, const SkinInfluences& influences, Vec3fSoA& out_positions, Vec3fSoA& out_normals) {
+			MATH_INSTRUMENT(Skinning);
+			assert(influences.size() >= in.size());
+			if (out_positions.size() != in.size()) out_positions.resize(in.size());
+			if (out_normals.size() != in.size()) out_normals.resize(in.size());
+			parallel_for(in.size(), SkinGrain, [&](size_t begin, size_t end) {
+				skin_range(kernel, in, influences, out_positions, out_normals, begin, end);
+			});
+		}
+	}
+
+	void skin_linear(span<const Xformf> bones, const Vert3dSoA& in, const SkinInfluences& influences,
+		Vec3fSoA& out_positions, Vec3fSoA& out_normals) {
+		skin(LinearKernel { bones.data() }, in, influences, out_positions, out_normals);
+	}
+
+	void skin_dual_quaternion(span<const DualQuaternion> bones, const Vert3dSoA& in, const SkinInfluences& influences,
+		Vec3fSoA& out_positions, Vec3fSoA& out_normals) {
+		skin(DualQuaternionKernel { bones.data() }, in, influences, out_positions, out_normals);
+	}
+}
@@ -0,0 +1,117 @@
+#include "SoA.h"
+
+namespace Math3D {
+	static_assert(sizeof(Vec3f) == 3 * sizeof(float));
+	static_assert(sizeof(Vert3d) == 8 * sizeof(float));
+
+	void to_soa(span<const Vec3f> in, Vec3fSoA& out) {
+		out.resize(in.size());
+		const float* src = reinterpret_cast<const float*>(in.data());
+		float* x = out.streams[0].data();
+		float* y = out.streams[1].data();
+		float* z = out.streams[2].data();
+
+		// Four packed Vec3f have the same layout as an Xformf
+		size_t i = 0;
+		for (; i + 4 <= in.size(); i += 4) {
+			simd::float4 r0, r1, r2, r3;
+			simd::load_xform(src + i * 3, r0, r1, r2, r3);
+			simd::transpose(r0, r1, r2, r3);
+			simd::store(x + i, r0);
+			simd::store(y + i, r1);
+			simd::store(z + i, r2);
+		}
+
+		for (; i < in.size(); ++i) {
+			out.set(i, in[i]);
+		}
+	}
+
+	void to_aos(const Vec3fSoA& in, span<Vec3f> out) {
+		assert(out.size() >= in.size());
+		float* dst = reinterpret_cast<float*>(out.data());
+		const float* x = in.streams[0].data();
+		const float* y = in.streams[1].data();
+		const float* z = in.streams[2].data();
+
+		size_t i = 0;
+		for (; i + 4 <= in.size(); i += 4) {
+			simd::float4 r0 = simd::load(x + i), r1 = simd::load(y + i), r2 = simd::load(z + i), r3 = simd::zero();
+			simd::transpose(r0, r1, r2, r3);
+			simd::store_xform(dst + i * 3, r0, r1, r2, r3);
+		}
+
+		for (; i < in.size(); ++i) {
+			out[i] = in.get(i);
+		}
+	}
+
+	// A Vert3d is two float4s: (pos.x, pos.y, pos.z, norm.x) and (norm.y, norm.z, uv.x, uv.y),
+	// so four vertices transpose into the eight streams with two 4x4 transposes
+	void to_soa(span<const Vert3d> in, Vert3dSoA& out) {
+		out.resize(in.size());
+		const float* src = reinterpret_cast<const float*>(in.data());
+		float* dst[8] = {
+			out.pos.streams[0].data(), out.pos.streams[1].data(), out.pos.streams[2].data(),
+			out.norm.streams[0].data(), out.norm.streams[1].data(), out.norm.streams[2].data(),
+			out.uv.streams[0].data(), out.uv.streams[1].data(),
+		};
+
+		size_t i = 0;
+		for (; i + 4 <= in.size(); i += 4) {
+			const float* v = src + i * 8;
+			simd::float4 a0 = simd::load(v), a1 = simd::load(v + 8), a2 = simd::load(v + 16), a3 = simd::load(v + 24);
+			simd::float4 b0 = simd::load(v + 4), b1 = simd::load(v + 12), b2 = simd::load(v + 20), b3 = simd::load(v + 28);
+			simd::transpose(a0, a1, a2, a3);
+			simd::transpose(b0, b1, b2, b3);
+			simd::store(dst[0] + i, a0);
+			simd::store(dst[1] + i, a1);
+			simd::store(dst[2] + i, a2);
+			simd::store(dst[3] + i, a3);
+			simd::store(dst[4] + i, b0);
+			simd::store(dst[5] + i, b1);
+			simd::store(dst[6] + i, b2);
+			simd::store(dst[7] + i, b3);
+		}
+
+		for (; i < in.size(); ++i) {
+			for (size_t k = 0; k < 8; ++k) {
+				dst[k][i] = src[i * 8 + k];
+			}
+		}
+	}
+
+	void to_aos(const Vert3dSoA& in, span<Vert3d> out) {
+		assert(out.size() >= in.size());
+		float* dst = reinterpret_cast<float*>(out.data());
+		const float* src[8] = {
+			in.pos.streams[0].data(), in.pos.streams[1].data(), in.pos.streams[2].data(),
+			in.norm.streams[0].data(), in.norm.streams[1].data(), in.norm.streams[2].data(),
+			in.uv.streams[0].data(), in.uv.streams[1].data(),
+		};
+
+		size_t i = 0;
+		for (; i + 4 <= in.size(); i += 4) {
+			simd::float4 a0 = simd::load(src[0] + i), a1 = simd::load(src[1] + i), a2 = simd::load(src[2] + i), a3 = simd::load(src[3] + i);
+			simd::float4 b0 = simd::load(src[4] + i), b1 = simd::load(src[5] + i), b2 = simd::load(src[6] + i), b3 = simd::load(src[7] + i);
+			simd::transpose(a0, a1, a2, a3);
+			simd::transpose(b0, b1, b2, b3);
+
+			float* v = dst + i * 8;
+			simd::store(v, a0);
+			simd::store(v + 4, b0);
+			simd::store(v + 8, a1);
+			simd::store(v + 12, b1);
+			simd::store(v + 16, a2);
+			simd::store(v + 20, b2);
+			simd::store(v + 24, a3);
+			simd::store(v + 28, b3);
+		}
+
+		for (; i < in.size(); ++i) {
+			for (size_t k = 0; k < 8; ++k) {
+				dst[i * 8 + k] = src[k][i];
+			}
+		}
+	}
+}
@@ -0,0 +1,184 @@
+#include "TRSBatch.h"
+#include "Parallel.h"
+#include "Transforms.h"
+
+#include <cassert>
+
+namespace Math3D {
+	static_assert(sizeof(Xformf) == 12 * sizeof(float));
+
+	namespace {
+		using simd::float4;
+
+		// Elements per parallel_for chunk
+		constexpr size_t TRSGrain = 8192;
+
+		// The thresholds decompose() uses to take its unsheared path
+		constexpr float ShearTolerance = 1e-5f;
+		constexpr float DegenerateScale = 1e-12f;
+
+		using simd::dot3;
+		using simd::negate_if;
+
+		void compose_range(const TRSBatch& trs, float* dst, size_t begin, size_t end) {
+			size_t n = begin;
+			for (; n + 4 <= end; n += 4) {
+				float4 q[4], m[3][3];
+				for (size_t c = 0; c < 4; ++c) q[c] = simd::load(trs.rotation.streams[c].data() + n);
+				simd::to_rot4(q, m);
+
+				// Each row is scaled, then transposed so lane n of the four becomes row r of xform n
+				float4 rows[4][4];
+				for (size_t row = 0; row < 3; ++row) {
+					float4 s = simd::load(trs.scale.streams[row].data() + n);
+					for (size_t c = 0; c < 3; ++c) rows[row][c] = simd::mul(m[row][c], s);
+					rows[row][3] = simd::zero();
+					simd::transpose(rows[row][0], rows[row][1], rows[row][2], rows[row][3]);
+				}
+				rows[3][0] = simd::load(trs.translation.streams[0].data() + n);
+				rows[3][1] = simd::load(trs.translation.streams[1].data() + n);
+				rows[3][2] = simd::load(trs.translation.streams[2].data() + n);
+				rows[3][3] = simd::zero();
+				simd::transpose(rows[3][0], rows[3][1], rows[3][2], rows[3][3]);
+
+				for (size_t lane = 0; lane < 4; ++lane) {
+					simd::store_xform(dst + (n + lane) * 12, rows[0][lane], rows[1][lane], rows[2][lane], rows[3][lane]);
+				}
+			}
+
+			for (; n < end; ++n) {
+				Xformf xform = compose(trs.rotation.get(n), trs.translation.get(n), trs.scale.get(n));
+				std::copy(xform.arr.begin(), xform.arr.end(), dst + n * 12);
+			}
+		}
+
+		// Quaternion(const Xformf&) without branches: every lane works from its largest of 4r^2, 4i^2, 4j^2
+		// and 4k^2, then the sign is made r >= 0 as decompose() does
+		void to_quaternion(const float4 (&u)[3][3], float4 (&q)[4]) {
+			float4 one = simd::set1(1.0f);
+			float4 t_r = simd::add(one, simd::add(u[0][0], simd::add(u[1][1], u[2][2])));
+			float4 t_i = simd::add(one, simd::sub(u[0][0], simd::add(u[1][1], u[2][2])));
+			float4 t_j = simd::add(one, simd::sub(u[1][1], simd::add(u[0][0], u[2][2])));
+			float4 t_k = simd::add(one, simd::sub(u[2][2], simd::add(u[0][0], u[1][1])));
+
+			float4 case_r = simd::bit_and(simd::cmple(t_i, t_r), simd::bit_and(simd::cmple(t_j, t_r), simd::cmple(t_k, t_r)));
+			float4 case_i = simd::bit_and(simd::cmple(t_j, t_i), simd::cmple(t_k, t_i));
+			float4 case_j = simd::cmple(t_k, t_j);
+
+			float4 s = simd::mul(simd::set1(2.0f), simd::sqrt(simd::max(simd::max(t_r, t_i), simd::max(t_j, t_k))));
+			float4 inv_s = simd::div(one, s), quarter = simd::mul(s, simd::set1(0.25f));
+			float4 a = simd::mul(simd::sub(u[2][1], u[1][2]), inv_s);
+			float4 b = simd::mul(simd::sub(u[0][2], u[2][0]), inv_s);
+			float4 c = simd::mul(simd::sub(u[1][0], u[0][1]), inv_s);
+			float4 d = simd::mul(simd::add(u[0][1], u[1][0]), inv_s);
+			float4 e = simd::mul(simd::add(u[0][2], u[2][0]), inv_s);
+			float4 f = simd::mul(simd::add(u[1][2], u[2][1]), inv_s);
+
+			auto pick = [&](float4 if_r, float4 if_i, float4 if_j, float4 if_k) {
+				return simd::select(case_r, if_r, simd::select(case_i, if_i, simd::select(case_j, if_j, if_k)));
+			};
+			q[0] = pick(a, quarter, d, e);
+			q[1] = pick(b, d, quarter, f);
+			q[2] = pick(c, e, f, quarter);
+			q[3] = pick(quarter, a, b, c);
+
+			float4 flip = simd::cmplt(q[3], simd::zero());
+			for (float4& v : q) v = negate_if(flip, v);
+		}
+
+		void decompose_range(span<const Xformf> xforms, TRSBatch& out, size_t begin, size_t end) {
+			const float* src = reinterpret_cast<const float*>(xforms.data());
+			float* rot[4] = { out.rotation.streams[0].data(), out.rotation.streams[1].data(), out.rotation.streams[2].data(), out.rotation.streams[3].data() };
+
+			size_t n = begin;
+			for (; n + 4 <= end; n += 4) {
+				// rows[x][r] is row r of xform n + x until transposed into lanes
+				float4 rows[4][4];
+				for (size_t x = 0; x < 4; ++x) {
+					simd::load_xform(src + (n + x) * 12, rows[x][0], rows[x][1], rows[x][2], rows[x][3]);
+				}
+
+				float4 m[4][3];
+				for (size_t r = 0; r < 4; ++r) {
+					float4 a = rows[0][r], b = rows[1][r], c = rows[2][r], d = rows[3][r];
+					simd::transpose(a, b, c, d);
+					m[r][0] = a;
+					m[r][1] = b;
+					m[r][2] = c;
+				}
+
+				float4 scale[3], u[3][3];
+				float4 usable = simd::cmplt(simd::zero(), simd::set1(1.0f));
+				for (size_t r = 0; r < 3; ++r) {
+					float4 length_sq = dot3(m[r], m[r]);
+					usable = simd::bit_and(usable, simd::cmplt(simd::set1(DegenerateScale), length_sq));
+					scale[r] = simd::sqrt(length_sq);
+					float4 inv = simd::div(simd::set1(1.0f), scale[r]);
+					for (size_t c = 0; c < 3; ++c) u[r][c] = simd::mul(m[r][c], inv);
+				}
+
+				// Zero rows give NaNs here, which fail the compares and so also land in the scalar fallback
+				float4 tolerance = simd::set1(ShearTolerance);
+				usable = simd::bit_and(usable, simd::cmplt(simd::abs(dot3(u[0], u[1])), tolerance));
+				usable = simd::bit_and(usable, simd::cmplt(simd::abs(dot3(u[0], u[2])), tolerance));
+				usable = simd::bit_and(usable, simd::cmplt(simd::abs(dot3(u[1], u[2])), tolerance));
+
+				// A mirror moves onto the first row and the first scale, as in decompose()
+				float4 cross[3] = {
+					simd::sub(simd::mul(u[0][1], u[1][2]), simd::mul(u[0][2], u[1][1])),
+					simd::sub(simd::mul(u[0][2], u[1][0]), simd::mul(u[0][0], u[1][2])),
+					simd::sub(simd::mul(u[0][0], u[1][1]), simd::mul(u[0][1], u[1][0])),
+				};
+				float4 mirror = simd::cmplt(dot3(cross, u[2]), simd::zero());
+				for (float4& v : u[0]) v = negate_if(mirror, v);
+				scale[0] = negate_if(mirror, scale[0]);
+
+				float4 q[4];
+				to_quaternion(u, q);
+				for (size_t c = 0; c < 4; ++c) simd::store(rot[c] + n, q[c]);
+				for (size_t c = 0; c < 3; ++c) {
+					simd::store(out.translation.streams[c].data() + n, m[3][c]);
+					simd::store(out.scale.streams[c].data() + n, scale[c]);
+				}
+
+				if (unsigned fallback = ~simd::movemask(usable) & 0xF) {
+					for (size_t lane = 0; lane < 4; ++lane) {
+						if (fallback >> lane & 1) {
+							Quaternion rotation;
+							Vec3f translation, scale_factors;
+							decompose(xforms[n + lane], rotation, translation, scale_factors);
+							out.rotation.set(n + lane, rotation);
+							out.scale.set(n + lane, scale_factors);
+						}
+					}
+				}
+			}
+
+			for (; n < end; ++n) {
+				Quaternion rotation;
+				Vec3f translation, scale_factors;
+				decompose(xforms[n], rotation, translation, scale_factors);
+				out.rotation.set(n, rotation);
+				out.translation.set(n, translation);
+				out.scale.set(n, scale_factors);
+			}
+		}
+	}
+
+	void compose(const TRSBatch& trs, span<Xformf> out) {
+		MATH_INSTRUMENT(Compose);
+		assert(out.size() >= trs.size());
+		float* dst = reinterpret_cast<float*>(out.data());
+		parallel_for(trs.size(), TRSGrain, [&](size_t begin, size_t end) {
+			compose_range(trs, dst, begin, end);
+		});
+	}
+
+	void decompose(span<const Xformf> xforms, TRSBatch& out) {
+		MATH_INSTRUMENT(Decompose);
+		if (out.size() != xforms.size()) out.resize(xforms.size());
+		parallel_for(xforms.size(), TRSGrain, [&](size_t begin, size_t end) {
+			decompose_range(xforms, out, begin, end);
+		});
+	}
+}
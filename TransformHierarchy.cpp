@@ -0,0 +1,212 @@
+#include "TransformHierarchy.h"
+#include "Parallel.h"
+#include "Transforms.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace Math3D {
+	TransformHierarchy::Handle TransformHierarchy::add(Handle parent, const Quaternion& rotation, const Vec3f& translation, const Vec3f& scale) {
+		assert(parent == None || parent < slot_of.size());
+
+		Handle node = Handle(slot_of.size());
+		uint32_t slot = uint32_t(handle_of.size());
+		uint32_t parent_at = parent == None ? None : slot_of[parent];
+
+		slot_of.push_back(slot);
+		handle_of.push_back(node);
+		parent_slot.push_back(parent_at);
+		level.push_back(parent == None ? 0 : level[parent_at] + 1);
+		rotations.push_back(rotation);
+		translations.push_back(translation);
+		scales.push_back(scale);
+		worlds_by_slot.push_back(Identity);
+		dirty.push_back(0);
+
+		mark_dirty(slot);
+		order_stale = true;
+		return node;
+	}
+
+	void TransformHierarchy::reserve(size_t count) {
+		slot_of.reserve(count);
+		handle_of.reserve(count);
+		parent_slot.reserve(count);
+		level.reserve(count);
+		rotations.reserve(count);
+		translations.reserve(count);
+		scales.reserve(count);
+		worlds_by_slot.reserve(count);
+		dirty.reserve(count);
+	}
+
+	TransformHierarchy::Handle TransformHierarchy::parent(Handle node) const {
+		uint32_t p = parent_slot[slot_of[node]];
+		return p == None ? None : handle_of[p];
+	}
+
+	void TransformHierarchy::set_local(Handle node, const Quaternion& rotation, const Vec3f& translation, const Vec3f& scale) {
+		uint32_t slot = slot_of[node];
+		rotations[slot] = rotation;
+		translations[slot] = translation;
+		scales[slot] = scale;
+		mark_dirty(slot);
+	}
+
+	void TransformHierarchy::set_rotation(Handle node, const Quaternion& rotation) {
+		uint32_t slot = slot_of[node];
+		rotations[slot] = rotation;
+		mark_dirty(slot);
+	}
+
+	void TransformHierarchy::set_translation(Handle node, const Vec3f& translation) {
+		uint32_t slot = slot_of[node];
+		translations[slot] = translation;
+		mark_dirty(slot);
+	}
+
+	void TransformHierarchy::set_scale(Handle node, const Vec3f& scale) {
+		uint32_t slot = slot_of[node];
+		scales[slot] = scale;
+		mark_dirty(slot);
+	}
+
+	void TransformHierarchy::mark_dirty(uint32_t slot) {
+		if (!dirty[slot]) {
+			dirty[slot] = 1;
+			dirty_slots.push_back(slot);
+		}
+	}
+
+	// Stable counting sort of the slots by level. Parents keep preceding their children and siblings keep
+	// their relative order, so repeated rebuilds are deterministic.
+	void TransformHierarchy::rebuild_order() {
+		size_t count = handle_of.size();
+		size_t levels = 0;
+		for (uint32_t l : level) levels = std::max<size_t>(levels, l + 1);
+
+		level_begin.assign(levels + 1, 0);
+		for (uint32_t l : level) ++level_begin[l + 1];
+		for (size_t l = 0; l < levels; ++l) level_begin[l + 1] += level_begin[l];
+
+		vector<uint32_t> new_slot(count);
+		vector<uint32_t> cursor(level_begin.begin(), level_begin.end() - 1);
+		for (size_t s = 0; s < count; ++s) {
+			new_slot[s] = cursor[level[s]]++;
+		}
+
+		auto permute = [&](auto& values) {
+			std::remove_reference_t<decltype(values)> sorted(values.size());
+			for (size_t s = 0; s < count; ++s) sorted[new_slot[s]] = values[s];
+			values.swap(sorted);
+		};
+
+		for (auto& p : parent_slot) {
+			if (p != None) p = new_slot[p];
+		}
+		for (auto& s : dirty_slots) s = new_slot[s];
+		permute(handle_of);
+		permute(parent_slot);
+		permute(level);
+		permute(rotations);
+		permute(translations);
+		permute(scales);
+		permute(worlds_by_slot);
+		permute(dirty);
+
+		for (size_t s = 0; s < count; ++s) {
+			slot_of[handle_of[s]] = uint32_t(s);
+		}
+
+		children_begin.assign(count, uint32_t(count));
+		children_end.assign(count, 0);
+		for (uint32_t s = 0; s < count; ++s) {
+			uint32_t p = parent_slot[s];
+			if (p == None) continue;
+			children_begin[p] = std::min(children_begin[p], s);
+			children_end[p] = std::max(children_end[p], s + 1);
+		}
+		order_stale = false;
+	}
+
+	size_t TransformHierarchy::update(size_t parallel_grain) {
+		if (order_stale) {
+			rebuild_order();
+		}
+		if (dirty_slots.empty()) {
+			return 0;
+		}
+
+		// Each level's span starts out covering its dirty nodes and grows by the children of the nodes
+		// recomputed on the level above
+		size_t levels = depth();
+		visit_begin.assign(levels, uint32_t(size()));
+		visit_end.assign(levels, 0);
+		for (uint32_t s : dirty_slots) {
+			visit_begin[level[s]] = std::min(visit_begin[level[s]], s);
+			visit_end[level[s]] = std::max(visit_end[level[s]], s + 1);
+		}
+
+		struct Visit {
+			size_t recomputed = 0;
+			uint32_t children_begin, children_end = 0;
+		};
+
+		// A node is recomputed when it or its parent is dirty; it then stays flagged for its own children
+		auto update_range = [this](size_t begin, size_t end) {
+			Visit visit { 0, uint32_t(size()) };
+			for (size_t s = begin; s < end; ++s) {
+				uint32_t p = parent_slot[s];
+				bool parent_dirty = p != None && dirty[p];
+				if (!dirty[s] && !parent_dirty) {
+					continue;
+				}
+
+				Xformf local = compose(rotations[s], translations[s], scales[s]);
+				worlds_by_slot[s] = p == None ? local : local * worlds_by_slot[p];
+				dirty[s] = 1;
+				++visit.recomputed;
+				if (children_begin[s] < children_end[s]) {
+					visit.children_begin = std::min(visit.children_begin, children_begin[s]);
+					visit.children_end = std::max(visit.children_end, children_end[s]);
+				}
+			}
+			return visit;
+		};
+
+		size_t recomputed = 0;
+		for (size_t l = 0; l < levels; ++l) {
+			size_t begin = visit_begin[l], end = visit_end[l];
+			if (begin >= end) continue;
+
+			Visit visit;
+			if (end - begin < parallel_grain) {
+				visit = update_range(begin, end);
+			}
+			else {
+				visit.children_begin = uint32_t(size());
+				std::mutex merge;
+				parallel_for(end - begin, parallel_grain, [&](size_t b, size_t e) {
+					Visit chunk = update_range(begin + b, begin + e);
+					std::lock_guard lock(merge);
+					visit.recomputed += chunk.recomputed;
+					visit.children_begin = std::min(visit.children_begin, chunk.children_begin);
+					visit.children_end = std::max(visit.children_end, chunk.children_end);
+				});
+			}
+
+			recomputed += visit.recomputed;
+			if (visit.children_begin < visit.children_end) {
+				visit_begin[l + 1] = std::min(visit_begin[l + 1], visit.children_begin);
+				visit_end[l + 1] = std::max(visit_end[l + 1], visit.children_end);
+			}
+		}
+
+		// Every flag set, by mark_dirty or above, lies in a visited span
+		for (size_t l = 0; l < levels; ++l) {
+			if (visit_begin[l] < visit_end[l]) std::fill(dirty.begin() + visit_begin[l], dirty.begin() + visit_end[l], uint8_t(0));
+		}
+		dirty_slots.clear();
+		return recomputed;
+	}
+}
@@ -1,144 +1,382 @@
 #include "Transforms.h"
 #include "Quaternion.h"
+#include "SIMD.h"
+#include "Parallel.h"
+#include <algorithm>
 #include <cmath>
 
 namespace Math3D {
-	Xformf rotation(const Vec3f& axis, float angle) {
-		float c = std::cos(angle);
-		float s = std::sin(angle);
-		float t = 1.0f - c;
-
-		Vec3f n_axis = axis.normalize();
-		float x = n_axis[0];
-		float y = n_axis[1];
-		float z = n_axis[2];
-
-		float tx = t * x, ty = t * y, tz = t * z;
-		float sx = s * x, sy = s * y, sz = s * z;
-		float txx = tx * x, tyy = ty * y, tzz = tz * z;
-		float txy = tx * y, txz = tx * z, tyz = ty * z;
-
-		return Xformf {
-			txx + c,  txy - sz, txz + sy,
-			txy + sz, tyy + c,  tyz - sx,
-			txz - sy, tyz + sx, tzz + c,
-			0.0f,     0.0f,     0.0f,
-		};
-	}
-
 	Xformf rotation(const Quaternion& axisAngle) {
-		float angle = 2.0f * std::acos(axisAngle.w);
+		float angle = 2.0f * trig::Precise::acos(axisAngle.w);
 		float rs = 1.0f /std::sqrt(1.0f - axisAngle.w * axisAngle.w);
 
 		return rotation(Vec3f(axisAngle.x * rs, axisAngle.y * rs, axisAngle.z * rs), angle);
 	}
 
-	Xformf rotX(float angle) {
-		float c = std::cos(angle);
-		float s = std::sin(angle);
+	namespace {
+		// Rows with pairwise dot products below this once normalized are taken as unsheared
+		constexpr float ShearTolerance = 1e-5f;
 
-		return Xformf {
-			1.0f, 	0.0f, 	0.0f,
-			0.0f, 	c, 		-s,
-			0.0f, 	s,		c,
-			0.0f, 	0.0f,	0.0f,
-		};
-	}
+		// Squared lengths and determinants below this count as zero
+		constexpr float DegenerateScale = 1e-12f;
 
-	Xformf rotY(float angle) {
-		float c = std::cos(angle);
-		float s = std::sin(angle);
+		// Gram-Schmidt over the rows, longest first, filling in whatever a zero scale left undetermined.
+		// Only reached for singular linear parts, where any rotation the stretch maps back to the input will do.
+		template <class T>
+		Matrix<T, 3, 3> orthonormalize(const Matrix<T, 3, 3>& m) {
+			using Vec3 = Vec<T, 3>;
+			Vec3 rows[3] = { m[0], m[1], m[2] };
+			size_t order[3] = { 0, 1, 2 };
+			std::sort(order, order + 3, [&](size_t x, size_t y) { return rows[x].dot(rows[x]) > rows[y].dot(rows[y]); });
 
-		return Xformf {
-			c,		0.0f,	s,
-			0.0f,	1.0f,	0.0f,
-			-s, 	0.0f, 	c,
-			0.0f,	0.0f,	0.0f,
-		};
-	}
+			Vec3 a = rows[order[0]];
+			if (a.dot(a) <= DegenerateScale) {
+				return Matrix<T, 3, 3> { T(1), T(0), T(0), T(0), T(1), T(0), T(0), T(0), T(1) };
+			}
+			a = a.normalize();
 
-	Xformf rotZ(float angle) {
-		float c = std::cos(angle);
-		float s = std::sin(angle);
+			Vec3 b = rows[order[1]] - a * rows[order[1]].dot(a);
+			if (b.dot(b) <= DegenerateScale) {
+				b = std::fabs(a[0]) < T(0.9) ? Vec3(T(1), T(0), T(0)) : Vec3(T(0), T(1), T(0));
+				b = b - a * b.dot(a);
+			}
+			b = b.normalize();
 
-		return Xformf {
-			c,		-s,		0.0f,
-			s,		c,		0.0f,
-			0.0f,	0.0f,	1.0f,
-			0.0f,	0.0f,	0.0f,
-		};
+			Vec3 c = a.cross(b);
+			if (rows[order[2]].dot(c) < T(0)) c = c * T(-1);
+
+			Matrix<T, 3, 3> u;
+			u[order[0]] = a;
+			u[order[1]] = b;
+			u[order[2]] = c;
+			return u;
+		}
+
+		template <class T>
+		T frobenius(const Matrix<T, 3, 3>& m) {
+			return std::sqrt(m.dot(m));
+		}
+
+		// Orthogonal factor of the polar decomposition by Higham's scaled Newton iteration, which converges
+		// quadratically for any invertible m
+		template <class T>
+		Matrix<T, 3, 3> polar_rotation(const Matrix<T, 3, 3>& m) {
+			Matrix<T, 3, 3> u = m;
+			for (int iteration = 0; iteration < 16; ++iteration) {
+				Matrix<T, 3, 3> inv_t = u.inverse().transpose();
+				T gamma = std::sqrt(frobenius(inv_t) / frobenius(u));
+				Matrix<T, 3, 3> next = u * (T(0.5) * gamma) + inv_t * (T(0.5) / gamma);
+				T change = frobenius(next - u);
+				u = next;
+				if (change < T(1e-6)) break;
+			}
+			return u;
+		}
+
+		template <class T>
+		Quaternion to_quaternion(const Matrix<T, 3, 3>& u) {
+			Quaternion q(Xformf {
+				float(u[0][0]), float(u[0][1]), float(u[0][2]),
+				float(u[1][0]), float(u[1][1]), float(u[1][2]),
+				float(u[2][0]), float(u[2][1]), float(u[2][2]),
+				0.0f,           0.0f,           0.0f,
+			});
+			return q.r < 0.0f ? q * -1.0f : q;
+		}
+
+		template <class T>
+		void decompose_impl(const Matrix<T, 3, 4>& xform, Quaternion& out_rotation, Vec<T, 3>& out_translation, Matrix<T, 3, 3>& out_stretch) {
+			using Vec3 = Vec<T, 3>;
+			Matrix<T, 3, 3> m {
+				xform[0][0], xform[0][1], xform[0][2],
+				xform[1][0], xform[1][1], xform[1][2],
+				xform[2][0], xform[2][1], xform[2][2],
+			};
+			out_translation = xform[3];
+
+			// Unsheared rows are the common case: their lengths are the scale and their directions the rotation
+			Vec3 lengths(m[0].length(), m[1].length(), m[2].length());
+			Matrix<T, 3, 3> u;
+			bool direct = lengths[0] * lengths[0] > DegenerateScale && lengths[1] * lengths[1] > DegenerateScale && lengths[2] * lengths[2] > DegenerateScale;
+			if (direct) {
+				for (size_t r = 0; r < 3; ++r) {
+					u[r] = Vec3(m[r]) / lengths[r];
+				}
+				direct = std::fabs(Vec3(u[0]).dot(u[1])) < ShearTolerance && std::fabs(Vec3(u[0]).dot(u[2])) < ShearTolerance &&
+					std::fabs(Vec3(u[1]).dot(u[2])) < ShearTolerance;
+			}
+
+			if (!direct) {
+				u = std::fabs(m.determinant()) > DegenerateScale ? polar_rotation(m) : orthonormalize(m);
+			}
+
+			// A mirror leaves u improper; moving the reflection onto the first row keeps u a rotation
+			if (Vec3(u[0]).cross(u[1]).dot(u[2]) < T(0)) {
+				u[0] = Vec3(u[0]) * T(-1);
+			}
+
+			out_rotation = to_quaternion(u);
+			if (direct) {
+				T sign = Vec3(m[0]).dot(u[0]) < T(0) ? T(-1) : T(1);
+				out_stretch = Matrix<T, 3, 3> { sign * lengths[0], T(0), T(0), T(0), lengths[1], T(0), T(0), T(0), lengths[2] };
+			}
+			else {
+				out_stretch = m * u.transpose();
+			}
+		}
 	}
 
-	Xformf translation(const Vec3f& offset) {
-		return Xformf {
-			1.0f, 0.0f, 0.0f,
-			0.0f, 1.0f, 0.0f,
-			0.0f, 0.0f, 1.0f,
-			offset[0], offset[1], offset[2],
-		};
+	void decompose(const Xformf& xform, Quaternion& out_rotation, Vec3f& out_translation, Mat3f& out_stretch) {
+		MATH_INSTRUMENT(Decompose);
+		decompose_impl(xform, out_rotation, out_translation, out_stretch);
 	}
 
-	Xformf scale(const Vec3f& scale_factors) {
-		return Xformf {
-			scale_factors[0], 0.0f, 0.0f,
-			0.0f, scale_factors[1], 0.0f,
-			0.0f, 0.0f, scale_factors[2],
-			0.0f, 0.0f, 0.0f,
-		};
+	void decompose(const Xformd& xform, Quaternion& out_rotation, Vec3d& out_translation, Mat3d& out_stretch) {
+		MATH_INSTRUMENT(Decompose);
+		decompose_impl(xform, out_rotation, out_translation, out_stretch);
+	}
+
+	void decompose(const Xformf& xform, Quaternion& out_rotation, Vec3f& out_translation, Vec3f& out_scale) {
+		Mat3f stretch;
+		decompose(xform, out_rotation, out_translation, stretch);
+		out_scale = Vec3f(stretch[0][0], stretch[1][1], stretch[2][2]);
 	}
 
-	Xformf compose(const Quaternion& _rotation, const Vec3f& _translation, const Vec3f& _scale) {
-		return rotation(_rotation) * translation(_translation) * scale(_scale);
+	void decompose(const Xformd& xform, Quaternion& out_rotation, Vec3d& out_translation, Vec3d& out_scale) {
+		Mat3d stretch;
+		decompose(xform, out_rotation, out_translation, stretch);
+		out_scale = Vec3d(stretch[0][0], stretch[1][1], stretch[2][2]);
 	}
 
 	float distance(const Vec3f& a, const Vec3f& b) {
 		return (a - b).length();
 	}
 
+	double distance(const Vec3d& a, const Vec3d& b) {
+		return (a - b).length();
+	}
+
 	float angle(const Vec3f& a, const Vec3f& b) {
 		return std::acos(a.dot(b));
 	}
-	
-	Xformf look_at(const Xformf& from, const Xformf& to) {
-		Vec3f eye = from[3];
-		Vec3f target = to[3];
-
-		Vec3f fwd = (target - eye).normalize();
-		Vec3f left = Vec3f(0.0f, 1.0f, 0.0f).cross(fwd).normalize();
-		Vec3f up = fwd.cross(left).normalize();
-
-		// Transpose the rotation (rows become columns) and negate
-		// the translation through dot products to get world-to-camera.
-		return Xformf {
-			left[0],  up[0],  fwd[0],
-			left[1],  up[1],  fwd[1],
-			left[2],  up[2],  fwd[2],
-			-left.dot(eye), -up.dot(eye), -fwd.dot(eye),
-		};
+
+	double angle(const Vec3d& a, const Vec3d& b) {
+		return std::acos(a.dot(b));
 	}
 
-	Mat4f perspective(float fov, float aspect, float near_clip, float far_clip) {
-		assert(far_clip != near_clip);
-		assert(fov != 0.0f);
+	namespace {
+		using simd::float4;
 
-		float height = 1.0f / std::tan(fov * 0.5f);
-		float width = height / aspect;
-		float range = far_clip / (near_clip - far_clip); // Depth range [0, 1]
-		
-		return Mat4f {
-			width,	0.0f, 0.0f, 0.0f,
-			0.0f,	height, 0.0f, 0.0f,
-			0.0f,	0.0f, -range,  1.0f,
-			0.0f,	0.0f, range * near_clip, 0.0f,
+		// Runs kernel over packed Vec3f four at a time, transposed into x, y and z lanes.
+		// The tail is padded through a scratch block, so in and out may be the same memory.
+		template <class Kernel>
+		void for_each_vec3x4(span<const Vec3f> in, span<Vec3f> out, Kernel&& kernel) {
+			assert(out.size() >= in.size());
+			const float* src = reinterpret_cast<const float*>(in.data());
+			float* dst = reinterpret_cast<float*>(out.data());
+
+			auto run = [&kernel](const float* s, float* d) {
+				float4 x, y, z, w;
+				simd::load_xform(s, x, y, z, w);
+				simd::transpose(x, y, z, w);
+				kernel(x, y, z);
+				simd::transpose(x, y, z, w);
+				simd::store_xform(d, x, y, z, w);
+			};
+
+			size_t i = 0;
+			for (; i + 4 <= in.size(); i += 4) {
+				run(src + i * 3, dst + i * 3);
+			}
+
+			if (size_t rem = in.size() - i) {
+				float scratch[12] = {};
+				std::copy(src + i * 3, src + (i + rem) * 3, scratch);
+				run(scratch, scratch);
+				std::copy(scratch, scratch + rem * 3, dst + i * 3);
+			}
+		}
+
+		// Broadcast 3x3 linear part, m[row][col]
+		struct Linear3x4 {
+			float4 m[3][3];
+
+			Linear3x4(const Xformf& xform) {
+				for (size_t r = 0; r < 3; ++r) {
+					for (size_t c = 0; c < 3; ++c) {
+						m[r][c] = simd::set1(xform[r][c]);
+					}
+				}
+			}
+
+			void apply(float4& x, float4& y, float4& z) const {
+				float4 ox = simd::madd(z, m[2][0], simd::madd(y, m[1][0], simd::mul(x, m[0][0])));
+				float4 oy = simd::madd(z, m[2][1], simd::madd(y, m[1][1], simd::mul(x, m[0][1])));
+				float4 oz = simd::madd(z, m[2][2], simd::madd(y, m[1][2], simd::mul(x, m[0][2])));
+				x = ox;
+				y = oy;
+				z = oz;
+			}
 		};
 	}
 
-	Mat4f orthographic(float width, float height, float scale, float offset) {
-		return Mat4f {
-			1.0f / width,	0.0f,			0.0f,					0.0f,
-			0.0f,			1.0f / height,	0.0f,					0.0f,
-			0.0f, 			0.0f, 			scale,					0.0f,
-			0.0f, 			0.0f, 			1.0f - offset * scale,	1.0f,
+	void transform_points(const Xformf& xform, span<const Vec3f> in, span<Vec3f> out) {
+		MATH_INSTRUMENT(TransformPoints);
+		Linear3x4 linear(xform);
+		float4 tx = simd::set1(xform[3][0]), ty = simd::set1(xform[3][1]), tz = simd::set1(xform[3][2]);
+
+		for_each_vec3x4(in, out, [&](float4& x, float4& y, float4& z) {
+			linear.apply(x, y, z);
+			x = simd::add(x, tx);
+			y = simd::add(y, ty);
+			z = simd::add(z, tz);
+		});
+	}
+
+	void transform_points(const Xformf& xform, span<Vec3f> points) {
+		transform_points(xform, points, points);
+	}
+
+	void transform_points(const Mat4f& mat, span<const Vec4f> in, span<Vec4f> out) {
+		MATH_INSTRUMENT(TransformPoints);
+		assert(out.size() >= in.size());
+		simd::mul_rows_mat4(reinterpret_cast<const float*>(in.data()), in.size(), mat.arr.data(), reinterpret_cast<float*>(out.data()));
+	}
+
+	void transform_points(const Mat4f& mat, span<Vec4f> points) {
+		transform_points(mat, points, points);
+	}
+
+	void transform_vectors(const Xformf& xform, span<const Vec3f> in, span<Vec3f> out) {
+		MATH_INSTRUMENT(TransformVectors);
+		Linear3x4 linear(xform);
+		for_each_vec3x4(in, out, [&](float4& x, float4& y, float4& z) {
+			linear.apply(x, y, z);
+		});
+	}
+
+	void transform_vectors(const Xformf& xform, span<Vec3f> vectors) {
+		transform_vectors(xform, vectors, vectors);
+	}
+
+	void transform_normals(const Xformf& xform, span<const Vec3f> in, span<Vec3f> out) {
+		MATH_INSTRUMENT(TransformNormals);
+		// The inverse transpose is the cofactor matrix over the determinant. Only the sign of the
+		// determinant survives renormalization, so no inverse is needed.
+		Vec3f r0 = xform[0], r1 = xform[1], r2 = xform[2];
+		Vec3f c0 = r1.cross(r2), c1 = r2.cross(r0), c2 = r0.cross(r1);
+		float sign = r0.dot(c0) < 0.0f ? -1.0f : 1.0f;
+
+		Xformf cofactor = Identity;
+		cofactor[0] = c0 * sign;
+		cofactor[1] = c1 * sign;
+		cofactor[2] = c2 * sign;
+		Linear3x4 linear(cofactor);
+
+		for_each_vec3x4(in, out, [&](float4& x, float4& y, float4& z) {
+			linear.apply(x, y, z);
+			float4 len = simd::sqrt(simd::madd(z, z, simd::madd(y, y, simd::mul(x, x))));
+			x = simd::div(x, len);
+			y = simd::div(y, len);
+			z = simd::div(z, len);
+		});
+	}
+
+	void transform_normals(const Xformf& xform, span<Vec3f> normals) {
+		transform_normals(xform, normals, normals);
+	}
+
+	void project_points(const Mat4f& view_projection, span<const Vec3f> in, span<Vec3f> out) {
+		MATH_INSTRUMENT(ProjectPoints);
+		float4 m[4][4];
+		for (size_t r = 0; r < 4; ++r) {
+			for (size_t c = 0; c < 4; ++c) {
+				m[r][c] = simd::set1(view_projection[r][c]);
+			}
+		}
+
+		for_each_vec3x4(in, out, [&](float4& x, float4& y, float4& z) {
+			float4 clip[4];
+			for (size_t c = 0; c < 4; ++c) {
+				clip[c] = simd::madd(z, m[2][c], simd::madd(y, m[1][c], simd::madd(x, m[0][c], m[3][c])));
+			}
+			x = simd::div(clip[0], clip[3]);
+			y = simd::div(clip[1], clip[3]);
+			z = simd::div(clip[2], clip[3]);
+		});
+	}
+
+	void project_points(const Mat4f& view_projection, span<Vec3f> points) {
+		project_points(view_projection, points, points);
+	}
+
+	void transform_points(const Xformd& xform, span<const Vec3d> in, span<Vec3d> out) {
+		MATH_INSTRUMENT(TransformPoints);
+		assert(out.size() >= in.size());
+		Vec3d r0 = xform[0], r1 = xform[1], r2 = xform[2], t = xform[3];
+		for (size_t i = 0; i < in.size(); ++i) {
+			Vec3d p = in[i];
+			out[i] = r0 * p[0] + r1 * p[1] + r2 * p[2] + t;
+		}
+	}
+
+	void transform_points(const Xformd& xform, span<Vec3d> points) {
+		transform_points(xform, points, points);
+	}
+
+	void transform_vectors(const Xformd& xform, span<const Vec3d> in, span<Vec3d> out) {
+		MATH_INSTRUMENT(TransformVectors);
+		assert(out.size() >= in.size());
+		Vec3d r0 = xform[0], r1 = xform[1], r2 = xform[2];
+		for (size_t i = 0; i < in.size(); ++i) {
+			Vec3d v = in[i];
+			out[i] = r0 * v[0] + r1 * v[1] + r2 * v[2];
+		}
+	}
+
+	void transform_vectors(const Xformd& xform, span<Vec3d> vectors) {
+		transform_vectors(xform, vectors, vectors);
+	}
+
+	namespace {
+		// World transforms per parallel_for chunk in to_view_space
+		constexpr size_t ViewSpaceGrain = 4096;
+
+		// world * inverse(camera) as (world - eye) * rotation: only the camera-relative offset is rounded to
+		// float, and the rest is a float Xformf product
+		struct ViewSpace {
+			Xformf rotation;
+			Vec3d eye;
+
+			explicit ViewSpace(const Xformd& camera) : eye(camera[3]) {
+				Xformd view = camera.affine_inverse();
+				view[3] = Vec3d(0.0, 0.0, 0.0);
+				rotation = Xformf(view);
+			}
+
+			Xformf operator()(const Xformd& world) const {
+				const auto& w = world.arr;
+				Xformf relative(array<float, 12> {
+					float(w[0]), float(w[1]), float(w[2]),
+					float(w[3]), float(w[4]), float(w[5]),
+					float(w[6]), float(w[7]), float(w[8]),
+					float(w[9] - eye[0]), float(w[10] - eye[1]), float(w[11] - eye[2]),
+				});
+				return relative * rotation;
+			}
 		};
 	}
+
+	Xformf to_view_space(const Xformd& camera, const Xformd& world) {
+		return ViewSpace(camera)(world);
+	}
+
+	void to_view_space(const Xformd& camera, span<const Xformd> world, span<Xformf> out) {
+		MATH_INSTRUMENT(ViewSpace);
+		assert(out.size() >= world.size());
+		ViewSpace view(camera);
+		parallel_for(world.size(), ViewSpaceGrain, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) out[i] = view(world[i]);
+		});
+	}
 }
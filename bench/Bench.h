@@ -0,0 +1,250 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define MATH_BENCH_HAS_TSC
+#endif
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#elif defined(MATH_BENCH_HAS_TSC)
+	#include <x86intrin.h>
+#endif
+
+#include "SIMD.h"
+
+// Minimal self-contained microbenchmark harness for MathBench.
+//
+//   Bench::Runner bench(argc, argv);
+//   bench.run("Mat4f * Mat4f", [&] { Bench::do_not_optimize(a * b); });
+//   return bench.finish();
+//
+// Each benchmark is calibrated until one sample takes at least min_time / samples, then timed over
+// several samples; the median is reported as ns/op, ops/s and cycles/op (TSC reference cycles, x86 only),
+// plus GB/s for benchmarks that give their bytes per call.
+namespace Bench {
+#if defined(_MSC_VER) && !defined(__clang__)
+	inline void sink(const volatile void*) {}
+
+	// Keeps value alive and opaque: the compiler has to materialize it and cannot hoist its computation
+	template <class T>
+	inline void do_not_optimize(const T& value) {
+		sink(&value);
+		_ReadWriteBarrier();
+	}
+
+	template <class T>
+	inline void do_not_optimize(T& value) {
+		sink(&value);
+		_ReadWriteBarrier();
+	}
+#else
+	template <class T>
+	inline void do_not_optimize(const T& value) {
+		asm volatile("" : : "m"(value) : "memory");
+	}
+
+	// Non-const values are also treated as modified, so inputs are reloaded every iteration
+	template <class T>
+	inline void do_not_optimize(T& value) {
+		asm volatile("" : "+m"(value) : : "memory");
+	}
+#endif
+
+	inline uint64_t cycles() {
+#ifdef MATH_BENCH_HAS_TSC
+		return __rdtsc();
+#else
+		return 0;
+#endif
+	}
+
+	struct Result {
+		std::string name;
+		uint64_t iterations;
+		double ns_per_op;
+		double ops_per_sec;
+		double cycles_per_op; // negative when no cycle counter is available
+		double gb_per_sec; // zero unless the benchmark gave its bytes per call
+	};
+
+	class Runner {
+	public:
+		Runner(int argc, char** argv) {
+			for (int i = 1; i < argc; ++i) {
+				if (!std::strcmp(argv[i], "--json")) {
+					json = true;
+					if (i + 1 < argc && argv[i + 1][0] != '-') json_path = argv[++i];
+				}
+				else if (!std::strcmp(argv[i], "--filter") && i + 1 < argc) {
+					filter = argv[++i];
+				}
+				else if (!std::strcmp(argv[i], "--min-time") && i + 1 < argc) {
+					min_time_ms = std::atof(argv[++i]);
+				}
+				else if (!std::strcmp(argv[i], "--samples") && i + 1 < argc) {
+					samples = std::max(1, std::atoi(argv[++i]));
+				}
+				else {
+					std::fprintf(stderr, "usage: %s [--json [path]] [--filter substring] [--min-time ms] [--samples n]\n", argv[0]);
+					std::exit(1);
+				}
+			}
+		}
+
+		// fn performs one operation per call
+		template <class Fn>
+		void run(const std::string& name, Fn&& fn) {
+			run(name, 1, fn);
+		}
+
+		// fn performs ops_per_call operations per call, e.g. a batch kernel over that many elements
+		template <class Fn>
+		void run(const std::string& name, size_t ops_per_call, Fn&& fn) {
+			run(name, ops_per_call, 0, fn);
+		}
+
+		// As above, also reporting GB/s for a kernel that reads and writes bytes_per_call bytes per call
+		template <class Fn>
+		void run(const std::string& name, size_t ops_per_call, size_t bytes_per_call, Fn&& fn) {
+			if (!filter.empty() && name.find(filter) == std::string::npos) {
+				return;
+			}
+
+			using clock = std::chrono::steady_clock;
+			auto time = [&](uint64_t count, uint64_t& tsc) {
+				uint64_t c0 = cycles();
+				auto t0 = clock::now();
+				for (uint64_t i = 0; i < count; ++i) {
+					fn();
+				}
+				auto t1 = clock::now();
+				tsc = cycles() - c0;
+				return std::chrono::duration<double, std::nano>(t1 - t0).count();
+			};
+
+			// Grow the call count until one sample is long enough to time reliably
+			double target_ns = min_time_ms * 1e6 / samples;
+			uint64_t count = 1, tsc = 0;
+			for (double ns = time(count, tsc); ns < target_ns && count < (uint64_t(1) << 40); ns = time(count, tsc)) {
+				count = ns <= 0 ? count * 10 : std::max(count + 1, std::min(count * 10, uint64_t(count * target_ns * 1.2 / ns)));
+			}
+
+			std::vector<double> ns(samples), cyc(samples);
+			for (int s = 0; s < samples; ++s) {
+				uint64_t c;
+				ns[s] = time(count, c);
+				cyc[s] = double(c);
+			}
+			std::sort(ns.begin(), ns.end());
+			std::sort(cyc.begin(), cyc.end());
+
+			double ops = double(count) * ops_per_call;
+			Result r { name, count * ops_per_call, ns[samples / 2] / ops, 0.0, -1.0, 0.0 };
+			r.ops_per_sec = 1e9 / r.ns_per_op;
+			r.gb_per_sec = double(count) * bytes_per_call / ns[samples / 2];
+#ifdef MATH_BENCH_HAS_TSC
+			r.cycles_per_op = cyc[samples / 2] / ops;
+#endif
+			results.push_back(r);
+
+			if (!json || json_path) {
+				print(r);
+			}
+		}
+
+		int finish() const {
+			if (!json) {
+				return 0;
+			}
+
+			FILE* out = json_path ? std::fopen(json_path, "w") : stdout;
+			if (!out) {
+				std::fprintf(stderr, "cannot open %s\n", json_path);
+				return 1;
+			}
+
+			std::fprintf(out, "{\n  \"context\": {\n");
+			std::fprintf(out, "    \"compiler\": \"%s\",\n", compiler());
+			std::fprintf(out, "    \"simd\": \"%s\",\n", simd_backend());
+			std::fprintf(out, "    \"fma\": %s,\n", fma() ? "true" : "false");
+			std::fprintf(out, "    \"samples\": %d,\n", samples);
+			std::fprintf(out, "    \"min_time_ms\": %g\n  },\n", min_time_ms);
+			std::fprintf(out, "  \"benchmarks\": [\n");
+			for (size_t i = 0; i < results.size(); ++i) {
+				const Result& r = results[i];
+				std::fprintf(out, "    { \"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.4f, \"ops_per_sec\": %.1f, \"cycles_per_op\": ",
+					r.name.c_str(), (unsigned long long)r.iterations, r.ns_per_op, r.ops_per_sec);
+				if (r.cycles_per_op < 0) std::fprintf(out, "null");
+				else std::fprintf(out, "%.3f", r.cycles_per_op);
+				if (r.gb_per_sec > 0) std::fprintf(out, ", \"gb_per_sec\": %.3f", r.gb_per_sec);
+				std::fprintf(out, " }");
+				std::fprintf(out, i + 1 < results.size() ? ",\n" : "\n");
+			}
+			std::fprintf(out, "  ]\n}\n");
+
+			if (json_path) {
+				std::fclose(out);
+			}
+			return 0;
+		}
+
+	private:
+		static void print(const Result& r) {
+			if (r.cycles_per_op < 0) {
+				std::printf("%-56s %12.3f ns/op %16.0f ops/s %12s", r.name.c_str(), r.ns_per_op, r.ops_per_sec, "-");
+			}
+			else {
+				std::printf("%-56s %12.3f ns/op %16.0f ops/s %8.2f cycles/op", r.name.c_str(), r.ns_per_op, r.ops_per_sec, r.cycles_per_op);
+			}
+			if (r.gb_per_sec > 0) {
+				std::printf(" %8.2f GB/s", r.gb_per_sec);
+			}
+			std::printf("\n");
+		}
+
+		static const char* compiler() {
+#if defined(__clang__)
+			return "clang " __clang_version__;
+#elif defined(__GNUC__)
+			return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+			return "msvc";
+#else
+			return "unknown";
+#endif
+		}
+
+		static const char* simd_backend() {
+#if defined(MATH3D_SIMD_SSE)
+			return "sse";
+#elif defined(MATH3D_SIMD_NEON)
+			return "neon";
+#else
+			return "scalar";
+#endif
+		}
+
+		static bool fma() {
+#if defined(__FMA__)
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		std::vector<Result> results;
+		std::string filter;
+		const char* json_path = nullptr;
+		bool json = false;
+		double min_time_ms = 100.0;
+		int samples = 5;
+	};
+}
@@ -0,0 +1,1055 @@
+#include "Bench.h"
+#include "Matrix.h"
+#include "Quaternion.h"
+#include "QuaternionBatch.h"
+#include "Transforms.h"
+#include "SoA.h"
+#include "TransformHierarchy.h"
+#include "Expr.h"
+#include "BVH.h"
+#include "RayPacket.h"
+#include "BroadPhase.h"
+#include "NarrowPhase.h"
+#include "Frustum.h"
+#include "TRSBatch.h"
+#include "Skinning.h"
+#include "Mesh.h"
+#include "Compression.h"
+#include "Animation.h"
+#include "BinaryFormat.h"
+#include "Parallel.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <numbers>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Math3D;
+using Bench::do_not_optimize;
+
+namespace {
+	constexpr size_t BatchSize = 4096;
+
+	// Deterministic, well conditioned inputs so results are comparable between runs
+	template <typename T, size_t W, size_t H>
+	Matrix<T, W, H> make_matrix(float seed) {
+		Matrix<T, W, H> m;
+		for (size_t i = 0; i < m.N; ++i) {
+			m.arr[i] = T(std::sin(seed + 0.37f * i) * 0.5f);
+		}
+		if constexpr (W == H || (W == 3 && H == 4)) {
+			for (size_t i = 0; i < W; ++i) {
+				m.data[i][i] += T(2);
+			}
+		}
+		return m;
+	}
+
+	vector<Vec3f> make_points(size_t count) {
+		vector<Vec3f> points(count);
+		for (size_t i = 0; i < count; ++i) {
+			float f = float(i);
+			points[i] = Vec3f(std::sin(f), std::cos(f * 0.7f), std::sin(f * 1.3f) + 2.0f);
+		}
+		return points;
+	}
+
+	template <typename T, size_t W>
+	void bench_multiply(Bench::Runner& bench, const char* name) {
+		auto a = make_matrix<T, W, W>(0.1f);
+		auto b = make_matrix<T, W, W>(0.7f);
+		bench.run(string("Matrix/") + name + " * " + name, [&] {
+			do_not_optimize(a);
+			do_not_optimize(a * b);
+		});
+	}
+
+	void matrix(Bench::Runner& bench) {
+		bench_multiply<float, 2>(bench, "Mat2f");
+		bench_multiply<float, 3>(bench, "Mat3f");
+		bench_multiply<float, 4>(bench, "Mat4f");
+		bench_multiply<float, 8>(bench, "Matrix<float, 8, 8>");
+		bench_multiply<double, 4>(bench, "Matrix<double, 4, 4>");
+
+		auto v = make_matrix<float, 4, 1>(0.3f);
+		auto m = make_matrix<float, 4, 4>(0.1f);
+		auto x = make_matrix<float, 3, 4>(0.2f);
+		auto y = make_matrix<float, 3, 4>(0.9f);
+
+		bench.run("Matrix/Vec4f * Mat4f", [&] { do_not_optimize(v); do_not_optimize(v * m); });
+		bench.run("Matrix/Xformf * Xformf", [&] { do_not_optimize(x); do_not_optimize(x * y); });
+		bench.run("Matrix/Xformf * Mat4f", [&] { do_not_optimize(x); do_not_optimize(x * m); });
+		bench.run("Matrix/Mat4f transpose", [&] { do_not_optimize(m); do_not_optimize(m.transpose()); });
+		bench.run("Matrix/Vec4f dot", [&] { do_not_optimize(v); do_not_optimize(v.dot(v)); });
+
+		auto v3 = make_matrix<float, 3, 1>(0.4f);
+		bench.run("Matrix/Vec3f normalize", [&] { do_not_optimize(v3); do_not_optimize(v3.normalize()); });
+	}
+
+	template <typename T, size_t W>
+	void bench_inverse(Bench::Runner& bench, const char* name) {
+		auto m = make_matrix<T, W, W>(0.5f);
+		bench.run(string("Inverse/") + name + " determinant", [&] { do_not_optimize(m); do_not_optimize(m.determinant()); });
+		bench.run(string("Inverse/") + name + " adjoint", [&] { do_not_optimize(m); do_not_optimize(m.adjoint()); });
+		bench.run(string("Inverse/") + name + " inverse", [&] { do_not_optimize(m); do_not_optimize(m.inverse()); });
+	}
+
+	void inverse(Bench::Runner& bench) {
+		bench_inverse<float, 3>(bench, "Mat3f");
+		bench_inverse<float, 4>(bench, "Mat4f");
+		bench_inverse<double, 6>(bench, "Matrix<double, 6, 6>");
+
+		Xformf x = rotation(Vec3f(1.0f, 2.0f, 3.0f), 0.6f) * translation(Vec3f(4.0f, 5.0f, 6.0f));
+		bench.run("Inverse/Xformf affine_inverse Rigid", [&] { do_not_optimize(x); do_not_optimize(x.affine_inverse<AffineKind::Rigid>()); });
+		bench.run("Inverse/Xformf affine_inverse UniformScale", [&] { do_not_optimize(x); do_not_optimize(x.affine_inverse<AffineKind::UniformScale>()); });
+		bench.run("Inverse/Xformf affine_inverse General", [&] { do_not_optimize(x); do_not_optimize(x.affine_inverse()); });
+	}
+
+	void quaternion(Bench::Runner& bench) {
+		Quaternion a = Quaternion(0.1f, 0.2f, 0.3f, 0.9f).Normalize();
+		Quaternion b = Quaternion(-0.4f, 0.1f, 0.5f, 0.7f).Normalize();
+		Xformf rot = rotation(Vec3f(1.0f, 2.0f, 3.0f), 0.6f);
+
+		bench.run("Quaternion/multiply", [&] { do_not_optimize(a); do_not_optimize(a * b); });
+		bench.run("Quaternion/Normalize", [&] { do_not_optimize(a); do_not_optimize(a.Normalize()); });
+		bench.run("Quaternion/from Xformf", [&] { do_not_optimize(rot); do_not_optimize(Quaternion(rot)); });
+		bench.run("Quaternion/ToRot", [&] { do_not_optimize(a); do_not_optimize(a.ToRot()); });
+		bench.run("Quaternion/Slerp", [&] { do_not_optimize(a); do_not_optimize(Slerp(a, b, 0.3f)); });
+
+		vector<Quaternion> qa(BatchSize), qb(BatchSize), qout(BatchSize);
+		for (size_t n = 0; n < BatchSize; ++n) {
+			qa[n] = Quaternion(Vec3f(std::sin(float(n)), 1.0f, 0.5f), 0.001f * n);
+			qb[n] = Quaternion(Vec3f(1.0f, std::cos(float(n)), -0.5f), 0.002f * n - 3.0f);
+		}
+
+		bench.run("Quaternion/per-element Slerp", BatchSize, [&] {
+			for (size_t n = 0; n < BatchSize; ++n) qout[n] = Slerp(qa[n], qb[n], 0.3f);
+			do_not_optimize(qout[0]);
+		});
+
+		QuaternionBatch ba, bb, bout;
+		to_soa(qa, ba);
+		to_soa(qb, bb);
+		Vec3f axis(1.0f, 2.0f, 3.0f);
+		vector<Xformf> rots(BatchSize);
+
+		bench.run("Quaternion/batch multiply", BatchSize, [&] { multiply(ba, bb, bout); do_not_optimize(bout.streams[0][0]); });
+		bench.run("Quaternion/batch normalize", BatchSize, [&] { normalize(ba, bout); do_not_optimize(bout.streams[0][0]); });
+		bench.run("Quaternion/batch nlerp", BatchSize, [&] { nlerp(ba, bb, 0.3f, bout); do_not_optimize(bout.streams[0][0]); });
+		bench.run("Quaternion/batch slerp", BatchSize, [&] { slerp(ba, bb, 0.3f, bout); do_not_optimize(bout.streams[0][0]); });
+		bench.run("Quaternion/batch to_rot", BatchSize, [&] { to_rot(ba, rots); do_not_optimize(rots[0]); });
+	}
+
+	void transforms(Bench::Runner& bench) {
+		Vec3f axis(1.0f, 2.0f, 3.0f), offset(4.0f, 5.0f, 6.0f), factors(1.5f, 1.5f, 1.5f);
+		float angle = 0.6f;
+		Quaternion q = Quaternion(0.1f, 0.2f, 0.3f, 0.9f).Normalize();
+		Xformf eye = translation(Vec3f(3.0f, 2.0f, -10.0f)), target = translation(Vec3f(0.0f, 1.0f, 0.0f));
+		float fov = float(std::numbers::pi) / 3.0f;
+
+		bench.run("Transforms/rotation", [&] { do_not_optimize(angle); do_not_optimize(rotation(axis, angle)); });
+		bench.run("Transforms/rotX", [&] { do_not_optimize(angle); do_not_optimize(rotX(angle)); });
+		bench.run("Transforms/compose", [&] { do_not_optimize(q); do_not_optimize(compose(q, offset, factors)); });
+
+		Xformf composed = compose(q, offset, factors);
+		bench.run("Transforms/decompose", [&] {
+			Quaternion r;
+			Vec3f t, s;
+			do_not_optimize(composed);
+			decompose(composed, r, t, s);
+			do_not_optimize(r);
+			do_not_optimize(s);
+		});
+		bench.run("Transforms/look_at", [&] { do_not_optimize(eye); do_not_optimize(look_at(eye, target)); });
+		bench.run("Transforms/perspective", [&] { do_not_optimize(fov); do_not_optimize(perspective(fov, 16.0f / 9.0f, 0.1f, 1000.0f)); });
+		bench.run("Transforms/constant perspective", [&] { do_not_optimize(perspective(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f)); });
+
+		Xformf model = rotation(axis, angle) * translation(offset);
+		Xformf view = look_at(eye, target);
+		Mat4f projection = perspective(fov, 16.0f / 9.0f, 0.1f, 1000.0f);
+		bench.run("Transforms/MVP", [&] { do_not_optimize(model); do_not_optimize(model * view * projection); });
+	}
+
+	template <class Trig>
+	void trig_policy(Bench::Runner& bench, const char* name) {
+		vector<float> angles(BatchSize);
+		for (size_t n = 0; n < BatchSize; ++n) angles[n] = float(n) * 0.01f - 20.0f;
+		bench.run(string("Trig/sincos ") + name, BatchSize, [&] {
+			float sum = 0.0f;
+			for (float angle : angles) {
+				float s, c;
+				Trig::sincos(angle, s, c);
+				sum += s * c;
+			}
+			do_not_optimize(sum);
+		});
+
+		bench.run(string("Trig/sincos float4 ") + name, BatchSize, [&] {
+			simd::float4 sum = simd::zero();
+			for (size_t n = 0; n < BatchSize; n += 4) {
+				simd::float4 s, c;
+				Trig::sincos(simd::load(angles.data() + n), s, c);
+				sum = simd::madd(s, c, sum);
+			}
+			do_not_optimize(sum);
+		});
+
+		Vec3f axis(1.0f, 2.0f, 3.0f);
+		vector<Xformf> rots(BatchSize);
+		bench.run(string("Trig/rotation ") + name, BatchSize, [&] {
+			for (size_t n = 0; n < BatchSize; ++n) rots[n] = rotation<Trig>(axis, angles[n]);
+			do_not_optimize(rots[0]);
+		});
+
+		Vec3fSoA axes;
+		for (size_t n = 0; n < BatchSize; ++n) axes.push_back(Vec3f(std::sin(float(n)), 1.0f, std::cos(float(n))));
+		QuaternionBatch out;
+		bench.run(string("Trig/batch from_axis_angle ") + name, BatchSize, [&] {
+			from_axis_angle<Trig>(axes, angles, out);
+			do_not_optimize(out.streams[0][0]);
+		});
+	}
+
+	void trigonometry(Bench::Runner& bench) {
+		trig_policy<trig::Std>(bench, "libm");
+		trig_policy<trig::Precise>(bench, "Precise");
+		trig_policy<trig::Fast>(bench, "Fast");
+	}
+
+	void batch(Bench::Runner& bench) {
+		Xformf xform = rotation(Vec3f(1.0f, 2.0f, 3.0f), 0.6f) * translation(Vec3f(4.0f, 5.0f, 6.0f));
+		Mat4f view_projection = look_at(translation(Vec3f(0.0f, 0.0f, -10.0f)), Identity) * perspective(1.0f, 1.5f, 0.1f, 100.0f);
+
+		vector<Vec3f> in = make_points(BatchSize), out(BatchSize);
+		vector<Vec4f> in4(BatchSize), out4(BatchSize);
+		for (size_t i = 0; i < BatchSize; ++i) {
+			in4[i] = Vec4f(in[i][0], in[i][1], in[i][2], 1.0f);
+		}
+
+		bench.run("Batch/transform_points Xformf", BatchSize, [&] { transform_points(xform, in, out); do_not_optimize(out[0]); });
+		bench.run("Batch/transform_points Mat4f", BatchSize, [&] { transform_points(view_projection, in4, out4); do_not_optimize(out4[0]); });
+		bench.run("Batch/transform_vectors", BatchSize, [&] { transform_vectors(xform, in, out); do_not_optimize(out[0]); });
+		bench.run("Batch/transform_normals", BatchSize, [&] { transform_normals(xform, in, out); do_not_optimize(out[0]); });
+		bench.run("Batch/project_points", BatchSize, [&] { project_points(view_projection, in, out); do_not_optimize(out[0]); });
+		bench.run("Batch/per-element Xformf points", BatchSize, [&] {
+			for (size_t i = 0; i < BatchSize; ++i) {
+				const Vec3f& p = in[i];
+				out[i] = Vec3f(
+					p[0] * xform.data[0][0] + p[1] * xform.data[1][0] + p[2] * xform.data[2][0] + xform.data[3][0],
+					p[0] * xform.data[0][1] + p[1] * xform.data[1][1] + p[2] * xform.data[2][1] + xform.data[3][1],
+					p[0] * xform.data[0][2] + p[1] * xform.data[1][2] + p[2] * xform.data[2][2] + xform.data[3][2]);
+			}
+			do_not_optimize(out[0]);
+		});
+
+		TRSBatch trs;
+		for (size_t i = 0; i < BatchSize; ++i) {
+			trs.push_back(Quaternion(in[i], float(i) * 0.01f), in[(i + 1) % BatchSize], Vec3f(1.0f, 2.0f, 0.5f) + in[i] * 0.1f);
+		}
+		vector<Xformf> xforms(BatchSize);
+		TRSBatch decomposed;
+		bench.run("Batch/TRS compose", BatchSize, [&] { compose(trs, xforms); do_not_optimize(xforms[0]); });
+		bench.run("Batch/TRS decompose", BatchSize, [&] { decompose(xforms, decomposed); do_not_optimize(decomposed.scale.streams[0][0]); });
+		bench.run("Batch/per-element compose", BatchSize, [&] {
+			for (size_t i = 0; i < BatchSize; ++i) xforms[i] = compose(trs.rotation.get(i), trs.translation.get(i), trs.scale.get(i));
+			do_not_optimize(xforms[0]);
+		});
+		bench.run("Batch/per-element decompose", BatchSize, [&] {
+			for (size_t i = 0; i < BatchSize; ++i) {
+				Quaternion q;
+				Vec3f t, s;
+				decompose(xforms[i], q, t, s);
+				decomposed.rotation.set(i, q);
+				decomposed.scale.set(i, s);
+			}
+			do_not_optimize(decomposed.scale.streams[0][0]);
+		});
+
+		// Camera and objects 1000 km from the origin
+		Vec3d eye(1e6, 50.0, -1e6);
+		Xformd camera = compose(Quaternion(Vec3f(0.0f, 1.0f, 0.0f), 0.3f), eye, Vec3d(1.0, 1.0, 1.0));
+		vector<Xformd> world(BatchSize);
+		for (size_t i = 0; i < BatchSize; ++i) world[i] = compose(trs.rotation.get(i), eye + Vec3d(in[i]) * 100.0, Vec3d(trs.scale.get(i)));
+		bench.run("Batch/to_view_space", BatchSize, [&] { to_view_space(camera, world, xforms); do_not_optimize(xforms[0]); });
+		bench.run("Batch/per-element double view space", BatchSize, [&] {
+			Xformd view = camera.affine_inverse();
+			for (size_t i = 0; i < BatchSize; ++i) xforms[i] = Xformf(world[i] * view);
+			do_not_optimize(xforms[0]);
+		});
+
+		Vec3fSoA a, b, r;
+		to_soa(in, a);
+		to_soa(span<const Vec3f>(make_points(BatchSize + 7)).subspan(7), b);
+		vector<float> lengths(BatchSize);
+
+		bench.run("Batch/SoA to_soa Vec3f", BatchSize, [&] { to_soa(in, r); do_not_optimize(r.streams[0][0]); });
+		bench.run("Batch/SoA add", BatchSize, [&] { add(a, b, r); do_not_optimize(r.streams[0][0]); });
+		bench.run("Batch/SoA cross", BatchSize, [&] { cross(a, b, r); do_not_optimize(r.streams[0][0]); });
+		bench.run("Batch/SoA normalize", BatchSize, [&] { normalize(a, r); do_not_optimize(r.streams[0][0]); });
+		bench.run("Batch/SoA length", BatchSize, [&] { length(a, lengths); do_not_optimize(lengths[0]); });
+	}
+
+	void hierarchy(Bench::Runner& bench) {
+		constexpr uint32_t Nodes = 200000;
+		TransformHierarchy h;
+		h.reserve(Nodes);
+		uint32_t seed = 1;
+		for (uint32_t n = 0; n < Nodes; ++n) {
+			seed = seed * 1664525u + 1013904223u;
+			auto parent = n < 16 ? TransformHierarchy::None : (seed >> 8) % n;
+			h.add(parent, Quaternion(Vec3f(0.0f, 1.0f, 0.0f), 0.001f * n), Vec3f(0.01f * (n % 7), 0.0f, 0.0f));
+		}
+		h.update();
+
+		bench.run("Hierarchy/full update 200k", Nodes, [&] {
+			for (TransformHierarchy::Handle n = 0; n < 16; ++n) h.set_translation(n, h.translation(n));
+			h.update();
+		});
+		bench.run("Hierarchy/1% dirty update 200k", Nodes, [&] {
+			for (TransformHierarchy::Handle n = 0; n < Nodes; n += 100) h.set_translation(n, h.translation(n));
+			h.update();
+		});
+		bench.run("Hierarchy/clean update 200k", [&] { h.update(); });
+	}
+
+	void bvh(Bench::Runner& bench) {
+		constexpr size_t Triangles = 100000, Rays = 4096;
+		uint32_t seed = 3;
+		auto next = [&] {
+			seed = seed * 1664525u + 1013904223u;
+			return float(seed >> 8) / float(1 << 24);
+		};
+
+		vector<Tri3d> tris(Triangles);
+		for (Tri3d& tri : tris) {
+			Vec3f center(next() * 100.0f, next() * 100.0f, next() * 100.0f);
+			for (Vert3d& vert : tri.verts) vert.pos = center + Vec3f(next(), next(), next());
+		}
+		vector<Ray> rays(Rays);
+		for (Ray& ray : rays) {
+			ray.point = Vec3f(next() * 100.0f, next() * 100.0f, next() * 100.0f);
+			ray.dir = Vec3f(next() - 0.5f, next() - 0.5f, next() - 0.5f).normalize();
+		}
+
+		BVH tree;
+		BVH::BuildOptions parallel;
+		parallel.parallel = true;
+		bench.run("BVH/build 100k triangles", Triangles, [&] { tree.build(tris); do_not_optimize(tree.nodes()[0]); });
+		bench.run("BVH/parallel build 100k triangles", Triangles, [&] { tree.build(tris, parallel); do_not_optimize(tree.nodes()[0]); });
+		bench.run("BVH/refit 100k triangles", Triangles, [&] { tree.refit(tris); do_not_optimize(tree.nodes()[0]); });
+
+		tree.build(tris);
+		bench.run("BVH/closest hit", Rays, [&] {
+			BVH::Hit hit {};
+			for (const Ray& ray : rays) tree.closest_hit(ray, hit);
+			do_not_optimize(hit);
+		});
+		bench.run("BVH/any hit t < 10", Rays, [&] {
+			size_t hits = 0;
+			for (const Ray& ray : rays) hits += tree.any_hit(ray, 10.0f);
+			do_not_optimize(hits);
+		});
+	}
+
+	void packets(Bench::Runner& bench) {
+		constexpr size_t Triangles = 10000, Width = 64;
+		uint32_t seed = 9;
+		auto next = [&] {
+			seed = seed * 1664525u + 1013904223u;
+			return float(seed >> 8) / float(1 << 24);
+		};
+
+		vector<Tri3d> tris(Triangles);
+		for (Tri3d& tri : tris) {
+			Vec3f center(next() * 40.0f, next() * 40.0f, next() * 40.0f);
+			for (Vert3d& vert : tri.verts) vert.pos = center + Vec3f(next(), next(), next());
+		}
+
+		// A 64x64 pinhole camera looking into the cloud, in 4x4 tiles so each 16-ray packet is coherent
+		vector<Ray> rays;
+		for (size_t ty = 0; ty < Width; ty += 4) {
+			for (size_t tx = 0; tx < Width; tx += 4) {
+				for (size_t y = ty; y < ty + 4; ++y) {
+					for (size_t x = tx; x < tx + 4; ++x) {
+						Vec3f dir(float(x) / Width - 0.5f, float(y) / Width - 0.5f, 1.0f);
+						rays.push_back({ Vec3f(20.0f, 20.0f, -10.0f), dir.normalize() });
+					}
+				}
+			}
+		}
+
+		vector<RayPacket<4>> packets4;
+		vector<RayPacket<8>> packets8;
+		vector<RayPacket<16>> packets16;
+		for (size_t n = 0; n < rays.size(); n += 16) {
+			span<const Ray> tile(rays.data() + n, 16);
+			packets4.emplace_back(tile.first(4));
+			packets4.emplace_back(tile.subspan(4, 4));
+			packets4.emplace_back(tile.subspan(8, 4));
+			packets4.emplace_back(tile.subspan(12, 4));
+			packets8.emplace_back(tile.first(8));
+			packets8.emplace_back(tile.subspan(8));
+			packets16.emplace_back(tile);
+		}
+
+		const Tri3d& tri = tris[0];
+		bench.run("Packet/RayTriangle scalar", rays.size(), [&] {
+			size_t hits = 0;
+			for (const Ray& ray : rays) {
+				float t, u, v;
+				hits += RayTriangle(ray, tri, t, u, v);
+			}
+			do_not_optimize(hits);
+		});
+		bench.run("Packet/RayTriangle 8 lanes", rays.size(), [&] {
+			uint32_t hits = 0;
+			alignas(64) float t[8], u[8], v[8];
+			for (const auto& packet : packets8) hits += RayTriangle(packet, tri, t, u, v);
+			do_not_optimize(hits);
+		});
+
+		AABB box { Vec3f(20.0f, 20.0f, 20.0f), { 5.0f, 5.0f, 5.0f } };
+		bench.run("Packet/RayAABB scalar", rays.size(), [&] {
+			size_t hits = 0;
+			for (const Ray& ray : rays) {
+				float t;
+				hits += RayAABB(ray, box, t);
+			}
+			do_not_optimize(hits);
+		});
+		bench.run("Packet/RayAABB 8 lanes", rays.size(), [&] {
+			uint32_t hits = 0;
+			alignas(64) float t[8];
+			for (const auto& packet : packets8) hits += RayAABB(packet, box, t);
+			do_not_optimize(hits);
+		});
+
+		BVH tree;
+		tree.build(tris);
+		bench.run("Packet/BVH closest hit single rays", rays.size(), [&] {
+			BVH::Hit hit {};
+			for (const Ray& ray : rays) tree.closest_hit(ray, hit);
+			do_not_optimize(hit);
+		});
+		auto run_packets = [&](const char* name, const auto& packets) {
+			using packet_t = std::decay_t<decltype(packets[0])>;
+			bench.run(name, rays.size(), [&] {
+				BVH::PacketHit<packet_t::Lanes> hit;
+				for (const auto& packet : packets) tree.closest_hit(packet, hit);
+				do_not_optimize(hit);
+			});
+		};
+		run_packets("Packet/BVH closest hit 4 lanes", packets4);
+		run_packets("Packet/BVH closest hit 8 lanes", packets8);
+		run_packets("Packet/BVH closest hit 16 lanes", packets16);
+	}
+
+	// Bodies of size ~1 at a density of one per 8 units of volume, drifting a little every frame
+	void bench_broad_phase(Bench::Runner& bench, size_t count, const char* label) {
+		uint32_t seed = 11;
+		auto next = [&] {
+			seed = seed * 1664525u + 1013904223u;
+			return float(seed >> 8) / float(1 << 24);
+		};
+
+		float side = std::cbrt(8.0f * count);
+		vector<AABB> boxes(count);
+		vector<Vec3f> velocity(count);
+		for (size_t n = 0; n < count; ++n) {
+			boxes[n].center = Vec3f(next(), next(), next()) * side;
+			for (float& h : boxes[n].halfwidths) h = 0.25f + next() * 0.5f;
+			velocity[n] = Vec3f(next() - 0.5f, next() - 0.5f, next() - 0.5f) * 0.05f;
+		}
+		auto step = [&] {
+			for (size_t n = 0; n < count; ++n) {
+				boxes[n].center = boxes[n].center + velocity[n];
+				for (size_t a = 0; a < 3; ++a) {
+					if (boxes[n].center[a] < 0.0f || boxes[n].center[a] > side) velocity[n][a] = -velocity[n][a];
+				}
+			}
+		};
+
+		SweepAndPrune sap;
+		vector<SweepAndPrune::Handle> handles;
+		for (const AABB& box : boxes) handles.push_back(sap.add(box));
+		vector<OverlapPair> pairs;
+		sap.find_pairs(pairs);
+
+		bench.run(string("BroadPhase/sweep and prune ") + label, count, [&] {
+			step();
+			for (size_t n = 0; n < count; ++n) sap.update(handles[n], boxes[n]);
+			sap.find_pairs(pairs);
+			do_not_optimize(pairs.data());
+		});
+
+		SpatialHashGrid grid(SpatialHashGrid::tune_cell_size(boxes));
+		grid.find_pairs(boxes, pairs);
+		bench.run(string("BroadPhase/hash grid ") + label, count, [&] {
+			step();
+			grid.find_pairs(boxes, pairs);
+			do_not_optimize(pairs.data());
+		});
+		bench.run(string("BroadPhase/move only ") + label, count, [&] {
+			step();
+			do_not_optimize(boxes.data());
+		});
+	}
+
+	void broad_phase(Bench::Runner& bench) {
+		bench_broad_phase(bench, 10000, "10k");
+		bench_broad_phase(bench, 100000, "100k");
+	}
+
+	// Pairs of unit-sized shapes scattered so roughly half of them overlap
+	void narrow_phase(Bench::Runner& bench) {
+		constexpr size_t Pairs = 1024;
+		uint32_t seed = 17;
+		auto next = [&] {
+			seed = seed * 1664525u + 1013904223u;
+			return float(seed >> 8) / float(1 << 24);
+		};
+		auto offset = [&] { return Vec3f(next() - 0.5f, next() - 0.5f, next() - 0.5f) * 2.5f; };
+
+		vector<Capsule> capsules(2 * Pairs);
+		vector<AABB> boxes(2 * Pairs);
+		vector<array<Point, 8>> corners(2 * Pairs);
+		vector<ConvexHull> hulls(2 * Pairs);
+		vector<Cylinder> cylinders(Pairs);
+		for (size_t n = 0; n < 2 * Pairs; ++n) {
+			Vec3f base = n & 1 ? capsules[n - 1].axis.start : Vec3f();
+			capsules[n] = { { base + offset(), base + offset() * 0.5f }, 0.25f + next() * 0.25f };
+			boxes[n] = { (n & 1 ? boxes[n - 1].center : Vec3f()) + offset() * 0.5f, { 0.3f + next() * 0.4f, 0.3f + next() * 0.4f, 0.3f + next() * 0.4f } };
+			for (size_t i = 0; i < 8; ++i) {
+				for (size_t a = 0; a < 3; ++a) {
+					corners[n][i][a] = boxes[n].center[a] + ((i >> a) & 1 ? boxes[n].halfwidths[a] : -boxes[n].halfwidths[a]);
+				}
+			}
+			hulls[n] = { corners[n] };
+		}
+		for (size_t n = 0; n < Pairs; ++n) {
+			Point start = boxes[2 * n].center + offset() * 0.8f;
+			cylinders[n] = { { start, start + offset() * 0.4f }, 0.3f + next() * 0.3f };
+		}
+
+		Contact contact;
+		Separation separation;
+		bench.run("NarrowPhase/capsule-capsule closed form", Pairs, [&] {
+			for (size_t n = 0; n < Pairs; ++n) do_not_optimize(Penetration(capsules[2 * n], capsules[2 * n + 1], contact));
+			do_not_optimize(contact);
+		});
+		bench.run("NarrowPhase/capsule-capsule GJK distance", Pairs, [&] {
+			for (size_t n = 0; n < Pairs; ++n) do_not_optimize(GJKDistance(capsules[2 * n], capsules[2 * n + 1], separation));
+			do_not_optimize(separation);
+		});
+		bench.run("NarrowPhase/box-box closed form", Pairs, [&] {
+			for (size_t n = 0; n < Pairs; ++n) do_not_optimize(Penetration(boxes[2 * n], boxes[2 * n + 1], contact));
+			do_not_optimize(contact);
+		});
+		bench.run("NarrowPhase/box-box hulls GJK+EPA", Pairs, [&] {
+			for (size_t n = 0; n < Pairs; ++n) do_not_optimize(Penetration(hulls[2 * n], hulls[2 * n + 1], contact));
+			do_not_optimize(contact);
+		});
+
+		// The box drifts a little each run, as between simulation frames
+		vector<GJKCache> caches(Pairs);
+		float phase = 0.0f;
+		auto drift = [&](size_t n) {
+			AABB box = boxes[2 * n];
+			box.center = box.center + Vec3f(std::sin(phase + n), std::cos(phase + n), 0.0f) * 0.01f;
+			return box;
+		};
+		bench.run("NarrowPhase/cylinder-box GJK cold", Pairs, [&] {
+			phase += 0.1f;
+			for (size_t n = 0; n < Pairs; ++n) do_not_optimize(GJKDistance(cylinders[n], drift(n), separation));
+			do_not_optimize(separation);
+		});
+		bench.run("NarrowPhase/cylinder-box GJK warm started", Pairs, [&] {
+			phase += 0.1f;
+			for (size_t n = 0; n < Pairs; ++n) do_not_optimize(GJKDistance(cylinders[n], drift(n), separation, &caches[n]));
+			do_not_optimize(separation);
+		});
+	}
+
+	// 500k objects spread around a camera that turns a little every run; cascades are four nested views
+	void culling(Bench::Runner& bench) {
+		constexpr size_t Count = 500000;
+		uint32_t seed = 23;
+		auto next = [&] {
+			seed = seed * 1664525u + 1013904223u;
+			return float(seed >> 8) / float(1 << 24);
+		};
+
+		// Stored in 20-unit tiles, row by row, as a scene kept in spatial order would be
+		vector<Vec3f> centers(Count);
+		for (Vec3f& center : centers) center = Vec3f(next() - 0.5f, next() * 0.1f, next() - 0.5f) * 400.0f;
+		auto tile = [](const Vec3f& c) { return std::make_pair(int(std::floor(c[2] / 20.0f)), int(std::floor(c[0] / 20.0f))); };
+		std::sort(centers.begin(), centers.end(), [&](const Vec3f& a, const Vec3f& b) { return tile(a) < tile(b); });
+
+		SphereSoA spheres;
+		AABBSoA boxes;
+		for (const Vec3f& center : centers) {
+			spheres.push_back({ center, 0.5f + next() * 2.0f });
+			boxes.push_back({ center, { 0.5f + next(), 0.5f + next(), 0.5f + next() } });
+		}
+
+		float yaw = 0.0f;
+		auto view = [&](float far_clip) {
+			Vec3f eye(0.0f, 10.0f, 0.0f);
+			Vec3f target = eye + Vec3f(std::sin(yaw), -0.2f, std::cos(yaw));
+			return ExtractFrustum(look_at(translation(eye), translation(target)) * perspective(1.2f, 16.0f / 9.0f, 0.1f, far_clip));
+		};
+
+		vector<uint64_t> visible(4 * VisibilityWords(Count));
+		vector<uint8_t> cache(4 * PlaneCacheSize(Count));
+		bench.run("Culling/spheres 500k", Count, [&] {
+			yaw += 0.01f;
+			CullSpheres(view(300.0f), spheres, visible);
+			do_not_optimize(visible.data());
+		});
+		bench.run("Culling/spheres 500k plane cache", Count, [&] {
+			yaw += 0.01f;
+			CullSpheres(view(300.0f), spheres, visible, cache);
+			do_not_optimize(visible.data());
+		});
+		bench.run("Culling/boxes 500k plane cache", Count, [&] {
+			yaw += 0.01f;
+			CullAABBs(view(300.0f), boxes, visible, cache);
+			do_not_optimize(visible.data());
+		});
+		bench.run("Culling/spheres 500k scalar", Count, [&] {
+			yaw += 0.01f;
+			Frustum frustum = view(300.0f);
+			for (size_t n = 0; n < Count; n += 64) {
+				uint64_t word = 0;
+				for (size_t i = n; i < std::min(n + 64, Count); ++i) word |= uint64_t(OverlapFrustumSphere(frustum, spheres.get(i))) << (i - n);
+				visible[n / 64] = word;
+			}
+			do_not_optimize(visible.data());
+		});
+		bench.run("Culling/spheres 500k x 4 cascades", Count, [&] {
+			yaw += 0.01f;
+			const Frustum cascades[] = { view(25.0f), view(60.0f), view(140.0f), view(300.0f) };
+			CullSpheres(cascades, spheres, visible, cache);
+			do_not_optimize(visible.data());
+		});
+	}
+
+	void skinning(Bench::Runner& bench) {
+		constexpr size_t Vertices = 200000;
+		constexpr size_t Bones = 64;
+		uint32_t seed = 31;
+		auto next = [&] {
+			seed = seed * 1664525u + 1013904223u;
+			return float(seed >> 8) / float(1 << 24);
+		};
+
+		vector<DualQuaternion> dual_quaternions;
+		vector<Xformf> xforms;
+		for (size_t b = 0; b < Bones; ++b) {
+			Quaternion q(Vec3f(next() - 0.5f, next() - 0.5f, next() + 0.1f), next() * 3.0f);
+			dual_quaternions.emplace_back(q, Vec3f(next(), next(), next()));
+			xforms.push_back(dual_quaternions.back().ToXform());
+		}
+
+		// Neighbouring vertices share bones, as in a real mesh, with two to four influences each
+		Vert3dSoA mesh;
+		SkinInfluences influences;
+		mesh.resize(Vertices);
+		influences.resize(Vertices);
+		for (size_t n = 0; n < Vertices; ++n) {
+			mesh.pos.set(n, Vec3f(next(), next(), next()));
+			mesh.norm.set(n, Vec3f(next() - 0.5f, next() - 0.5f, next() + 0.1f).normalize());
+			size_t used = 2 + n % 3;
+			for (size_t k = 0; k < used; ++k) {
+				influences.bones[k][n] = uint16_t((n / 256 + k) % Bones);
+				influences.weights[k][n] = 1.0f / float(used);
+			}
+		}
+
+		Vec3fSoA positions, normals;
+		bench.run("Skinning/linear blend 200k", Vertices, [&] {
+			skin_linear(xforms, mesh, influences, positions, normals);
+			do_not_optimize(positions.streams[0][0]);
+		});
+		bench.run("Skinning/dual quaternion 200k", Vertices, [&] {
+			skin_dual_quaternion(dual_quaternions, mesh, influences, positions, normals);
+			do_not_optimize(positions.streams[0][0]);
+		});
+		bench.run("Skinning/per-vertex linear blend 200k", Vertices, [&] {
+			for (size_t n = 0; n < Vertices; ++n) {
+				Xformf blend;
+				blend.arr.fill(0.0f);
+				for (size_t k = 0; k < SkinInfluences::Slots; ++k) {
+					float w = influences.weights[k][n];
+					if (w != 0.0f) blend += xforms[influences.bones[k][n]] * w;
+				}
+				Vec3f p = mesh.pos.get(n), normal = mesh.norm.get(n);
+				positions.set(n, Vec3f(blend[0]) * p[0] + Vec3f(blend[1]) * p[1] + Vec3f(blend[2]) * p[2] + Vec3f(blend[3]));
+				normals.set(n, (Vec3f(blend[0]) * normal[0] + Vec3f(blend[1]) * normal[1] + Vec3f(blend[2]) * normal[2]).normalize());
+			}
+			do_not_optimize(positions.streams[0][0]);
+		});
+	}
+
+	void mesh(Bench::Runner& bench) {
+		// A 512 x 512 height field: 262k vertices, 522k triangles in strip order
+		constexpr uint32_t Side = 512;
+		Vert3dSoA grid;
+		vector<uint32_t> indices;
+		for (uint32_t y = 0; y < Side; ++y) {
+			for (uint32_t x = 0; x < Side; ++x) {
+				grid.pos.push_back(Vec3f(float(x), float(y), std::sin(float(x) * 0.05f) * std::cos(float(y) * 0.07f) * 8.0f));
+				grid.norm.push_back(Vec3f(0.0f, 0.0f, 1.0f));
+				grid.uv.push_back(Vec2f(float(x) / Side, float(y) / Side));
+			}
+		}
+		for (uint32_t y = 0; y + 1 < Side; ++y) {
+			for (uint32_t x = 0; x + 1 < Side; ++x) {
+				uint32_t v = y * Side + x;
+				indices.insert(indices.end(), { v, v + 1, v + Side, v + 1, v + Side + 1, v + Side });
+			}
+		}
+		size_t vertices = grid.size();
+
+		VertexTriangles adjacency;
+		adjacency.build(indices, vertices);
+		Vec3fSoA normals;
+		Vec4fSoA tangents;
+		bench.run("Mesh/vertex adjacency 262k", vertices, [&] {
+			adjacency.build(indices, vertices);
+			do_not_optimize(adjacency.triangles[0]);
+		});
+		bench.run("Mesh/vertex normals 262k", vertices, [&] {
+			vertex_normals(grid.pos, indices, adjacency, normals);
+			do_not_optimize(normals.streams[0][0]);
+		});
+		bench.run("Mesh/per-vertex scatter normals 262k", vertices, [&] {
+			vector<Vec3f> sums(vertices, Vec3f(0.0f, 0.0f, 0.0f));
+			for (size_t i = 0; i < indices.size(); i += 3) {
+				Vec3f p0 = grid.pos.get(indices[i]);
+				Vec3f n = (grid.pos.get(indices[i + 1]) - p0).cross(grid.pos.get(indices[i + 2]) - p0);
+				for (size_t c = 0; c < 3; ++c) sums[indices[i + c]] = sums[indices[i + c]] + n;
+			}
+			for (size_t v = 0; v < vertices; ++v) normals.set(v, sums[v].normalize());
+			do_not_optimize(normals.streams[0][0]);
+		});
+		bench.run("Mesh/vertex tangents 262k", vertices, [&] {
+			vertex_tangents(grid, indices, adjacency, tangents);
+			do_not_optimize(tangents.streams[0][0]);
+		});
+		bench.run("Mesh/bounding box 262k", vertices, [&] {
+			do_not_optimize(bounding_box(grid.pos));
+		});
+		bench.run("Mesh/bounding sphere 262k", vertices, [&] {
+			do_not_optimize(bounding_sphere(grid.pos));
+		});
+	}
+
+	// Throughput counts the float side and the packed side, read plus written
+	void compression(Bench::Runner& bench) {
+		constexpr size_t Count = 1 << 20;
+		uint32_t seed = 41;
+		auto next = [&] {
+			seed = seed * 1664525u + 1013904223u;
+			return float(seed >> 8) / float(1 << 24);
+		};
+
+		Vec3fSoA normals(Count), positions(Count);
+		Vec2fSoA uvs(Count);
+		vector<Quaternion> rotations(Count);
+		for (size_t n = 0; n < Count; ++n) {
+			normals.set(n, Vec3f(next() - 0.5f, next() - 0.5f, next() - 0.5f).normalize());
+			positions.set(n, Vec3f(next(), next(), next()) * 100.0f);
+			uvs.set(n, Vec2f(next(), next()));
+			rotations[n] = Quaternion(Vec3f(next() - 0.5f, next() - 0.5f, next() + 0.1f), next() * 6.0f);
+		}
+		AABB bounds { Vec3f(50.0f, 50.0f, 50.0f), { 50.0f, 50.0f, 50.0f } };
+
+		vector<OctNormal32> oct(Count);
+		vector<HalfUV> half(Count);
+		vector<QuantizedPosition> quantized(Count);
+		vector<PackedQuaternion48> packed(Count);
+		bench.run("Compression/encode normals oct32 1M", Count, Count * (12 + 4), [&] {
+			encode_normals(normals, span<OctNormal32>(oct));
+			do_not_optimize(oct[0]);
+		});
+		bench.run("Compression/decode normals oct32 1M", Count, Count * (4 + 12), [&] {
+			decode_normals(span<const OctNormal32>(oct), normals);
+			do_not_optimize(normals.streams[0][0]);
+		});
+		bench.run("Compression/encode uvs half 1M", Count, Count * (8 + 4), [&] {
+			encode_uvs(uvs, half);
+			do_not_optimize(half[0]);
+		});
+		bench.run("Compression/decode uvs half 1M", Count, Count * (4 + 8), [&] {
+			decode_uvs(half, uvs);
+			do_not_optimize(uvs.streams[0][0]);
+		});
+		bench.run("Compression/quantize positions 1M", Count, Count * (12 + 6), [&] {
+			quantize_positions(bounds, positions, quantized);
+			do_not_optimize(quantized[0]);
+		});
+		bench.run("Compression/dequantize positions 1M", Count, Count * (6 + 12), [&] {
+			dequantize_positions(bounds, quantized, positions);
+			do_not_optimize(positions.streams[0][0]);
+		});
+		bench.run("Compression/encode quaternions 48-bit 1M", Count, Count * (16 + 6), [&] {
+			encode_quaternions(rotations, span<PackedQuaternion48>(packed));
+			do_not_optimize(packed[0]);
+		});
+		bench.run("Compression/decode quaternions 48-bit 1M", Count, Count * (6 + 16), [&] {
+			decode_quaternions(span<const PackedQuaternion48>(packed), rotations);
+			do_not_optimize(rotations[0]);
+		});
+
+		constexpr size_t Transforms = 1 << 16;
+		vector<Xformf> xforms(Transforms);
+		for (size_t n = 0; n < Transforms; ++n) xforms[n] = compose(rotations[n], Vec3f(next(), next(), next()), Vec3f(1.0f, 1.0f, 1.0f));
+		vector<PackedTRS> trs(Transforms);
+		bench.run("Compression/encode transforms 64k", Transforms, Transforms * (48 + 24), [&] {
+			encode_transforms(xforms, trs);
+			do_not_optimize(trs[0]);
+		});
+		bench.run("Compression/decode transforms 64k", Transforms, Transforms * (24 + 48), [&] {
+			decode_transforms(trs, xforms);
+			do_not_optimize(xforms[0]);
+		});
+	}
+
+	// 1000 characters of 64 joints playing forward at 60 Hz over 16 clips of 2 s with 30 keys per second,
+	// against a per-track loop binary searching each track and calling lerp and Slerp
+	void animation(Bench::Runner& bench) {
+		constexpr size_t Characters = 1000, Joints = 64, Clips = 16, Keys = 61;
+		constexpr float Frame = 1.0f / 60.0f;
+		uint32_t seed = 43;
+		auto next = [&] {
+			seed = seed * 1664525u + 1013904223u;
+			return float(seed >> 8) / float(1 << 24);
+		};
+
+		vector<float> times(Keys);
+		for (size_t k = 0; k < Keys; ++k) times[k] = float(k) / 30.0f;
+		auto make_clips = [&](Interpolation mode) {
+			vector<AnimationClip> clips;
+			for (size_t c = 0; c < Clips; ++c) {
+				AnimationClip& clip = clips.emplace_back(Joints);
+				for (size_t j = 0; j < Joints; ++j) {
+					vector<Vec3f> points(Keys);
+					vector<Quaternion> rotations(Keys);
+					for (size_t k = 0; k < Keys; ++k) {
+						points[k] = Vec3f(next(), next(), next());
+						rotations[k] = Quaternion(Vec3f(next() - 0.5f, next() - 0.5f, next() + 0.1f), next() * 0.5f);
+					}
+					clip.add_translation(j, times, points, mode);
+					clip.add_rotation(j, times, rotations, mode);
+					clip.add_scale(j, times, points, mode);
+				}
+			}
+			return clips;
+		};
+
+		auto run = [&](const char* name, const vector<AnimationClip>& clips) {
+			vector<AnimationSampler> samplers(Characters);
+			vector<TRSBatch> poses(Characters);
+			vector<AnimationJob> jobs(Characters);
+			for (size_t n = 0; n < Characters; ++n) {
+				jobs[n] = { &clips[n % Clips], &samplers[n], next() * clips[0].duration(), &poses[n] };
+			}
+			bench.run(name, Characters * Joints, [&] {
+				for (auto& job : jobs) {
+					job.time += Frame;
+					if (job.time > job.clip->duration()) job.time -= job.clip->duration();
+				}
+				sample_animations(jobs);
+				do_not_optimize(poses[0].rotation.streams[0][0]);
+			});
+		};
+
+		vector<AnimationClip> linear = make_clips(Interpolation::Linear);
+		run("Animation/sample linear 1000 x 64 joints", linear);
+		run("Animation/sample cubic 1000 x 64 joints", make_clips(Interpolation::Cubic));
+
+		vector<float> clock(Characters);
+		for (size_t n = 0; n < Characters; ++n) clock[n] = next() * linear[0].duration();
+		vector<TRSBatch> poses(Characters, TRSBatch(Joints));
+		bench.run("Animation/sample linear 1000 x 64 joints scalar", Characters * Joints, [&] {
+			for (size_t n = 0; n < Characters; ++n) {
+				const AnimationClip& clip = linear[n % Clips];
+				clock[n] += Frame;
+				if (clock[n] > clip.duration()) clock[n] -= clip.duration();
+				auto segment = [&](const auto& tracks, size_t j, size_t& k, float& s) {
+					const float* first = tracks.times.data() + tracks.offsets[j];
+					const float* last = tracks.times.data() + tracks.offsets[j + 1] - 1;
+					const float* key = std::max(first, std::min(last - 1, std::upper_bound(first, last, clock[n]) - 1));
+					k = size_t(key - tracks.times.data());
+					s = std::clamp((clock[n] - key[0]) / (key[1] - key[0]), 0.0f, 1.0f);
+				};
+				auto vec3 = [](const float* p) { return Vec3f(p[0], p[1], p[2]); };
+				auto quaternion = [](const float* p) { return Quaternion(p[0], p[1], p[2], p[3]); };
+				for (size_t j = 0; j < Joints; ++j) {
+					size_t k;
+					float s;
+					segment(clip.translations, j, k, s);
+					poses[n].translation.set(j, vec3(clip.translations.value(k)).lerp(vec3(clip.translations.value(k + 1)), s));
+					segment(clip.rotations, j, k, s);
+					poses[n].rotation.set(j, Slerp(quaternion(clip.rotations.value(k)), quaternion(clip.rotations.value(k + 1)), s));
+					segment(clip.scales, j, k, s);
+					poses[n].scale.set(j, vec3(clip.scales.value(k)).lerp(vec3(clip.scales.value(k + 1)), s));
+				}
+			}
+			do_not_optimize(poses[0].rotation.streams[0][0]);
+		});
+	}
+
+	// A 44 MB scene of 256k transforms and 1M vertices, copied out of the file into vectors against used
+	// in place, with and without touching every page. The file stays in the page cache, so this is the copy and
+	// page fault cost, not the disk.
+	void binary_format(Bench::Runner& bench) {
+		constexpr size_t Transforms = 1 << 18, Vertices = 1 << 20, Page = 4096;
+		vector<Xformf> xforms(Transforms);
+		vector<Vert3d> vertices(Vertices);
+		for (size_t n = 0; n < Transforms; ++n) xforms[n] = translation(Vec3f(float(n), 0.0f, 0.0f));
+		for (size_t n = 0; n < Vertices; ++n) vertices[n] = { Vec3f(float(n), 1.0f, 2.0f), Vec3f(0.0f, 1.0f, 0.0f), Vec2f(0.5f, 0.5f) };
+
+		std::string path = (std::filesystem::temp_directory_path() / "math3d_bench.m3db").string();
+		BinaryWriter writer;
+		if (!writer.open(path.c_str()) || !writer.add<Xformf>("transforms", xforms) || !writer.add<Vert3d>("vertices", vertices) || !writer.finish()) {
+			std::fprintf(stderr, "BinaryFormat: could not write %s\n", path.c_str());
+			return;
+		}
+		size_t bytes = size_t(std::filesystem::file_size(path));
+
+		bench.run("BinaryFormat/copy into vectors 256k xforms + 1M verts", 1, bytes, [&] {
+			BinaryFile file;
+			file.open(path.c_str());
+			span<const Xformf> x = file.get<Xformf>("transforms");
+			span<const Vert3d> v = file.get<Vert3d>("vertices");
+			vector<Xformf> loaded_xforms(x.begin(), x.end());
+			vector<Vert3d> loaded_vertices(v.begin(), v.end());
+			do_not_optimize(loaded_xforms.back());
+			do_not_optimize(loaded_vertices.back());
+		});
+		bench.run("BinaryFormat/open mapped 256k xforms + 1M verts", 1, [&] {
+			BinaryFile file;
+			file.open(path.c_str());
+			do_not_optimize(file.get<Xformf>("transforms").size());
+			do_not_optimize(file.get<Vert3d>("vertices").size());
+		});
+		bench.run("BinaryFormat/open mapped and touch every page", 1, [&] {
+			BinaryFile file;
+			file.open(path.c_str());
+			span<const Vert3d> v = file.get<Vert3d>("vertices");
+			span<const Xformf> x = file.get<Xformf>("transforms");
+			float sum = 0.0f;
+			for (size_t n = 0; n < x.size(); n += Page / sizeof(Xformf)) sum += x[n].arr[0];
+			for (size_t n = 0; n < v.size(); n += Page / sizeof(Vert3d)) sum += v[n].pos[0];
+			do_not_optimize(sum);
+		});
+		std::filesystem::remove(path);
+	}
+
+	// The same batch kernels on 1, 2, 4, ... threads up to one per hardware thread, each on its own
+	// JobSystem picked with a Scope, plus the cost of spawning and waiting for small tasks
+	void scaling(Bench::Runner& bench) {
+		constexpr size_t Count = 1 << 20, Tasks = 10000;
+		uint32_t seed = 47;
+		auto next = [&] {
+			seed = seed * 1664525u + 1013904223u;
+			return float(seed >> 8) / float(1 << 24);
+		};
+
+		vector<Xformf> xforms(Count);
+		for (size_t n = 0; n < Count; ++n) {
+			Quaternion q(Vec3f(next() - 0.5f, next() - 0.5f, next() + 0.1f), next() * 6.0f);
+			xforms[n] = compose(q, Vec3f(next(), next(), next()), Vec3f(next() + 0.5f, next() + 0.5f, next() + 0.5f));
+		}
+		TRSBatch trs;
+		vector<PackedTRS> packed(Count);
+
+		size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+		for (size_t threads = 1;; threads = std::min(threads * 2, hardware)) {
+			JobSystem system(threads);
+			JobSystem::Scope scope(system);
+			std::string suffix = " " + std::to_string(threads) + (threads == 1 ? " thread" : " threads");
+
+			bench.run("Scaling/decompose 1M" + suffix, Count, [&] {
+				decompose(xforms, trs);
+				do_not_optimize(trs.rotation.streams[0][0]);
+			});
+			bench.run("Scaling/encode transforms 1M" + suffix, Count, [&] {
+				encode_transforms(xforms, packed);
+				do_not_optimize(packed[0]);
+			});
+			bench.run("Scaling/task group 10k empty tasks" + suffix, Tasks, [&] {
+				TaskGroup group;
+				for (size_t n = 0; n < Tasks; ++n) group.run([] {});
+				group.wait();
+			});
+			if (threads == hardware) break;
+		}
+	}
+
+	template <size_t W, size_t H>
+	void bench_fused(Bench::Runner& bench, const char* name) {
+		auto a = make_matrix<float, W, H>(0.1f);
+		auto b = make_matrix<float, W, H>(0.5f);
+		auto c = make_matrix<float, W, H>(0.9f);
+		Matrix<float, W, H> r = a;
+		float s = 1.5f, t = 0.25f;
+
+		bench.run(string("Expr/") + name + " a * s + b * t - c eager", [&] {
+			do_not_optimize(a);
+			r = a * s + b * t - c;
+			do_not_optimize(r);
+		});
+		bench.run(string("Expr/") + name + " a * s + b * t - c fused", [&] {
+			do_not_optimize(a);
+			expr::eval_into(lazy(a) * s + lazy(b) * t - c, r);
+			do_not_optimize(r);
+		});
+		bench.run(string("Expr/") + name + " lerp then normalize eager", [&] {
+			do_not_optimize(a);
+			r = a.lerp(b, t).normalize();
+			do_not_optimize(r);
+		});
+		bench.run(string("Expr/") + name + " lerp then normalize fused", [&] {
+			do_not_optimize(a);
+			r = expr::normalize(expr::lerp(a, b, t));
+			do_not_optimize(r);
+		});
+	}
+
+	void expressions(Bench::Runner& bench) {
+		bench_fused<3, 1>(bench, "Vec3f");
+		bench_fused<4, 4>(bench, "Mat4f");
+		bench_fused<16, 16>(bench, "Matrix<float, 16, 16>");
+	}
+}
+
+int main(int argc, char** argv) {
+	Bench::Runner bench(argc, argv);
+
+	matrix(bench);
+	inverse(bench);
+	quaternion(bench);
+	transforms(bench);
+	trigonometry(bench);
+	batch(bench);
+	hierarchy(bench);
+	bvh(bench);
+	packets(bench);
+	broad_phase(bench);
+	narrow_phase(bench);
+	culling(bench);
+	skinning(bench);
+	mesh(bench);
+	compression(bench);
+	animation(bench);
+	binary_format(bench);
+	scaling(bench);
+	expressions(bench);
+
+	return bench.finish();
+}
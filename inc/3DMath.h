@@ -1,11 +1,53 @@
 #pragma once
+#include <algorithm>
 #include <cmath>
+#include <limits>
+#include <type_traits>
 
-// This is some bullshit
-// #define EPSILON numeric_limits<T>::epsilon()
+// Tolerance of the float comparisons, kept for code that predates Math3D::Epsilon<T>
 #define EPSILON 1e-06F
 
 namespace Math3D {
+	// Tolerance of nearly_equal per element type: absolute for float, relative to the larger magnitude
+	// past 1 for double, so large-world coordinates keep their extra digits without comparing exactly
+	// once they reach a few kilometres. Integers compare exactly.
+	template <typename T>
+	constexpr T Epsilon = T(1e-6);
+
+	template <>
+	constexpr double Epsilon<double> = 1e-12;
+
+	template <>
+	constexpr long double Epsilon<long double> = 1e-12L;
+
+	// Stand-ins for <cmath> that also work in constant expressions, where std::sqrt and std::fabs aren't
+	// portable. At runtime they are the std functions.
+	namespace cx {
+		template <typename T>
+		constexpr T abs(T x) {
+			if consteval {
+				return x < T(0) ? -x : x;
+			}
+			return std::fabs(x);
+		}
+
+		// Newton's method from above, carried out in double: float results match std::sqrt, double ones are within an ulp
+		template <typename T>
+		constexpr T sqrt(T x) {
+			if consteval {
+				// Zeros, NaN and infinity come back unchanged
+				if (!(x > T(0)) || x == std::numeric_limits<T>::infinity()) {
+					return x < T(0) ? std::numeric_limits<T>::quiet_NaN() : x;
+				}
+				using W = std::conditional_t<std::is_same_v<T, float>, double, T>;
+				W v = W(x), y = v > W(1) ? v : W(1);
+				for (W next = (y + v / y) / W(2); next < y; next = (y + v / y) / W(2)) y = next;
+				return T(y);
+			}
+			return std::sqrt(x);
+		}
+	}
+
 	template <typename T>
 	constexpr T lerp(const T& a, const T& b, float t) {
 		return (1 - t) * a + t * b;
@@ -13,6 +55,14 @@ namespace Math3D {
 
 	template <typename T>
 	bool nearly_equal(const T& lhs, const T& rhs) {
-		return std::abs(lhs - rhs) < EPSILON;
+		if constexpr (std::is_integral_v<T>) {
+			return lhs == rhs;
+		}
+		else if constexpr (std::is_same_v<T, float>) {
+			return std::abs(lhs - rhs) < Epsilon<T>;
+		}
+		else {
+			return std::abs(lhs - rhs) <= Epsilon<T> * std::max({ T(1), std::abs(lhs), std::abs(rhs) });
+		}
 	}
-}
\ No newline at end of file
+}
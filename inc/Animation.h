@@ -0,0 +1,104 @@
+#pragma once
+#include <cstdint>
+#include <span>
+
+#include "Quaternion.h"
+#include "SoA.h"
+#include "TRSBatch.h"
+
+namespace Math3D {
+	enum class Interpolation : uint8_t {
+		Step,   // holds each key until the next one
+		Linear, // lerp for Vec3f keys, slerp for Quaternion keys
+		Cubic,  // Hermite spline for Vec3f keys, squad for Quaternion keys
+	};
+
+	// The keyframe tracks of one channel of a clip, all keys pooled in one set of streams. Track n drives
+	// joint targets[n] with the keys offsets[n] up to offsets[n + 1], whose times increase strictly.
+	//
+	// Values and tangents hold Width floats per key, components together, so a track's neighbouring keys
+	// share a cache line and each is read with one four-wide load; a float of padding after the last key
+	// keeps that load in bounds when Width is 3. For Vec3f tracks a tangent is the Hermite tangent in value
+	// per unit time, zero unless the track is Cubic; for Quaternion tracks it is the squad control point,
+	// the key itself unless the track is Cubic.
+	template <size_t Width>
+	struct KeyframeTracks {
+		size_t size() const { return targets.size(); }
+		size_t key_count() const { return times.size(); }
+
+		const float* value(size_t key) const { return values.data() + key * Width; }
+		const float* tangent(size_t key) const { return tangents.data() + key * Width; }
+
+		aligned_vector<uint32_t> targets;
+		aligned_vector<uint32_t> offsets = { 0 };
+		aligned_vector<Interpolation> modes;
+		aligned_vector<float> times;
+		aligned_vector<float> values;
+		aligned_vector<float> tangents;
+	};
+
+	using Vec3Tracks = KeyframeTracks<3>;
+	using QuaternionTracks = KeyframeTracks<4>;
+
+	// Translation, rotation and scale tracks for the joints of a skeleton, sampled into a TRSBatch with a
+	// joint per element. Each joint has at most one track per channel; channels without one sample as the
+	// identity. Before its first key a track holds the first value and after its last the last value.
+	struct AnimationClip {
+		AnimationClip() = default;
+		explicit AnimationClip(size_t joints) : joint_count(joints) {}
+
+		// Cubic tracks without tangents get Catmull-Rom ones: the difference of the neighbouring keys over
+		// their time apart, one sided at the ends
+		void add_translation(size_t joint, span<const float> times, span<const Vec3f> values, Interpolation mode,
+			span<const Vec3f> tangents = {});
+		void add_scale(size_t joint, span<const float> times, span<const Vec3f> values, Interpolation mode,
+			span<const Vec3f> tangents = {});
+
+		// Keys are normalized and flipped onto the hemisphere of the previous key. Cubic tracks get squad
+		// control points from the neighbouring keys, as for evenly spaced keys.
+		void add_rotation(size_t joint, span<const float> times, span<const Quaternion> values, Interpolation mode);
+
+		// Time of the last key of any track
+		float duration() const { return end_time; }
+
+		size_t joint_count = 0;
+		float end_time = 0.0f;
+		Vec3Tracks translations;
+		QuaternionTracks rotations;
+		Vec3Tracks scales;
+	};
+
+	// The segment each track of a channel was last sampled in: keys[n] and next[n], the same key past the
+	// ends and for Step tracks, the times [begin[n], end[n]) it covers and the time between the two keys.
+	// Streams are padded to a multiple of four tracks with segments covering every time.
+	struct TrackCursors {
+		aligned_vector<uint32_t> keys, next;
+		aligned_vector<float> begin, end, duration;
+	};
+
+	// Playback state of one clip instance. While time stays in the segments of the last sample, four tracks
+	// are checked with one comparison and no key times are read; a track that has moved on steps forward a
+	// key or two, or binary searches after a jump. Give every instance its own sampler. Sampling another
+	// clip resets it; call reset() after adding tracks to the clip it last sampled.
+	struct AnimationSampler {
+		// Samples every track at time, four tracks per SIMD pass, into out resized to clip.joint_count.
+		// Tracks are split over parallel_for when a clip has thousands.
+		void sample(const AnimationClip& clip, float time, TRSBatch& out);
+
+		void reset() { current = nullptr; }
+
+		const AnimationClip* current = nullptr;
+		TrackCursors translations, rotations, scales;
+	};
+
+	struct AnimationJob {
+		const AnimationClip* clip = nullptr;
+		AnimationSampler* sampler = nullptr;
+		float time = 0.0f;
+		TRSBatch* out = nullptr;
+	};
+
+	// Runs every job's sampler over parallel_for, for the many characters of a frame. Jobs must not share
+	// a sampler or an output.
+	void sample_animations(span<const AnimationJob> jobs);
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "GeometricPrimitives.h"
+#include "RayPacket.h"
+#include "SoA.h"
+
+namespace Math3D {
+	// 32 bytes, two to a cache line. Interior nodes keep their children next to each other at
+	// first and first + 1; leaves own count primitives starting at first in the BVH's primitive order.
+	// Node 0 is the root and node 1 is unused, so each pair of siblings fills one cache line.
+	struct alignas(32) BVHNode {
+		float min[3];
+		uint32_t first;
+		float max[3];
+		uint32_t count;
+
+		bool is_leaf() const { return count != 0; }
+	};
+
+	// Bounding volume hierarchy over a triangle soup or a set of boxes, built with binned SAH and flattened
+	// into one node array. Primitive data is copied in leaf order so queries never touch the caller's arrays;
+	// results report the caller's primitive indices.
+	class BVH {
+	public:
+		struct BuildOptions {
+			uint32_t max_leaf_size = 4;
+			uint32_t bins = 16;
+
+			// Splits the top of the tree serially, then builds the subtrees on parallel_for
+			bool parallel = false;
+		};
+
+		struct Hit {
+			float t;
+			uint32_t primitive;
+
+			// Barycentrics of verts[1] and verts[2]; zero for box sets
+			float u, v;
+		};
+
+		// Hit per lane of a packet query, valid for the lanes the query returns
+		template <size_t N>
+		struct PacketHit {
+			alignas(64) float t[N];
+			alignas(64) uint32_t primitive[N];
+			alignas(64) float u[N];
+			alignas(64) float v[N];
+		};
+
+		void build(span<const Tri3d> triangles, const BuildOptions& options);
+		void build(span<const Tri3d> triangles) { build(triangles, BuildOptions()); }
+		void build(span<const AABB> boxes, const BuildOptions& options);
+		void build(span<const AABB> boxes) { build(boxes, BuildOptions()); }
+
+		// Recomputes bounds bottom-up for moved primitives, keeping the topology. The primitive count
+		// and kind must match the last build; quality degrades as geometry moves far from it.
+		void refit(span<const Tri3d> triangles);
+		void refit(span<const AABB> boxes);
+
+		// Nearest hit with t in [0, t_max]
+		bool closest_hit(const Ray& ray, Hit& hit, float t_max = numeric_limits<float>::infinity()) const;
+
+		// Any hit with t in [0, t_max]; stops at the first one, for occlusion and line of sight
+		bool any_hit(const Ray& ray, float t_max = numeric_limits<float>::infinity()) const;
+
+		// Packet versions for coherent rays: the lanes share one traversal and each is clipped to its own
+		// t_max. They return a mask of the lanes that hit. Instantiated for 4, 8 and 16 lanes.
+		template <size_t N>
+		uint32_t closest_hit(const RayPacket<N>& rays, PacketHit<N>& hit) const;
+
+		template <size_t N>
+		uint32_t any_hit(const RayPacket<N>& rays) const;
+
+		// Appends every primitive whose bounds overlap box
+		void overlaps(const AABB& box, vector<uint32_t>& out) const;
+
+		span<const BVHNode> nodes() const { return node_array; }
+		size_t size() const { return primitive_ids.size(); }
+		bool empty() const { return primitive_ids.empty(); }
+
+	private:
+		struct Triangle {
+			Vec3f v0, e1, e2;
+		};
+
+		struct Box {
+			Vec3f min, max;
+		};
+
+		void build_nodes(span<const Box> bounds, const BuildOptions& options);
+		void refit_nodes();
+
+		aligned_vector<BVHNode> node_array;
+
+		// Leaf order -> caller's index
+		vector<uint32_t> primitive_ids;
+
+		// Leaf order; exactly one of these is filled
+		vector<Triangle> triangles;
+		vector<Box> boxes;
+	};
+}
@@ -0,0 +1,193 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "GeometricPrimitives.h"
+#include "Quaternion.h"
+#include "SoA.h"
+
+namespace Math3D {
+	// A container of named arrays that are used straight from the mapped file. The file is a 64-byte
+	// FileHeader, the sections, each starting on a 64-byte boundary, and a table of SectionEntry records.
+	// Elements are stored exactly as they are laid out in memory, in the byte order of the machine that
+	// wrote them; a reader on another byte order or with other element sizes rejects the file rather than
+	// converting it. VecSoA sections store their streams back to back, each on a 64-byte boundary, so they
+	// can be read with the same aligned loads as an aligned_vector.
+	enum class ElementType : uint32_t { Float, Uint32, Vec2f, Vec3f, Vec4f, Quaternion, Xformf, Vert3d, AABB };
+
+	template <class T> struct element_type;
+	template <> struct element_type<float> { static constexpr ElementType value = ElementType::Float; };
+	template <> struct element_type<uint32_t> { static constexpr ElementType value = ElementType::Uint32; };
+	template <> struct element_type<Vec2f> { static constexpr ElementType value = ElementType::Vec2f; };
+	template <> struct element_type<Vec3f> { static constexpr ElementType value = ElementType::Vec3f; };
+	template <> struct element_type<Vec4f> { static constexpr ElementType value = ElementType::Vec4f; };
+	template <> struct element_type<Quaternion> { static constexpr ElementType value = ElementType::Quaternion; };
+	template <> struct element_type<Xformf> { static constexpr ElementType value = ElementType::Xformf; };
+	template <> struct element_type<Vert3d> { static constexpr ElementType value = ElementType::Vert3d; };
+	template <> struct element_type<AABB> { static constexpr ElementType value = ElementType::AABB; };
+
+	// The layouts the file format assumes. A change here changes the format, so bump FormatVersion.
+	static_assert(sizeof(Vec2f) == 8 && alignof(Vec2f) == 4 && sizeof(Vec3f) == 12 && alignof(Vec3f) == 4);
+	static_assert(sizeof(Vec4f) == 16 && alignof(Vec4f) == 16 && sizeof(Xformf) == 48 && alignof(Xformf) == 16);
+	static_assert(sizeof(Quaternion) == 16 && sizeof(Vert3d) == 32 && sizeof(AABB) == 24);
+	static_assert(is_trivially_copyable_v<Vec3f> && is_trivially_copyable_v<Vec4f> && is_trivially_copyable_v<Xformf>);
+	static_assert(is_trivially_copyable_v<Quaternion> && is_trivially_copyable_v<Vert3d> && is_trivially_copyable_v<AABB>);
+
+	constexpr uint32_t FormatVersion = 1;
+	constexpr uint32_t ByteOrderMark = 0x01020304u;
+	constexpr size_t SectionAlignment = 64;
+
+	struct FileHeader {
+		char magic[4];             // "M3DB", written last so an unfinished file never validates
+		uint32_t byte_order;       // ByteOrderMark as the writer stored it
+		uint32_t version;
+		uint32_t section_count;
+		uint64_t table_offset;
+		uint64_t file_size;
+		uint8_t reserved[32];
+	};
+
+	struct SectionEntry {
+		char name[32];             // NUL terminated
+		ElementType type;
+		uint32_t element_size;     // sizeof the element type when written
+		uint32_t components;       // W for VecSoA sections, otherwise 1
+		uint32_t reserved;
+		uint64_t offset;           // of the first element, a multiple of SectionAlignment
+		uint64_t count;            // elements, per stream for VecSoA sections
+		uint64_t stride;           // bytes between VecSoA streams, otherwise 0
+	};
+
+	static_assert(sizeof(FileHeader) == 64 && sizeof(SectionEntry) == 72);
+
+	enum class FormatError {
+		None,
+		Open,      // the file could not be opened or mapped
+		Truncated, // the header, table or a section runs past the end of the data
+		Magic,
+		ByteOrder, // written on a machine of the other byte order
+		Version,
+		Layout,    // an element size, alignment or section record that doesn't match this build
+	};
+
+	// Read-only view of a whole file, mmap on POSIX and a file mapping on Windows. Pages are read on first
+	// touch, so opening costs the same for any file size.
+	class MappedFile {
+	public:
+		MappedFile() = default;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+		~MappedFile() { close(); }
+
+		bool open(const char* path);
+		void close();
+
+		span<const byte> bytes() const { return { base, length }; }
+
+	private:
+		const byte* base = nullptr;
+		size_t length = 0;
+#ifdef _WIN32
+		void* mapping = nullptr;
+#endif
+	};
+
+	// The sections of one VecSoA, read in place
+	template <size_t W>
+	struct SoAView {
+		size_t size() const { return streams[0].size(); }
+		span<const float> stream(size_t k) const { return streams[k]; }
+
+		array<span<const float>, W> streams;
+	};
+
+	// A validated file: open() maps one, view() checks a buffer the caller keeps alive, which must start
+	// on a SectionAlignment boundary. Lookups return empty spans for missing names or other element types.
+	class BinaryFile {
+	public:
+		FormatError open(const char* path);
+		FormatError view(span<const byte> bytes);
+
+		span<const SectionEntry> sections() const { return table; }
+		const SectionEntry* find(string_view name) const;
+
+		template <class T>
+		span<const T> get(string_view name) const {
+			const SectionEntry* entry = find(name);
+			if (!entry || entry->type != element_type<T>::value || entry->components != 1) return {};
+			return { reinterpret_cast<const T*>(data.data() + entry->offset), size_t(entry->count) };
+		}
+
+		template <size_t W>
+		SoAView<W> get_soa(string_view name) const {
+			SoAView<W> view;
+			const SectionEntry* entry = find(name);
+			if (!entry || entry->type != ElementType::Float || entry->components != W) return view;
+			for (size_t k = 0; k < W; ++k) {
+				view.streams[k] = { reinterpret_cast<const float*>(data.data() + entry->offset + k * entry->stride), size_t(entry->count) };
+			}
+			return view;
+		}
+
+	private:
+		MappedFile file;
+		span<const byte> data;
+		span<const SectionEntry> table;
+	};
+
+	// Writes each section as it is added, so a scene never has to be held in memory whole: add() writes an
+	// array at once, begin() / append() / end() one section in pieces. finish() writes the table and the
+	// header; a writer destroyed without it leaves a file that doesn't validate. Every call returns false
+	// after a write fails or for a name that is empty, longer than 31 characters or already used.
+	class BinaryWriter {
+	public:
+		BinaryWriter() = default;
+		BinaryWriter(const BinaryWriter&) = delete;
+		BinaryWriter& operator=(const BinaryWriter&) = delete;
+		~BinaryWriter();
+
+		bool open(const char* path);
+
+		template <class T>
+		bool add(string_view name, span<const T> elements) {
+			return begin<T>(name) && append(elements) && end();
+		}
+
+		template <size_t W>
+		bool add(string_view name, const VecSoA<float, W>& soa) {
+			array<const float*, W> streams;
+			for (size_t k = 0; k < W; ++k) streams[k] = soa.streams[k].data();
+			return add_soa(name, streams.data(), W, soa.size());
+		}
+
+		template <class T>
+		bool begin(string_view name) { return begin_section(name, element_type<T>::value, sizeof(T)); }
+
+		template <class T>
+		bool append(span<const T> elements) {
+			return open_section && current.type == element_type<T>::value && write(elements.data(), elements.size_bytes());
+		}
+
+		bool end();
+		bool finish();
+
+	private:
+		bool begin_section(string_view name, ElementType type, uint32_t element_size);
+		bool add_soa(string_view name, const float* const* streams, uint32_t components, size_t count);
+		bool write(const void* bytes, size_t size);
+		bool pad_to(size_t alignment);
+
+		FILE* file = nullptr;
+		uint64_t position = 0;
+		bool failed = false;
+		bool open_section = false;
+		SectionEntry current = {};
+		vector<SectionEntry> table;
+	};
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "GeometricPrimitives.h"
+
+namespace Math3D {
+	// A pair of bodies whose bounds overlap, a < b
+	struct OverlapPair {
+		uint32_t a, b;
+
+		bool operator==(const OverlapPair&) const = default;
+	};
+
+	// Incremental sort-and-sweep on all three axes. Body bounds, the sorted endpoint arrays and the set of
+	// overlapping pairs all persist between frames. find_pairs() re-sorts each axis with insertion sort; every
+	// swap of a min past a max endpoint starts or ends an overlap on that axis, and the pair set is updated
+	// from those swaps alone. With bodies moving a little each frame this costs O(n + swaps + pairs) rather
+	// than testing everything that overlaps along one axis. Swaps grow with how crowded each axis projection is,
+	// so for large, evenly spread crowds SpatialHashGrid is usually the faster choice.
+	//
+	// Adding many bodies at once falls back to a full sort and one sweep to rebuild the pair set.
+	class SweepAndPrune {
+	public:
+		using Handle = uint32_t;
+
+		Handle add(const AABB& bounds);
+		Handle add(const Sphere& sphere) { return add(BoundingBox(sphere)); }
+		void remove(Handle body);
+
+		void update(Handle body, const AABB& bounds);
+		void update(Handle body, const Sphere& sphere) { update(body, BoundingBox(sphere)); }
+
+		size_t size() const { return endpoints[0].size() / 2; }
+
+		// Replaces the contents of pairs with every overlapping pair of bodies. Reuses pairs' capacity, so
+		// steady-state frames don't allocate.
+		void find_pairs(vector<OverlapPair>& pairs);
+
+	private:
+		struct Bounds {
+			float lo[3], hi[3];
+		};
+
+		// Body handle << 1 | 1 for a max endpoint
+		struct Endpoint {
+			float value;
+			uint32_t tag;
+		};
+
+		// Open-addressed map from a pair's key to its index in pair_list, so pairs come and go in O(1)
+		class PairIndex {
+		public:
+			uint32_t* find(uint64_t key);
+			void insert(uint64_t key, uint32_t index);
+			void erase(uint64_t key);
+			void clear();
+
+		private:
+			static constexpr uint64_t Empty = ~uint64_t(0);
+
+			struct Slot {
+				uint64_t key;
+				uint32_t index;
+			};
+
+			size_t home(uint64_t key) const;
+
+			vector<Slot> slots;
+			size_t count = 0;
+		};
+
+		void sort_axis(size_t axis);
+		void rebuild();
+		void add_pair(uint32_t a, uint32_t b);
+		void remove_pair(uint32_t a, uint32_t b);
+
+		vector<Bounds> bounds;
+		vector<uint8_t> alive;
+		vector<Handle> free_handles;
+		vector<Endpoint> endpoints[3];
+
+		vector<OverlapPair> pair_list;
+		PairIndex pair_index;
+
+		// Scratch for rebuild(): open bodies and each body's slot in that list
+		vector<uint32_t> open;
+		vector<uint32_t> open_slot;
+
+		size_t added_since_sort = 0;
+	};
+
+	// Uniform grid hashed into a flat table, rebuilt from scratch every call. Each body goes into every cell
+	// its bounds touch and pairs are tested within a cell; a pair is reported only from the cell holding
+	// the low corner of the two boxes' intersection, so bodies sharing several cells still appear once.
+	// Bodies spanning more than MaxCellsPerBody cells are tested against everything instead.
+	//
+	// Works best with the cell size close to the typical body size; tune_cell_size() picks one.
+	class SpatialHashGrid {
+	public:
+		static constexpr size_t MaxCellsPerBody = 64;
+
+		explicit SpatialHashGrid(float cell_size = 1.0f) : size(cell_size) {}
+
+		float cell_size() const { return size; }
+		void set_cell_size(float cell_size) { size = cell_size; }
+
+		// Mean of the bodies' largest extents, so a typical body touches at most two cells per axis
+		static float tune_cell_size(span<const AABB> bounds);
+
+		// Replaces the contents of pairs with every overlapping pair of bodies, indexed as in the input.
+		// Internal buffers and pairs keep their capacity, so steady-state frames don't allocate.
+		void find_pairs(span<const AABB> bounds, vector<OverlapPair>& pairs);
+		void find_pairs(span<const Sphere> spheres, vector<OverlapPair>& pairs);
+
+	private:
+		struct Bounds {
+			float lo[3], hi[3];
+		};
+
+		struct Entry {
+			int32_t cell[3];
+			uint32_t body;
+		};
+
+		void find_pairs(vector<OverlapPair>& pairs);
+
+		float size;
+		vector<Bounds> boxes;
+		vector<Entry> entries;
+		vector<Entry> by_bucket;
+		vector<uint32_t> bucket_start;
+		vector<uint32_t> oversized;
+		vector<uint8_t> is_oversized;
+	};
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <span>
+
+#include "GeometricPrimitives.h"
+#include "Quaternion.h"
+#include "SoA.h"
+
+namespace Math3D {
+	// IEEE 754 binary16, rounding to nearest even. Overflow goes to infinity, NaNs stay NaN and values below
+	// 2^-14 become subnormals; every half converts to float and back unchanged.
+	constexpr uint16_t to_half(float f) {
+		uint32_t bits = std::bit_cast<uint32_t>(f);
+		uint32_t sign = (bits >> 16) & 0x8000u;
+		uint32_t abs = bits & 0x7FFFFFFFu;
+
+		uint32_t h;
+		if (abs >= 0x47800000u) {
+			h = abs > 0x7F800000u ? 0x7E00u : 0x7C00u;
+		}
+		else if (abs < 0x38800000u) {
+			// Adding 0.5 lines the subnormal's bits up at the bottom of the mantissa, rounded by the FPU
+			h = std::bit_cast<uint32_t>(std::bit_cast<float>(abs) + 0.5f) - 0x3F000000u;
+		}
+		else {
+			// Rebias the exponent and round to nearest even on the 13 dropped bits
+			h = (abs + 0xC8000FFFu + ((abs >> 13) & 1u)) >> 13;
+		}
+		return uint16_t(sign | h);
+	}
+
+	constexpr float from_half(uint16_t h) {
+		constexpr uint32_t ShiftedExponent = 0x7C00u << 13;
+		uint32_t bits = uint32_t(h & 0x7FFFu) << 13;
+		uint32_t exponent = bits & ShiftedExponent;
+		bits += (127u - 15u) << 23;
+
+		float f;
+		if (exponent == ShiftedExponent) {
+			f = std::bit_cast<float>(bits + ((128u - 16u) << 23));
+		}
+		else if (exponent == 0) {
+			// Subnormal: renormalize through the FPU
+			f = std::bit_cast<float>(bits + (1u << 23)) - std::bit_cast<float>(113u << 23);
+		}
+		else {
+			f = std::bit_cast<float>(bits);
+		}
+		return std::bit_cast<float>(std::bit_cast<uint32_t>(f) | (uint32_t(h & 0x8000u) << 16));
+	}
+
+	// Unit vector on the octahedron folded onto a square, 8 * sizeof(T) bits per coordinate. The worst case
+	// angular error is about 6.5e-5 radians for OctNormal32 and 1.7e-2 for OctNormal16; zero vectors come
+	// back as +z.
+	template <class T>
+	struct OctNormal {
+		static constexpr uint32_t Max = (1u << (8 * sizeof(T))) - 1;
+
+		OctNormal() = default;
+		explicit OctNormal(const Vec3f& n);
+
+		Vec3f decode() const;
+
+		T x = 0, y = 0;
+	};
+
+	using OctNormal32 = OctNormal<uint16_t>;
+	using OctNormal16 = OctNormal<uint8_t>;
+
+	// Two halves, for texture coordinates: about three significant digits, exact for multiples of 1/1024
+	// up to 2
+	struct HalfUV {
+		HalfUV() = default;
+		explicit HalfUV(const Vec2f& uv) : u(to_half(uv[0])), v(to_half(uv[1])) {}
+
+		Vec2f decode() const { return Vec2f(from_half(u), from_half(v)); }
+
+		uint16_t u = 0, v = 0;
+	};
+
+	// Position as 16-bit fractions of a box, at most box.halfwidths[k] / 65535 off per axis. Points outside
+	// the box are clamped onto it.
+	struct QuantizedPosition {
+		QuantizedPosition() = default;
+		QuantizedPosition(const Vec3f& p, const AABB& bounds);
+
+		Vec3f decode(const AABB& bounds) const;
+
+		uint16_t x = 0, y = 0, z = 0;
+	};
+
+	// Smallest three: the largest component is dropped and rebuilt from the unit length, its sign folded in
+	// by negating q, and the other three are stored in [-1/sqrt(2), 1/sqrt(2)] with 10 or 15 bits each. The
+	// decoded quaternion may be -q, the same rotation. Worst case component error is about 1.9e-3 for
+	// PackedQuaternion32 and 6.1e-5 for PackedQuaternion48, mostly in the rebuilt component. Expects a unit
+	// quaternion.
+	struct PackedQuaternion32 {
+		PackedQuaternion32() = default;
+		explicit PackedQuaternion32(const Quaternion& q);
+
+		Quaternion decode() const;
+
+		uint32_t bits = 0;
+	};
+
+	struct PackedQuaternion48 {
+		PackedQuaternion48() = default;
+		explicit PackedQuaternion48(const Quaternion& q);
+
+		Quaternion decode() const;
+
+		uint16_t bits[3] = {};
+	};
+
+	// Xformf in 24 bytes instead of 48: float translation, 48-bit rotation and half scale. Goes through
+	// decompose(), so shear is lost and only the diagonal of the stretch is kept.
+	struct PackedTRS {
+		PackedTRS() = default;
+		explicit PackedTRS(const Xformf& xform);
+
+		Xformf decode() const;
+
+		float translation[3] = {};
+		PackedQuaternion48 rotation;
+		uint16_t scale[3] = {};
+	};
+
+	static_assert(sizeof(OctNormal32) == 4 && sizeof(OctNormal16) == 2 && sizeof(HalfUV) == 4);
+	static_assert(sizeof(QuantizedPosition) == 6 && sizeof(PackedQuaternion48) == 6 && sizeof(PackedTRS) == 24);
+
+	// Batch encoders and decoders. Spans must hold at least as many elements as the SoA side, which the
+	// decoders resize to match the input; large batches are split over parallel_for.
+	void encode_normals(const Vec3fSoA& normals, span<OctNormal32> out);
+	void encode_normals(const Vec3fSoA& normals, span<OctNormal16> out);
+	void decode_normals(span<const OctNormal32> in, Vec3fSoA& out);
+	void decode_normals(span<const OctNormal16> in, Vec3fSoA& out);
+
+	void encode_uvs(const Vec2fSoA& uvs, span<HalfUV> out);
+	void decode_uvs(span<const HalfUV> in, Vec2fSoA& out);
+
+	void quantize_positions(const AABB& bounds, const Vec3fSoA& positions, span<QuantizedPosition> out);
+	void dequantize_positions(const AABB& bounds, span<const QuantizedPosition> in, Vec3fSoA& out);
+
+	// Quaternions are AoS on both sides; out must hold in.size() elements
+	void encode_quaternions(span<const Quaternion> in, span<PackedQuaternion32> out);
+	void encode_quaternions(span<const Quaternion> in, span<PackedQuaternion48> out);
+	void decode_quaternions(span<const PackedQuaternion32> in, span<Quaternion> out);
+	void decode_quaternions(span<const PackedQuaternion48> in, span<Quaternion> out);
+
+	void encode_transforms(span<const Xformf> in, span<PackedTRS> out);
+	void decode_transforms(span<const PackedTRS> in, span<Xformf> out);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "Quaternion.h"
+
+namespace Math3D {
+	// Rigid transform as real + dual * epsilon: real is the rotation and dual = real * (translation, 0) / 2.
+	// Products compose in the same order as Xformf, so (a * b).ToXform() is a.ToXform() * b.ToXform().
+	class DualQuaternion {
+	public:
+		DualQuaternion() = default;
+		DualQuaternion(const Quaternion& _real, const Quaternion& _dual) : real(_real), dual(_dual) {}
+		DualQuaternion(const Quaternion& rotation, const Vec3f& translation);
+
+		// Keeps the rotation and translation of decompose(); scale and shear are dropped
+		explicit DualQuaternion(const Xformf& xform);
+
+		DualQuaternion operator*(const DualQuaternion& q) const;
+		DualQuaternion operator*(float f) const { return DualQuaternion(real * f, dual * f); }
+		DualQuaternion operator+(const DualQuaternion& q) const { return DualQuaternion(real + q.real, dual + q.dual); }
+
+		// Divides both parts by |real|, the step after blending
+		DualQuaternion Normalize() const;
+
+		// Conjugates both parts, which inverts a unit dual quaternion
+		DualQuaternion Conjugate() const { return DualQuaternion(real.Conjugate(), dual.Conjugate()); }
+
+		bool nearly_equal(const DualQuaternion& q) const { return real.nearly_equal(q.real) && dual.nearly_equal(q.dual); }
+
+		const Quaternion& Rotation() const { return real; }
+		Vec3f Translation() const;
+		Xformf ToXform() const;
+
+		// As ToXform() applied to a point, and to a direction without the translation
+		Vec3f TransformPoint(const Vec3f& p) const;
+		Vec3f TransformVector(const Vec3f& v) const;
+
+		Quaternion real;
+		Quaternion dual;
+	};
+}
@@ -0,0 +1,217 @@
+#pragma once
+#include <array>
+#include <concepts>
+#include <functional>
+#include <utility>
+
+#include "Matrix.h"
+
+namespace Math3D {
+	// Opt-in lazy evaluation for element-wise Matrix arithmetic.
+	//
+	//   Vec3f r = lazy(a) * s + lazy(b) * t - c;
+	//
+	// lazy(m) wraps a matrix; operators on the wrapper build an expression tree that is evaluated in a single
+	// pass when it is converted back to a Matrix, without the per-operator temporaries of the eager API.
+	// Matrix operands are held by reference, so evaluate an expression before any of its operands go away.
+	namespace expr {
+		template <class E>
+		concept Expression = requires(const E& e, size_t i) {
+			typename E::value_type;
+			{ E::Width } -> convertible_to<size_t>;
+			{ E::Height } -> convertible_to<size_t>;
+			{ e[i] } -> convertible_to<typename E::value_type>;
+		};
+
+		template <class E>
+		using matrix_t = Matrix<typename E::value_type, E::Width, E::Height>;
+
+		template <class E, size_t ... Seq>
+		constexpr matrix_t<E> eval_impl(const E& e, const index_sequence<Seq...>&) {
+			return matrix_t<E>(array<typename E::value_type, sizeof...(Seq)>{ e[Seq] ... });
+		}
+
+		// Small matrices are expanded inline like the eager operators; larger ones use a loop the compiler can vectorize
+		template <Expression E>
+		constexpr matrix_t<E> eval(const E& e) {
+			constexpr size_t N = E::Width * E::Height;
+			if constexpr (N <= 16) {
+				return eval_impl(e, make_index_sequence<N>());
+			}
+			else {
+				array<typename E::value_type, N> out{};
+				for (size_t i = 0; i < N; ++i) {
+					out[i] = e[i];
+				}
+				return matrix_t<E>(out);
+			}
+		}
+
+		// Evaluates straight into out. Every element only reads its own index, so out may be an operand.
+		template <Expression E>
+		constexpr void eval_into(const E& e, matrix_t<E>& out) {
+			if constexpr (E::Width * E::Height <= 16) {
+				out = eval(e);
+			}
+			else {
+				for (size_t i = 0; i < E::Width * E::Height; ++i) {
+					out.arr[i] = e[i];
+				}
+			}
+		}
+
+		// Element type and dimensions, shared by every node
+		template <typename T, size_t W, size_t H>
+		struct Node {
+			using value_type = T;
+			static constexpr size_t Width = W;
+			static constexpr size_t Height = H;
+		};
+
+		template <typename T, size_t W, size_t H>
+		struct Ref : Node<T, W, H> {
+			const Matrix<T, W, H>& m;
+
+			constexpr Ref(const Matrix<T, W, H>& _m) : m(_m) {}
+			constexpr T operator[](size_t i) const { return m.arr[i]; }
+			constexpr operator Matrix<T, W, H>() const { return eval(*this); }
+		};
+
+		template <class L, class R, class Op>
+		struct Binary : Node<typename L::value_type, L::Width, L::Height> {
+			using T = typename L::value_type;
+			static_assert(L::Width == R::Width && L::Height == R::Height);
+
+			L l;
+			R r;
+
+			constexpr Binary(const L& _l, const R& _r) : l(_l), r(_r) {}
+			constexpr T operator[](size_t i) const { return Op()(l[i], r[i]); }
+			constexpr operator Matrix<T, L::Width, L::Height>() const { return eval(*this); }
+		};
+
+		template <class E, class Op>
+		struct Scalar : Node<typename E::value_type, E::Width, E::Height> {
+			using T = typename E::value_type;
+
+			E e;
+			T s;
+
+			constexpr Scalar(const E& _e, const T& _s) : e(_e), s(_s) {}
+			constexpr T operator[](size_t i) const { return Op()(e[i], s); }
+			constexpr operator Matrix<T, E::Width, E::Height>() const { return eval(*this); }
+		};
+
+		// a * s + b, per element
+		template <class A, class B>
+		struct MulAdd : Node<typename A::value_type, A::Width, A::Height> {
+			using T = typename A::value_type;
+			static_assert(A::Width == B::Width && A::Height == B::Height);
+
+			A a;
+			T s;
+			B b;
+
+			constexpr MulAdd(const A& _a, const T& _s, const B& _b) : a(_a), s(_s), b(_b) {}
+			constexpr T operator[](size_t i) const { return a[i] * s + b[i]; }
+			constexpr operator Matrix<T, A::Width, A::Height>() const { return eval(*this); }
+		};
+
+		template <class A, class B>
+		struct Lerp : Node<typename A::value_type, A::Width, A::Height> {
+			using T = typename A::value_type;
+			static_assert(A::Width == B::Width && A::Height == B::Height);
+
+			A a;
+			B b;
+			float t;
+
+			constexpr Lerp(const A& _a, const B& _b, float _t) : a(_a), b(_b), t(_t) {}
+			constexpr T operator[](size_t i) const { return Math3D::lerp(a[i], b[i], t); }
+			constexpr operator Matrix<T, A::Width, A::Height>() const { return eval(*this); }
+		};
+
+		template <typename T, size_t W, size_t H>
+		constexpr Ref<T, W, H> as_expr(const Matrix<T, W, H>& m) { return m; }
+
+		template <Expression E>
+		constexpr const E& as_expr(const E& e) { return e; }
+
+		template <class E>
+		using expr_t = remove_cvref_t<decltype(as_expr(declval<const E&>()))>;
+
+		// A Matrix or an expression
+		template <class E>
+		concept Operand = requires(const E& e) { as_expr(e); };
+
+		// Operators only kick in once one side is already lazy, so Matrix arithmetic stays eager
+		template <class L, class R>
+		concept Operands = Operand<L> && Operand<R> && (Expression<L> || Expression<R>);
+
+		template <class L, class R> requires Operands<L, R>
+		constexpr auto operator+(const L& l, const R& r) {
+			return Binary<expr_t<L>, expr_t<R>, plus<>>(as_expr(l), as_expr(r));
+		}
+
+		template <class L, class R> requires Operands<L, R>
+		constexpr auto operator-(const L& l, const R& r) {
+			return Binary<expr_t<L>, expr_t<R>, minus<>>(as_expr(l), as_expr(r));
+		}
+
+		template <Expression E>
+		constexpr auto operator+(const E& e, const typename E::value_type& s) { return Scalar<E, plus<>>(e, s); }
+
+		template <Expression E>
+		constexpr auto operator-(const E& e, const typename E::value_type& s) { return Scalar<E, minus<>>(e, s); }
+
+		template <Expression E>
+		constexpr auto operator*(const E& e, const typename E::value_type& s) { return Scalar<E, multiplies<>>(e, s); }
+
+		template <Expression E>
+		constexpr auto operator*(const typename E::value_type& s, const E& e) { return Scalar<E, multiplies<>>(e, s); }
+
+		template <Expression E>
+		constexpr auto operator/(const E& e, const typename E::value_type& s) { return Scalar<E, divides<>>(e, s); }
+
+		// Fused forms of the eager Matrix members
+
+		template <Operand A, Operand B>
+		constexpr auto madd(const A& a, const typename expr_t<A>::value_type& s, const B& b) {
+			return MulAdd<expr_t<A>, expr_t<B>>(as_expr(a), s, as_expr(b));
+		}
+
+		template <Operand A, Operand B>
+		constexpr auto lerp(const A& a, const B& b, float t) {
+			return Lerp<expr_t<A>, expr_t<B>>(as_expr(a), as_expr(b), t);
+		}
+
+		// Evaluates e once, accumulating the squared length on the way, then scales the result in place.
+		// Small results go through the eager normalize, which already has SIMD paths.
+		template <Expression E>
+		constexpr matrix_t<E> normalize(const E& e) {
+			if constexpr (E::Width * E::Height <= 16) {
+				return eval(e).normalize();
+			}
+			else {
+				using T = typename E::value_type;
+				array<T, E::Width * E::Height> out{};
+				T len_sq = 0;
+				for (size_t i = 0; i < out.size(); ++i) {
+					out[i] = e[i];
+					len_sq += out[i] * out[i];
+				}
+
+				T inv_len = 1 / cx::sqrt(len_sq);
+				for (auto& v : out) {
+					v *= inv_len;
+				}
+				return matrix_t<E>(out);
+			}
+		}
+	}
+
+	template <typename T, size_t W, size_t H>
+	constexpr expr::Ref<T, W, H> lazy(const Matrix<T, W, H>& m) {
+		return m;
+	}
+}
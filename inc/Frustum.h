@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <span>
+
+#include "GeometricPrimitives.h"
+#include "SoA.h"
+
+namespace Math3D {
+	// Six normalized planes facing inward: HalfSpace3D(p, plane) is the signed distance, positive inside
+	struct Frustum {
+		enum Side { Left, Right, Bottom, Top, Near, Far, Sides };
+
+		Plane planes[Sides];
+	};
+
+	// Gribb-Hartmann extraction for row vectors (clip = p * view_projection), with the left-handed clip
+	// space and [0, 1] depth that perspective() produces
+	Frustum ExtractFrustum(const Mat4f& view_projection);
+
+	// Plane-by-plane tests: conservative, so a box or sphere just off a frustum corner may count as inside
+	bool OverlapFrustumSphere(const Frustum& frustum, const Sphere& sphere);
+	bool OverlapFrustumAABB(const Frustum& frustum, const AABB& box);
+
+	// Words in a visibility bitmask of count objects; object i is bit i % 64 of word i / 64
+	constexpr size_t VisibilityWords(size_t count) { return (count + 63) / 64; }
+
+	// Bytes of plane cache for count objects: one per group of four, the width the kernels test at once
+	constexpr size_t PlaneCacheSize(size_t count) { return (count + 3) / 4; }
+
+	// Batch culling, four objects per SIMD test, writing the same answers as the Overlap functions into a
+	// bitmask of VisibilityWords(count) words. Large batches are split over parallel_for.
+	//
+	// plane_cache is optional. Each byte remembers the plane that last rejected its group and is tried first
+	// next time, so a view that moves a little each frame usually rejects a group with one plane test. Keep
+	// it per view between frames; any starting contents are valid.
+	void CullSpheres(const Frustum& frustum, const SphereSoA& spheres, span<uint64_t> visible, span<uint8_t> plane_cache = {});
+	void CullAABBs(const Frustum& frustum, const AABBSoA& boxes, span<uint64_t> visible, span<uint8_t> plane_cache = {});
+
+	// Several views at once, such as shadow cascades; each chunk of objects is loaded once and tested against
+	// every view while it is in cache. View v writes the VisibilityWords(count) words starting at
+	// v * VisibilityWords(count) and uses the PlaneCacheSize(count) cache bytes starting at v * PlaneCacheSize(count).
+	void CullSpheres(span<const Frustum> frustums, const SphereSoA& spheres, span<uint64_t> visible, span<uint8_t> plane_cache = {});
+	void CullAABBs(span<const Frustum> frustums, const AABBSoA& boxes, span<uint64_t> visible, span<uint8_t> plane_cache = {});
+}
@@ -60,4 +60,23 @@ namespace Math3D {
 	};
 
 	float HalfSpace3D(const Point& lhs, const Plane& rhs);
+
+	// t is the entry distance along ray.dir, 0 when the ray starts inside the box
+	bool RayAABB(const Ray& ray, const AABB& box, float& t);
+
+	// Moller-Trumbore. t is the distance along ray.dir; u and v weight verts[1] and verts[2].
+	// Both windings hit; rays parallel to the triangle miss.
+	bool RayTriangle(const Ray& ray, const Tri3d& tri, float& t, float& u, float& v);
+
+	bool OverlapAABB(const AABB& a, const AABB& b);
+	bool OverlapSphere(const Sphere& a, const Sphere& b);
+	bool OverlapSphereAABB(const Sphere& sphere, const AABB& box);
+
+	AABB BoundingBox(const Sphere& sphere);
+	AABB BoundingBox(const Capsule& capsule);
+
+	Point ClosestPoint(const Segment& segment, const Point& point);
+
+	// Closest pair of points between two segments; degenerate segments are treated as points
+	void ClosestPoints(const Segment& a, const Segment& b, Point& on_a, Point& on_b);
 }
@@ -0,0 +1,146 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#if defined(MATH_ENABLE_INSTRUMENTATION)
+	#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		#include <intrin.h>
+		#define MATH_INSTRUMENT_HAS_TSC
+	#elif defined(__x86_64__) || defined(__i386__)
+		#include <x86intrin.h>
+		#define MATH_INSTRUMENT_HAS_TSC
+	#else
+		#include <chrono>
+	#endif
+#endif
+
+// Call counts and cycle totals for the library's expensive entry points, compiled in with the CMake option
+// MATH_ENABLE_INSTRUMENTATION. When it is off MATH_INSTRUMENT expands to nothing and the query functions
+// report zeros, so callers don't need their own #ifdefs.
+//
+// Each thread records into its own counters; stats() and to_json() sum them on demand. Cycles are TSC
+// reference cycles on x86 and nanoseconds elsewhere, and are inclusive: an inverse that calls a
+// determinant counts towards both.
+namespace Math3D::instrumentation {
+	enum class Counter : uint32_t {
+		MatrixMultiply,            // generic element-by-element product
+		MatrixMultiplySIMD,        // rows of four floats against a Mat4f
+		MatrixDeterminant,         // closed form, up to 4x4
+		MatrixDeterminantGeneric,  // Gauss-Jordan or cofactor expansion, above 4x4
+		MatrixAdjoint,             // closed form, 3x3 and 4x4
+		MatrixAdjointGeneric,      // cofactor matrix
+		MatrixInverse,             // closed form or SIMD, up to 4x4
+		MatrixInverseGeneric,      // Gauss-Jordan or adjoint, above 4x4
+		QuaternionFromMatrix,
+		QuaternionToMatrix,
+		QuaternionSlerp,
+		Compose,
+		Decompose,
+		TransformPoints,
+		TransformVectors,
+		TransformNormals,
+		ProjectPoints,
+		QuaternionBatch,
+		FrustumCull,
+		ViewSpace,
+		Skinning,
+		Mesh,
+		Compression,
+		Animation,
+		Count
+	};
+
+	struct Stats {
+		uint64_t calls = 0;
+		uint64_t cycles = 0;
+	};
+
+#if defined(MATH_ENABLE_INSTRUMENTATION)
+	constexpr bool enabled = true;
+#else
+	constexpr bool enabled = false;
+#endif
+
+	const char* name(Counter counter);
+
+	// Totals over every thread that has recorded, including threads that have since exited
+	Stats stats(Counter counter);
+
+	// Counts recorded by other threads while this runs may land on either side of the reset
+	void reset();
+
+	// {"enabled": bool, "counters": {"MatrixInverse": {"calls": n, "cycles": n}, ...}}
+	std::string to_json();
+	bool dump_json(const char* path);
+
+#if defined(MATH_ENABLE_INSTRUMENTATION)
+	inline uint64_t timestamp() {
+	#if defined(MATH_INSTRUMENT_HAS_TSC)
+		return __rdtsc();
+	#else
+		return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	#endif
+	}
+
+	// Only the owning thread writes the counts, so plain relaxed loads and stores suffice; they're atomic
+	// so that stats() can read them from another thread. reset() never writes them: it records the counts
+	// as a baseline, under the registry lock, which stats() subtracts.
+	struct ThreadCounters {
+		struct Slot {
+			std::atomic<uint64_t> calls { 0 };
+			std::atomic<uint64_t> cycles { 0 };
+			uint64_t reset_calls = 0, reset_cycles = 0;
+		};
+
+		ThreadCounters();
+		~ThreadCounters();
+
+		Slot slots[size_t(Counter::Count)];
+	};
+
+	inline thread_local ThreadCounters thread_counters;
+
+	inline void record(Counter counter, uint64_t cycles) {
+		ThreadCounters::Slot& slot = thread_counters.slots[size_t(counter)];
+		slot.calls.store(slot.calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		slot.cycles.store(slot.cycles.load(std::memory_order_relaxed) + cycles, std::memory_order_relaxed);
+	}
+
+	// Literal type so it can sit in constexpr functions; it records nothing during constant evaluation
+	class ScopedTimer {
+	public:
+		constexpr explicit ScopedTimer(Counter counter) : counter(counter) {
+			if !consteval {
+				start = timestamp();
+			}
+		}
+
+		constexpr ~ScopedTimer() {
+			if !consteval {
+				record(counter, timestamp() - start);
+			}
+		}
+
+		ScopedTimer(const ScopedTimer&) = delete;
+		ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+	private:
+		Counter counter;
+		uint64_t start = 0;
+	};
+#endif
+}
+
+// Times the rest of the enclosing scope against a Counter; the _SELECT form picks one of two by a
+// compile-time condition
+#if defined(MATH_ENABLE_INSTRUMENTATION)
+	#define MATH_INSTRUMENT(counter) \
+		::Math3D::instrumentation::ScopedTimer math_instrument_timer_(::Math3D::instrumentation::Counter::counter)
+	#define MATH_INSTRUMENT_SELECT(condition, counter, otherwise) \
+		::Math3D::instrumentation::ScopedTimer math_instrument_timer_((condition) \
+			? ::Math3D::instrumentation::Counter::counter : ::Math3D::instrumentation::Counter::otherwise)
+#else
+	#define MATH_INSTRUMENT(counter) static_cast<void>(0)
+	#define MATH_INSTRUMENT_SELECT(condition, counter, otherwise) static_cast<void>(0)
+#endif
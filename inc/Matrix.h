@@ -4,8 +4,11 @@
 #include <type_traits>
 #include <utility>
 #include <cmath>
+#include <optional>
 
 #include "3DMath.h"
+#include "Instrumentation.h"
+#include "SIMD.h"
 
 namespace Math3D {
 	using namespace std;
@@ -13,13 +16,27 @@ namespace Math3D {
 	template <typename T, size_t W, size_t H>
 	struct Matrix;
 
+	// float matrices whose storage is a whole number of float4 lanes run through the SIMD kernels
+	template <typename T, size_t W, size_t H>
+	constexpr bool is_simd_matrix = is_same_v<T, float> && (W * H) % 4 == 0;
+
+	template <typename T, size_t W, size_t H>
+	constexpr size_t matrix_alignment = is_simd_matrix<T, W, H> ? 16 : alignof(T);
+
+	// What the linear part of an Xformf is known to be, for affine_inverse
+	enum class AffineKind {
+		General,      // any invertible 3x3
+		UniformScale, // rotation times a uniform scale
+		Rigid,        // pure rotation
+	};
+
 	template<class T, class ... ArgTypes>
 	concept Assignable = requires() {
 		conjunction_v<is_assignable<T, ArgTypes>...> && sizeof...(ArgTypes) > 1;
 	};
 
 	template <typename T, size_t W, size_t H>
-	struct Matrix {
+	struct alignas(matrix_alignment<T, W, H>) Matrix {
 		using this_t = Matrix<T, W, H>;
 		using row_t  = Matrix<T, W, 1>;
 		using col_t  = Matrix<T, 1, H>;
@@ -38,9 +55,10 @@ namespace Math3D {
 			return this_t(std::array<T, N>{ ((Seq / W == Seq % W) ? (1) : (0))... });
 		}
 
-		Matrix() requires(is_same_v<this_t, Matrix<float, 3, 4>>);
+		// Xforms start out as the identity, everything else as zeros
+		constexpr Matrix() requires(W == 3 && H == 4 && is_floating_point_v<T>) : arr(identity_impl(Seq_Data).arr) {}
 
-		Matrix() : arr{0} {}
+		constexpr Matrix() : arr{} {}
 
 		Matrix(const T& val) {arr.fill(val); }
 
@@ -49,13 +67,54 @@ namespace Math3D {
 		template <typename ... ArgTypes>
 		constexpr Matrix(ArgTypes ... args) requires (Assignable<T, ArgTypes...>): arr{args...} { static_assert(sizeof...(args) <= N); }
 		constexpr Matrix(const array<T, N>& _arr) : arr(_arr) {}
-		constexpr this_t& operator= (const this_t& val) { arr = val.arr; return *this; }
+
+		// Element-wise conversion between precisions, as in Xformf(world) for an Xformd
+		template <typename U>
+		constexpr explicit Matrix(const Matrix<U, W, H>& m) requires (!is_same_v<T, U>) : arr(convert_impl(m.arr, Seq_Data)) {}
+		constexpr this_t& operator= (const this_t& val) = default;
 		constexpr bool operator==(const this_t& val) const { return arr == val.arr; }
-		constexpr conditional_t<H == 1, T, row_t>& operator[](size_t i) { return vec[i]; }
-		constexpr conditional_t<H == 1, T, row_t> operator[](size_t i) const { return vec[i]; }
-		constexpr this_t operator+(const T& val) const { return scalar_add_impl(val, Seq_Data); }
-		constexpr this_t operator*(const T& val) const { return scalar_mul_impl(val, Seq_Data); }
-		constexpr this_t operator/(const T& val) const { return scalar_div_impl(val, Seq_Data); }
+		constexpr conditional_t<H == 1, T, row_t>& operator[](size_t i) {
+			if constexpr (H == 1) return arr[i];
+			else return vec[i];
+		}
+		constexpr conditional_t<H == 1, T, row_t> operator[](size_t i) const {
+			// arr is the member the constructors initialize, and the only one constant evaluation may read
+			if constexpr (H == 1) {
+				return arr[i];
+			}
+			else {
+				if consteval {
+					return row_impl(i, Seq_Row);
+				}
+				return vec[i];
+			}
+		}
+		constexpr this_t operator+(const T& val) const {
+			if !consteval {
+				if constexpr (is_simd_matrix<T, W, H>) {
+					return simd_elementwise(val, simd::add);
+				}
+			}
+			return scalar_add_impl(val, Seq_Data);
+		}
+
+		constexpr this_t operator*(const T& val) const {
+			if !consteval {
+				if constexpr (is_simd_matrix<T, W, H>) {
+					return simd_elementwise(val, simd::mul);
+				}
+			}
+			return scalar_mul_impl(val, Seq_Data);
+		}
+
+		constexpr this_t operator/(const T& val) const {
+			if !consteval {
+				if constexpr (is_simd_matrix<T, W, H>) {
+					return simd_elementwise(val, simd::div);
+				}
+			}
+			return scalar_div_impl(val, Seq_Data);
+		}
 
 		constexpr bool nearly_equal(const this_t& rhs) const {
 			return nearly_equal_impl(rhs, Seq_Data);
@@ -79,15 +138,33 @@ namespace Math3D {
 		}
 
 		constexpr this_t operator+(const this_t& val) const {
+			if !consteval {
+				if constexpr (is_simd_matrix<T, W, H>) {
+					return simd_elementwise(val, simd::add);
+				}
+			}
 			return vector_add_impl(val, Seq_Data);
 		}
 
 		constexpr this_t operator-(const this_t& val) const {
+			if !consteval {
+				if constexpr (is_simd_matrix<T, W, H>) {
+					return simd_elementwise(val, simd::sub);
+				}
+			}
 			return vector_sub_impl(val, Seq_Data);
 		}
 
 		// Special case for Xformf * Xformf: treat as 4x4 with implied 4th column (0,0,0,1)
 		constexpr Matrix<T, 3, 4> operator*(const Matrix<T, 3, 4>& val) const requires (W == 3 && H == 4) {
+			if !consteval {
+				if constexpr (is_same_v<T, float>) {
+					array<T, 12> out;
+					simd::mul_xform_xform(arr.data(), val.arr.data(), out.data());
+					return Matrix<T, 3, 4>(out);
+				}
+			}
+
 			return Matrix<T, 3, 4> {
 				data[0][0] * val.data[0][0] + data[0][1] * val.data[1][0] + data[0][2] * val.data[2][0],
 				data[0][0] * val.data[0][1] + data[0][1] * val.data[1][1] + data[0][2] * val.data[2][1],
@@ -105,6 +182,14 @@ namespace Math3D {
 		}
 
 		constexpr Matrix<T, 4, 4> operator*(const Matrix<T, 4, 4>& val) const requires (W == 3 && H == 4) {
+			if !consteval {
+				if constexpr (is_same_v<T, float>) {
+					array<T, 16> out;
+					simd::mul_xform_mat4(arr.data(), val.arr.data(), out.data());
+					return Matrix<T, 4, 4>(out);
+				}
+			}
+
 			return Matrix<T, 4, 4> {
 				data[0][0] * val.data[0][0] + data[0][1] * val.data[1][0] + data[0][2] * val.data[2][0],
 				data[0][0] * val.data[0][1] + data[0][1] * val.data[1][1] + data[0][2] * val.data[2][1],
@@ -128,7 +213,19 @@ namespace Math3D {
 		template <class _T, size_t _W, size_t _H>
 		constexpr Matrix<T, _W, H> operator*(const Matrix<_T, _W, _H>& val) const /*requires (W == _W && H == _H)*/ {
 			static_assert(W == _H);
-			return matrix_mul_impl(val, Seq_Row);
+
+			if !consteval {
+				// Rows of four floats against a Mat4f, e.g. Vec4f * Mat4f and Mat4f * Mat4f
+				if constexpr (is_same_v<T, float> && is_same_v<_T, float> && W == 4 && _W == 4) {
+					MATH_INSTRUMENT(MatrixMultiplySIMD);
+					array<T, 4 * H> out;
+					simd::mul_rows_mat4(arr.data(), H, val.arr.data(), out.data());
+					return Matrix<T, _W, H>(out);
+				}
+			}
+
+			MATH_INSTRUMENT(MatrixMultiply);
+			return matrix_mul_impl(val, make_index_sequence<_W * H>());
 		}
 
 		this_t operator+=(const this_t& val) {
@@ -140,6 +237,13 @@ namespace Math3D {
 		template <class _T, size_t _W, size_t _H>
 		constexpr T dot(const Matrix<_T, _W, _H>& val) const {
 			static_assert(N == Matrix<_T, _W, _H>::N);
+
+			if !consteval {
+				if constexpr (is_same_v<T, float> && is_same_v<_T, float> && N == 4) {
+					return simd::dot(simd::load(arr.data()), simd::load(val.arr.data()));
+				}
+			}
+
 			return inner_product_impl(val, Seq_Data);
 		}
 
@@ -165,9 +269,9 @@ namespace Math3D {
 
 		constexpr this_t cross(const this_t& val) const requires (is_same_v<this_t, Matrix<T, 3, 1>>) {
 			return row_t(
-				vec[1] * val[2] - vec[2] * val[1],
-				vec[2] * val[0] - vec[0] * val[2],
-				vec[0] * val[1] - vec[1] * val[0]
+				arr[1] * val.arr[2] - arr[2] * val.arr[1],
+				arr[2] * val.arr[0] - arr[0] * val.arr[2],
+				arr[0] * val.arr[1] - arr[1] * val.arr[0]
 			);
 		}
 
@@ -178,12 +282,33 @@ namespace Math3D {
 			else if constexpr (W == 2) {
 				return data[0][0] * data[1][1] - data[0][1] * data[1][0];
 			} 
+			else if constexpr (W == 3 || W == 4) {
+				MATH_INSTRUMENT(MatrixDeterminant);
+				T det{};
+				adjugate_impl(det);
+				return det;
+			}
+			else if constexpr (is_floating_point_v<T>) {
+				MATH_INSTRUMENT(MatrixDeterminantGeneric);
+				T det{};
+				gauss_jordan_impl(det, false);
+				return det;
+			}
 			else {
+				MATH_INSTRUMENT(MatrixDeterminantGeneric);
 				return determinant_impl(Seq_Row, make_adjoint_sign_sequence(Seq_Row));
 			}
 		}
 
-		constexpr Matrix<T, H, W> transpose() {
+		constexpr Matrix<T, H, W> transpose() const {
+			if !consteval {
+				if constexpr (is_same_v<T, float> && W == 4 && H == 4) {
+					array<T, 16> out;
+					simd::transpose_mat4(arr.data(), out.data());
+					return Matrix<T, H, W>(out);
+				}
+			}
+
 			return transpose_impl(Seq_Row);
 		}
 
@@ -200,14 +325,70 @@ namespace Math3D {
 		}
 
 		constexpr this_t adjoint() const {
-			return adjoint_impl(Seq_Data, make_adjoint_sign_sequence(Seq_Data));
+			if constexpr (W == H && (W == 3 || W == 4)) {
+				MATH_INSTRUMENT(MatrixAdjoint);
+				T det{};
+				return adjugate_impl(det);
+			}
+			else {
+				MATH_INSTRUMENT(MatrixAdjointGeneric);
+				return adjoint_impl(Seq_Data, make_adjoint_sign_sequence(Seq_Data));
+			}
 		}
 
-		constexpr this_t inverse() const {
-			T det = determinant();
+		constexpr this_t inverse() const requires (W == H) {
+			MATH_INSTRUMENT_SELECT(W <= 4, MatrixInverse, MatrixInverseGeneric);
+			T det{};
+			this_t inv = inverse_impl(det);
 			assert(det != 0);
 
-			return adjoint() * (1 / det);
+			return inv;
+		}
+
+		// Empty when the matrix is singular to working precision: |det| at most Epsilon<T> times the product
+		// of the row lengths, the largest |det| rows of those lengths can have, so the test doesn't depend
+		// on the matrix's scale. Integer matrices are singular only at det == 0.
+		constexpr optional<this_t> try_inverse() const requires (W == H) {
+			MATH_INSTRUMENT_SELECT(W <= 4, MatrixInverse, MatrixInverseGeneric);
+			T det{};
+			this_t inv = inverse_impl(det);
+			if (near_singular(det)) {
+				return nullopt;
+			}
+
+			return inv;
+		}
+
+		// Inverse of an Xformf as a 4x4 with implied last column (0,0,0,1): the linear part is inverted
+		// according to Kind and the translation becomes -t * L^-1
+		template <AffineKind Kind = AffineKind::General>
+		constexpr this_t affine_inverse() const requires (W == 3 && H == 4) {
+			const auto& a = arr;
+			array<T, 9> inv;
+
+			if constexpr (Kind == AffineKind::Rigid) {
+				inv = { a[0], a[3], a[6], a[1], a[4], a[7], a[2], a[5], a[8] };
+			}
+			else if constexpr (Kind == AffineKind::UniformScale) {
+				T inv_sq = 1 / (a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+				inv = {
+					a[0] * inv_sq, a[3] * inv_sq, a[6] * inv_sq,
+					a[1] * inv_sq, a[4] * inv_sq, a[7] * inv_sq,
+					a[2] * inv_sq, a[5] * inv_sq, a[8] * inv_sq,
+				};
+			}
+			else {
+				inv = Matrix<T, 3, 3>(array<T, 9>{ a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8] }).inverse().arr;
+			}
+
+			return this_t(array<T, N>{
+				inv[0], inv[1], inv[2],
+				inv[3], inv[4], inv[5],
+				inv[6], inv[7], inv[8],
+				-(a[9] * inv[0] + a[10] * inv[3] + a[11] * inv[6]),
+				-(a[9] * inv[1] + a[10] * inv[4] + a[11] * inv[7]),
+				-(a[9] * inv[2] + a[10] * inv[5] + a[11] * inv[8]),
+			});
 		}
 
 		template <size_t ... Args>
@@ -223,6 +404,16 @@ namespace Math3D {
 		};
 
 	private:
+		template <size_t ... Seq>
+		constexpr row_t row_impl(size_t i, const index_sequence<Seq...>&) const {
+			return row_t(array<T, W>{ arr[i * W + Seq] ... });
+		}
+
+		template <typename U, size_t ... Seq>
+		static constexpr array<T, N> convert_impl(const array<U, N>& from, const index_sequence<Seq...>&) {
+			return { T(from[Seq]) ... };
+		}
+
 		template <size_t ... Seq>
 		constexpr this_t scalar_add_impl(const T& val, const index_sequence<Seq...>& = Seq_Data) const {
 			return {(arr[Seq] + val) ...};
@@ -254,16 +445,29 @@ namespace Math3D {
 			return (0 + ... + (arr[Seq] * val.arr[Seq]));
 		}
 
+		// Seq spans the result's data; each cell is row Seq / _W of this against column Seq % _W of val
 		template <class _T, size_t _W, size_t _H, size_t ... Seq>
 		constexpr Matrix<T, _W, H> matrix_mul_impl(const Matrix<_T, _W, _H>& val, const index_sequence<Seq...>&) const {
-			Matrix<T, _W, H> out;
-			((out[Seq] = matrix_mul_impl_inner(val, Seq, Seq_Col)), ...);
-			return out;
+			return Matrix<T, _W, H>(array<T, _W * H>{ matrix_mul_impl_inner(val, Seq / _W, Seq % _W, Seq_Row) ... });
 		}
 
 		template <class _T, size_t _W, size_t _H, size_t ... Seq>
-		constexpr Matrix<T, _W, 1> matrix_mul_impl_inner(const Matrix<_T, _W, _H>& val, size_t i, const index_sequence<Seq...>&) const {
-			return Matrix<T, _W, 1>(row(i).dot(val.col(Seq)) ...);
+		constexpr T matrix_mul_impl_inner(const Matrix<_T, _W, _H>& val, size_t i, size_t j, const index_sequence<Seq...>&) const {
+			return (0 + ... + (arr[i * W + Seq] * val.arr[Seq * _W + j]));
+		}
+
+		template <class Op>
+		this_t simd_elementwise(const this_t& val, Op op) const {
+			array<T, N> out;
+			simd::elementwise(arr.data(), val.arr.data(), out.data(), N, op);
+			return this_t(out);
+		}
+
+		template <class Op>
+		this_t simd_elementwise(const T& val, Op op) const {
+			array<T, N> out;
+			simd::elementwise(arr.data(), val, out.data(), N, op);
+			return this_t(out);
 		}
 
 		template <size_t ... Seq>
@@ -288,7 +492,7 @@ namespace Math3D {
 
 		template <size_t ... Seq>
 		constexpr T magnitude_impl(const index_sequence<Seq...>&) const {
-			return std::sqrt((0 + ... + static_cast<T>(arr[Seq] * arr[Seq])));
+			return cx::sqrt((0 + ... + static_cast<T>(arr[Seq] * arr[Seq])));
 		}
 
 		template <size_t ... Seq>
@@ -343,6 +547,162 @@ namespace Math3D {
 			return Matrix<T, H, 1>(data[Seq][i] ...);
 		}
 
+		constexpr bool near_singular(T det) const requires (W == H) {
+			if constexpr (is_floating_point_v<T>) {
+				T bound = 1;
+				for (size_t r = 0; r < H; ++r) {
+					T length_sq = 0;
+					for (size_t c = 0; c < W; ++c) {
+						length_sq += arr[r * W + c] * arr[r * W + c];
+					}
+					bound *= cx::sqrt(length_sq);
+				}
+				return cx::abs(det) <= Epsilon<T> * bound;
+			}
+			else {
+				return det == 0;
+			}
+		}
+
+		// Unspecified result when det is zero; never divides by zero so it stays usable in constant expressions
+		constexpr this_t inverse_impl(T& det) const {
+			if constexpr (W == 4 && is_same_v<T, float>) {
+				if !consteval {
+					array<T, 16> out;
+					det = simd::inverse_mat4(arr.data(), out.data());
+					return this_t(out);
+				}
+			}
+
+			if constexpr (W == 3 || W == 4) {
+				this_t adj = adjugate_impl(det);
+				return det == 0 ? adj : adj * (1 / det);
+			}
+			else if constexpr (W > 4 && is_floating_point_v<T>) {
+				return gauss_jordan_impl(det, true);
+			}
+			else {
+				det = determinant();
+				return det == 0 ? *this : adjoint() * (1 / det);
+			}
+		}
+
+		// Closed form adjugate, with the determinant as a by-product
+		constexpr this_t adjugate_impl(T& det) const requires (W == 3 && H == 3) {
+			const auto& a = arr;
+			T c0 = a[4] * a[8] - a[5] * a[7];
+			T c1 = a[5] * a[6] - a[3] * a[8];
+			T c2 = a[3] * a[7] - a[4] * a[6];
+			det = a[0] * c0 + a[1] * c1 + a[2] * c2;
+
+			return this_t(array<T, N>{
+				c0, a[2] * a[7] - a[1] * a[8], a[1] * a[5] - a[2] * a[4],
+				c1, a[0] * a[8] - a[2] * a[6], a[2] * a[3] - a[0] * a[5],
+				c2, a[1] * a[6] - a[0] * a[7], a[0] * a[4] - a[1] * a[3],
+			});
+		}
+
+		// Laplace expansion over the top and bottom row pairs, sharing the 2x2 sub-determinants
+		constexpr this_t adjugate_impl(T& det) const requires (W == 4 && H == 4) {
+			const auto& a = arr;
+			T s0 = a[0] * a[5] - a[4] * a[1];
+			T s1 = a[0] * a[6] - a[4] * a[2];
+			T s2 = a[0] * a[7] - a[4] * a[3];
+			T s3 = a[1] * a[6] - a[5] * a[2];
+			T s4 = a[1] * a[7] - a[5] * a[3];
+			T s5 = a[2] * a[7] - a[6] * a[3];
+
+			T c5 = a[10] * a[15] - a[14] * a[11];
+			T c4 = a[9] * a[15] - a[13] * a[11];
+			T c3 = a[9] * a[14] - a[13] * a[10];
+			T c2 = a[8] * a[15] - a[12] * a[11];
+			T c1 = a[8] * a[14] - a[12] * a[10];
+			T c0 = a[8] * a[13] - a[12] * a[9];
+
+			det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+
+			return this_t(array<T, N>{
+				a[5] * c5 - a[6] * c4 + a[7] * c3,
+				-a[1] * c5 + a[2] * c4 - a[3] * c3,
+				a[13] * s5 - a[14] * s4 + a[15] * s3,
+				-a[9] * s5 + a[10] * s4 - a[11] * s3,
+
+				-a[4] * c5 + a[6] * c2 - a[7] * c1,
+				a[0] * c5 - a[2] * c2 + a[3] * c1,
+				-a[12] * s5 + a[14] * s2 - a[15] * s1,
+				a[8] * s5 - a[10] * s2 + a[11] * s1,
+
+				a[4] * c4 - a[5] * c2 + a[7] * c0,
+				-a[0] * c4 + a[1] * c2 - a[3] * c0,
+				a[12] * s4 - a[13] * s2 + a[15] * s0,
+				-a[8] * s4 + a[9] * s2 - a[11] * s0,
+
+				-a[4] * c3 + a[5] * c1 - a[6] * c0,
+				a[0] * c3 - a[1] * c1 + a[2] * c0,
+				-a[12] * s3 + a[13] * s1 - a[14] * s0,
+				a[8] * s3 - a[9] * s1 + a[10] * s0,
+			});
+		}
+
+		// Gauss-Jordan elimination with partial pivoting. Returns the inverse when track_inverse is set;
+		// det is zero as soon as a pivot column is all zeros.
+		constexpr this_t gauss_jordan_impl(T& det, bool track_inverse) const requires (W == H) {
+			array<T, N> a = arr;
+			array<T, N> inv = identity().arr;
+			auto magnitude = [](T v) { return v < 0 ? -v : v; };
+
+			det = 1;
+			for (size_t c = 0; c < W; ++c) {
+				size_t pivot = c;
+				for (size_t r = c + 1; r < W; ++r) {
+					if (magnitude(a[r * W + c]) > magnitude(a[pivot * W + c])) {
+						pivot = r;
+					}
+				}
+
+				if (a[pivot * W + c] == 0) {
+					det = 0;
+					return *this;
+				}
+
+				if (pivot != c) {
+					for (size_t k = 0; k < W; ++k) {
+						swap(a[pivot * W + k], a[c * W + k]);
+						swap(inv[pivot * W + k], inv[c * W + k]);
+					}
+					det = -det;
+				}
+
+				T p = a[c * W + c];
+				det *= p;
+
+				T rp = 1 / p;
+				for (size_t k = c; k < W; ++k) {
+					a[c * W + k] *= rp;
+				}
+				for (size_t k = 0; k < W && track_inverse; ++k) {
+					inv[c * W + k] *= rp;
+				}
+
+				// Determinant only needs the rows below the pivot eliminated
+				for (size_t r = track_inverse ? 0 : c + 1; r < W; ++r) {
+					T f = a[r * W + c];
+					if (r == c || f == 0) {
+						continue;
+					}
+
+					for (size_t k = c; k < W; ++k) {
+						a[r * W + k] -= f * a[c * W + k];
+					}
+					for (size_t k = 0; k < W && track_inverse; ++k) {
+						inv[r * W + k] -= f * inv[c * W + k];
+					}
+				}
+			}
+
+			return this_t(inv);
+		}
+
 		template <size_t... Is>
 		static constexpr auto make_adjoint_sign_sequence(index_sequence<Is...>) {
 			return integer_sequence<int, ((Is % W + Is / W) % 2 ? -1 : 1)...>{};
@@ -379,8 +739,15 @@ namespace Math3D {
 	using Mat4f = Matrix<float, 4, 4>;
 	using Xformf = Matrix<float, 3, 4>;
 
+	// Double precision for large-world positions; see Transforms.h for the builders and to_view_space
+	using Vec2d = Vec<double, 2>;
+	using Vec3d = Vec<double, 3>;
+	using Vec4d = Vec<double, 4>;
+	using Mat3d = Matrix<double, 3, 3>;
+	using Mat4d = Matrix<double, 4, 4>;
+	using Xformd = Matrix<double, 3, 4>;
+
 	constexpr const Xformf Identity = Xformf::identity();
+	constexpr const Xformd Identityd = Xformd::identity();
 
-	template <typename T, size_t W, size_t H>
-	Matrix<T, W, H>::Matrix() requires(is_same_v<this_t, Matrix<float, 3, 4>>) {*this = Identity;}
 }
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <span>
+
+#include "GeometricPrimitives.h"
+#include "SoA.h"
+
+namespace Math3D {
+	// Indexed triangle lists: triangle t is the vertices indices[3t], indices[3t + 1] and indices[3t + 2],
+	// and its normal is cross(p1 - p0, p2 - p0) for those positions in order.
+
+	// The triangles around each vertex in compressed rows: vertex v is used by triangles[offsets[v]] up to
+	// triangles[offsets[v + 1]], in ascending order. The per-vertex sums below follow that order, so their
+	// results don't depend on the thread count. Build it once to share between vertex_normals and
+	// vertex_tangents; it stays valid until the indices change.
+	struct VertexTriangles {
+		void build(span<const uint32_t> indices, size_t vertex_count);
+
+		size_t vertex_count() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+		span<const uint32_t> around(size_t vertex) const {
+			return span<const uint32_t>(triangles).subspan(offsets[vertex], offsets[vertex + 1] - offsets[vertex]);
+		}
+
+		aligned_vector<uint32_t> offsets;
+		aligned_vector<uint32_t> triangles;
+	};
+
+	// Bulk mesh kernels, four triangles or vertices per SIMD pass and large meshes split over parallel_for.
+	// Outputs are resized to the triangle or vertex count.
+
+	// Unit normal of each triangle, zero for degenerate ones
+	void face_normals(const Vec3fSoA& positions, span<const uint32_t> indices, Vec3fSoA& out_normals);
+
+	// Sum of the normals of the triangles around each vertex weighted by their area, normalized. Vertices
+	// no triangle uses get a zero normal.
+	void vertex_normals(const Vec3fSoA& positions, span<const uint32_t> indices, Vec3fSoA& out_normals);
+	void vertex_normals(const Vec3fSoA& positions, span<const uint32_t> indices, const VertexTriangles& adjacency, Vec3fSoA& out_normals);
+
+	// Tangent frames in the MikkTSpace convention: xyz is the unit tangent along +u, made orthogonal to
+	// mesh.norm, and w is the handedness, so the bitangent is w * cross(norm, tangent). Each triangle's
+	// uv-derived directions are weighted by its area; triangles with degenerate uvs are skipped, and a vertex
+	// left without a tangent gets an arbitrary one perpendicular to its normal. Vertices are not split at
+	// mirrored seams, so it matches MikkTSpace on meshes that are already split there.
+	void vertex_tangents(const Vert3dSoA& mesh, span<const uint32_t> indices, Vec4fSoA& out_tangents);
+	void vertex_tangents(const Vert3dSoA& mesh, span<const uint32_t> indices, const VertexTriangles& adjacency, Vec4fSoA& out_tangents);
+
+	// Tightest box around the points; zero sized at the origin when there are none
+	AABB bounding_box(const Vec3fSoA& positions);
+
+	// EPOS-6: the farthest apart pair of the extreme points along x, y and z seeds the sphere, and Ritter's
+	// pass grows it over every point. Chunks grow from the same seed in parallel and their spheres are merged
+	// in order, so the result is the same on any thread count. Usually within 10% of the minimal radius.
+	Sphere bounding_sphere(const Vec3fSoA& positions);
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <span>
+
+#include "GeometricPrimitives.h"
+
+namespace Math3D {
+	// Convex hull given by its points, which are not copied and must outlive any ConvexShape made from it
+	struct ConvexHull {
+		span<const Point> points;
+	};
+
+	// Farthest point of the shape along dir, which need not be normalized
+	Point Support(const Sphere& sphere, const Vec3f& dir);
+	Point Support(const Capsule& capsule, const Vec3f& dir);
+	Point Support(const Cylinder& cylinder, const Vec3f& dir);
+	Point Support(const AABB& box, const Vec3f& dir);
+	Point Support(const ConvexHull& hull, const Vec3f& dir);
+
+	// Non-owning view of a convex shape for GJK/EPA. Rounded shapes are split into a core and a margin: a sphere
+	// is its center plus its radius and a capsule its axis plus its radius. GJK runs on the cores, which
+	// converges in a few iterations and stays exact for curved surfaces, and the margins are added back after.
+	struct ConvexShape {
+		enum class Kind : uint8_t { Sphere, Capsule, Cylinder, AABB, Hull };
+
+		ConvexShape(const Sphere& sphere) : shape(&sphere), core(&sphere_core), margin(sphere.radius), kind(Kind::Sphere) {}
+		ConvexShape(const Capsule& capsule) : shape(&capsule), core(&capsule_core), margin(capsule.radius), kind(Kind::Capsule) {}
+		ConvexShape(const Cylinder& cylinder) : shape(&cylinder), core(&cylinder_core), margin(0.0f), kind(Kind::Cylinder) {}
+		ConvexShape(const AABB& box) : shape(&box), core(&box_core), margin(0.0f), kind(Kind::AABB) {}
+		ConvexShape(const ConvexHull& hull) : shape(&hull), core(&hull_core), margin(0.0f), kind(Kind::Hull) {}
+
+		Point core_support(const Vec3f& dir) const { return core(shape, dir); }
+
+		const void* shape;
+		Point (*core)(const void* shape, const Vec3f& dir);
+		float margin;
+		Kind kind;
+
+	private:
+		static Point sphere_core(const void* shape, const Vec3f&) { return static_cast<const Sphere*>(shape)->center; }
+		static Point capsule_core(const void* shape, const Vec3f& dir);
+		static Point cylinder_core(const void* shape, const Vec3f& dir) { return Support(*static_cast<const Cylinder*>(shape), dir); }
+		static Point box_core(const void* shape, const Vec3f& dir) { return Support(*static_cast<const AABB*>(shape), dir); }
+		static Point hull_core(const void* shape, const Vec3f& dir) { return Support(*static_cast<const ConvexHull*>(shape), dir); }
+	};
+
+	// The search directions that produced the last GJK simplex for a pair of shapes. Keep one per pair and pass it
+	// back every frame: GJK re-evaluates those directions on the moved shapes and usually starts next to the
+	// answer. A default-constructed cache starts from scratch.
+	struct GJKCache {
+		Vec3f dirs[4];
+		uint32_t count = 0;
+	};
+
+	struct Separation {
+		float distance;
+		Point on_a, on_b;
+	};
+
+	// normal points from a to b; moving b by normal * depth separates the shapes
+	struct Contact {
+		Vec3f normal;
+		float depth;
+		Point on_a, on_b;
+	};
+
+	// GJK distance between separated shapes. Returns false, leaving result alone, when they overlap.
+	bool GJKDistance(const ConvexShape& a, const ConvexShape& b, Separation& result, GJKCache* cache = nullptr);
+
+	// Boolean GJK, stopping as soon as a separating plane or an enclosing simplex is found
+	bool GJKIntersect(const ConvexShape& a, const ConvexShape& b, GJKCache* cache = nullptr);
+
+	// Penetration of overlapping shapes; returns false when they are separated. Sphere, capsule and box pairs
+	// go to the closed forms below. Otherwise GJK runs on the cores: if they are apart the contact comes from
+	// the margins, and if they overlap EPA expands the GJK simplex to find the depth.
+	bool Penetration(const ConvexShape& a, const ConvexShape& b, Contact& contact, GJKCache* cache = nullptr);
+
+	// Closed forms
+	bool Penetration(const Sphere& a, const Sphere& b, Contact& contact);
+	bool Penetration(const Sphere& a, const Capsule& b, Contact& contact);
+	bool Penetration(const Capsule& a, const Capsule& b, Contact& contact);
+	bool Penetration(const AABB& a, const AABB& b, Contact& contact);
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace Math3D {
+	namespace job_detail {
+		// A unit of work in a deque. The job owns whatever it needs and must stay alive until run returns.
+		struct Job {
+			void (*run)(Job*);
+		};
+	}
+
+	// Work-stealing scheduler: thread_count() - 1 workers plus the thread that calls in, each with a
+	// Chase-Lev deque. A thread pushes and pops work at the bottom of its own deque and idle threads steal
+	// from the top of the others', so the largest pieces of a split range are the ones that move. Threads
+	// waiting for their work to finish run other jobs meanwhile, so parallel_for and TaskGroup nest.
+	// Threads from outside the pool borrow a deque while they have a call or task group open; when more
+	// than eight do at once, the others run their work inline rather than wait for one.
+	class JobSystem {
+	public:
+		// threads counts the calling thread; 0 means one per hardware thread
+		explicit JobSystem(size_t threads = 0);
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		size_t thread_count() const;
+
+		// The process-wide system, one thread per hardware thread, started on first use
+		static JobSystem& shared();
+
+		// The system parallel_for and TaskGroup use on this thread: the innermost Scope's, the one whose
+		// worker this is, or shared()
+		static JobSystem& current();
+
+		// Points current() at system on this thread until destroyed
+		class Scope {
+		public:
+			explicit Scope(JobSystem& system);
+			~Scope();
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+			JobSystem* previous;
+		};
+
+		void parallel_for_impl(size_t count, size_t grain, void (*fn)(void*, size_t, size_t), void* ctx);
+
+	private:
+		friend class TaskGroup;
+
+		// Gives this thread a deque in the system if it has none, counting nested calls. False when every
+		// deque for outside threads is taken; the caller then runs its work inline.
+		bool enter();
+		void leave();
+		void submit(job_detail::Job* job);
+		void wait_for(const std::atomic<size_t>& pending);
+
+		struct State;
+		std::unique_ptr<State> state;
+	};
+
+	// Tasks run on a JobSystem and waited for together. run() and wait() are called from one thread, and
+	// groups on that thread may be waited in any order. Destroying a group waits for it. Tasks must not
+	// throw.
+	class TaskGroup {
+	public:
+		explicit TaskGroup(JobSystem& system = JobSystem::current()) : system(system) {}
+		~TaskGroup() { wait(); }
+
+		TaskGroup(const TaskGroup&) = delete;
+		TaskGroup& operator=(const TaskGroup&) = delete;
+
+		template <class Fn>
+		void run(Fn&& fn) {
+			struct Task : job_detail::Job {
+				Task(Fn&& fn, std::atomic<size_t>& pending) : job_detail::Job{ &Task::execute }, fn(std::forward<Fn>(fn)), pending(pending) {}
+
+				static void execute(job_detail::Job* job) {
+					Task* task = static_cast<Task*>(job);
+					std::atomic<size_t>& pending = task->pending;
+					task->fn();
+					delete task;
+					pending.fetch_sub(1, std::memory_order_release);
+				}
+
+				std::decay_t<Fn> fn;
+				std::atomic<size_t>& pending;
+			};
+
+			if (!entered) {
+				seated = system.enter();
+				entered = true;
+			}
+			// Without a deque of its own the group runs its tasks as they come, even once the thread has one
+			// through another group, so wait() never has anything to wait for
+			if (!seated) {
+				fn();
+				return;
+			}
+			pending.fetch_add(1, std::memory_order_relaxed);
+			system.submit(new Task(std::forward<Fn>(fn), pending));
+		}
+
+		// Runs other jobs until every task of the group has finished
+		void wait();
+
+	private:
+		JobSystem& system;
+		bool entered = false, seated = false;
+		std::atomic<size_t> pending { 0 };
+	};
+
+	// Number of threads parallel_for spreads work over on this thread's current() system, including the caller
+	size_t parallel_thread_count();
+
+	// Splits [0, count) into chunks of grain elements and calls fn(begin, end) for each, spread over
+	// system by halving the range and leaving halves to be stolen. The caller takes chunks too and returns
+	// once every chunk is done. Runs inline when there is a single chunk. fn must not throw.
+	// Chunks always start at multiples of grain, whatever the thread count, so with a grain that is a
+	// multiple of four every chunk starts on a SIMD group and only the last one has a scalar tail.
+	template <class Fn>
+	void parallel_for(JobSystem& system, size_t count, size_t grain, Fn&& fn) {
+		if (grain == 0) grain = 1;
+		if (count <= grain) {
+			if (count) fn(size_t(0), count);
+			return;
+		}
+
+		using fn_t = std::remove_reference_t<Fn>;
+		system.parallel_for_impl(count, grain, [](void* ctx, size_t begin, size_t end) {
+			(*static_cast<fn_t*>(ctx))(begin, end);
+		}, const_cast<void*>(static_cast<const void*>(&fn)));
+	}
+
+	// The batch kernels call this one, so a JobSystem::Scope picks the threads they run on
+	template <class Fn>
+	void parallel_for(size_t count, size_t grain, Fn&& fn) {
+		parallel_for(JobSystem::current(), count, grain, std::forward<Fn>(fn));
+	}
+}
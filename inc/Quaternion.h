@@ -1,54 +1,110 @@
 #pragma once
 #include "Matrix.h"
+#include "Trig.h"
 #include <cmath>
 
 namespace Math3D {
 	class Quaternion {
 	public:
 		Quaternion() = default;
-		Quaternion(float _i, float _j, float _k, float _r);
-		Quaternion(const Vec3f& axis, float angle);
-		Quaternion(const Xformf& rot);
+		constexpr Quaternion(float _i, float _j, float _k, float _r) : i(_i), j(_j), k(_k), r(_r) {}
+		// The tag picks the Trig.h policy for the half-angle sincos, as in Quaternion(axis, angle, trig::Fast())
+		template <class Trig = trig::Precise>
+		constexpr Quaternion(const Vec3f& axis, float angle, Trig = {}) : Quaternion(FromAxisAngle<Trig>(axis, angle)) {}
+		constexpr Quaternion(const Xformf& rot) : Quaternion(FromRot(rot)) {}
 
 		~Quaternion() = default;
 
-		bool operator==(const Quaternion& q) const;
+		constexpr bool operator==(const Quaternion& q) const { return i == q.i && j == q.j && k == q.k && r == q.r; }
 		bool nearly_equal(const Quaternion& q) const;
 
-		Quaternion operator*(const Quaternion& q) const;
-		Quaternion operator*(float f) const;
-		Quaternion& operator*= (const Quaternion& q) { *this = *this * q; return *this; }
-		Quaternion& operator*= (float f) { *this = *this * f; return *this; }
+		constexpr Quaternion operator*(const Quaternion& q) const {
+			return Quaternion(
+				r * q.i + i * q.r + j * q.k - k * q.j,
+				r * q.j - i * q.k + j * q.r + k * q.i,
+				r * q.k + i * q.j - j * q.i + k * q.r,
+				r * q.r - i * q.i - j * q.j - k * q.k
+			);
+		}
+		constexpr Quaternion operator*(float f) const { return Quaternion(i * f, j * f, k * f, r * f); }
+		constexpr Quaternion& operator*= (const Quaternion& q) { *this = *this * q; return *this; }
+		constexpr Quaternion& operator*= (float f) { *this = *this * f; return *this; }
 
 		Quaternion operator/(const Quaternion& q) const;
-		Quaternion operator/(float f) const;
+		constexpr Quaternion operator/(float f) const { return Quaternion(i / f, j / f, k / f, r / f); }
 		Quaternion& operator/=(const Quaternion& q);
 		Quaternion& operator/=(float f);
 
-		Quaternion operator+(const Quaternion& q) const;
-		Quaternion operator+(float f) const;
+		constexpr Quaternion operator+(const Quaternion& q) const { return Quaternion(i + q.i, j + q.j, k + q.k, r + q.r); }
+		constexpr Quaternion operator+(float f) const { return Quaternion(i + f, j + f, k + f, r + f); }
 		Quaternion& operator+=(const Quaternion& q);
 		Quaternion& operator+=(float f);
 
-		Quaternion operator-(const Quaternion& q) const;
-		Quaternion operator-(float f) const;
+		constexpr Quaternion operator-(const Quaternion& q) const { return Quaternion(i - q.i, j - q.j, k - q.k, r - q.r); }
+		constexpr Quaternion operator-(float f) const { return Quaternion(i - f, j - f, k - f, r - f); }
 		Quaternion& operator-=(const Quaternion& q);
 		Quaternion& operator-=(float f);
 
-		Xformf ToRot();
-		float Dot(const Quaternion& q) const { return this->vals[0] * q.vals[0] + this->vals[1] * q.vals[1] + this->vals[2] * q.vals[2] + this->vals[3] * q.vals[3]; };
-		float Mag() const { return std::sqrt(this->Dot(*this)); }
-		Quaternion Normalize() const { return (*this) / Mag(); }
-		Quaternion Conjugate() const { return Quaternion(i, -j, -k, -r); }
+		// Inverse of the matrix constructor
+		constexpr Xformf ToRot() const {
+			MATH_INSTRUMENT(QuaternionToMatrix);
+			float ii = i * i, jj = j * j, kk = k * k;
+			float ij = i * j, ik = i * k, jk = j * k;
+			float ir = i * r, jr = j * r, kr = k * r;
+
+			return Xformf {
+				1.0f - 2.0f * (jj + kk), 2.0f * (ij - kr),        2.0f * (ik + jr),
+				2.0f * (ij + kr),        1.0f - 2.0f * (ii + kk), 2.0f * (jk - ir),
+				2.0f * (ik - jr),        2.0f * (jk + ir),        1.0f - 2.0f * (ii + jj),
+				0.0f,                    0.0f,                    0.0f,
+			};
+		}
+
+		constexpr float Dot(const Quaternion& q) const { return i * q.i + j * q.j + k * q.k + r * q.r; }
+		constexpr float Mag() const { return cx::sqrt(Dot(*this)); }
+		constexpr Quaternion Normalize() const { return (*this) / Mag(); }
+		constexpr Quaternion Conjugate() const { return Quaternion(-i, -j, -k, r); }
 		
 		union {
 			float vals[4];
 			struct {float i, j, k, r;};
 			struct {float x, y, z, w;};
 		};
+
+	private:
+		// The constructors delegate here so constant evaluation only ever sees i, j, k, r initialized
+		template <class Trig>
+		static constexpr Quaternion FromAxisAngle(const Vec3f& axis, float angle) {
+			Vec3f n = axis.normalize();
+			float s, c;
+			Trig::sincos(angle * 0.5f, s, c);
+			return Quaternion(n[0] * s, n[1] * s, n[2] * s, c);
+		}
+
+		static constexpr Quaternion FromRot(const Xformf& rot) {
+			MATH_INSTRUMENT(QuaternionFromMatrix);
+			const auto& m = rot.arr;
+			float trace = m[0] + m[4] + m[8];
+			if (trace > 0.0f) {
+				float s = cx::sqrt(trace + 1.0f) * 2.0f;
+				return Quaternion((m[7] - m[5]) / s, (m[2] - m[6]) / s, (m[3] - m[1]) / s, 0.25f * s);
+			}
+			if ((m[0] > m[4]) && (m[0] > m[8])) {
+				float s = cx::sqrt(1.0f + m[0] - m[4] - m[8]) * 2.0f;
+				return Quaternion(0.25f * s, (m[1] + m[3]) / s, (m[2] + m[6]) / s, (m[7] - m[5]) / s);
+			}
+			if (m[4] > m[8]) {
+				float s = cx::sqrt(1.0f + m[4] - m[0] - m[8]) * 2.0f;
+				return Quaternion((m[1] + m[3]) / s, 0.25f * s, (m[5] + m[7]) / s, (m[2] - m[6]) / s);
+			}
+			float s = cx::sqrt(1.0f + m[8] - m[0] - m[4]) * 2.0f;
+			return Quaternion((m[2] + m[6]) / s, (m[5] + m[7]) / s, 0.25f * s, (m[3] - m[1]) / s);
+		}
 	};
 
-	Quaternion Slerp(const Quaternion& A, const Quaternion& b, float t);
+	// a and b must be unit length. Takes the shortest path; falls back to a normalized lerp when a and b are
+	// nearly parallel.
+	Quaternion Slerp(const Quaternion& a, const Quaternion& b, float t);
 	Quaternion operator/(const Quaternion& q, float f);
 	Quaternion operator/(float f, const Quaternion& q);
 }
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+#include <span>
+
+#include "Quaternion.h"
+#include "SoA.h"
+
+namespace Math3D {
+	// Structure-of-arrays batch of quaternions: one aligned stream per component, in (i, j, k, r) order
+	struct QuaternionBatch {
+		using stream_t = aligned_vector<float>;
+
+		QuaternionBatch() = default;
+		explicit QuaternionBatch(size_t count) { resize(count); }
+
+		size_t size() const { return streams[0].size(); }
+		bool empty() const { return streams[0].empty(); }
+
+		void resize(size_t count) { for (auto& s : streams) s.resize(count); }
+		void reserve(size_t count) { for (auto& s : streams) s.reserve(count); }
+		void clear() { for (auto& s : streams) s.clear(); }
+
+		void push_back(const Quaternion& q) {
+			for (size_t c = 0; c < 4; ++c) {
+				streams[c].push_back(q.vals[c]);
+			}
+		}
+
+		Quaternion get(size_t n) const { return Quaternion(streams[0][n], streams[1][n], streams[2][n], streams[3][n]); }
+
+		void set(size_t n, const Quaternion& q) {
+			for (size_t c = 0; c < 4; ++c) {
+				streams[c][n] = q.vals[c];
+			}
+		}
+
+		span<float> i() { return streams[0]; }
+		span<float> j() { return streams[1]; }
+		span<float> k() { return streams[2]; }
+		span<float> r() { return streams[3]; }
+		span<const float> i() const { return streams[0]; }
+		span<const float> j() const { return streams[1]; }
+		span<const float> k() const { return streams[2]; }
+		span<const float> r() const { return streams[3]; }
+
+		array<stream_t, 4> streams;
+	};
+
+	// Batch kernels mirroring the Quaternion members; out is resized to match and may alias an input
+
+	void multiply(const QuaternionBatch& a, const QuaternionBatch& b, QuaternionBatch& out);
+	void conjugate(const QuaternionBatch& a, QuaternionBatch& out);
+	void normalize(const QuaternionBatch& a, QuaternionBatch& out);
+	void dot(const QuaternionBatch& a, const QuaternionBatch& b, span<float> out);
+
+	// Both interpolations take the shortest path, flipping b where a . b < 0
+	void nlerp(const QuaternionBatch& a, const QuaternionBatch& b, float t, QuaternionBatch& out);
+
+	// Polynomial slerp with no acos, sin or division (Eberly, "A Fast and Accurate Algorithm for Computing SLERP").
+	// The weights sin(t theta) / sin(theta) are within 2e-5 of exact for unit inputs.
+	void slerp(const QuaternionBatch& a, const QuaternionBatch& b, float t, QuaternionBatch& out);
+
+	// The same slerp on four quaternions held as (i, j, k, r) component lanes, with a t per lane
+	simd::float4xN<4> slerp4(const simd::float4xN<4>& a, const simd::float4xN<4>& b, simd::float4 t);
+
+	// Quaternion(axis, angle) for each pair, four at a time through the float4 sincos of the Trig policy.
+	// The axes need not be unit length; angles must hold at least axes.size() elements.
+	template <class Trig = trig::Precise>
+	void from_axis_angle(const Vec3fSoA& axes, span<const float> angles, QuaternionBatch& out);
+
+	// Rotation matrices as Quaternion::ToRot, with zero translation. out must hold at least q.size() elements.
+	void to_rot(const QuaternionBatch& q, span<Xformf> out);
+
+	// AoS <-> SoA transposition
+	void to_soa(span<const Quaternion> in, QuaternionBatch& out);
+	void to_aos(const QuaternionBatch& in, span<Quaternion> out);
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <span>
+
+#include "GeometricPrimitives.h"
+#include "SIMD.h"
+
+namespace Math3D {
+	// N rays in structure-of-arrays form, processed as N / 4 groups of simd::float4. Inverse directions are
+	// stored alongside so slab tests never divide. Each lane has its own t_max; unused lanes have
+	// t_max = -inf and never hit, so a partly filled packet needs no separate mask.
+	template <size_t N>
+	struct RayPacket {
+		static_assert(N == 4 || N == 8 || N == 16, "RayPacket is 4, 8 or 16 lanes wide");
+		static constexpr size_t Lanes = N;
+		static constexpr uint32_t AllLanes = uint32_t((uint64_t(1) << N) - 1);
+
+		alignas(64) float origin[3][N];
+		alignas(64) float dir[3][N];
+		alignas(64) float inv_dir[3][N];
+		alignas(64) float t_max[N];
+
+		RayPacket() {
+			for (size_t n = 0; n < N; ++n) clear(n);
+		}
+
+		// Fills the first min(N, rays.size()) lanes; the rest stay unused
+		explicit RayPacket(span<const Ray> rays, float max_t = numeric_limits<float>::infinity()) {
+			for (size_t n = 0; n < N; ++n) {
+				if (n < rays.size()) set(n, rays[n], max_t);
+				else clear(n);
+			}
+		}
+
+		void set(size_t lane, const Ray& ray, float max_t = numeric_limits<float>::infinity()) {
+			for (size_t a = 0; a < 3; ++a) {
+				origin[a][lane] = ray.point[a];
+				dir[a][lane] = ray.dir[a];
+				inv_dir[a][lane] = 1.0f / ray.dir[a];
+			}
+			t_max[lane] = max_t;
+		}
+
+		void clear(size_t lane) {
+			for (size_t a = 0; a < 3; ++a) {
+				origin[a][lane] = 0.0f;
+				dir[a][lane] = a == 2 ? 1.0f : 0.0f;
+				inv_dir[a][lane] = 1.0f / dir[a][lane];
+			}
+			t_max[lane] = -numeric_limits<float>::infinity();
+		}
+
+		Ray get(size_t lane) const {
+			return { Point(origin[0][lane], origin[1][lane], origin[2][lane]), Vec3f(dir[0][lane], dir[1][lane], dir[2][lane]) };
+		}
+
+		// Bit i set for every lane holding a ray
+		uint32_t active() const {
+			uint32_t mask = 0;
+			for (size_t n = 0; n < N; ++n) mask |= uint32_t(t_max[n] >= 0.0f) << n;
+			return mask;
+		}
+	};
+
+	using RayPacket4 = RayPacket<4>;
+	using RayPacket8 = RayPacket<8>;
+	using RayPacket16 = RayPacket<16>;
+
+	namespace packet_detail {
+		// Box bounds and triangles are shared by every lane, so they come in as broadcast scalars
+		template <size_t N>
+		uint32_t slab(const RayPacket<N>& rays, const float* lo, const float* hi, const float* t_max, float* t_entry) {
+			using namespace simd;
+			uint32_t mask = 0;
+			for (size_t g = 0; g < N; g += 4) {
+				float4 near_t = zero();
+				float4 far_t = load(t_max + g);
+				for (size_t a = 0; a < 3; ++a) {
+					// Pick the entry plane from the direction's sign instead of min/max so a NaN slab (origin on
+					// the plane of a parallel ray) leaves the interval alone, as in RayAABB
+					float4 inv = load(rays.inv_dir[a] + g);
+					float4 o = load(rays.origin[a] + g);
+					float4 negative = cmplt(inv, zero());
+					float4 t0 = mul(sub(select(negative, set1(hi[a]), set1(lo[a])), o), inv);
+					float4 t1 = mul(sub(select(negative, set1(lo[a]), set1(hi[a])), o), inv);
+					near_t = select(cmplt(near_t, t0), t0, near_t);
+					far_t = select(cmplt(t1, far_t), t1, far_t);
+				}
+				store(t_entry + g, near_t);
+				mask |= movemask(cmple(near_t, far_t)) << g;
+			}
+			return mask;
+		}
+
+		// Moller-Trumbore with the edges precomputed, the same steps as RayTriangle. Builds with FMA contract
+		// the two differently, so t, u and v agree to about 1e-4 relative and rays through an edge may differ.
+		template <size_t N>
+		uint32_t triangle(const RayPacket<N>& rays, const Vec3f& v0, const Vec3f& e1, const Vec3f& e2, const float* t_max,
+			float* t_out, float* u_out, float* v_out) {
+			using namespace simd;
+			const float4 e1x = set1(e1[0]), e1y = set1(e1[1]), e1z = set1(e1[2]);
+			const float4 e2x = set1(e2[0]), e2y = set1(e2[1]), e2z = set1(e2[2]);
+			const float4 zeros = zero(), ones = set1(1.0f);
+
+			uint32_t mask = 0;
+			for (size_t g = 0; g < N; g += 4) {
+				float4 dx = load(rays.dir[0] + g), dy = load(rays.dir[1] + g), dz = load(rays.dir[2] + g);
+
+				// p = dir x e2, det = e1 . p
+				float4 px = sub(mul(dy, e2z), mul(dz, e2y));
+				float4 py = sub(mul(dz, e2x), mul(dx, e2z));
+				float4 pz = sub(mul(dx, e2y), mul(dy, e2x));
+				float4 det = add(add(mul(e1x, px), mul(e1y, py)), mul(e1z, pz));
+				float4 valid = cmple(set1(numeric_limits<float>::min()), abs(det));
+				float4 inv_det = div(ones, det);
+
+				float4 sx = sub(load(rays.origin[0] + g), set1(v0[0]));
+				float4 sy = sub(load(rays.origin[1] + g), set1(v0[1]));
+				float4 sz = sub(load(rays.origin[2] + g), set1(v0[2]));
+				float4 u = mul(add(add(mul(sx, px), mul(sy, py)), mul(sz, pz)), inv_det);
+
+				// q = s x e1
+				float4 qx = sub(mul(sy, e1z), mul(sz, e1y));
+				float4 qy = sub(mul(sz, e1x), mul(sx, e1z));
+				float4 qz = sub(mul(sx, e1y), mul(sy, e1x));
+				float4 v = mul(add(add(mul(dx, qx), mul(dy, qy)), mul(dz, qz)), inv_det);
+				float4 t = mul(add(add(mul(e2x, qx), mul(e2y, qy)), mul(e2z, qz)), inv_det);
+
+				valid = bit_and(valid, bit_and(cmple(zeros, u), cmple(u, ones)));
+				valid = bit_and(valid, bit_and(cmple(zeros, v), cmple(add(u, v), ones)));
+				valid = bit_and(valid, bit_and(cmple(zeros, t), cmple(t, load(t_max + g))));
+
+				store(t_out + g, t);
+				store(u_out + g, u);
+				store(v_out + g, v);
+				mask |= movemask(valid) << g;
+			}
+			return mask;
+		}
+	}
+
+	// Slab test of every lane against box within [0, t_max]. Returns the lanes that hit; t holds their entry
+	// distance, 0 for rays starting inside. Agrees with RayAABB lane by lane up to rounding: with FMA
+	// contraction the entry distance may differ by a few ulps and rays grazing an edge or corner may differ.
+	template <size_t N>
+	uint32_t RayAABB(const RayPacket<N>& rays, const AABB& box, float (&t)[N]) {
+		float lo[3], hi[3];
+		for (size_t a = 0; a < 3; ++a) {
+			lo[a] = box.center[a] - box.halfwidths[a];
+			hi[a] = box.center[a] + box.halfwidths[a];
+		}
+		return packet_detail::slab(rays, lo, hi, rays.t_max, t);
+	}
+
+	// Moller-Trumbore per lane, hits with t in [0, t_max]. Returns the lanes that hit; t, u and v are as in
+	// RayTriangle for those lanes and unspecified for the others.
+	template <size_t N>
+	uint32_t RayTriangle(const RayPacket<N>& rays, const Tri3d& tri, float (&t)[N], float (&u)[N], float (&v)[N]) {
+		const Vec3f& v0 = tri.verts[0].pos;
+		return packet_detail::triangle(rays, v0, tri.verts[1].pos - v0, tri.verts[2].pos - v0, rays.t_max, t, u, v);
+	}
+}
@@ -0,0 +1,415 @@
+#pragma once
+#include <bit>
+#include <cstddef>
+#include <cmath>
+
+// Selects the widest 4-lane float backend available to the translation unit.
+// Define MATH3D_NO_SIMD to force the scalar fallback.
+#if !defined(MATH3D_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+	#define MATH3D_SIMD_SSE 1
+	#include <immintrin.h>
+#elif !defined(MATH3D_NO_SIMD) && (defined(__aarch64__) || defined(_M_ARM64))
+	#define MATH3D_SIMD_NEON 1
+	#include <arm_neon.h>
+#else
+	#define MATH3D_SIMD_SCALAR 1
+#endif
+
+namespace Math3D::simd {
+#if defined(MATH3D_SIMD_SSE)
+	using float4 = __m128;
+
+	inline float4 load(const float* p) { return _mm_loadu_ps(p); }
+	inline void store(float* p, float4 v) { _mm_storeu_ps(p, v); }
+	inline float4 set1(float f) { return _mm_set1_ps(f); }
+	inline float4 set(float x, float y, float z, float w) { return _mm_setr_ps(x, y, z, w); }
+	inline float4 zero() { return _mm_setzero_ps(); }
+
+	// Loads three floats and zeroes the fourth lane without reading past p[2]. The pair goes through
+	// __m128i, which may alias anything; a double* access to floats lets GCC drop the stores before it.
+	inline float4 load3(const float* p) {
+		__m128 xy = _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+		return _mm_movelh_ps(xy, _mm_load_ss(p + 2));
+	}
+
+	inline void store3(float* p, float4 v) {
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_castps_si128(v));
+		_mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+	}
+
+	inline float4 add(float4 a, float4 b) { return _mm_add_ps(a, b); }
+	inline float4 sub(float4 a, float4 b) { return _mm_sub_ps(a, b); }
+	inline float4 mul(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+	inline float4 div(float4 a, float4 b) { return _mm_div_ps(a, b); }
+	inline float4 min(float4 a, float4 b) { return _mm_min_ps(a, b); }
+	inline float4 max(float4 a, float4 b) { return _mm_max_ps(a, b); }
+	inline float4 sqrt(float4 a) { return _mm_sqrt_ps(a); }
+	inline float4 abs(float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+	// a with its sign flipped in the lanes where s is negative
+	inline float4 flip_sign(float4 a, float4 s) { return _mm_xor_ps(a, _mm_and_ps(s, _mm_set1_ps(-0.0f))); }
+
+	// Comparisons return lane masks (all bits set or clear) for select, the bitwise ops and movemask
+	inline float4 cmplt(float4 a, float4 b) { return _mm_cmplt_ps(a, b); }
+	inline float4 cmple(float4 a, float4 b) { return _mm_cmple_ps(a, b); }
+	inline float4 bit_and(float4 a, float4 b) { return _mm_and_ps(a, b); }
+	inline float4 bit_or(float4 a, float4 b) { return _mm_or_ps(a, b); }
+
+	// a where mask is set, b elsewhere
+	inline float4 select(float4 mask, float4 a, float4 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+	// Bit i set when lane i of the mask is set
+	inline unsigned movemask(float4 mask) { return unsigned(_mm_movemask_ps(mask)); }
+
+	// a * b + c
+	inline float4 madd(float4 a, float4 b, float4 c) {
+	#if defined(__FMA__)
+		return _mm_fmadd_ps(a, b, c);
+	#else
+		return _mm_add_ps(_mm_mul_ps(a, b), c);
+	#endif
+	}
+
+	template <int I>
+	inline float4 splat(float4 v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(I, I, I, I)); }
+
+	// (a[X], a[Y], b[Z], b[W])
+	template <int X, int Y, int Z, int W>
+	inline float4 shuffle(float4 a, float4 b) { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(W, Z, Y, X)); }
+
+	template <int I>
+	inline float lane(float4 v) { return _mm_cvtss_f32(splat<I>(v)); }
+
+	inline float hsum(float4 v) {
+		__m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+		return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+	}
+
+	inline void transpose(float4& r0, float4& r1, float4& r2, float4& r3) { _MM_TRANSPOSE4_PS(r0, r1, r2, r3); }
+
+#elif defined(MATH3D_SIMD_NEON)
+	using float4 = float32x4_t;
+
+	inline float4 load(const float* p) { return vld1q_f32(p); }
+	inline void store(float* p, float4 v) { vst1q_f32(p, v); }
+	inline float4 set1(float f) { return vdupq_n_f32(f); }
+	inline float4 set(float x, float y, float z, float w) { const float v[4] = {x, y, z, w}; return vld1q_f32(v); }
+	inline float4 zero() { return vdupq_n_f32(0.0f); }
+
+	inline float4 load3(const float* p) { return vcombine_f32(vld1_f32(p), vld1_lane_f32(p + 2, vdup_n_f32(0.0f), 0)); }
+
+	inline void store3(float* p, float4 v) {
+		vst1_f32(p, vget_low_f32(v));
+		vst1q_lane_f32(p + 2, v, 2);
+	}
+
+	inline float4 add(float4 a, float4 b) { return vaddq_f32(a, b); }
+	inline float4 sub(float4 a, float4 b) { return vsubq_f32(a, b); }
+	inline float4 mul(float4 a, float4 b) { return vmulq_f32(a, b); }
+	inline float4 div(float4 a, float4 b) { return vdivq_f32(a, b); }
+	inline float4 min(float4 a, float4 b) { return vminq_f32(a, b); }
+	inline float4 max(float4 a, float4 b) { return vmaxq_f32(a, b); }
+	inline float4 sqrt(float4 a) { return vsqrtq_f32(a); }
+	inline float4 abs(float4 a) { return vabsq_f32(a); }
+
+	inline float4 flip_sign(float4 a, float4 s) {
+		uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(s), vdupq_n_u32(0x80000000u));
+		return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(a), sign));
+	}
+
+	inline float4 cmplt(float4 a, float4 b) { return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+	inline float4 cmple(float4 a, float4 b) { return vreinterpretq_f32_u32(vcleq_f32(a, b)); }
+	inline float4 bit_and(float4 a, float4 b) { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+	inline float4 bit_or(float4 a, float4 b) { return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+	inline float4 select(float4 mask, float4 a, float4 b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+
+	inline unsigned movemask(float4 mask) {
+		static const uint32_t bits[4] = {1, 2, 4, 8};
+		return vaddvq_u32(vandq_u32(vreinterpretq_u32_f32(mask), vld1q_u32(bits)));
+	}
+
+	inline float4 madd(float4 a, float4 b, float4 c) { return vmlaq_f32(c, a, b); }
+
+	template <int I>
+	inline float4 splat(float4 v) { return vdupq_laneq_f32(v, I); }
+
+	template <int X, int Y, int Z, int W>
+	inline float4 shuffle(float4 a, float4 b) {
+	#if defined(__GNUC__) || defined(__clang__)
+		return __builtin_shufflevector(a, b, X, Y, Z + 4, W + 4);
+	#else
+		float4 r = vdupq_n_f32(vgetq_lane_f32(a, X));
+		r = vsetq_lane_f32(vgetq_lane_f32(a, Y), r, 1);
+		r = vsetq_lane_f32(vgetq_lane_f32(b, Z), r, 2);
+		return vsetq_lane_f32(vgetq_lane_f32(b, W), r, 3);
+	#endif
+	}
+
+	template <int I>
+	inline float lane(float4 v) { return vgetq_lane_f32(v, I); }
+
+	inline float hsum(float4 v) { return vaddvq_f32(v); }
+
+	inline void transpose(float4& r0, float4& r1, float4& r2, float4& r3) {
+		float32x4x2_t t01 = vtrnq_f32(r0, r1);
+		float32x4x2_t t23 = vtrnq_f32(r2, r3);
+		r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+		r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+		r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+		r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+	}
+
+#else
+	struct float4 { float v[4]; };
+
+	inline float4 load(const float* p) { return {p[0], p[1], p[2], p[3]}; }
+	inline void store(float* p, float4 v) { for (int i = 0; i < 4; ++i) p[i] = v.v[i]; }
+	inline float4 set1(float f) { return {f, f, f, f}; }
+	inline float4 set(float x, float y, float z, float w) { return {x, y, z, w}; }
+	inline float4 zero() { return {0.0f, 0.0f, 0.0f, 0.0f}; }
+	inline float4 load3(const float* p) { return {p[0], p[1], p[2], 0.0f}; }
+	inline void store3(float* p, float4 v) { for (int i = 0; i < 3; ++i) p[i] = v.v[i]; }
+
+	inline float4 add(float4 a, float4 b) { return {a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}; }
+	inline float4 sub(float4 a, float4 b) { return {a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}; }
+	inline float4 mul(float4 a, float4 b) { return {a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}; }
+	inline float4 div(float4 a, float4 b) { return {a.v[0] / b.v[0], a.v[1] / b.v[1], a.v[2] / b.v[2], a.v[3] / b.v[3]}; }
+	inline float4 min(float4 a, float4 b) { return {a.v[0] < b.v[0] ? a.v[0] : b.v[0], a.v[1] < b.v[1] ? a.v[1] : b.v[1], a.v[2] < b.v[2] ? a.v[2] : b.v[2], a.v[3] < b.v[3] ? a.v[3] : b.v[3]}; }
+	inline float4 max(float4 a, float4 b) { return {a.v[0] > b.v[0] ? a.v[0] : b.v[0], a.v[1] > b.v[1] ? a.v[1] : b.v[1], a.v[2] > b.v[2] ? a.v[2] : b.v[2], a.v[3] > b.v[3] ? a.v[3] : b.v[3]}; }
+	inline float4 sqrt(float4 a) { return {std::sqrt(a.v[0]), std::sqrt(a.v[1]), std::sqrt(a.v[2]), std::sqrt(a.v[3])}; }
+	inline float4 abs(float4 a) { return {std::fabs(a.v[0]), std::fabs(a.v[1]), std::fabs(a.v[2]), std::fabs(a.v[3])}; }
+	inline float4 flip_sign(float4 a, float4 s) {
+		return {
+			std::signbit(s.v[0]) ? -a.v[0] : a.v[0], std::signbit(s.v[1]) ? -a.v[1] : a.v[1],
+			std::signbit(s.v[2]) ? -a.v[2] : a.v[2], std::signbit(s.v[3]) ? -a.v[3] : a.v[3],
+		};
+	}
+
+	// Mask lanes hold all-ones or zero bit patterns, as in the vector backends
+	inline float mask_lane(bool set) { return std::bit_cast<float>(set ? ~0u : 0u); }
+	inline unsigned lane_bits(float f) { return std::bit_cast<unsigned>(f); }
+
+	inline float4 cmplt(float4 a, float4 b) { return {mask_lane(a.v[0] < b.v[0]), mask_lane(a.v[1] < b.v[1]), mask_lane(a.v[2] < b.v[2]), mask_lane(a.v[3] < b.v[3])}; }
+	inline float4 cmple(float4 a, float4 b) { return {mask_lane(a.v[0] <= b.v[0]), mask_lane(a.v[1] <= b.v[1]), mask_lane(a.v[2] <= b.v[2]), mask_lane(a.v[3] <= b.v[3])}; }
+
+	inline float4 bit_and(float4 a, float4 b) {
+		float4 r;
+		for (int i = 0; i < 4; ++i) r.v[i] = std::bit_cast<float>(lane_bits(a.v[i]) & lane_bits(b.v[i]));
+		return r;
+	}
+
+	inline float4 bit_or(float4 a, float4 b) {
+		float4 r;
+		for (int i = 0; i < 4; ++i) r.v[i] = std::bit_cast<float>(lane_bits(a.v[i]) | lane_bits(b.v[i]));
+		return r;
+	}
+
+	inline float4 select(float4 mask, float4 a, float4 b) {
+		float4 r;
+		for (int i = 0; i < 4; ++i) r.v[i] = lane_bits(mask.v[i]) ? a.v[i] : b.v[i];
+		return r;
+	}
+
+	inline unsigned movemask(float4 mask) {
+		unsigned bits = 0;
+		for (int i = 0; i < 4; ++i) bits |= (lane_bits(mask.v[i]) >> 31) << i;
+		return bits;
+	}
+	inline float4 madd(float4 a, float4 b, float4 c) { return add(mul(a, b), c); }
+
+	template <int I>
+	inline float4 splat(float4 v) { return set1(v.v[I]); }
+
+	template <int X, int Y, int Z, int W>
+	inline float4 shuffle(float4 a, float4 b) { return {a.v[X], a.v[Y], b.v[Z], b.v[W]}; }
+
+	template <int I>
+	inline float lane(float4 v) { return v.v[I]; }
+
+	inline float hsum(float4 v) { return (v.v[0] + v.v[2]) + (v.v[1] + v.v[3]); }
+
+	inline void transpose(float4& r0, float4& r1, float4& r2, float4& r3) {
+		float4 t0 = {r0.v[0], r1.v[0], r2.v[0], r3.v[0]};
+		float4 t1 = {r0.v[1], r1.v[1], r2.v[1], r3.v[1]};
+		float4 t2 = {r0.v[2], r1.v[2], r2.v[2], r3.v[2]};
+		float4 t3 = {r0.v[3], r1.v[3], r2.v[3], r3.v[3]};
+		r0 = t0; r1 = t1; r2 = t2; r3 = t3;
+	}
+#endif
+
+	inline float dot(float4 a, float4 b) { return hsum(mul(a, b)); }
+
+	// Lane-wise helpers for structure-of-arrays kernels, where a float4[3] holds x, y and z of four vectors
+	// and a float4[4] the (i, j, k, r) of four quaternions
+	inline float4 dot3(const float4 (&a)[3], const float4 (&b)[3]) {
+		return madd(a[2], b[2], madd(a[1], b[1], mul(a[0], b[0])));
+	}
+
+	inline float4 negate_if(float4 mask, float4 v) { return select(mask, sub(zero(), v), v); }
+
+	// Rotation matrices of four unit quaternions, the same terms as Quaternion::ToRot
+	inline void to_rot4(const float4 (&q)[4], float4 (&m)[3][3]) {
+		float4 one = set1(1.0f), two = set1(2.0f);
+		float4 i2 = mul(q[0], two), j2 = mul(q[1], two), k2 = mul(q[2], two);
+		float4 ii = mul(q[0], i2), jj = mul(q[1], j2), kk = mul(q[2], k2);
+		float4 ij = mul(q[0], j2), ik = mul(q[0], k2), jk = mul(q[1], k2);
+		float4 ir = mul(q[3], i2), jr = mul(q[3], j2), kr = mul(q[3], k2);
+
+		m[0][0] = sub(one, add(jj, kk)); m[0][1] = sub(ij, kr); m[0][2] = add(ik, jr);
+		m[1][0] = add(ij, kr); m[1][1] = sub(one, add(ii, kk)); m[1][2] = sub(jk, ir);
+		m[2][0] = sub(ik, jr); m[2][1] = add(jk, ir); m[2][2] = sub(one, add(ii, jj));
+	}
+
+	// std::array<__m128, N> drops the vector type's attributes under GCC; a plain member array keeps them
+	template <size_t N>
+	struct float4xN {
+		float4 v[N];
+
+		float4& operator[](size_t i) { return v[i]; }
+		const float4& operator[](size_t i) const { return v[i]; }
+	};
+
+	// Kernels below operate on row-major float storage so Matrix can dispatch to them
+	// without this header knowing about Matrix.
+
+	// out[i] = a[i] (op) b[i] over n floats, n a multiple of 4
+	template <class Op>
+	inline void elementwise(const float* a, const float* b, float* out, size_t n, Op op) {
+		for (size_t i = 0; i < n; i += 4) {
+			store(out + i, op(load(a + i), load(b + i)));
+		}
+	}
+
+	template <class Op>
+	inline void elementwise(const float* a, float b, float* out, size_t n, Op op) {
+		float4 vb = set1(b);
+		for (size_t i = 0; i < n; i += 4) {
+			store(out + i, op(load(a + i), vb));
+		}
+	}
+
+	// Row i of the result is the linear combination of b's rows weighted by row i of a.
+	// Summed as two independent chains to keep the dependency depth short.
+	inline float4 combine_rows(float4 a, float4 b0, float4 b1, float4 b2, float4 b3) {
+		float4 r01 = madd(splat<1>(a), b1, mul(splat<0>(a), b0));
+		float4 r23 = madd(splat<3>(a), b3, mul(splat<2>(a), b2));
+		return add(r01, r23);
+	}
+
+	// Same as above for a three wide row read straight from memory; broadcasting from memory
+	// keeps the shuffle port free for packing and unpacking Xformf rows
+	inline float4 combine_rows(const float* a, float4 b0, float4 b1, float4 b2) {
+		return madd(set1(a[2]), b2, madd(set1(a[1]), b1, mul(set1(a[0]), b0)));
+	}
+
+	// (rows x 4) * (4 x 4)
+	inline void mul_rows_mat4(const float* a, size_t rows, const float* b, float* out) {
+		float4 b0 = load(b), b1 = load(b + 4), b2 = load(b + 8), b3 = load(b + 12);
+		for (size_t i = 0; i < rows; ++i) {
+			store(out + i * 4, combine_rows(load(a + i * 4), b0, b1, b2, b3));
+		}
+	}
+
+	// Unpacks the twelve floats of an Xformf into four rows; the fourth lane of each row is unspecified
+	inline void load_xform(const float* p, float4& r0, float4& r1, float4& r2, float4& r3) {
+		float4 l0 = load(p), l1 = load(p + 4), l2 = load(p + 8);
+		r0 = l0;
+		r1 = shuffle<0, 2, 1, 1>(shuffle<3, 3, 0, 0>(l0, l1), l1);
+		r2 = shuffle<2, 3, 0, 0>(l1, l2);
+		r3 = shuffle<1, 2, 3, 3>(l2, l2);
+	}
+
+	inline void store_xform(float* p, float4 r0, float4 r1, float4 r2, float4 r3) {
+		store(p, shuffle<0, 1, 0, 2>(r0, shuffle<2, 2, 0, 0>(r0, r1)));
+		store(p + 4, shuffle<1, 2, 0, 1>(r1, r2));
+		store(p + 8, shuffle<0, 2, 1, 2>(shuffle<2, 2, 0, 0>(r2, r3), r3));
+	}
+
+	// Xformf * Xformf, both 3 wide with an implied (0,0,0,1) column
+	inline void mul_xform_xform(const float* a, const float* b, float* out) {
+		float4 b0, b1, b2, b3;
+		load_xform(b, b0, b1, b2, b3);
+		store_xform(out,
+			combine_rows(a, b0, b1, b2),
+			combine_rows(a + 3, b0, b1, b2),
+			combine_rows(a + 6, b0, b1, b2),
+			add(combine_rows(a + 9, b0, b1, b2), b3));
+	}
+
+	// Xformf * Mat4f, Xformf 3 wide with an implied (0,0,0,1) column
+	inline void mul_xform_mat4(const float* a, const float* b, float* out) {
+		float4 b0 = load(b), b1 = load(b + 4), b2 = load(b + 8), b3 = load(b + 12);
+		store(out, combine_rows(a, b0, b1, b2));
+		store(out + 4, combine_rows(a + 3, b0, b1, b2));
+		store(out + 8, combine_rows(a + 6, b0, b1, b2));
+		store(out + 12, add(combine_rows(a + 9, b0, b1, b2), b3));
+	}
+
+	inline void transpose_mat4(const float* a, float* out) {
+		float4 r0 = load(a), r1 = load(a + 4), r2 = load(a + 8), r3 = load(a + 12);
+		transpose(r0, r1, r2, r3);
+		store(out, r0);
+		store(out + 4, r1);
+		store(out + 8, r2);
+		store(out + 12, r3);
+	}
+
+	// 2x2 row-major blocks packed as (m00, m01, m10, m11)
+	inline float4 mat2_mul(float4 a, float4 b) {
+		return add(mul(a, shuffle<0, 3, 0, 3>(b, b)), mul(shuffle<1, 0, 3, 2>(a, a), shuffle<2, 1, 2, 1>(b, b)));
+	}
+
+	// adj(a) * b
+	inline float4 mat2_adj_mul(float4 a, float4 b) {
+		return sub(mul(shuffle<3, 3, 0, 0>(a, a), b), mul(shuffle<1, 1, 2, 2>(a, a), shuffle<2, 3, 0, 1>(b, b)));
+	}
+
+	// a * adj(b)
+	inline float4 mat2_mul_adj(float4 a, float4 b) {
+		return sub(mul(a, shuffle<3, 0, 3, 0>(b, b)), mul(shuffle<1, 0, 3, 2>(a, a), shuffle<2, 1, 2, 1>(b, b)));
+	}
+
+	// Block-wise 4x4 inverse. With M = |A B|, each 2x2 block of the adjugate is built from the
+	//                                   |C D|
+	// blocks' determinants and adjugates. Returns det(M); out is not finite when it is zero.
+	inline float inverse_mat4(const float* m, float* out) {
+		float4 r0 = load(m), r1 = load(m + 4), r2 = load(m + 8), r3 = load(m + 12);
+		float4 a = shuffle<0, 1, 0, 1>(r0, r1);
+		float4 b = shuffle<2, 3, 2, 3>(r0, r1);
+		float4 c = shuffle<0, 1, 0, 1>(r2, r3);
+		float4 d = shuffle<2, 3, 2, 3>(r2, r3);
+
+		// (|A|, |B|, |C|, |D|)
+		float4 det_sub = sub(
+			mul(shuffle<0, 2, 0, 2>(r0, r2), shuffle<1, 3, 1, 3>(r1, r3)),
+			mul(shuffle<1, 3, 1, 3>(r0, r2), shuffle<0, 2, 0, 2>(r1, r3)));
+		float4 det_a = splat<0>(det_sub);
+		float4 det_b = splat<1>(det_sub);
+		float4 det_c = splat<2>(det_sub);
+		float4 det_d = splat<3>(det_sub);
+
+		float4 d_c = mat2_adj_mul(d, c);
+		float4 a_b = mat2_adj_mul(a, b);
+
+		float4 x = sub(mul(det_d, a), mat2_mul(b, d_c));
+		float4 w = sub(mul(det_a, d), mat2_mul(c, a_b));
+		float4 y = sub(mul(det_b, c), mat2_mul_adj(d, a_b));
+		float4 z = sub(mul(det_c, b), mat2_mul_adj(a, d_c));
+
+		// |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+		float det = lane<0>(add(mul(det_a, det_d), mul(det_b, det_c))) - hsum(mul(a_b, shuffle<0, 2, 1, 3>(d_c, d_c)));
+
+		float4 rdet = div(set(1.0f, -1.0f, -1.0f, 1.0f), set1(det));
+		x = mul(x, rdet);
+		y = mul(y, rdet);
+		z = mul(z, rdet);
+		w = mul(w, rdet);
+
+		// Undo the block adjugates while scattering back into rows
+		store(out, shuffle<3, 1, 3, 1>(x, y));
+		store(out + 4, shuffle<2, 0, 2, 0>(x, y));
+		store(out + 8, shuffle<3, 1, 3, 1>(z, w));
+		store(out + 12, shuffle<2, 0, 2, 0>(z, w));
+		return det;
+	}
+}
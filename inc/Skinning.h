@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <span>
+
+#include "DualQuaternion.h"
+#include "SoA.h"
+
+namespace Math3D {
+	// Up to four weighted bones per vertex, one stream per slot: vertex v takes bones[k][v] with weight
+	// weights[k][v]. Unused slots have weight zero, and the weights of a vertex should sum to one.
+	struct SkinInfluences {
+		static constexpr size_t Slots = 4;
+
+		size_t size() const { return weights[0].size(); }
+
+		void resize(size_t count) {
+			for (size_t k = 0; k < Slots; ++k) {
+				bones[k].resize(count);
+				weights[k].resize(count);
+			}
+		}
+
+		void push_back(const array<uint16_t, Slots>& vertex_bones, const array<float, Slots>& vertex_weights) {
+			for (size_t k = 0; k < Slots; ++k) {
+				bones[k].push_back(vertex_bones[k]);
+				weights[k].push_back(vertex_weights[k]);
+			}
+		}
+
+		array<aligned_vector<uint16_t>, Slots> bones;
+		array<aligned_vector<float>, Slots> weights;
+	};
+
+	// Batch skinning of in.pos and in.norm, four vertices per SIMD pass and large meshes split over
+	// parallel_for. Every bone index must be below bones.size(); the outputs are resized to in.size().
+
+	// Linear blend skinning: each vertex goes through the weighted sum of its bones' matrices. Normals use the
+	// blended linear part and are renormalized, which is exact for bones without non-uniform scale.
+	void skin_linear(span<const Xformf> bones, const Vert3dSoA& in, const SkinInfluences& influences,
+		Vec3fSoA& out_positions, Vec3fSoA& out_normals);
+
+	// Dual quaternion skinning: blends the bones' unit dual quaternions, each flipped onto the hemisphere of
+	// the vertex's first bone, and normalizes. Keeps volume around twisting joints where linear blending
+	// collapses, but only represents rigid bones.
+	void skin_dual_quaternion(span<const DualQuaternion> bones, const Vert3dSoA& in, const SkinInfluences& influences,
+		Vec3fSoA& out_positions, Vec3fSoA& out_normals);
+}
@@ -0,0 +1,280 @@
+#pragma once
+#include <array>
+#include <cassert>
+#include <new>
+#include <span>
+#include <vector>
+
+#include "Matrix.h"
+#include "GeometricPrimitives.h"
+#include "SIMD.h"
+
+namespace Math3D {
+	// Hands out Align-byte aligned blocks so SoA streams start on a cache line and can be read with full-width loads
+	template <typename T, size_t Align = 64>
+	struct aligned_allocator {
+		static_assert(Align >= alignof(T) && (Align & (Align - 1)) == 0);
+
+		using value_type = T;
+		template <class U> struct rebind { using other = aligned_allocator<U, Align>; };
+
+		aligned_allocator() = default;
+		template <class U> constexpr aligned_allocator(const aligned_allocator<U, Align>&) noexcept {}
+
+		T* allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), align_val_t(Align))); }
+		void deallocate(T* p, size_t) noexcept { ::operator delete(p, align_val_t(Align)); }
+
+		template <class U> bool operator==(const aligned_allocator<U, Align>&) const noexcept { return true; }
+	};
+
+	template <typename T, size_t Align = 64>
+	using aligned_vector = vector<T, aligned_allocator<T, Align>>;
+
+	// Structure-of-arrays batch of Vec<T, W>: one contiguous stream per component
+	template <typename T, size_t W, size_t Align = 64>
+	struct VecSoA {
+		using vec_t = Vec<T, W>;
+		using stream_t = aligned_vector<T, Align>;
+
+		VecSoA() = default;
+		explicit VecSoA(size_t count) { resize(count); }
+
+		size_t size() const { return streams[0].size(); }
+		bool empty() const { return streams[0].empty(); }
+
+		void resize(size_t count) { for (auto& s : streams) s.resize(count); }
+		void reserve(size_t count) { for (auto& s : streams) s.reserve(count); }
+		void clear() { for (auto& s : streams) s.clear(); }
+
+		void push_back(const vec_t& v) {
+			for (size_t k = 0; k < W; ++k) {
+				streams[k].push_back(v[k]);
+			}
+		}
+
+		vec_t get(size_t i) const { return get_impl(i, make_index_sequence<W>()); }
+
+		void set(size_t i, const vec_t& v) {
+			for (size_t k = 0; k < W; ++k) {
+				streams[k][i] = v[k];
+			}
+		}
+
+		span<T> stream(size_t k) { return streams[k]; }
+		span<const T> stream(size_t k) const { return streams[k]; }
+
+		span<T> x() { return streams[0]; }
+		span<T> y() requires (W > 1) { return streams[1]; }
+		span<T> z() requires (W > 2) { return streams[2]; }
+		span<T> w() requires (W > 3) { return streams[3]; }
+		span<const T> x() const { return streams[0]; }
+		span<const T> y() const requires (W > 1) { return streams[1]; }
+		span<const T> z() const requires (W > 2) { return streams[2]; }
+		span<const T> w() const requires (W > 3) { return streams[3]; }
+
+		array<stream_t, W> streams;
+
+	private:
+		template <size_t ... Seq>
+		vec_t get_impl(size_t i, const index_sequence<Seq...>&) const {
+			return vec_t(streams[Seq][i] ...);
+		}
+	};
+
+	using Vec2fSoA = VecSoA<float, 2>;
+	using Vec3fSoA = VecSoA<float, 3>;
+	using Vec4fSoA = VecSoA<float, 4>;
+
+	struct Vert3dSoA {
+		Vec3fSoA pos;
+		Vec3fSoA norm;
+		Vec2fSoA uv;
+
+		size_t size() const { return pos.size(); }
+		void resize(size_t count) { pos.resize(count); norm.resize(count); uv.resize(count); }
+	};
+
+	struct SphereSoA {
+		Vec3fSoA center;
+		aligned_vector<float> radius;
+
+		size_t size() const { return radius.size(); }
+		void resize(size_t count) { center.resize(count); radius.resize(count); }
+		void push_back(const Sphere& sphere) { center.push_back(sphere.center); radius.push_back(sphere.radius); }
+		Sphere get(size_t i) const { return { center.get(i), radius[i] }; }
+	};
+
+	struct AABBSoA {
+		Vec3fSoA center;
+		Vec3fSoA halfwidths;
+
+		size_t size() const { return center.size(); }
+		void resize(size_t count) { center.resize(count); halfwidths.resize(count); }
+		void push_back(const AABB& box) {
+			center.push_back(box.center);
+			halfwidths.push_back(Vec3f(box.halfwidths[0], box.halfwidths[1], box.halfwidths[2]));
+		}
+		AABB get(size_t i) const {
+			Vec3f h = halfwidths.get(i);
+			return { center.get(i), { h[0], h[1], h[2] } };
+		}
+	};
+
+	namespace soa_detail {
+		// Runs op over n lanes four at a time. The tail goes through a zero padded scratch block,
+		// so every kernel is written once against float4.
+		template <size_t In, size_t Out, class Op>
+		void for_each_float4(size_t n, const array<const float*, In>& in, const array<float*, Out>& out, Op&& op) {
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				simd::float4xN<In> a;
+				for (size_t k = 0; k < In; ++k) {
+					a[k] = simd::load(in[k] + i);
+				}
+
+				simd::float4xN<Out> r = op(a);
+				for (size_t k = 0; k < Out; ++k) {
+					simd::store(out[k] + i, r[k]);
+				}
+			}
+
+			if (size_t rem = n - i) {
+				float scratch[4] = {};
+				simd::float4xN<In> a;
+				for (size_t k = 0; k < In; ++k) {
+					for (size_t j = 0; j < rem; ++j) scratch[j] = in[k][i + j];
+					a[k] = simd::load(scratch);
+				}
+
+				simd::float4xN<Out> r = op(a);
+				for (size_t k = 0; k < Out; ++k) {
+					simd::store(scratch, r[k]);
+					for (size_t j = 0; j < rem; ++j) out[k][i + j] = scratch[j];
+				}
+			}
+		}
+
+		template <size_t W, size_t Align>
+		void resize_like(VecSoA<float, W, Align>& out, size_t count) {
+			if (out.size() != count) out.resize(count);
+		}
+
+		// Per-lane dot product of the first W streams against the last W
+		template <size_t W>
+		simd::float4 dot(const simd::float4xN<2 * W>& v) {
+			simd::float4 r = simd::mul(v[0], v[W]);
+			for (size_t k = 1; k < W; ++k) {
+				r = simd::madd(v[k], v[W + k], r);
+			}
+			return r;
+		}
+	}
+
+	// Batch kernels mirroring the Matrix members; out may alias either input
+
+	template <size_t W, size_t Align>
+	void add(const VecSoA<float, W, Align>& a, const VecSoA<float, W, Align>& b, VecSoA<float, W, Align>& out) {
+		assert(a.size() == b.size());
+		soa_detail::resize_like(out, a.size());
+		for (size_t k = 0; k < W; ++k) {
+			soa_detail::for_each_float4<2, 1>(a.size(), {a.streams[k].data(), b.streams[k].data()}, {out.streams[k].data()},
+				[](const auto& v) { return simd::float4xN<1>{simd::add(v[0], v[1])}; });
+		}
+	}
+
+	template <size_t W, size_t Align>
+	void sub(const VecSoA<float, W, Align>& a, const VecSoA<float, W, Align>& b, VecSoA<float, W, Align>& out) {
+		assert(a.size() == b.size());
+		soa_detail::resize_like(out, a.size());
+		for (size_t k = 0; k < W; ++k) {
+			soa_detail::for_each_float4<2, 1>(a.size(), {a.streams[k].data(), b.streams[k].data()}, {out.streams[k].data()},
+				[](const auto& v) { return simd::float4xN<1>{simd::sub(v[0], v[1])}; });
+		}
+	}
+
+	template <size_t W, size_t Align>
+	void scale(const VecSoA<float, W, Align>& a, float s, VecSoA<float, W, Align>& out) {
+		soa_detail::resize_like(out, a.size());
+		simd::float4 vs = simd::set1(s);
+		for (size_t k = 0; k < W; ++k) {
+			soa_detail::for_each_float4<1, 1>(a.size(), {a.streams[k].data()}, {out.streams[k].data()},
+				[vs](const auto& v) { return simd::float4xN<1>{simd::mul(v[0], vs)}; });
+		}
+	}
+
+	template <size_t W, size_t Align>
+	void lerp(const VecSoA<float, W, Align>& a, const VecSoA<float, W, Align>& b, float t, VecSoA<float, W, Align>& out) {
+		assert(a.size() == b.size());
+		soa_detail::resize_like(out, a.size());
+		simd::float4 vt = simd::set1(t), vs = simd::set1(1 - t);
+		for (size_t k = 0; k < W; ++k) {
+			soa_detail::for_each_float4<2, 1>(a.size(), {a.streams[k].data(), b.streams[k].data()}, {out.streams[k].data()},
+				[vs, vt](const auto& v) { return simd::float4xN<1>{simd::madd(v[0], vs, simd::mul(v[1], vt))}; });
+		}
+	}
+
+	template <size_t W, size_t Align>
+	void dot(const VecSoA<float, W, Align>& a, const VecSoA<float, W, Align>& b, span<float> out) {
+		assert(a.size() == b.size() && out.size() >= a.size());
+		array<const float*, 2 * W> in;
+		for (size_t k = 0; k < W; ++k) {
+			in[k] = a.streams[k].data();
+			in[W + k] = b.streams[k].data();
+		}
+		soa_detail::for_each_float4<2 * W, 1>(a.size(), in, {out.data()},
+			[](const auto& v) { return simd::float4xN<1>{soa_detail::dot<W>(v)}; });
+	}
+
+	template <size_t W, size_t Align>
+	void length(const VecSoA<float, W, Align>& a, span<float> out) {
+		assert(out.size() >= a.size());
+		array<const float*, 2 * W> in;
+		for (size_t k = 0; k < W; ++k) {
+			in[k] = in[W + k] = a.streams[k].data();
+		}
+		soa_detail::for_each_float4<2 * W, 1>(a.size(), in, {out.data()},
+			[](const auto& v) { return simd::float4xN<1>{simd::sqrt(soa_detail::dot<W>(v))}; });
+	}
+
+	template <size_t W, size_t Align>
+	void normalize(const VecSoA<float, W, Align>& a, VecSoA<float, W, Align>& out) {
+		soa_detail::resize_like(out, a.size());
+		array<const float*, W> in;
+		array<float*, W> dst;
+		for (size_t k = 0; k < W; ++k) {
+			in[k] = a.streams[k].data();
+			dst[k] = out.streams[k].data();
+		}
+		soa_detail::for_each_float4<W, W>(a.size(), in, dst, [](const auto& v) {
+			simd::float4xN<2 * W> vv;
+			for (size_t k = 0; k < W; ++k) vv[k] = vv[W + k] = v[k];
+
+			simd::float4 len = simd::sqrt(soa_detail::dot<W>(vv));
+			simd::float4xN<W> r;
+			for (size_t k = 0; k < W; ++k) r[k] = simd::div(v[k], len);
+			return r;
+		});
+	}
+
+	template <size_t Align>
+	void cross(const VecSoA<float, 3, Align>& a, const VecSoA<float, 3, Align>& b, VecSoA<float, 3, Align>& out) {
+		assert(a.size() == b.size());
+		soa_detail::resize_like(out, a.size());
+		soa_detail::for_each_float4<6, 3>(a.size(),
+			{a.streams[0].data(), a.streams[1].data(), a.streams[2].data(), b.streams[0].data(), b.streams[1].data(), b.streams[2].data()},
+			{out.streams[0].data(), out.streams[1].data(), out.streams[2].data()},
+			[](const auto& v) {
+				return simd::float4xN<3>{
+					simd::sub(simd::mul(v[1], v[5]), simd::mul(v[2], v[4])),
+					simd::sub(simd::mul(v[2], v[3]), simd::mul(v[0], v[5])),
+					simd::sub(simd::mul(v[0], v[4]), simd::mul(v[1], v[3])),
+				};
+			});
+	}
+
+	// AoS <-> SoA transposition
+	void to_soa(span<const Vec3f> in, Vec3fSoA& out);
+	void to_aos(const Vec3fSoA& in, span<Vec3f> out);
+	void to_soa(span<const Vert3d> in, Vert3dSoA& out);
+	void to_aos(const Vert3dSoA& in, span<Vert3d> out);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <span>
+
+#include "QuaternionBatch.h"
+#include "SoA.h"
+
+namespace Math3D {
+	// Rotation, translation and scale streams, one element per transform, as compose() takes them
+	struct TRSBatch {
+		TRSBatch() = default;
+		explicit TRSBatch(size_t count) { resize(count); }
+
+		size_t size() const { return rotation.size(); }
+		bool empty() const { return rotation.empty(); }
+
+		void resize(size_t count) {
+			rotation.resize(count);
+			translation.resize(count);
+			scale.resize(count);
+		}
+
+		void push_back(const Quaternion& r, const Vec3f& t, const Vec3f& s) {
+			rotation.push_back(r);
+			translation.push_back(t);
+			scale.push_back(s);
+		}
+
+		QuaternionBatch rotation;
+		Vec3fSoA translation;
+		Vec3fSoA scale;
+	};
+
+	// compose() for every element, four at a time. out must hold at least trs.size() elements.
+	void compose(const TRSBatch& trs, span<Xformf> out);
+
+	// decompose() for every xform into out, which is resized to match. Unsheared xforms are split four at
+	// a time; sheared or singular ones go through the scalar polar decomposition and keep its diagonal.
+	void decompose(span<const Xformf> xforms, TRSBatch& out);
+}
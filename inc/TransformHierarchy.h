@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Matrix.h"
+#include "Quaternion.h"
+
+namespace Math3D {
+	// Parent/child transforms stored breadth-first in flat arrays. Each node has a local rotation,
+	// translation and scale and a cached world Xformf (local * parent world, row vector convention).
+	//
+	// Setting a local transform marks the node dirty; update() walks the tree one depth level at a time and
+	// recomputes only nodes that are dirty or whose parent was recomputed. On each level it visits just the
+	// span of slots between the first and last such node, so a few dirty nodes cost little however large
+	// the tree is. Nodes within a level only read the previous level, so large spans are split across
+	// threads with parallel_for.
+	//
+	// Nodes are addressed by the handle add() returns. Handles stay valid when the breadth-first order is
+	// rebuilt after adding nodes; the slot order behind worlds() does not.
+	class TransformHierarchy {
+	public:
+		using Handle = uint32_t;
+		static constexpr Handle None = ~Handle(0);
+
+		// parent must be None or an existing handle, so every node is added after its parent
+		Handle add(Handle parent, const Quaternion& rotation = Quaternion(0.0f, 0.0f, 0.0f, 1.0f),
+			const Vec3f& translation = Vec3f(0.0f, 0.0f, 0.0f), const Vec3f& scale = Vec3f(1.0f, 1.0f, 1.0f));
+
+		size_t size() const { return slot_of.size(); }
+		void reserve(size_t count);
+
+		Handle parent(Handle node) const;
+		const Quaternion& rotation(Handle node) const { return rotations[slot_of[node]]; }
+		const Vec3f& translation(Handle node) const { return translations[slot_of[node]]; }
+		const Vec3f& scale(Handle node) const { return scales[slot_of[node]]; }
+
+		void set_local(Handle node, const Quaternion& rotation, const Vec3f& translation, const Vec3f& scale);
+		void set_rotation(Handle node, const Quaternion& rotation);
+		void set_translation(Handle node, const Vec3f& translation);
+		void set_scale(Handle node, const Vec3f& scale);
+
+		// Recomputes dirty subtrees and returns how many nodes were recomputed. Levels with at least
+		// parallel_grain nodes are split into chunks of that size across threads.
+		size_t update(size_t parallel_grain = 4096);
+
+		// Valid as of the last update()
+		const Xformf& world(Handle node) const { return worlds_by_slot[slot_of[node]]; }
+		span<const Xformf> worlds() const { return worlds_by_slot; }
+
+		// Number of depth levels; level 0 holds the roots
+		size_t depth() const { return level_begin.empty() ? 0 : level_begin.size() - 1; }
+
+	private:
+		void mark_dirty(uint32_t slot);
+		void rebuild_order();
+
+		// By handle
+		vector<uint32_t> slot_of;
+
+		// By slot, breadth-first once rebuild_order has run; nodes added since are appended at the end
+		vector<Handle> handle_of;
+		vector<uint32_t> parent_slot;
+		vector<uint32_t> level;
+		vector<Quaternion> rotations;
+		vector<Vec3f> translations;
+		vector<Vec3f> scales;
+		vector<Xformf> worlds_by_slot;
+		vector<uint8_t> dirty;
+
+		// By slot, the span of the next level holding the node's children; empty for leaves. Set by
+		// rebuild_order, which update() runs first whenever nodes have been added.
+		vector<uint32_t> children_begin, children_end;
+
+		// Slots marked since the last update(), each once
+		vector<uint32_t> dirty_slots;
+
+		// First slot of each level, plus one past the end
+		vector<uint32_t> level_begin;
+		// Scratch for update(): the span of each level to visit
+		vector<uint32_t> visit_begin, visit_end;
+		bool order_stale = false;
+	};
+}
@@ -1,26 +1,239 @@
 #pragma once
 #include "Matrix.h"
+#include "Quaternion.h"
+#include "Trig.h"
 #include <cmath>
+#include <span>
 
 namespace Math3D {
-	class Quaternion;
+	namespace transform_detail {
+		// The builders are written once over the element type and touch only arr, the member constant
+		// evaluation can read, so each one folds to a constant when its arguments are constants
+		template <class Trig, class T>
+		constexpr Matrix<T, 3, 4> rotation(const Vec<T, 3>& axis, T angle) {
+			T s, c;
+			Trig::sincos(angle, s, c);
+			T t = T(1) - c;
 
-	Xformf rotation(const Vec3f& axis, float angle);
-	Xformf translation(const Vec3f& offset);
-	Xformf scale(const Vec3f& scale_factors);
+			Vec<T, 3> n_axis = axis.normalize();
+			T x = n_axis[0];
+			T y = n_axis[1];
+			T z = n_axis[2];
 
-	Xformf rotX(float angle);
-	Xformf rotY(float angle);
-	Xformf rotZ(float angle);
+			T tx = t * x, ty = t * y, tz = t * z;
+			T sx = s * x, sy = s * y, sz = s * z;
+			T txx = tx * x, tyy = ty * y, tzz = tz * z;
+			T txy = tx * y, txz = tx * z, tyz = ty * z;
 
-	Xformf look_at(const Xformf& from, const Xformf& to);
+			return Matrix<T, 3, 4> {
+				txx + c,  txy - sz, txz + sy,
+				txy + sz, tyy + c,  tyz - sx,
+				txz - sy, tyz + sx, tzz + c,
+				T(0),     T(0),     T(0),
+			};
+		}
 
-	Xformf compose(const Quaternion& rotation, const Vec3f& translation, const Vec3f& scale);
+		template <class Trig, class T>
+		constexpr Matrix<T, 3, 4> rotX(T angle) {
+			T s, c;
+			Trig::sincos(angle, s, c);
+
+			return Matrix<T, 3, 4> {
+				T(1), 	T(0), 	T(0),
+				T(0), 	c, 		-s,
+				T(0), 	s,		c,
+				T(0), 	T(0),	T(0),
+			};
+		}
+
+		template <class Trig, class T>
+		constexpr Matrix<T, 3, 4> rotY(T angle) {
+			T s, c;
+			Trig::sincos(angle, s, c);
+
+			return Matrix<T, 3, 4> {
+				c,		T(0),	s,
+				T(0),	T(1),	T(0),
+				-s, 	T(0), 	c,
+				T(0),	T(0),	T(0),
+			};
+		}
+
+		template <class Trig, class T>
+		constexpr Matrix<T, 3, 4> rotZ(T angle) {
+			T s, c;
+			Trig::sincos(angle, s, c);
+
+			return Matrix<T, 3, 4> {
+				c,		-s,		T(0),
+				s,		c,		T(0),
+				T(0),	T(0),	T(1),
+				T(0),	T(0),	T(0),
+			};
+		}
+
+		template <class T>
+		constexpr Matrix<T, 3, 4> translation(const Vec<T, 3>& offset) {
+			return Matrix<T, 3, 4> {
+				T(1), T(0), T(0),
+				T(0), T(1), T(0),
+				T(0), T(0), T(1),
+				offset[0], offset[1], offset[2],
+			};
+		}
+
+		template <class T>
+		constexpr Matrix<T, 3, 4> scale(const Vec<T, 3>& scale_factors) {
+			return Matrix<T, 3, 4> {
+				scale_factors[0], T(0), T(0),
+				T(0), scale_factors[1], T(0),
+				T(0), T(0), scale_factors[2],
+				T(0), T(0), T(0),
+			};
+		}
+
+		// The rows of ToRot() scaled by their scale factor, with the translation as the last row. For floats
+		// this matches the product scale * ToRot() * translation bit for bit.
+		template <class T>
+		constexpr Matrix<T, 3, 4> compose(const Quaternion& q, const Vec<T, 3>& t, const Vec<T, 3>& s) {
+			MATH_INSTRUMENT(Compose);
+			T i = q.i, j = q.j, k = q.k, r = q.r;
+			T i2 = i * T(2), j2 = j * T(2), k2 = k * T(2);
+			T ii = i * i2, jj = j * j2, kk = k * k2;
+			T ij = i * j2, ik = i * k2, jk = j * k2;
+			T ir = r * i2, jr = r * j2, kr = r * k2;
+
+			return Matrix<T, 3, 4> {
+				s[0] * (T(1) - (jj + kk)), s[0] * (ij - kr),          s[0] * (ik + jr),
+				s[1] * (ij + kr),          s[1] * (T(1) - (ii + kk)), s[1] * (jk - ir),
+				s[2] * (ik - jr),          s[2] * (jk + ir),          s[2] * (T(1) - (ii + jj)),
+				t[0],                      t[1],                      t[2],
+			};
+		}
+
+		template <class T>
+		constexpr Matrix<T, 3, 4> look_at(const Matrix<T, 3, 4>& from, const Matrix<T, 3, 4>& to) {
+			Vec<T, 3> eye(from.arr[9], from.arr[10], from.arr[11]);
+			Vec<T, 3> target(to.arr[9], to.arr[10], to.arr[11]);
+
+			Vec<T, 3> fwd = (target - eye).normalize();
+			Vec<T, 3> left = Vec<T, 3>(T(0), T(1), T(0)).cross(fwd).normalize();
+			Vec<T, 3> up = fwd.cross(left).normalize();
+
+			// Camera-to-world is orthonormal, so world-to-camera is its rigid inverse
+			Matrix<T, 3, 4> camera {
+				left[0], left[1], left[2],
+				up[0],   up[1],   up[2],
+				fwd[0],  fwd[1],  fwd[2],
+				eye[0],  eye[1],  eye[2],
+			};
+			return camera.template affine_inverse<AffineKind::Rigid>();
+		}
+	}
+
+	// The builders are constexpr and inline, so constant arguments give constant matrices. The angle-taking
+	// ones get their sin, cos and tan from a Trig.h policy, as in rotX<trig::Fast>(a); Precise, the default,
+	// is within a few ulp of libm.
+	template <class Trig = trig::Precise> constexpr Xformf rotation(const Vec3f& axis, float angle) { return transform_detail::rotation<Trig>(axis, angle); }
+	constexpr Xformf translation(const Vec3f& offset) { return transform_detail::translation(offset); }
+	constexpr Xformf scale(const Vec3f& scale_factors) { return transform_detail::scale(scale_factors); }
+
+	template <class Trig = trig::Precise> constexpr Xformf rotX(float angle) { return transform_detail::rotX<Trig>(angle); }
+	template <class Trig = trig::Precise> constexpr Xformf rotY(float angle) { return transform_detail::rotY<Trig>(angle); }
+	template <class Trig = trig::Precise> constexpr Xformf rotZ(float angle) { return transform_detail::rotZ<Trig>(angle); }
+
+	constexpr Xformf look_at(const Xformf& from, const Xformf& to) { return transform_detail::look_at(from, to); }
+
+	// Double precision builders for large worlds, where float positions lose millimetres past a few
+	// kilometres. Every trig policy evaluates doubles with libm. The angle builders take a d suffix so a
+	// double angle still picks the float rotX.
+	template <class Trig = trig::Precise> constexpr Xformd rotation(const Vec3d& axis, double angle) { return transform_detail::rotation<Trig>(axis, angle); }
+	constexpr Xformd translation(const Vec3d& offset) { return transform_detail::translation(offset); }
+	constexpr Xformd scale(const Vec3d& scale_factors) { return transform_detail::scale(scale_factors); }
+
+	template <class Trig = trig::Precise> constexpr Xformd rotXd(double angle) { return transform_detail::rotX<Trig>(angle); }
+	template <class Trig = trig::Precise> constexpr Xformd rotYd(double angle) { return transform_detail::rotY<Trig>(angle); }
+	template <class Trig = trig::Precise> constexpr Xformd rotZd(double angle) { return transform_detail::rotZ<Trig>(angle); }
+
+	constexpr Xformd look_at(const Xformd& from, const Xformd& to) { return transform_detail::look_at(from, to); }
+
+	// Scale, then rotate, then translate, built directly from the quaternion terms
+	constexpr Xformf compose(const Quaternion& rotation, const Vec3f& translation, const Vec3f& scale) { return transform_detail::compose(rotation, translation, scale); }
+	constexpr Xformd compose(const Quaternion& rotation, const Vec3d& translation, const Vec3d& scale) { return transform_detail::compose(rotation, translation, scale); }
+
+	// Splits the linear part into stretch * rotation by polar decomposition, with out_rotation.r >= 0. Without
+	// shear the stretch is diagonal and compose() of the result gives xform back; a sheared xform keeps only
+	// the diagonal in out_scale, while the Mat3f overload returns the whole stretch. A mirror shows up as a
+	// negative first scale, and a zero scale leaves the rotation about that axis arbitrary.
 	void decompose(const Xformf& xform, Quaternion& out_rotation, Vec3f& out_translation, Vec3f& out_scale);
+	void decompose(const Xformf& xform, Quaternion& out_rotation, Vec3f& out_translation, Mat3f& out_stretch);
+	// The Xformd versions keep translation and stretch in double; the rotation is rounded to a float Quaternion
+	void decompose(const Xformd& xform, Quaternion& out_rotation, Vec3d& out_translation, Vec3d& out_scale);
+	void decompose(const Xformd& xform, Quaternion& out_rotation, Vec3d& out_translation, Mat3d& out_stretch);
 
 	float distance(const Vec3f& a, const Vec3f& b);
+	double distance(const Vec3d& a, const Vec3d& b);
 	float angle(const Vec3f& a, const Vec3f& b);
+	double angle(const Vec3d& a, const Vec3d& b);
+
+	// Left-handed, depth in [0, 1]
+	template <class Trig = trig::Precise>
+	constexpr Mat4f perspective(float fov, float aspect, float near_clip, float far_clip) {
+		assert(far_clip != near_clip);
+		assert(fov != 0.0f);
+
+		float s, c;
+		Trig::sincos(fov * 0.5f, s, c);
+		float height = c / s;
+		float width = height / aspect;
+		float range = far_clip / (near_clip - far_clip);
+
+		return Mat4f {
+			width,	0.0f, 0.0f, 0.0f,
+			0.0f,	height, 0.0f, 0.0f,
+			0.0f,	0.0f, -range,  1.0f,
+			0.0f,	0.0f, range * near_clip, 0.0f,
+		};
+	}
+
+	constexpr Mat4f orthographic(float width, float height, float scale, float offset) {
+		return Mat4f {
+			1.0f / width,	0.0f,			0.0f,					0.0f,
+			0.0f,			1.0f / height,	0.0f,					0.0f,
+			0.0f, 			0.0f, 			scale,					0.0f,
+			0.0f, 			0.0f, 			1.0f - offset * scale,	1.0f,
+		};
+	}
+
+	// Batch transforms. out must hold at least in.size() elements and may be the same span as in;
+	// the single span overloads transform in place.
+	void transform_points(const Xformf& xform, span<const Vec3f> in, span<Vec3f> out);
+	void transform_points(const Xformf& xform, span<Vec3f> points);
+	void transform_points(const Mat4f& mat, span<const Vec4f> in, span<Vec4f> out);
+	void transform_points(const Mat4f& mat, span<Vec4f> points);
+
+	// Ignores translation
+	void transform_vectors(const Xformf& xform, span<const Vec3f> in, span<Vec3f> out);
+	void transform_vectors(const Xformf& xform, span<Vec3f> vectors);
+
+	// Multiplies by the inverse transpose of the linear part and renormalizes
+	void transform_normals(const Xformf& xform, span<const Vec3f> in, span<Vec3f> out);
+	void transform_normals(const Xformf& xform, span<Vec3f> normals);
+
+	// Treats each point as (x, y, z, 1) and applies the perspective divide
+	void project_points(const Mat4f& view_projection, span<const Vec3f> in, span<Vec3f> out);
+	void project_points(const Mat4f& view_projection, span<Vec3f> points);
+
+	// Double precision point and vector transforms, one element at a time
+	void transform_points(const Xformd& xform, span<const Vec3d> in, span<Vec3d> out);
+	void transform_points(const Xformd& xform, span<Vec3d> points);
+	void transform_vectors(const Xformd& xform, span<const Vec3d> in, span<Vec3d> out);
+	void transform_vectors(const Xformd& xform, span<Vec3d> vectors);
 
-	Mat4f perspective(float fov, float aspect, float near_clip, float far_clip);
-	Mat4f orthographic(float width, float height, float scale, float offset);
+	// Camera-relative rendering: world * inverse(camera) as a float view-space Xformf. The camera position
+	// is subtracted in double before anything is rounded, so objects near the camera keep full float
+	// precision however far both are from the origin, and the world never needs rebasing. The batch
+	// version runs over parallel_for; out must hold at least world.size() elements.
+	Xformf to_view_space(const Xformd& camera, const Xformd& world);
+	void to_view_space(const Xformd& camera, span<const Xformd> world, span<Xformf> out);
 }
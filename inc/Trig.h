@@ -0,0 +1,344 @@
+#pragma once
+#include <cmath>
+#include <type_traits>
+
+#include "3DMath.h"
+#include "SIMD.h"
+
+// Polynomial sin, cos, tan, acos and atan2 for one float or four lanes at a time. Each accuracy tier is a
+// policy struct with the same static members, so callers pick one per call (trig::Fast::sincos(a, s, c))
+// or pass it to a builder as a template argument (rotation<trig::Fast>(axis, a)).
+//
+// Worst errors against double precision libm, from the Trig tests:
+//
+//            sin, cos                           tan                   acos         atan2
+//   Precise  2 ulp on [-pi, pi], 1e-7 to 8192   4 ulp on [-1.5, 1.5]  2 ulp        4 ulp
+//   Fast     1.5e-5 absolute to 8192            1.5e-5 relative       4e-5 abs     1e-5 abs
+//   Std      the float libm functions, lane by lane for float4
+//
+// sincos works out both from one range reduction. Past |x| = 8192 Precise falls back to libm and Fast
+// loses accuracy. atan2 treats -0 as +0, so atan2(0, -0) is 0 rather than pi. Every policy takes doubles
+// too, for the Xformd builders, and hands them to the double libm functions.
+//
+// The scalar members are constexpr. In constant evaluation, where libm can't be called, Std uses the
+// Precise kernels and doubles a Taylor series; the float kernels run unchanged, so compile-time results
+// agree with runtime ones up to FMA contraction.
+namespace Math3D::trig {
+	namespace detail {
+		using simd::float4;
+
+		enum class Tier { Fast, Precise };
+
+		// Scalar stand-ins for the simd operations, so each kernel is written once for both widths
+		using simd::add, simd::sub, simd::mul, simd::div, simd::madd, simd::min, simd::max, simd::sqrt, simd::abs;
+		using simd::cmplt, simd::bit_and, simd::bit_or, simd::select;
+
+		constexpr float add(float a, float b) { return a + b; }
+		constexpr float sub(float a, float b) { return a - b; }
+		constexpr float mul(float a, float b) { return a * b; }
+		constexpr float div(float a, float b) { return a / b; }
+		constexpr float madd(float a, float b, float c) { return a * b + c; }
+		constexpr float min(float a, float b) { return a < b ? a : b; }
+		constexpr float max(float a, float b) { return a > b ? a : b; }
+		constexpr float sqrt(float a) { return cx::sqrt(a); }
+		constexpr float abs(float a) { return cx::abs(a); }
+		constexpr bool cmplt(float a, float b) { return a < b; }
+		constexpr bool bit_and(bool a, bool b) { return a && b; }
+		constexpr bool bit_or(bool a, bool b) { return a || b; }
+		constexpr float select(bool mask, float a, float b) { return mask ? a : b; }
+		constexpr bool any(bool mask) { return mask; }
+		inline bool any(float4 mask) { return simd::movemask(mask) != 0; }
+
+		template <class V>
+		constexpr V broadcast(float f) {
+			if constexpr (std::is_same_v<V, float>) return f;
+			else return simd::set1(f);
+		}
+
+		template <class V>
+		constexpr V negate_if(decltype(cmplt(V(), V())) mask, V v) { return select(mask, sub(broadcast<V>(0.0f), v), v); }
+
+		// Nearest integer for |v| < 2^22: adding 1.5 * 2^23 pushes the fraction out of the mantissa
+		template <class V>
+		constexpr V round_nearest(V v) {
+			const V magic = broadcast<V>(12582912.0f);
+			return sub(add(v, magic), magic);
+		}
+
+		constexpr float Pi = 3.14159265358979f;
+		constexpr float HalfPi = 1.57079632679490f;
+		constexpr float QuarterPi = 0.78539816339745f;
+		constexpr float TwoOverPi = 0.63661977236758f;
+		constexpr float TanEighthPi = 0.41421356237310f;
+		constexpr float LargeArgument = 8192.0f;
+
+		// pi/2 in pieces short enough that q * piece is exact for the quotients below LargeArgument
+		constexpr float HalfPi1 = 1.5703125f;
+		constexpr float HalfPi2 = 4.837512969970703125e-4f;
+		constexpr float HalfPi3 = 7.54978995489188216e-8f;
+		constexpr float HalfPi2Fast = 4.8382673412823e-4f; // pi/2 - HalfPi1
+
+		// Minimax fits on the reduced ranges, |r| <= pi/4 for sin and cos, [0, 1/2] for asin and
+		// [0, tan(pi/8)] for atan. The Precise sets are the Cephes single precision ones.
+		template <Tier T, class V>
+		constexpr V sin_poly(V r, V r2) {
+			V p;
+			if constexpr (T == Tier::Precise) {
+				p = madd(madd(broadcast<V>(-1.9515295891e-4f), r2, broadcast<V>(8.3321608736e-3f)), r2, broadcast<V>(-1.6666654611e-1f));
+			}
+			else {
+				p = madd(broadcast<V>(8.163282723e-3f), r2, broadcast<V>(-1.666339042e-1f));
+			}
+			return madd(mul(r, r2), p, r);
+		}
+
+		template <Tier T, class V>
+		constexpr V cos_poly(V r2) {
+			if constexpr (T == Tier::Precise) {
+				V p = madd(madd(broadcast<V>(2.443315711809948e-5f), r2, broadcast<V>(-1.388731625493765e-3f)), r2, broadcast<V>(4.166664568298827e-2f));
+				return madd(mul(r2, r2), p, madd(broadcast<V>(-0.5f), r2, broadcast<V>(1.0f)));
+			}
+			else {
+				V p = madd(broadcast<V>(4.045845828e-2f), r2, broadcast<V>(-4.997605601e-1f));
+				return madd(r2, p, broadcast<V>(1.0f));
+			}
+		}
+
+		template <Tier T, class V>
+		constexpr V asin_poly(V s, V z) {
+			V p;
+			if constexpr (T == Tier::Precise) {
+				p = madd(madd(madd(madd(broadcast<V>(4.2163199048e-2f), z, broadcast<V>(2.4181311049e-2f)), z, broadcast<V>(4.5470025998e-2f)),
+					z, broadcast<V>(7.4953002686e-2f)), z, broadcast<V>(1.6666752422e-1f));
+			}
+			else {
+				p = madd(broadcast<V>(9.429863162e-2f), z, broadcast<V>(1.650577689e-1f));
+			}
+			return madd(mul(s, z), p, s);
+		}
+
+		template <Tier T, class V>
+		constexpr V atan_poly(V t) {
+			V z = mul(t, t), p;
+			if constexpr (T == Tier::Precise) {
+				p = madd(madd(madd(broadcast<V>(8.05374449538e-2f), z, broadcast<V>(-1.38776856032e-1f)), z, broadcast<V>(1.99777106478e-1f)),
+					z, broadcast<V>(-3.33329491539e-1f));
+			}
+			else {
+				p = madd(broadcast<V>(1.703417777e-1f), z, broadcast<V>(-3.318337751e-1f));
+			}
+			return madd(mul(t, z), p, t);
+		}
+
+		// The quadrant q mod 4 swaps and negates the sin and cos of the reduced argument
+		constexpr void apply_quadrant(float q, float sin_r, float cos_r, float& s, float& c) {
+			unsigned quadrant = unsigned(int(q));
+			float swapped_s = quadrant & 1 ? cos_r : sin_r, swapped_c = quadrant & 1 ? sin_r : cos_r;
+			s = quadrant & 2 ? -swapped_s : swapped_s;
+			c = (quadrant + 1) & 2 ? -swapped_c : swapped_c;
+		}
+
+		// Without integer lanes: j = q - 4 round(q / 4) is in [-2, 2], and -2 and 2 are the same quadrant
+		inline void apply_quadrant(float4 q, float4 sin_r, float4 cos_r, float4& s, float4& c) {
+			float4 j = madd(round_nearest(mul(q, simd::set1(0.25f))), simd::set1(-4.0f), q);
+			float4 swap = cmplt(abs(sub(abs(j), simd::set1(1.0f))), simd::set1(0.5f));
+			float4 negate_s = bit_or(cmplt(j, simd::set1(-0.5f)), cmplt(simd::set1(1.5f), j));
+			float4 negate_c = bit_or(cmplt(simd::set1(0.5f), j), cmplt(j, simd::set1(-1.5f)));
+			s = negate_if(negate_s, select(swap, cos_r, sin_r));
+			c = negate_if(negate_c, select(swap, sin_r, cos_r));
+		}
+
+		// Double sincos for constant evaluation, where libm isn't available: x = q pi/2 + r in two parts (the
+		// fdlibm split), then Taylor series to r^19 and r^18. Within a couple of ulp for |x| < 2^30.
+		constexpr void sincos_series(double x, double& s, double& c) {
+			double qf = x * 0.63661977236758134308;
+			long long q = qf < 0.0 ? (long long)(qf - 0.5) : (long long)(qf + 0.5);
+			double r = (x - double(q) * 1.57079632673412561417) - double(q) * 6.07710050650619224932e-11;
+
+			// Horner from the top term: term k of sin(r) / r is (-r^2)^k / (2k + 1)!, of cos(r) (-r^2)^k / (2k)!
+			double r2 = r * r, sin_r = 0.0, cos_r = 0.0;
+			for (int k = 9; k >= 0; --k) {
+				double sin_coeff = 1.0, cos_coeff = 1.0;
+				for (int f = 2; f <= 2 * k + 1; ++f) {
+					sin_coeff /= f;
+					if (f <= 2 * k) cos_coeff /= f;
+				}
+				sin_r = sin_r * -r2 + sin_coeff;
+				cos_r = cos_r * -r2 + cos_coeff;
+			}
+			sin_r *= r;
+
+			unsigned quadrant = unsigned(q & 3);
+			double swapped_s = quadrant & 1 ? cos_r : sin_r, swapped_c = quadrant & 1 ? sin_r : cos_r;
+			s = quadrant & 2 ? -swapped_s : swapped_s;
+			c = (quadrant + 1) & 2 ? -swapped_c : swapped_c;
+		}
+
+		// x = q pi/2 + r with |r| <= pi/4
+		template <Tier T, class V>
+		constexpr void sincos(V x, V& s, V& c) {
+			V q = round_nearest(mul(x, broadcast<V>(TwoOverPi)));
+			V r = sub(x, mul(q, broadcast<V>(HalfPi1)));
+			if constexpr (T == Tier::Precise) {
+				r = sub(r, mul(q, broadcast<V>(HalfPi2)));
+				r = sub(r, mul(q, broadcast<V>(HalfPi3)));
+			}
+			else {
+				r = sub(r, mul(q, broadcast<V>(HalfPi2Fast)));
+			}
+
+			V r2 = mul(r, r);
+			V sin_r = sin_poly<T>(r, r2), cos_r = cos_poly<T>(r2);
+
+			apply_quadrant(q, sin_r, cos_r, s, c);
+
+			if constexpr (T == Tier::Precise) {
+				auto large = cmplt(broadcast<V>(LargeArgument), abs(x));
+				if (any(large)) {
+					if constexpr (std::is_same_v<V, float>) {
+						if consteval {
+							double ds, dc;
+							sincos_series(x, ds, dc);
+							s = float(ds);
+							c = float(dc);
+						}
+						else {
+							s = std::sin(x);
+							c = std::cos(x);
+						}
+					}
+					else {
+						alignas(16) float xs[4], ss[4], cs[4];
+						simd::store(xs, x);
+						simd::store(ss, s);
+						simd::store(cs, c);
+						for (size_t i = 0; i < 4; ++i) {
+							if (std::fabs(xs[i]) > LargeArgument) {
+								ss[i] = std::sin(xs[i]);
+								cs[i] = std::cos(xs[i]);
+							}
+						}
+						s = simd::load(ss);
+						c = simd::load(cs);
+					}
+				}
+			}
+		}
+
+		// asin of s = |x| or sqrt((1 - |x|) / 2), whichever is at most 1/2, then the identities back to acos(x)
+		template <Tier T, class V>
+		constexpr V acos(V x) {
+			V a = abs(x);
+			auto big = cmplt(broadcast<V>(0.5f), a);
+			V z = select(big, mul(broadcast<V>(0.5f), sub(broadcast<V>(1.0f), a)), mul(a, a));
+			V s = select(big, sqrt(z), a);
+			V p = asin_poly<T>(s, z);
+
+			auto negative = cmplt(x, broadcast<V>(0.0f));
+			V from_big = add(p, p);
+			from_big = select(negative, sub(broadcast<V>(Pi), from_big), from_big);
+			V from_small = sub(broadcast<V>(HalfPi), negate_if(negative, p));
+			return select(big, from_big, from_small);
+		}
+
+		// atan of min / max of |y| and |x|, folded to [0, tan(pi/8)] with atan(t) = pi/4 + atan((t - 1) / (t + 1)),
+		// then unfolded by octant
+		template <Tier T, class V>
+		constexpr V atan2(V y, V x) {
+			V ax = abs(x), ay = abs(y);
+			V num = min(ax, ay), den = max(ax, ay);
+			const V zero = broadcast<V>(0.0f), one = broadcast<V>(1.0f);
+			V t = select(cmplt(zero, den), div(num, den), zero);
+
+			auto fold = cmplt(broadcast<V>(TanEighthPi), t);
+			t = select(fold, div(sub(t, one), add(t, one)), t);
+			V angle = add(select(fold, broadcast<V>(QuarterPi), zero), atan_poly<T>(t));
+
+			angle = select(cmplt(ax, ay), sub(broadcast<V>(HalfPi), angle), angle);
+			angle = select(cmplt(x, zero), sub(broadcast<V>(Pi), angle), angle);
+			return negate_if(cmplt(y, zero), angle);
+		}
+
+		// Both sin and cos of a double from libm, or from the series in constant evaluation
+		constexpr void libm_sincos(double x, double& s, double& c) {
+			if consteval {
+				sincos_series(x, s, c);
+			}
+			else {
+				s = std::sin(x);
+				c = std::cos(x);
+			}
+		}
+
+		template <Tier T>
+		struct Policy {
+			static constexpr void sincos(float x, float& s, float& c) { detail::sincos<T>(x, s, c); }
+			static constexpr float sin(float x) { float s, c; detail::sincos<T>(x, s, c); return s; }
+			static constexpr float cos(float x) { float s, c; detail::sincos<T>(x, s, c); return c; }
+			static constexpr float tan(float x) { float s, c; detail::sincos<T>(x, s, c); return s / c; }
+			static constexpr float acos(float x) { return detail::acos<T>(x); }
+			static constexpr float atan2(float y, float x) { return detail::atan2<T>(y, x); }
+
+			static constexpr void sincos(double x, double& s, double& c) { libm_sincos(x, s, c); }
+			static constexpr double sin(double x) { double s, c; libm_sincos(x, s, c); return s; }
+			static constexpr double cos(double x) { double s, c; libm_sincos(x, s, c); return c; }
+			static constexpr double tan(double x) { double s, c; libm_sincos(x, s, c); return s / c; }
+			static double acos(double x) { return std::acos(x); }
+			static double atan2(double y, double x) { return std::atan2(y, x); }
+
+			static void sincos(float4 x, float4& s, float4& c) { detail::sincos<T>(x, s, c); }
+			static float4 sin(float4 x) { float4 s, c; detail::sincos<T>(x, s, c); return s; }
+			static float4 cos(float4 x) { float4 s, c; detail::sincos<T>(x, s, c); return c; }
+			static float4 tan(float4 x) { float4 s, c; detail::sincos<T>(x, s, c); return simd::div(s, c); }
+			static float4 acos(float4 x) { return detail::acos<T>(x); }
+			static float4 atan2(float4 y, float4 x) { return detail::atan2<T>(y, x); }
+		};
+
+		template <float (*F)(float)>
+		float4 per_lane(float4 x) {
+			alignas(16) float v[4];
+			simd::store(v, x);
+			for (float& f : v) f = F(f);
+			return simd::load(v);
+		}
+	}
+
+	struct Precise : detail::Policy<detail::Tier::Precise> {};
+	struct Fast : detail::Policy<detail::Tier::Fast> {};
+
+	// Constant evaluation can't call libm, so there Std computes with the Precise kernels
+	struct Std {
+		using float4 = simd::float4;
+		using Fallback = detail::Policy<detail::Tier::Precise>;
+
+		static constexpr void sincos(float x, float& s, float& c) {
+			if consteval { Fallback::sincos(x, s, c); }
+			else { s = std::sin(x); c = std::cos(x); }
+		}
+		static constexpr float sin(float x) { if consteval { return Fallback::sin(x); } return std::sin(x); }
+		static constexpr float cos(float x) { if consteval { return Fallback::cos(x); } return std::cos(x); }
+		static constexpr float tan(float x) { if consteval { return Fallback::tan(x); } return std::tan(x); }
+		static constexpr float acos(float x) { if consteval { return Fallback::acos(x); } return std::acos(x); }
+		static constexpr float atan2(float y, float x) { if consteval { return Fallback::atan2(y, x); } return std::atan2(y, x); }
+
+		static constexpr void sincos(double x, double& s, double& c) { detail::libm_sincos(x, s, c); }
+		static constexpr double sin(double x) { double s, c; detail::libm_sincos(x, s, c); return s; }
+		static constexpr double cos(double x) { double s, c; detail::libm_sincos(x, s, c); return c; }
+		static constexpr double tan(double x) { double s, c; detail::libm_sincos(x, s, c); return s / c; }
+		static double acos(double x) { return std::acos(x); }
+		static double atan2(double y, double x) { return std::atan2(y, x); }
+
+		static void sincos(float4 x, float4& s, float4& c) { s = sin(x); c = cos(x); }
+		static float4 sin(float4 x) { return detail::per_lane<sin>(x); }
+		static float4 cos(float4 x) { return detail::per_lane<cos>(x); }
+		static float4 tan(float4 x) { return detail::per_lane<tan>(x); }
+		static float4 acos(float4 x) { return detail::per_lane<acos>(x); }
+		static float4 atan2(float4 y, float4 x) {
+			alignas(16) float ys[4], xs[4];
+			simd::store(ys, y);
+			simd::store(xs, x);
+			for (size_t i = 0; i < 4; ++i) ys[i] = std::atan2(ys[i], xs[i]);
+			return simd::load(ys);
+		}
+	};
+}
@@ -1,4 +1,9 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
 #include <string>
+#include <thread>
 
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
@@ -6,11 +11,45 @@
 #include "Quaternion.h"
 #include "Transforms.h"
 #include "GeometricPrimitives.h"
+#include "SoA.h"
+#include "Expr.h"
+#include "QuaternionBatch.h"
+#include "TransformHierarchy.h"
+#include "Parallel.h"
+#include "BVH.h"
+#include "RayPacket.h"
+#include "BroadPhase.h"
+#include "NarrowPhase.h"
+#include "Frustum.h"
+#include "Instrumentation.h"
+#include "Trig.h"
+#include "TRSBatch.h"
+#include "DualQuaternion.h"
+#include "Skinning.h"
+#include "Mesh.h"
+#include "Compression.h"
+#include "Animation.h"
+#include "BinaryFormat.h"
 
 #include <numbers>
 using std::numbers::pi;
 using namespace Math3D;
 
+// Uniform in [0, 1) from a small LCG, so the randomized tests are the same on every run
+float random_float(uint32_t& seed) {
+	seed = seed * 1664525u + 1013904223u;
+	return float(seed >> 8) / float(1 << 24);
+}
+
+Vec3f random_point(uint32_t& seed, float extent) {
+	return Vec3f(random_float(seed), random_float(seed), random_float(seed)) * extent;
+}
+
+// In a cube of side extent around the origin
+Vec3f random_centered(uint32_t& seed, float extent) {
+	return Vec3f(random_float(seed) - 0.5f, random_float(seed) - 0.5f, random_float(seed) - 0.5f) * extent;
+}
+
 TEST_SUITE("Matrix") {
 
 	TEST_CASE("Construction") {
@@ -146,6 +185,51 @@ TEST_SUITE("Matrix") {
 		});
 	}
 
+	TEST_CASE("Matrix multiplication 4x4") {
+		Mat4f a {
+			1.0f, 2.0f, 3.0f, 4.0f,
+			5.0f, 6.0f, 7.0f, 8.0f,
+			9.0f, 10.0f, 11.0f, 12.0f,
+			13.0f, 14.0f, 15.0f, 16.0f,
+		};
+
+		Mat4f b {
+			2.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 3.0f,
+			1.0f, 0.0f, 2.0f, 0.0f,
+			0.0f, 2.0f, 0.0f, 1.0f,
+		};
+
+		CHECK(a * b == Mat4f {
+			5.0f, 10.0f, 7.0f, 10.0f,
+			17.0f, 22.0f, 19.0f, 26.0f,
+			29.0f, 34.0f, 31.0f, 42.0f,
+			41.0f, 46.0f, 43.0f, 58.0f,
+		});
+
+		CHECK(Vec4f(1.0f, 2.0f, 3.0f, 4.0f) * b == Vec4f(5.0f, 10.0f, 7.0f, 10.0f));
+		CHECK(Mat4f::identity() * a == a);
+	}
+
+	TEST_CASE("Compile-time and runtime multiplication agree") {
+		constexpr Mat4f a {
+			1.0f, 2.0f, 3.0f, 4.0f,
+			5.0f, 6.0f, 7.0f, 8.0f,
+			9.0f, 10.0f, 11.0f, 12.0f,
+			13.0f, 14.0f, 15.0f, 16.0f,
+		};
+		constexpr Mat4f aa = a * a;
+		constexpr Vec4f va = Vec4f(1.0f, 2.0f, 3.0f, 4.0f) * a;
+
+		Mat4f ra = a;
+		Vec4f rv(1.0f, 2.0f, 3.0f, 4.0f);
+
+		CHECK(ra * ra == aa);
+		CHECK(rv * ra == va);
+		CHECK(ra + ra == a * 2.0f);
+		CHECK(ra - ra == Mat4f());
+	}
+
 	TEST_CASE("Scalar division") {
 		CHECK(Vec3f(3.0f, 6.0f, 9.0f) / 3.0f == Vec3f(1.0f, 2.0f, 3.0f));
 	}
@@ -172,6 +256,7 @@ TEST_SUITE("Matrix") {
 
 	TEST_CASE("Inner Product") {
 		CHECK(Vec3f(1.0f, 2.0f, 3.0f).dot(Vec3f(3.0f, 4.0f, 5.0f)) == 26.0f);
+		CHECK(Vec4f(1.0f, 2.0f, 3.0f, 4.0f).dot(Vec4f(3.0f, 4.0f, 5.0f, 6.0f)) == 50.0f);
 	}
 
 	TEST_CASE("Interpolation") {
@@ -267,6 +352,23 @@ TEST_SUITE("Matrix") {
 		);
 	}
 
+	TEST_CASE("Transpose 4x4") {
+		Mat4f m {
+			1.0f, 2.0f, 3.0f, 4.0f,
+			5.0f, 6.0f, 7.0f, 8.0f,
+			9.0f, 10.0f, 11.0f, 12.0f,
+			13.0f, 14.0f, 15.0f, 16.0f,
+		};
+
+		CHECK(m.transpose() == Mat4f {
+			1.0f, 5.0f, 9.0f, 13.0f,
+			2.0f, 6.0f, 10.0f, 14.0f,
+			3.0f, 7.0f, 11.0f, 15.0f,
+			4.0f, 8.0f, 12.0f, 16.0f,
+		});
+		CHECK(m.transpose().transpose() == m);
+	}
+
 	TEST_CASE("Adjoint") {
 		Matrix<int, 3, 3> before {
 			-1, -2, -2,
@@ -349,6 +451,117 @@ TEST_SUITE("Matrix") {
 		CHECK(Mat3f { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,}.nearly_equal(before * before.inverse()));
 	}
 
+	TEST_CASE("Inverse 4x4") {
+		constexpr Mat4f m {
+			2.0f, 1.0f, 3.0f, 4.0f,
+			0.0f, -1.0f, 2.0f, 1.0f,
+			3.0f, 2.0f, 0.0f, 5.0f,
+			-1.0f, 3.0f, 2.0f, 1.0f,
+		};
+
+		// Compile-time closed form against the runtime SIMD path
+		constexpr Mat4f inv = m.inverse();
+		static_assert(m.determinant() == 35.0f);
+
+		Mat4f runtime = m;
+		CHECK(runtime.inverse().nearly_equal(inv));
+		CHECK((runtime * runtime.inverse()).nearly_equal(Mat4f::identity()));
+		CHECK((runtime.adjoint() * (1.0f / 35.0f)).nearly_equal(inv));
+
+		Mat4f projection = perspective((float)pi / 3.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+		CHECK((projection * projection.inverse()).nearly_equal(Mat4f::identity()));
+	}
+
+	TEST_CASE("Try Inverse") {
+		constexpr Mat3f singular {
+			1.0f, 2.0f, 3.0f,
+			4.0f, 5.0f, 6.0f,
+			7.0f, 8.0f, 9.0f,
+		};
+		static_assert(!singular.try_inverse());
+
+		Mat4f singular4 {
+			1.0f, 2.0f, 3.0f, 4.0f,
+			2.0f, 4.0f, 6.0f, 8.0f,
+			0.0f, 1.0f, 0.0f, 1.0f,
+			1.0f, 0.0f, 1.0f, 0.0f,
+		};
+		CHECK(!singular4.try_inverse());
+
+		Mat3f invertible {
+			4.0f, 3.0f, 8.0f,
+			6.0f, 2.0f, 5.0f,
+			1.0f, 5.0f, 9.0f
+		};
+		REQUIRE(invertible.try_inverse());
+		CHECK(invertible.try_inverse()->nearly_equal(invertible.inverse()));
+
+		// Rank deficient in exact arithmetic, but rounding leaves a determinant of about 1e-8
+		Mat3f rank2 {
+			0.1f, 0.2f, 0.3f,
+			0.4f, 0.5f, 0.6f,
+			0.7f, 0.8f, 0.9f,
+		};
+		CHECK(rank2.determinant() != 0.0f);
+		CHECK(!rank2.try_inverse());
+		static_assert(!Mat3f { 0.1f, 0.2f, 0.3f, 0.4f, 0.5f, 0.6f, 0.7f, 0.8f, 0.9f }.try_inverse());
+
+		Mat4f rank2_4 {
+			0.1f, 0.2f, 0.3f, 0.4f,
+			0.5f, 0.6f, 0.7f, 0.8f,
+			0.9f, 1.0f, 1.1f, 1.2f,
+			1.3f, 1.4f, 1.5f, 1.6f,
+		};
+		CHECK(!rank2_4.try_inverse());
+		static_assert(!Mat4f { 0.1f, 0.2f, 0.3f, 0.4f, 0.5f, 0.6f, 0.7f, 0.8f, 0.9f, 1.0f, 1.1f, 1.2f, 1.3f, 1.4f, 1.5f, 1.6f }.try_inverse());
+
+		// The same test on the Gauss-Jordan path
+		Matrix<float, 5, 5> rank4;
+		for (size_t r = 0; r < 5; ++r) {
+			for (size_t c = 0; c < 5; ++c) rank4.data[r][c] = 0.1f * float(r * 5 + c + 1);
+		}
+		rank4.data[0][0] = 2.0f;
+		rank4.data[1][1] = -1.0f;
+		CHECK(!rank4.try_inverse());
+
+		// Scale doesn't matter: a tiny but well conditioned matrix still inverts
+		Mat3f tiny = invertible * 1e-6f;
+		REQUIRE(tiny.try_inverse());
+		CHECK((tiny * *tiny.try_inverse()).nearly_equal(Mat3f::identity()));
+		Mat4f tiny4 = Mat4f::identity() * 1e-5f;
+		CHECK(tiny4.try_inverse());
+	}
+
+	TEST_CASE("Gauss-Jordan") {
+		Matrix<int, 5, 5> cofactor {
+			2, 0, 1, 3, -1,
+			1, 4, 0, 2, 2,
+			0, 3, 5, 1, 0,
+			-2, 1, 0, 4, 3,
+			1, 0, 2, 0, 6,
+		};
+
+		Matrix<double, 5, 5> m;
+		for (size_t i = 0; i < m.N; ++i) {
+			m.arr[i] = cofactor.arr[i];
+		}
+
+		CHECK(m.determinant() == doctest::Approx(cofactor.determinant()));
+
+		auto inv = m.try_inverse();
+		REQUIRE(inv);
+
+		Matrix<double, 5, 5> product = m * *inv;
+		for (size_t r = 0; r < 5; ++r) {
+			for (size_t c = 0; c < 5; ++c) {
+				CHECK(product.data[r][c] == doctest::Approx(r == c ? 1.0 : 0.0));
+			}
+		}
+
+		Matrix<double, 6, 6> singular;
+		CHECK(!singular.try_inverse());
+	}
+
 	TEST_CASE("Swizzle") {
 		CHECK(Vec3f(1.0f, 2.0f, 3.0f).swizzle<0, 1, 2>() == Vec3f(1.0f, 2.0f, 3.0f));
 		CHECK(Vec3f(1.0f, 2.0f, 3.0f).swizzle<2, 0, 1>() == Vec3f(3.0f, 1.0f, 2.0f));
@@ -416,6 +629,100 @@ TEST_SUITE("Transforms") {
 		});
 	}
 
+	TEST_CASE("Compose") {
+		Quaternion q(Vec3f(0.0f, 0.0f, 1.0f), (float)pi / 2.0f);
+		Xformf m = compose(q, Vec3f(1.0f, 2.0f, 3.0f), Vec3f(2.0f, 2.0f, 2.0f));
+
+		// Scale, then rotate, then translate; the translation is not scaled
+		CHECK(nearly_equal(m, scale(Vec3f(2.0f, 2.0f, 2.0f)) * rot90z * translation(Vec3f(1.0f, 2.0f, 3.0f))));
+		CHECK(m[3] == Vec3f(1.0f, 2.0f, 3.0f));
+		CHECK(nearly_equal(compose(Quaternion(0.0f, 0.0f, 0.0f, 1.0f), Vec3f(0.0f, 0.0f, 0.0f), Vec3f(1.0f, 1.0f, 1.0f)), Identity));
+	}
+
+	bool same_rotation(const Quaternion& a, const Quaternion& b) {
+		return std::fabs(std::fabs(a.Dot(b)) - 1.0f) < 1e-5f;
+	}
+
+	bool close(const Xformf& a, const Xformf& b, float tolerance) {
+		for (size_t n = 0; n < 12; ++n) {
+			if (std::fabs(a.arr[n] - b.arr[n]) > tolerance) return false;
+		}
+		return true;
+	}
+
+	TEST_CASE("Decompose") {
+		Quaternion identity_rotation;
+		Vec3f t, s;
+		decompose(Identity, identity_rotation, t, s);
+		CHECK(identity_rotation == Quaternion(0.0f, 0.0f, 0.0f, 1.0f));
+		CHECK(t == Vec3f(0.0f, 0.0f, 0.0f));
+		CHECK(nearly_equal(s, Vec3f(1.0f, 1.0f, 1.0f)));
+
+		Quaternion q = Quaternion(Vec3f(0.3f, -0.5f, 0.8f), 2.2f);
+		q = q.r < 0.0f ? q * -1.0f : q;
+		for (Vec3f factors : { Vec3f(1.0f, 1.0f, 1.0f), Vec3f(2.0f, 0.5f, 3.0f), Vec3f(0.01f, 40.0f, 1.0f), Vec3f(-2.0f, 1.5f, 1.0f) }) {
+			Xformf m = compose(q, Vec3f(1.0f, -2.0f, 3.0f), factors);
+			Quaternion rotation;
+			decompose(m, rotation, t, s);
+			CHECK(rotation.r >= 0.0f);
+			CHECK(same_rotation(rotation, q));
+			CHECK(t == Vec3f(1.0f, -2.0f, 3.0f));
+			for (size_t n = 0; n < 3; ++n) CHECK(s[n] == doctest::Approx(factors[n]).epsilon(1e-5));
+			CHECK(close(compose(rotation, t, s), m, 1e-5f));
+		}
+
+		// A mirror on any axis comes back as a negative first scale and the matching rotation
+		Xformf mirrored = compose(q, Vec3f(), Vec3f(1.0f, -2.0f, 3.0f));
+		Quaternion rotation;
+		decompose(mirrored, rotation, t, s);
+		CHECK(s[0] == doctest::Approx(-1.0f));
+		CHECK(s[1] == doctest::Approx(2.0f));
+		CHECK(rotation.Mag() == doctest::Approx(1.0f));
+		CHECK(close(compose(rotation, t, s), mirrored, 1e-5f));
+
+		// A zero scale still gives a unit rotation that composes back
+		Xformf flat = compose(q, Vec3f(), Vec3f(0.0f, 1.0f, 2.0f));
+		decompose(flat, rotation, t, s);
+		CHECK(rotation.Mag() == doctest::Approx(1.0f));
+		CHECK(close(compose(rotation, t, s), flat, 1e-5f));
+	}
+
+	TEST_CASE("Decompose Shear") {
+		// Symmetric stretch times rotation, so the polar factors are known
+		Mat3f stretch { 2.0f, 0.5f, 0.0f, 0.5f, 1.0f, 0.25f, 0.0f, 0.25f, 1.5f };
+		Quaternion q = Quaternion(Vec3f(1.0f, 1.0f, 0.0f), 0.9f);
+		Xformf r = q.ToRot();
+		Mat3f linear = stretch * Mat3f { r[0][0], r[0][1], r[0][2], r[1][0], r[1][1], r[1][2], r[2][0], r[2][1], r[2][2] };
+		Xformf m {
+			linear[0][0], linear[0][1], linear[0][2],
+			linear[1][0], linear[1][1], linear[1][2],
+			linear[2][0], linear[2][1], linear[2][2],
+			5.0f,         6.0f,         7.0f,
+		};
+
+		Quaternion rotation;
+		Vec3f t, s;
+		Mat3f out_stretch;
+		decompose(m, rotation, t, out_stretch);
+		CHECK(same_rotation(rotation, q));
+		CHECK(t == Vec3f(5.0f, 6.0f, 7.0f));
+		for (size_t n = 0; n < 9; ++n) CHECK(out_stretch.arr[n] == doctest::Approx(stretch.arr[n]).epsilon(1e-4));
+
+		decompose(m, rotation, t, s);
+		CHECK(nearly_equal(s, Vec3f(out_stretch[0][0], out_stretch[1][1], out_stretch[2][2])));
+
+		// Shear together with a mirror
+		m.data[0][0] *= -1.0f;
+		m.data[0][1] *= -1.0f;
+		m.data[0][2] *= -1.0f;
+		decompose(m, rotation, t, out_stretch);
+		Xformf u = rotation.ToRot();
+		Mat3f back = out_stretch * Mat3f { u[0][0], u[0][1], u[0][2], u[1][0], u[1][1], u[1][2], u[2][0], u[2][1], u[2][2] };
+		for (size_t row = 0; row < 3; ++row) {
+			for (size_t col = 0; col < 3; ++col) CHECK(back[row][col] == doctest::Approx(m[row][col]).epsilon(1e-4));
+		}
+	}
+
 	TEST_CASE("Look At") {
 		CHECK(nearly_equal(look_at(translation(Vec3f{0.0f, 0.0f, -1.0f}), Identity), Xformf {
 			1.0f, 0.0f, 0.0f,
@@ -425,6 +732,27 @@ TEST_SUITE("Transforms") {
 		}));
 	}
 
+	TEST_CASE("Affine Inverse") {
+		Xformf rigid = rotation(Vec3f(1.0f, 2.0f, 3.0f).normalize(), 0.7f) * translation(Vec3f(4.0f, -5.0f, 6.0f));
+		Xformf uniform = scale(Vec3f(2.5f, 2.5f, 2.5f)) * rigid;
+		Xformf general = scale(Vec3f(2.0f, 3.0f, 0.5f)) * rigid;
+		general.data[1][0] = 0.75f;
+
+		CHECK(nearly_equal(rigid * rigid.affine_inverse<AffineKind::Rigid>(), Identity));
+		CHECK(nearly_equal(rigid.affine_inverse<AffineKind::Rigid>() * rigid, Identity));
+		CHECK(nearly_equal(uniform * uniform.affine_inverse<AffineKind::UniformScale>(), Identity));
+		CHECK(nearly_equal(general * general.affine_inverse(), Identity));
+
+		// Agrees with the full 4x4 inverse
+		Mat4f promoted = general * Mat4f::identity();
+		Mat4f expected = promoted.inverse();
+		Mat4f actual = general.affine_inverse() * Mat4f::identity();
+		CHECK(nearly_equal(actual, expected));
+
+		constexpr Xformf shifted = Xformf::identity() + Xformf(array<float, 12>{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 1.0f, 2.0f, 3.0f });
+		static_assert(shifted.affine_inverse<AffineKind::Rigid>().arr[10] == -2.0f);
+	}
+
 	TEST_CASE("Perspective Projection") {
 
 		// Row major
@@ -462,6 +790,501 @@ TEST_SUITE("Transforms") {
 
 		CHECK(nearly_equal(model * view * projection, expected));
 	}
+
+	TEST_CASE("Constant Evaluation") {
+		// Every builder folds to a constant...
+		constexpr Xformf shift = translation(Vec3f(1.0f, 2.0f, 3.0f));
+		static_assert(shift.arr[9] == 1.0f && shift.arr[10] == 2.0f && shift.arr[11] == 3.0f && shift.arr[0] == 1.0f);
+		static_assert(scale(Vec3f(2.0f, 3.0f, 4.0f)).arr[4] == 3.0f);
+		static_assert(rotX(0.0f) == Identity && rotY<trig::Fast>(0.0f) == Identity && rotZ<trig::Std>(0.0f) == Identity);
+
+		constexpr Xformf turn = rotZ((float)pi / 2.0f);
+		static_assert(cx::abs(turn.arr[0]) < 1e-7f && turn.arr[1] == -1.0f && turn.arr[3] == 1.0f);
+
+		constexpr Xformf spin = rotation(Vec3f(1.0f, 2.0f, -0.5f), 0.8f);
+		constexpr Mat4f projection = perspective((float)pi / 2.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+		static_assert(cx::abs(projection.arr[5] - 1.0f) < 1e-6f && projection.arr[11] == 1.0f);
+		constexpr Mat4f ortho = orthographic(4.0f, 2.0f, 0.5f, 1.0f);
+		static_assert(ortho.arr[0] == 0.25f && ortho.arr[14] == 0.5f);
+		constexpr Xformf view = look_at(translation(Vec3f(0.0f, 0.0f, -1.0f)), Identity);
+		static_assert(view.arr[11] == 1.0f);
+
+		constexpr Quaternion q(Vec3f(1.0f, -2.0f, 0.5f), 1.2f);
+		static_assert(cx::abs(q.Mag() - 1.0f) < 1e-6f);
+		constexpr Quaternion from_matrix(rotY(0.8f));
+		static_assert(cx::abs(from_matrix.j - 0.38941834f) < 1e-6f && from_matrix.i == 0.0f);
+		constexpr Xformf composed = compose(q, Vec3f(1.0f, 2.0f, 3.0f), Vec3f(2.0f, 0.5f, 1.0f));
+		constexpr Xformf rot = q.ToRot();
+		static_assert(composed.arr[0] == 2.0f * rot.arr[0] && composed.arr[11] == 3.0f);
+
+		constexpr Xformd far = compose(q, Vec3d(1e7, 0.25, -3e6), Vec3d(1.0, 1.0, 1.0));
+		constexpr Xformd tilt = rotXd(0.3);
+		static_assert(far.arr[9] == 1e7 && cx::abs(tilt.arr[4] - 0.955336489125606) < 1e-15);
+		static_assert(cx::sqrt(2.0f) == 1.41421354f && cx::sqrt(0.0f) == 0.0f);
+
+		// ...that agrees with the same call at runtime
+		volatile float half_pi = (float)pi / 2.0f, angle = 0.8f, y_angle = 0.8f;
+		volatile double x_angle = 0.3;
+		CHECK(nearly_equal(turn, rotZ(float(half_pi))));
+		CHECK(nearly_equal(spin, rotation(Vec3f(1.0f, 2.0f, -0.5f), float(angle))));
+		CHECK(nearly_equal(projection, perspective(float(half_pi), 16.0f / 9.0f, 0.1f, 100.0f)));
+		CHECK(nearly_equal(view, look_at(translation(Vec3f(0.0f, 0.0f, -1.0f)), Identity)));
+		CHECK(from_matrix.nearly_equal(Quaternion(rotY(float(y_angle)))));
+		CHECK(nearly_equal(composed, compose(Quaternion(Vec3f(1.0f, -2.0f, 0.5f), 1.2f), Vec3f(1.0f, 2.0f, 3.0f), Vec3f(2.0f, 0.5f, 1.0f))));
+		CHECK(nearly_equal(tilt, rotXd(double(x_angle))));
+
+		// Std has no libm at compile time and uses the Precise kernels there
+		constexpr Xformf std_turn = rotZ<trig::Std>((float)pi / 2.0f);
+		CHECK(nearly_equal(std_turn, rotZ<trig::Std>(float(half_pi))));
+	}
+}
+
+TEST_SUITE("Large Worlds") {
+	template <class A, class B>
+	bool close(const A& a, const B& b, double tolerance) {
+		for (size_t k = 0; k < a.N; ++k) if (std::fabs(double(a.arr[k]) - double(b.arr[k])) > tolerance) return false;
+		return true;
+	}
+
+	TEST_CASE("Epsilon") {
+		CHECK(nearly_equal(1.0f, 1.0f + 5e-7f));
+		CHECK(!nearly_equal(1.0, 1.0 + 5e-7));
+		CHECK(nearly_equal(1.0, 1.0 + 1e-13));
+
+		// Doubles compare relative to their magnitude, so positions 100 km out keep a tolerance
+		CHECK(nearly_equal(1e5, 1e5 + 1e-8));
+		CHECK(nearly_equal(-1e5 - 1e-8, -1e5));
+		CHECK(!nearly_equal(1e5, 1e5 + 1e-6));
+		CHECK(nearly_equal(Vec3d(1e5, -2e5, 0.5), Vec3d(1e5 + 1e-8, -2e5 - 2e-8, 0.5)));
+		CHECK(!nearly_equal(Vec3d(1e5, -2e5, 0.5), Vec3d(1e5, -2e5, 0.5 + 1e-9)));
+		CHECK(std::is_same_v<decltype(rotX(pi / 2.0f)), Xformf> && std::is_same_v<decltype(rotXd(pi / 2.0f)), Xformd>);
+		CHECK(nearly_equal(3, 3));
+		CHECK(!nearly_equal(3, 4));
+		CHECK(Xformd() == Identityd);
+		CHECK(Xformf(Identityd) == Identity);
+	}
+
+	TEST_CASE("Double Builders") {
+		Vec3f axis(0.3f, -1.0f, 0.5f);
+		Quaternion q(axis, 0.7f);
+
+		CHECK(close(rotation(Vec3d(axis), 0.7), rotation(axis, 0.7f), 1e-6));
+		CHECK(close(rotXd(0.7), rotX(0.7f), 1e-6));
+		CHECK(close(rotYd(0.7), rotY(0.7f), 1e-6));
+		CHECK(close(rotZd(0.7), rotZ(0.7f), 1e-6));
+		CHECK(close(rotation<trig::Fast>(Vec3d(axis), 0.7), rotation(Vec3d(axis), 0.7), 1e-15));
+		CHECK(close(compose(q, Vec3d(1.0, 2.0, 3.0), Vec3d(2.0, 1.0, 0.5)), compose(q, Vec3f(1.0f, 2.0f, 3.0f), Vec3f(2.0f, 1.0f, 0.5f)), 1e-6));
+		CHECK(close(look_at(translation(Vec3d(1.0, 2.0, -3.0)), Identityd), look_at(translation(Vec3f(1.0f, 2.0f, -3.0f)), Identity), 1e-6));
+		CHECK(distance(Vec3d(1e7, 2.0, 3.0), Vec3d(1e7 + 3.0, 6.0, 3.0)) == 5.0);
+	}
+
+	TEST_CASE("Double Decompose") {
+		// Far enough out that a float translation would be off by half a metre
+		Quaternion q(Vec3f(1.0f, 2.0f, -0.5f), 2.1f);
+		Vec3d t(1.5e7 + 0.125, -2e6 + 0.0625, 8e6 + 0.25), s(1.5, 0.25, 3.0);
+		Xformd xform = compose(q, t, s);
+
+		Quaternion rotation;
+		Vec3d translation, scale_factors;
+		decompose(xform, rotation, translation, scale_factors);
+		CHECK(translation == t);
+		CHECK(std::fabs(rotation.Dot(q)) == doctest::Approx(1.0f).epsilon(1e-6));
+		for (size_t k = 0; k < 3; ++k) CHECK(scale_factors[k] == doctest::Approx(s[k]).epsilon(1e-6));
+
+		Vec3d points[2] = { Vec3d(1.0, 0.0, 0.0), Vec3d(0.0, 2.0, -1.0) }, moved[2], turned[2];
+		transform_points(xform, points, moved);
+		transform_vectors(xform, points, turned);
+		for (size_t n = 0; n < 2; ++n) {
+			Vec3d expected = Vec3d(xform[0]) * points[n][0] + Vec3d(xform[1]) * points[n][1] + Vec3d(xform[2]) * points[n][2];
+			CHECK(close(turned[n], expected, 1e-12));
+			CHECK(close(moved[n], expected + t, 1e-8));
+		}
+	}
+
+	TEST_CASE("View Space") {
+		// A camera 1000 km out looking at objects a few metres away
+		Vec3d eye(1e6 + 0.3, 120.0, -2.5e6 - 0.7);
+		Xformd camera = compose(Quaternion(Vec3f(0.2f, 1.0f, 0.1f), 0.9f), eye, Vec3d(1.0, 1.0, 1.0));
+		Xformd view = camera.affine_inverse();
+
+		vector<Xformd> world;
+		for (size_t n = 0; n < 5003; ++n) {
+			Quaternion q(Vec3f(1.0f, float(n % 7), 0.5f), float(n) * 0.01f);
+			Vec3d offset(double(n % 13) * 0.37, double(n % 5) * -0.21, 2.0 + double(n % 11) * 0.5);
+			world.push_back(compose(q, eye + offset, Vec3d(1.0, 2.0, 0.5)));
+		}
+
+		vector<Xformf> out(world.size());
+		to_view_space(camera, world, out);
+		for (size_t n = 0; n < world.size(); n += 97) {
+			Xformd expected = world[n] * view;
+			CHECK(close(out[n], expected, 1e-5));
+			CHECK(out[n] == to_view_space(camera, world[n]));
+		}
+
+		// Doing the same in float loses the offset to the rounding of the world position
+		Xformf naive = Xformf(world[1]) * Xformf(camera).affine_inverse();
+		CHECK(!close(naive, world[1] * view, 1e-2));
+	}
+}
+
+TEST_SUITE("SoA") {
+	Vec3fSoA make_soa(size_t count, float offset) {
+		Vec3fSoA soa;
+		for (size_t i = 0; i < count; ++i) {
+			soa.push_back(Vec3f(float(i) + offset, 2.0f * float(i) - offset, 1.0f - float(i) * offset));
+		}
+		return soa;
+	}
+
+	TEST_CASE("Alignment") {
+		Vec3fSoA soa(5);
+		CHECK(reinterpret_cast<uintptr_t>(soa.x().data()) % 64 == 0);
+		CHECK(reinterpret_cast<uintptr_t>(soa.z().data()) % 64 == 0);
+		CHECK(reinterpret_cast<uintptr_t>(VecSoA<float, 4, 16>(3).w().data()) % 16 == 0);
+	}
+
+	TEST_CASE("Batch kernels match Matrix members") {
+		// 11 exercises both the four-wide body and the padded tail
+		Vec3fSoA a = make_soa(11, 0.5f);
+		Vec3fSoA b = make_soa(11, -1.5f);
+		Vec3fSoA sum, diff, scaled, crossed, normalized, blended;
+		vector<float> dots(11), lengths(11);
+
+		add(a, b, sum);
+		sub(a, b, diff);
+		scale(a, 3.0f, scaled);
+		cross(a, b, crossed);
+		normalize(a, normalized);
+		lerp(a, b, 0.25f, blended);
+		dot(a, b, dots);
+		length(a, lengths);
+
+		for (size_t i = 0; i < a.size(); ++i) {
+			Vec3f va = a.get(i), vb = b.get(i);
+			CHECK(sum.get(i) == va + vb);
+			CHECK(diff.get(i) == va - vb);
+			CHECK(scaled.get(i) == va * 3.0f);
+			CHECK(crossed.get(i) == va.cross(vb));
+			CHECK(normalized.get(i).nearly_equal(va.normalize()));
+			CHECK(blended.get(i).nearly_equal(va.lerp(vb, 0.25f)));
+			CHECK(dots[i] == doctest::Approx(va.dot(vb)));
+			CHECK(lengths[i] == doctest::Approx(va.length()));
+		}
+	}
+
+	TEST_CASE("In place") {
+		Vec3fSoA a = make_soa(6, 1.0f);
+		Vec3fSoA expected = make_soa(6, 1.0f);
+		add(a, a, a);
+		scale(expected, 2.0f, expected);
+
+		for (size_t i = 0; i < a.size(); ++i) {
+			CHECK(a.get(i) == expected.get(i));
+		}
+	}
+
+	TEST_CASE("Vec3f AoS round trip") {
+		vector<Vec3f> aos;
+		for (size_t i = 0; i < 7; ++i) {
+			aos.push_back(Vec3f(float(i), float(i) + 0.5f, -float(i)));
+		}
+
+		Vec3fSoA soa;
+		to_soa(aos, soa);
+		REQUIRE(soa.size() == aos.size());
+		for (size_t i = 0; i < aos.size(); ++i) {
+			CHECK(soa.x()[i] == aos[i][0]);
+			CHECK(soa.y()[i] == aos[i][1]);
+			CHECK(soa.z()[i] == aos[i][2]);
+		}
+
+		vector<Vec3f> back(aos.size());
+		to_aos(soa, back);
+		CHECK(back == aos);
+	}
+
+	TEST_CASE("Vert3d AoS round trip") {
+		vector<Vert3d> verts;
+		for (size_t i = 0; i < 9; ++i) {
+			float f = float(i);
+			verts.push_back(Vert3d { Vec3f(f, f + 1.0f, f + 2.0f), Vec3f(-f, -f - 1.0f, -f - 2.0f), Vec2f(f * 0.5f, f * 0.25f) });
+		}
+
+		Vert3dSoA soa;
+		to_soa(verts, soa);
+		REQUIRE(soa.size() == verts.size());
+		for (size_t i = 0; i < verts.size(); ++i) {
+			CHECK(soa.pos.get(i) == verts[i].pos);
+			CHECK(soa.norm.get(i) == verts[i].norm);
+			CHECK(soa.uv.get(i) == verts[i].uv);
+		}
+
+		vector<Vert3d> back(verts.size());
+		to_aos(soa, back);
+		for (size_t i = 0; i < verts.size(); ++i) {
+			CHECK(back[i].pos == verts[i].pos);
+			CHECK(back[i].norm == verts[i].norm);
+			CHECK(back[i].uv == verts[i].uv);
+		}
+	}
+}
+
+TEST_SUITE("Batch Transforms") {
+	Xformf test_xform() {
+		return rotation(Vec3f(1.0f, 2.0f, 3.0f), 0.7f) * scale(Vec3f(2.0f, 0.5f, 1.5f)) * translation(Vec3f(4.0f, -5.0f, 6.0f));
+	}
+
+	vector<Vec3f> test_points(size_t count) {
+		vector<Vec3f> points;
+		for (size_t i = 0; i < count; ++i) {
+			float f = float(i);
+			points.push_back(Vec3f(f * 0.5f - 2.0f, 1.0f - f * 0.25f, f * 0.1f + 0.3f));
+		}
+		return points;
+	}
+
+	// Reference through the generic row vector * Mat4f path
+	Vec4f reference(const Mat4f& m, const Vec3f& p, float w) {
+		return Vec4f(p[0], p[1], p[2], w) * m;
+	}
+
+	TEST_CASE("Points and vectors") {
+		Xformf xform = test_xform();
+		Mat4f promoted = xform * Mat4f::identity();
+		vector<Vec3f> in = test_points(7);
+		vector<Vec3f> points(in.size()), vectors(in.size());
+
+		transform_points(xform, in, points);
+		transform_vectors(xform, in, vectors);
+
+		for (size_t i = 0; i < in.size(); ++i) {
+			Vec4f p = reference(promoted, in[i], 1.0f);
+			Vec4f v = reference(promoted, in[i], 0.0f);
+			CHECK(points[i].nearly_equal(Vec3f(p[0], p[1], p[2])));
+			CHECK(vectors[i].nearly_equal(Vec3f(v[0], v[1], v[2])));
+		}
+
+		transform_points(xform, in);
+		CHECK(in == points);
+	}
+
+	TEST_CASE("Homogeneous points") {
+		Mat4f m = test_xform() * perspective(1.0f, 1.5f, 0.1f, 50.0f);
+		vector<Vec4f> in, out(5);
+		for (size_t i = 0; i < out.size(); ++i) {
+			in.push_back(Vec4f(float(i), 1.0f, -float(i), 1.0f));
+		}
+
+		transform_points(m, in, out);
+		for (size_t i = 0; i < in.size(); ++i) {
+			CHECK(out[i] == in[i] * m);
+		}
+	}
+
+	TEST_CASE("Normals") {
+		Xformf xform = test_xform();
+		vector<Vec3f> normals { Vec3f(1.0f, 0.0f, 0.0f), Vec3f(0.0f, 1.0f, 0.0f), Vec3f(0.0f, 0.0f, 1.0f), Vec3f(0.6f, 0.8f, 0.0f), Vec3f(0.0f, 0.6f, -0.8f) };
+		vector<Vec3f> tangents { Vec3f(0.0f, 1.0f, 0.0f), Vec3f(0.0f, 0.0f, 1.0f), Vec3f(1.0f, 0.0f, 0.0f), Vec3f(-0.8f, 0.6f, 0.0f), Vec3f(1.0f, 0.0f, 0.0f) };
+
+		transform_vectors(xform, tangents);
+		transform_normals(xform, normals);
+
+		for (size_t i = 0; i < normals.size(); ++i) {
+			CHECK(normals[i].length() == doctest::Approx(1.0f));
+			CHECK(std::abs(normals[i].dot(tangents[i])) < 1e-5f);
+		}
+	}
+
+	TEST_CASE("Projection") {
+		Mat4f view_projection = look_at(translation(Vec3f(0.0f, 0.0f, -5.0f)), Identity) * perspective((float)pi / 2.0f, 1.0f, 0.1f, 100.0f);
+		vector<Vec3f> in = test_points(6), out(6);
+
+		project_points(view_projection, in, out);
+		for (size_t i = 0; i < in.size(); ++i) {
+			Vec4f clip = reference(view_projection, in[i], 1.0f);
+			CHECK(out[i].nearly_equal(Vec3f(clip[0] / clip[3], clip[1] / clip[3], clip[2] / clip[3])));
+		}
+
+		project_points(view_projection, in);
+		CHECK(in == out);
+	}
+}
+
+TEST_SUITE("Expressions") {
+	Vec4f a(1.0f, 2.0f, 3.0f, 4.0f);
+	Vec4f b(-2.0f, 0.5f, 1.0f, 3.0f);
+	Vec4f c(0.25f, -1.0f, 2.0f, -3.0f);
+
+	TEST_CASE("Fused matches eager") {
+		Vec4f fused = lazy(a) * 2.0f + lazy(b) * 3.0f - c;
+		CHECK(fused.nearly_equal(a * 2.0f + b * 3.0f - c));
+
+		Vec4f shifted = (lazy(a) - b) / 2.0f + 1.0f;
+		CHECK(shifted.nearly_equal((a - b) / 2.0f + 1.0f));
+
+		CHECK(expr::eval(expr::madd(a, 0.5f, b)).nearly_equal(a * 0.5f + b));
+		CHECK(expr::eval(expr::lerp(a, b, 0.25f)).nearly_equal(a.lerp(b, 0.25f)));
+		CHECK(expr::normalize(lazy(a) - b).nearly_equal((a - b).normalize()));
+	}
+
+	TEST_CASE("Evaluate into an operand") {
+		Vec4f r = a;
+		expr::eval_into(lazy(r) * 2.0f - b, r);
+		CHECK(r.nearly_equal(a * 2.0f - b));
+	}
+
+	TEST_CASE("Compile time") {
+		constexpr Vec3f x(1.0f, 2.0f, 3.0f);
+		constexpr Vec3f y(4.0f, 5.0f, 6.0f);
+		constexpr Vec3f r = expr::eval(lazy(x) * 2.0f + y);
+		static_assert(r.arr[0] == 6.0f && r.arr[1] == 9.0f && r.arr[2] == 12.0f);
+
+		// Past 16 elements normalize skips the eager path and takes its own square root
+		constexpr Matrix<float, 5, 4> big = expr::normalize(lazy(Matrix<float, 5, 4>()) + 2.0f);
+		static_assert(cx::abs(big.arr[0] - 0.2236068f) < 1e-6f && big.arr[19] == big.arr[0]);
+	}
+
+	TEST_CASE("Large matrices") {
+		Matrix<float, 8, 8> m, n;
+		for (size_t i = 0; i < m.N; ++i) {
+			m.arr[i] = (float)i;
+			n.arr[i] = 64.0f - i;
+		}
+
+		Matrix<float, 8, 8> fused = expr::lerp(m, n, 0.5f) * 2.0f - m;
+		CHECK(fused.nearly_equal(m.lerp(n, 0.5f) * 2.0f - m));
+	}
+}
+
+TEST_SUITE("Transform Hierarchy") {
+	Quaternion turn(float angle) { return Quaternion(Vec3f(0.0f, 1.0f, 0.0f), angle); }
+
+	// Reference world transform by walking up the parents
+	Xformf naive_world(const TransformHierarchy& h, TransformHierarchy::Handle node) {
+		Xformf world = compose(h.rotation(node), h.translation(node), h.scale(node));
+		for (auto p = h.parent(node); p != TransformHierarchy::None; p = h.parent(p)) {
+			world = world * compose(h.rotation(p), h.translation(p), h.scale(p));
+		}
+		return world;
+	}
+
+	TEST_CASE("World transforms") {
+		TransformHierarchy h;
+		auto root = h.add(TransformHierarchy::None, turn(0.5f), Vec3f(10.0f, 0.0f, 0.0f));
+		auto child = h.add(root, turn(0.25f), Vec3f(0.0f, 1.0f, 0.0f), Vec3f(2.0f, 2.0f, 2.0f));
+		auto grandchild = h.add(child, turn(-1.0f), Vec3f(0.0f, 0.0f, 3.0f));
+
+		CHECK(h.update() == 3);
+		CHECK(h.depth() == 3);
+		CHECK(h.parent(grandchild) == child);
+		CHECK(nearly_equal(h.world(root), compose(turn(0.5f), Vec3f(10.0f, 0.0f, 0.0f), Vec3f(1.0f, 1.0f, 1.0f))));
+		CHECK(nearly_equal(h.world(grandchild), naive_world(h, grandchild)));
+	}
+
+	TEST_CASE("Only dirty subtrees recompute") {
+		TransformHierarchy h;
+		auto a = h.add(TransformHierarchy::None);
+		auto b = h.add(TransformHierarchy::None);
+		auto a1 = h.add(a, turn(0.1f), Vec3f(1.0f, 0.0f, 0.0f));
+		auto a2 = h.add(a1, turn(0.2f), Vec3f(1.0f, 0.0f, 0.0f));
+		auto b1 = h.add(b, turn(0.3f), Vec3f(0.0f, 1.0f, 0.0f));
+
+		CHECK(h.update() == 5);
+		CHECK(h.update() == 0);
+
+		Xformf b1_before = h.world(b1);
+		h.set_translation(a1, Vec3f(5.0f, 0.0f, 0.0f));
+		CHECK(h.update() == 2);
+		CHECK(h.world(b1) == b1_before);
+		CHECK(nearly_equal(h.world(a2), naive_world(h, a2)));
+
+		h.set_rotation(a, turn(1.0f));
+		h.set_scale(b, Vec3f(3.0f, 3.0f, 3.0f));
+		CHECK(h.update() == 5);
+		for (auto node : {a, b, a1, a2, b1}) {
+			CHECK(nearly_equal(h.world(node), naive_world(h, node)));
+		}
+	}
+
+	TEST_CASE("Handles survive reordering") {
+		TransformHierarchy h;
+		auto root = h.add(TransformHierarchy::None, turn(0.4f));
+		auto deep = h.add(root, turn(0.4f), Vec3f(1.0f, 0.0f, 0.0f));
+		h.update();
+
+		// Added after a deeper node, so the breadth-first order has to be rebuilt
+		auto second_root = h.add(TransformHierarchy::None, turn(-0.4f), Vec3f(0.0f, 2.0f, 0.0f));
+		auto deeper = h.add(deep, turn(0.4f), Vec3f(1.0f, 0.0f, 0.0f));
+		CHECK(h.update() == 2);
+
+		CHECK(h.parent(deeper) == deep);
+		CHECK(h.parent(second_root) == TransformHierarchy::None);
+		CHECK(nearly_equal(h.world(deeper), naive_world(h, deeper)));
+		CHECK(nearly_equal(h.world(second_root), compose(turn(-0.4f), Vec3f(0.0f, 2.0f, 0.0f), Vec3f(1.0f, 1.0f, 1.0f))));
+	}
+
+	TEST_CASE("Parallel update matches serial") {
+		TransformHierarchy serial, parallel;
+		uint32_t seed = 12345;
+		for (uint32_t n = 0; n < 3000; ++n) {
+			seed = seed * 1664525u + 1013904223u;
+			auto parent = n < 4 ? TransformHierarchy::None : (seed >> 8) % n;
+			Quaternion q = turn(0.001f * n);
+			Vec3f t(0.01f * (n % 7), 0.0f, 0.02f * (n % 5));
+			serial.add(parent, q, t);
+			parallel.add(parent, q, t);
+		}
+
+		CHECK(serial.update(~size_t(0)) == 3000);
+		CHECK(parallel.update(16) == 3000);
+		for (TransformHierarchy::Handle n = 0; n < 3000; ++n) {
+			REQUIRE(serial.world(n) == parallel.world(n));
+		}
+	}
+
+	TEST_CASE("Sparse updates") {
+		TransformHierarchy h;
+		uint32_t seed = 777;
+		for (uint32_t n = 0; n < 5000; ++n) {
+			seed = seed * 1664525u + 1013904223u;
+			auto parent = n < 8 ? TransformHierarchy::None : (seed >> 8) % n;
+			h.add(parent, turn(0.002f * n), Vec3f(0.01f * (n % 3), 0.03f, 0.0f));
+		}
+		h.update();
+
+		// Nodes nobody names as a parent are leaves, which recompute alone
+		vector<uint8_t> has_child(h.size(), 0);
+		for (TransformHierarchy::Handle n = 0; n < h.size(); ++n) {
+			if (h.parent(n) != TransformHierarchy::None) has_child[h.parent(n)] = 1;
+		}
+		auto leaf = TransformHierarchy::Handle(h.size() - 1);
+		while (has_child[leaf]) --leaf;
+		h.set_translation(leaf, Vec3f(1.0f, 2.0f, 3.0f));
+		CHECK(h.update() == 1);
+		CHECK(h.update() == 0);
+
+		// A few scattered nodes at a time, some split across threads, against walking up the parents
+		for (int round = 0; round < 5; ++round) {
+			for (int k = 0; k < 3; ++k) {
+				seed = seed * 1664525u + 1013904223u;
+				h.set_rotation((seed >> 8) % h.size(), turn(0.1f * round + k));
+			}
+			h.update(round % 2 ? 16 : ~size_t(0));
+			for (TransformHierarchy::Handle n = 0; n < h.size(); n += 7) {
+				REQUIRE(nearly_equal(h.world(n), naive_world(h, n)));
+			}
+		}
+	}
+
+	TEST_CASE("parallel_for covers the range once") {
+		vector<int> hits(10000, 0);
+		parallel_for(hits.size(), 64, [&](size_t begin, size_t end) {
+			for (size_t n = begin; n < end; ++n) ++hits[n];
+		});
+		CHECK(std::count(hits.begin(), hits.end(), 1) == 10000);
+		CHECK(parallel_thread_count() >= 1);
+	}
 }
 
 TEST_SUITE("Quaternions") {
@@ -490,6 +1313,123 @@ TEST_SUITE("Quaternions") {
 			(Quaternion(std::sqrt(0.5f), 0.0f, 0.0f, std::sqrt(0.5f)))
 		);
 	}
+
+	TEST_CASE("Axis Angle and ToRot") {
+		Vec3f axis = Vec3f(1.0f, -2.0f, 0.5f).normalize();
+		Quaternion q(axis, 1.2f);
+
+		CHECK(nearly_equal(q.ToRot(), rotation(axis, 1.2f)));
+		CHECK(Quaternion(q.ToRot()).nearly_equal(q));
+		CHECK(nearly_equal(Quaternion(Vec3f(1.0f, 0.0f, 0.0f), (float)pi / 2.0f).ToRot(), rotX(pi / 2.0f)));
+	}
+
+	TEST_CASE("Conjugate") {
+		Quaternion q = Quaternion(Vec3f(0.0f, 1.0f, 1.0f), 0.8f);
+		CHECK((q * q.Conjugate()).nearly_equal(Quaternion(0.0f, 0.0f, 0.0f, 1.0f)));
+	}
+
+	TEST_CASE("Slerp") {
+		Vec3f axis = Vec3f(0.0f, 0.0f, 1.0f);
+		Quaternion a(axis, 0.2f);
+		Quaternion b(axis, 1.4f);
+
+		CHECK(Slerp(a, b, 0.0f).nearly_equal(a));
+		CHECK(Slerp(a, b, 1.0f).nearly_equal(b));
+		CHECK(Slerp(a, b, 0.25f).nearly_equal(Quaternion(axis, 0.5f)));
+
+		// -b is the same rotation; the result must stay on the short arc
+		CHECK(Slerp(a, b * -1.0f, 0.25f).nearly_equal(Quaternion(axis, 0.5f)));
+
+		// Nearly parallel inputs take the normalized lerp path
+		CHECK(Slerp(a, a, 0.5f).nearly_equal(a));
+	}
+}
+
+TEST_SUITE("Quaternion Batch") {
+	// 11 elements covers both the four-wide body and the scalar tail
+	vector<Quaternion> make_quaternions(float seed) {
+		vector<Quaternion> q;
+		for (int n = 0; n < 11; ++n) {
+			float f = seed + n;
+			q.push_back(Quaternion(Vec3f(std::sin(f), std::cos(f * 1.3f), 0.5f), f * 0.7f - 3.0f));
+		}
+		return q;
+	}
+
+	vector<Quaternion> a = make_quaternions(0.0f);
+	vector<Quaternion> b = make_quaternions(5.0f);
+
+	bool nearly_equal(const Quaternion& x, const Quaternion& y, float tolerance) {
+		return std::fabs(x.i - y.i) <= tolerance && std::fabs(x.j - y.j) <= tolerance &&
+			std::fabs(x.k - y.k) <= tolerance && std::fabs(x.r - y.r) <= tolerance;
+	}
+
+	TEST_CASE("AoS round trip") {
+		QuaternionBatch batch;
+		to_soa(a, batch);
+		REQUIRE(batch.size() == a.size());
+		for (size_t n = 0; n < a.size(); ++n) {
+			CHECK(batch.get(n) == a[n]);
+		}
+
+		vector<Quaternion> back(a.size());
+		to_aos(batch, back);
+		for (size_t n = 0; n < a.size(); ++n) {
+			CHECK(back[n] == a[n]);
+		}
+	}
+
+	TEST_CASE("Kernels match Quaternion members") {
+		QuaternionBatch qa, qb, out;
+		to_soa(a, qa);
+		to_soa(b, qb);
+		vector<float> dots(a.size());
+
+		multiply(qa, qb, out);
+		for (size_t n = 0; n < a.size(); ++n) CHECK(out.get(n).nearly_equal(a[n] * b[n]));
+
+		conjugate(qa, out);
+		for (size_t n = 0; n < a.size(); ++n) CHECK(out.get(n) == a[n].Conjugate());
+
+		QuaternionBatch scaled = qa;
+		for (auto& s : scaled.streams) for (float& f : s) f *= 3.0f;
+		normalize(scaled, out);
+		for (size_t n = 0; n < a.size(); ++n) CHECK(out.get(n).nearly_equal(a[n]));
+
+		dot(qa, qb, dots);
+		for (size_t n = 0; n < a.size(); ++n) CHECK(dots[n] == doctest::Approx(a[n].Dot(b[n])));
+
+		vector<Xformf> rots(a.size());
+		to_rot(qa, rots);
+		for (size_t n = 0; n < a.size(); ++n) CHECK(nearly_equal(rots[n], a[n].ToRot()));
+	}
+
+	TEST_CASE("Interpolation") {
+		QuaternionBatch qa, qb, out;
+		to_soa(a, qa);
+		to_soa(b, qb);
+
+		for (float t : {0.0f, 0.3f, 0.5f, 1.0f}) {
+			slerp(qa, qb, t, out);
+			for (size_t n = 0; n < a.size(); ++n) {
+				CHECK(nearly_equal(out.get(n), Slerp(a[n], b[n], t), 1e-4f));
+			}
+
+			nlerp(qa, qb, t, out);
+			for (size_t n = 0; n < a.size(); ++n) {
+				Quaternion to = a[n].Dot(b[n]) < 0.0f ? b[n] * -1.0f : b[n];
+				CHECK(out.get(n).nearly_equal((a[n] * (1.0f - t) + to * t).Normalize()));
+			}
+		}
+
+		// In place, against the shortest-path flip
+		QuaternionBatch flipped = qb;
+		for (auto& s : flipped.streams) for (float& f : s) f = -f;
+		slerp(qa, flipped, 0.5f, flipped);
+		for (size_t n = 0; n < a.size(); ++n) {
+			CHECK(nearly_equal(flipped.get(n), Slerp(a[n], b[n], 0.5f), 1e-4f));
+		}
+	}
 }
 
 TEST_SUITE("Collision Detection") {
@@ -499,4 +1439,2141 @@ TEST_SUITE("Collision Detection") {
 		CHECK(HalfSpace3D(Vec3f(0.0f, -1.0f, 0.0f), plane) < 0); // below the plane
 		CHECK(HalfSpace3D(Vec3f(1.0f, 0.0f, 1.0f), plane) == 0); // on the plane
 	}
+
+	TEST_CASE("Ray AABB") {
+		AABB box { Vec3f(0.0f, 0.0f, 5.0f), { 1.0f, 1.0f, 1.0f } };
+		float t = -1.0f;
+		CHECK(RayAABB(Ray { Vec3f(0.0f, 0.0f, 0.0f), Vec3f(0.0f, 0.0f, 1.0f) }, box, t));
+		CHECK(t == doctest::Approx(4.0f));
+		CHECK_FALSE(RayAABB(Ray { Vec3f(0.0f, 0.0f, 0.0f), Vec3f(0.0f, 0.0f, -1.0f) }, box, t));
+		CHECK_FALSE(RayAABB(Ray { Vec3f(2.0f, 0.0f, 0.0f), Vec3f(0.0f, 0.0f, 1.0f) }, box, t));
+
+		// Starting inside, and grazing a face with an axis-parallel ray
+		CHECK(RayAABB(Ray { Vec3f(0.0f, 0.0f, 5.0f), Vec3f(1.0f, 0.0f, 0.0f) }, box, t));
+		CHECK(t == 0.0f);
+		CHECK(RayAABB(Ray { Vec3f(1.0f, 0.0f, 0.0f), Vec3f(0.0f, 0.0f, 1.0f) }, box, t));
+	}
+
+	TEST_CASE("Ray Triangle") {
+		Tri3d tri {};
+		tri.verts[0].pos = Vec3f(0.0f, 0.0f, 2.0f);
+		tri.verts[1].pos = Vec3f(1.0f, 0.0f, 2.0f);
+		tri.verts[2].pos = Vec3f(0.0f, 1.0f, 2.0f);
+
+		float t, u, v;
+		CHECK(RayTriangle(Ray { Vec3f(0.25f, 0.5f, 0.0f), Vec3f(0.0f, 0.0f, 1.0f) }, tri, t, u, v));
+		CHECK(t == doctest::Approx(2.0f));
+		CHECK(u == doctest::Approx(0.25f));
+		CHECK(v == doctest::Approx(0.5f));
+		CHECK(RayTriangle(Ray { Vec3f(0.25f, 0.5f, 4.0f), Vec3f(0.0f, 0.0f, -1.0f) }, tri, t, u, v));
+		CHECK_FALSE(RayTriangle(Ray { Vec3f(0.75f, 0.75f, 0.0f), Vec3f(0.0f, 0.0f, 1.0f) }, tri, t, u, v));
+		CHECK_FALSE(RayTriangle(Ray { Vec3f(0.25f, 0.5f, 0.0f), Vec3f(1.0f, 0.0f, 0.0f) }, tri, t, u, v));
+		CHECK_FALSE(RayTriangle(Ray { Vec3f(0.25f, 0.5f, 3.0f), Vec3f(0.0f, 0.0f, 1.0f) }, tri, t, u, v));
+	}
+
+	TEST_CASE("Overlap AABB") {
+		AABB a { Vec3f(0.0f, 0.0f, 0.0f), { 1.0f, 1.0f, 1.0f } };
+		CHECK(OverlapAABB(a, AABB { Vec3f(1.5f, 0.0f, 0.0f), { 0.5f, 0.5f, 0.5f } }));
+		CHECK(OverlapAABB(a, AABB { Vec3f(0.0f, 0.0f, 0.0f), { 0.1f, 0.1f, 0.1f } }));
+		CHECK_FALSE(OverlapAABB(a, AABB { Vec3f(0.0f, 2.5f, 0.0f), { 1.0f, 1.0f, 1.0f } }));
+	}
+}
+
+TEST_SUITE("BVH") {
+	vector<Tri3d> random_triangles(size_t count, uint32_t seed) {
+		vector<Tri3d> tris(count);
+		for (Tri3d& tri : tris) {
+			Vec3f center = random_point(seed, 20.0f);
+			for (Vert3d& vert : tri.verts) vert.pos = center + random_point(seed, 2.0f);
+		}
+		return tris;
+	}
+
+	vector<Ray> random_rays(size_t count, uint32_t seed) {
+		vector<Ray> rays(count);
+		for (Ray& ray : rays) {
+			ray.point = random_point(seed, 20.0f);
+			ray.dir = (random_point(seed, 2.0f) - Vec3f(1.0f, 1.0f, 1.0f)).normalize();
+		}
+		return rays;
+	}
+
+	bool brute_closest(span<const Tri3d> tris, const Ray& ray, BVH::Hit& hit) {
+		bool found = false;
+		for (size_t n = 0; n < tris.size(); ++n) {
+			float t, u, v;
+			if (RayTriangle(ray, tris[n], t, u, v) && (!found || t < hit.t)) {
+				hit = { t, uint32_t(n), u, v };
+				found = true;
+			}
+		}
+		return found;
+	}
+
+	void check_against_brute_force(const BVH& bvh, span<const Tri3d> tris, span<const Ray> rays) {
+		for (const Ray& ray : rays) {
+			BVH::Hit expected {}, hit {};
+			bool found = brute_closest(tris, ray, expected);
+			REQUIRE(bvh.closest_hit(ray, hit) == found);
+			REQUIRE(bvh.any_hit(ray) == found);
+			if (found) {
+				CHECK(hit.t == doctest::Approx(expected.t));
+				CHECK(bvh.any_hit(ray, expected.t * 1.001f));
+				CHECK_FALSE(bvh.any_hit(ray, expected.t * 0.999f));
+			}
+		}
+	}
+
+	TEST_CASE("Ray queries match brute force") {
+		auto tris = random_triangles(2000, 7);
+		auto rays = random_rays(500, 11);
+
+		BVH bvh;
+		bvh.build(tris);
+		REQUIRE(bvh.size() == tris.size());
+		REQUIRE(bvh.nodes().size() <= tris.size() * 2);
+		check_against_brute_force(bvh, tris, rays);
+
+		size_t leaf_prims = 0;
+		for (const BVHNode& node : bvh.nodes()) {
+			if (node.is_leaf()) {
+				CHECK(node.count <= 4);
+				leaf_prims += node.count;
+			}
+		}
+		CHECK(leaf_prims == tris.size());
+	}
+
+	TEST_CASE("Rays in a face plane") {
+		// A wall at x = 5 over y in [0, 3]: the ray runs along y = 0, the plane of the node's min y face,
+		// so that slab is 0 * inf
+		auto vert = [](float x, float y, float z) { Vert3d v {}; v.pos = Vec3f(x, y, z); return v; };
+		vector<Tri3d> wall = {
+			{ { vert(5.0f, 0.0f, 0.0f), vert(5.0f, 3.0f, 0.0f), vert(5.0f, 3.0f, 3.0f) } },
+			{ { vert(5.0f, 0.0f, 0.0f), vert(5.0f, 3.0f, 3.0f), vert(5.0f, 0.0f, 3.0f) } },
+		};
+		Ray ray { Vec3f(0.0f, 0.0f, 0.5f), Vec3f(1.0f, 0.0f, 0.0f) };
+
+		BVH bvh;
+		bvh.build(wall);
+		BVH::Hit expected {}, hit {};
+		REQUIRE(brute_closest(wall, ray, expected));
+		CHECK(bvh.closest_hit(ray, hit));
+		CHECK(hit.t == doctest::Approx(5.0f));
+		CHECK(bvh.any_hit(ray));
+
+		AABB box { Vec3f(5.5f, 1.5f, 1.5f), { 0.5f, 1.5f, 1.5f } };
+		float t;
+		REQUIRE(RayAABB(ray, box, t));
+		BVH boxes;
+		boxes.build(span<const AABB>(&box, 1));
+		CHECK(boxes.closest_hit(ray, hit));
+		CHECK(hit.t == doctest::Approx(t));
+		CHECK(boxes.any_hit(ray));
+	}
+
+	TEST_CASE("Parallel build and refit") {
+		auto tris = random_triangles(5000, 3);
+		auto rays = random_rays(300, 5);
+
+		BVH serial, parallel;
+		serial.build(tris);
+		BVH::BuildOptions options;
+		options.parallel = true;
+		parallel.build(tris, options);
+		CHECK(parallel.nodes().size() == serial.nodes().size());
+		check_against_brute_force(parallel, tris, rays);
+
+		// Move every triangle and refit instead of rebuilding
+		uint32_t seed = 99;
+		for (Tri3d& tri : tris) {
+			Vec3f offset = random_point(seed, 3.0f);
+			for (Vert3d& vert : tri.verts) vert.pos = vert.pos + offset;
+		}
+		serial.refit(tris);
+		check_against_brute_force(serial, tris, rays);
+	}
+
+	TEST_CASE("Box sets") {
+		uint32_t seed = 21;
+		vector<AABB> boxes(1000);
+		for (AABB& box : boxes) {
+			box.center = random_point(seed, 50.0f);
+			for (float& h : box.halfwidths) h = 0.1f + random_float(seed);
+		}
+
+		BVH bvh;
+		bvh.build(boxes);
+		for (int q = 0; q < 50; ++q) {
+			AABB query { random_point(seed, 50.0f), { 3.0f, 3.0f, 3.0f } };
+			vector<uint32_t> found, expected;
+			bvh.overlaps(query, found);
+			for (uint32_t n = 0; n < boxes.size(); ++n) {
+				if (OverlapAABB(query, boxes[n])) expected.push_back(n);
+			}
+			std::sort(found.begin(), found.end());
+			CHECK(found == expected);
+		}
+
+		for (const Ray& ray : random_rays(200, 4)) {
+			float nearest = numeric_limits<float>::infinity();
+			for (const AABB& box : boxes) {
+				float t;
+				if (RayAABB(ray, box, t)) nearest = std::min(nearest, t);
+			}
+
+			BVH::Hit hit {};
+			REQUIRE(bvh.closest_hit(ray, hit) == (nearest != numeric_limits<float>::infinity()));
+			if (bvh.closest_hit(ray, hit)) {
+				CHECK(hit.t == doctest::Approx(nearest));
+				float t;
+				CHECK(RayAABB(ray, boxes[hit.primitive], t));
+			}
+		}
+	}
+
+	template <size_t N>
+	void check_packets(const BVH& bvh, span<const Ray> rays) {
+		for (size_t first = 0; first < rays.size(); first += N) {
+			// The last packet is partly filled when rays.size() isn't a multiple of N
+			auto slice = rays.subspan(first, std::min(N, rays.size() - first));
+			RayPacket<N> packet(slice);
+			BVH::PacketHit<N> hits;
+			uint32_t mask = bvh.closest_hit(packet, hits);
+			uint32_t occluded = bvh.any_hit(packet);
+			REQUIRE((mask & ~packet.active()) == 0);
+
+			for (size_t lane = 0; lane < slice.size(); ++lane) {
+				BVH::Hit expected {};
+				bool found = bvh.closest_hit(slice[lane], expected);
+				REQUIRE(bool(mask >> lane & 1) == found);
+				CHECK(bool(occluded >> lane & 1) == found);
+				if (found) {
+					CHECK(hits.t[lane] == doctest::Approx(expected.t));
+				}
+			}
+		}
+	}
+
+	TEST_CASE("Packet queries match single rays") {
+		auto tris = random_triangles(2000, 8);
+		BVH bvh;
+		bvh.build(tris);
+
+		// Coherent bundles: a small cone of rays from one origin each
+		uint32_t seed = 17;
+		vector<Ray> rays;
+		for (int bundle = 0; bundle < 40; ++bundle) {
+			Vec3f origin = random_point(seed, 20.0f);
+			Vec3f dir = random_point(seed, 2.0f) - Vec3f(1.0f, 1.0f, 1.0f);
+			for (int n = 0; n < 16; ++n) {
+				rays.push_back({ origin, (dir + random_point(seed, 0.2f)).normalize() });
+			}
+		}
+		rays.resize(rays.size() - 5);
+
+		check_packets<4>(bvh, rays);
+		check_packets<8>(bvh, rays);
+		check_packets<16>(bvh, rays);
+
+		// Occlusion respects each lane's own t_max
+		RayPacket<4> packet(span<const Ray>(rays).first(4));
+		for (size_t lane = 0; lane < 4; ++lane) {
+			BVH::Hit hit {};
+			if (bvh.closest_hit(rays[lane], hit)) packet.t_max[lane] = hit.t * 0.5f;
+		}
+		uint32_t occluded = bvh.any_hit(packet);
+		for (size_t lane = 0; lane < 4; ++lane) {
+			CHECK(bool(occluded >> lane & 1) == bvh.any_hit(rays[lane], packet.t_max[lane]));
+		}
+	}
+
+	TEST_CASE("Empty and degenerate input") {
+		BVH bvh;
+		bvh.build(span<const Tri3d>());
+		CHECK(bvh.empty());
+		BVH::Hit hit {};
+		CHECK_FALSE(bvh.closest_hit(Ray { Vec3f(0.0f, 0.0f, 0.0f), Vec3f(0.0f, 0.0f, 1.0f) }, hit));
+
+		// Identical triangles have no centroid extent to split on
+		Tri3d tri {};
+		tri.verts[1].pos = Vec3f(1.0f, 0.0f, 0.0f);
+		tri.verts[2].pos = Vec3f(0.0f, 1.0f, 0.0f);
+		vector<Tri3d> tris(100, tri);
+		bvh.build(tris);
+		CHECK(bvh.closest_hit(Ray { Vec3f(0.2f, 0.2f, -1.0f), Vec3f(0.0f, 0.0f, 1.0f) }, hit));
+		CHECK(hit.t == doctest::Approx(1.0f));
+	}
+}
+
+TEST_SUITE("Ray Packets") {
+	TEST_CASE("Packet layout") {
+		vector<Ray> rays { { Vec3f(1.0f, 2.0f, 3.0f), Vec3f(0.0f, 2.0f, 0.0f) }, { Vec3f(4.0f, 5.0f, 6.0f), Vec3f(1.0f, 0.0f, 0.0f) } };
+		RayPacket<8> packet(rays, 10.0f);
+		CHECK(packet.active() == 0b11);
+		CHECK(packet.get(1).point == rays[1].point);
+		CHECK(packet.get(0).dir == rays[0].dir);
+		CHECK(packet.inv_dir[1][0] == 0.5f);
+		CHECK(packet.t_max[1] == 10.0f);
+
+		packet.set(5, rays[0]);
+		CHECK(packet.active() == 0b100011);
+		packet.clear(0);
+		CHECK(packet.active() == 0b100010);
+	}
+
+	template <size_t N>
+	void check_boxes(uint32_t seed) {
+		for (int round = 0; round < 200; ++round) {
+			AABB box { random_point(seed, 10.0f), { 0.5f + random_float(seed), 0.5f + random_float(seed), 0.5f + random_float(seed) } };
+			RayPacket<N> packet;
+			for (size_t lane = 0; lane < N; ++lane) {
+				Ray ray { random_point(seed, 10.0f), random_point(seed, 2.0f) - Vec3f(1.0f, 1.0f, 1.0f) };
+
+				// Some axis-parallel rays, including ones lying in a face plane
+				if (lane % 4 == 1) ray.dir[lane % 3] = 0.0f;
+				if (lane % 8 == 3) {
+					ray.dir = Vec3f(0.0f, 0.0f, 1.0f);
+					ray.point[0] = box.center[0] + box.halfwidths[0];
+				}
+				packet.set(lane, ray);
+			}
+
+			float t[N];
+			uint32_t mask = RayAABB(packet, box, t);
+			for (size_t lane = 0; lane < N; ++lane) {
+				float expected;
+				bool hit = RayAABB(packet.get(lane), box, expected);
+				REQUIRE(bool(mask >> lane & 1) == hit);
+				if (hit) CHECK(t[lane] == doctest::Approx(expected));
+			}
+		}
+	}
+
+	TEST_CASE("Ray AABB matches scalar") {
+		check_boxes<4>(1);
+		check_boxes<8>(2);
+		check_boxes<16>(3);
+	}
+
+	template <size_t N>
+	void check_triangles(uint32_t seed) {
+		for (int round = 0; round < 200; ++round) {
+			Tri3d tri {};
+			for (Vert3d& vert : tri.verts) vert.pos = random_point(seed, 10.0f);
+
+			// Aim each lane at a barycentric point clear of the edges, inside or outside the triangle, so
+			// rounding can't decide the outcome
+			RayPacket<N> packet;
+			for (size_t lane = 0; lane < N; ++lane) {
+				float a = 0.05f + random_float(seed) * 0.9f, b = 0.05f + random_float(seed) * 0.9f;
+				if (lane % 2 == 0 && a + b > 0.95f) {
+					a *= 0.5f;
+					b *= 0.5f;
+				}
+				Vec3f target = tri.verts[0].pos + (tri.verts[1].pos - tri.verts[0].pos) * a + (tri.verts[2].pos - tri.verts[0].pos) * b;
+				Vec3f origin = random_point(seed, 10.0f);
+				float t_max = lane % 3 == 0 ? (target - origin).length() * 0.5f : numeric_limits<float>::infinity();
+				packet.set(lane, { origin, (target - origin).normalize() }, t_max);
+			}
+
+			float t[N], u[N], v[N];
+			uint32_t mask = RayTriangle(packet, tri, t, u, v);
+			for (size_t lane = 0; lane < N; ++lane) {
+				float et, eu, ev;
+				bool hit = RayTriangle(packet.get(lane), tri, et, eu, ev) && et <= packet.t_max[lane];
+				REQUIRE(bool(mask >> lane & 1) == hit);
+				if (hit) {
+					CHECK(t[lane] == doctest::Approx(et).epsilon(1e-4));
+					CHECK(u[lane] == doctest::Approx(eu).epsilon(1e-4));
+					CHECK(v[lane] == doctest::Approx(ev).epsilon(1e-4));
+				}
+			}
+		}
+	}
+
+	TEST_CASE("Ray Triangle matches scalar") {
+		check_triangles<4>(4);
+		check_triangles<8>(5);
+		check_triangles<16>(6);
+	}
+}
+
+TEST_SUITE("Broad Phase") {
+	vector<OverlapPair> brute_force(span<const AABB> boxes) {
+		vector<OverlapPair> pairs;
+		for (uint32_t a = 0; a < boxes.size(); ++a) {
+			for (uint32_t b = a + 1; b < boxes.size(); ++b) {
+				if (OverlapAABB(boxes[a], boxes[b])) pairs.push_back({ a, b });
+			}
+		}
+		return pairs;
+	}
+
+	vector<OverlapPair> sorted(vector<OverlapPair> pairs) {
+		std::sort(pairs.begin(), pairs.end(), [](const OverlapPair& l, const OverlapPair& r) {
+			return l.a < r.a || (l.a == r.a && l.b < r.b);
+		});
+		return pairs;
+	}
+
+	vector<AABB> random_boxes(size_t count, float extent, uint32_t& seed) {
+		vector<AABB> boxes(count);
+		for (AABB& box : boxes) {
+			box.center = Vec3f(random_float(seed), random_float(seed), random_float(seed)) * extent;
+			for (float& h : box.halfwidths) h = 0.2f + random_float(seed) * 0.8f;
+		}
+		return boxes;
+	}
+
+	TEST_CASE("Sphere and box overlap") {
+		Sphere a { Vec3f(0.0f, 0.0f, 0.0f), 1.0f };
+		CHECK(OverlapSphere(a, Sphere { Vec3f(1.5f, 0.0f, 0.0f), 0.5f }));
+		CHECK_FALSE(OverlapSphere(a, Sphere { Vec3f(1.5f, 1.5f, 0.0f), 0.5f }));
+
+		AABB box { Vec3f(2.0f, 2.0f, 0.0f), { 1.0f, 1.0f, 1.0f } };
+		CHECK_FALSE(OverlapSphereAABB(a, box)); // corner at distance sqrt(2)
+		CHECK(OverlapSphereAABB(Sphere { Vec3f(0.0f, 0.0f, 0.0f), 1.5f }, box));
+		CHECK(OverlapSphereAABB(Sphere { Vec3f(2.0f, 2.0f, 0.5f), 0.1f }, box));
+
+		AABB bounds = BoundingBox(Capsule { { Vec3f(0.0f, 0.0f, 0.0f), Vec3f(2.0f, -2.0f, 0.0f) }, 0.5f });
+		CHECK(bounds.center == Vec3f(1.0f, -1.0f, 0.0f));
+		CHECK(bounds.halfwidths[0] == 1.5f);
+		CHECK(bounds.halfwidths[2] == 0.5f);
+	}
+
+	TEST_CASE("Sweep and prune matches brute force") {
+		uint32_t seed = 5;
+		auto boxes = random_boxes(600, 30.0f, seed);
+
+		SweepAndPrune sap;
+		vector<SweepAndPrune::Handle> handles;
+		for (const AABB& box : boxes) handles.push_back(sap.add(box));
+
+		vector<OverlapPair> pairs;
+		for (int frame = 0; frame < 10; ++frame) {
+			sap.find_pairs(pairs);
+			REQUIRE(sorted(pairs) == brute_force(boxes));
+
+			for (size_t n = 0; n < boxes.size(); ++n) {
+				for (size_t a = 0; a < 3; ++a) boxes[n].center[a] += random_float(seed) - 0.5f;
+				sap.update(handles[n], boxes[n]);
+			}
+		}
+
+		// Large jumps and a few additions take many swaps but must land on the same pairs
+		for (size_t n = 0; n < boxes.size(); n += 7) {
+			boxes[n].center[n % 3] = 30.0f - boxes[n].center[n % 3];
+			sap.update(handles[n], boxes[n]);
+		}
+		for (size_t n = 0; n < 5; ++n) {
+			boxes.push_back({ Vec3f(15.0f, 15.0f, 15.0f) + Vec3f(float(n), 0.0f, 0.0f), { 1.0f, 1.0f, 1.0f } });
+			handles.push_back(sap.add(boxes.back()));
+		}
+		sap.find_pairs(pairs);
+		CHECK(sorted(pairs) == brute_force(boxes));
+
+		// Removing bodies frees their handles for reuse
+		for (size_t n = 0; n < 10; ++n) sap.remove(handles[n]);
+		sap.find_pairs(pairs);
+		for (const OverlapPair& pair : pairs) CHECK(pair.a >= 10);
+		CHECK(sap.add(boxes[3]) < 10);
+		CHECK(sap.size() == boxes.size() - 9);
+		sap.find_pairs(pairs);
+		CHECK(std::count_if(pairs.begin(), pairs.end(), [](const OverlapPair& p) { return p.a < 10; }) > 0);
+	}
+
+	TEST_CASE("Hash grid matches brute force") {
+		uint32_t seed = 6;
+		auto boxes = random_boxes(800, 25.0f, seed);
+
+		// One body covering a large part of the world goes to the oversized list
+		boxes[7].halfwidths[0] = boxes[7].halfwidths[1] = boxes[7].halfwidths[2] = 8.0f;
+
+		SpatialHashGrid grid(SpatialHashGrid::tune_cell_size(boxes));
+		CHECK(grid.cell_size() > 0.4f);
+		CHECK(grid.cell_size() < 2.0f);
+
+		vector<OverlapPair> pairs;
+		for (float cell : { grid.cell_size(), 0.3f, 5.0f }) {
+			grid.set_cell_size(cell);
+			grid.find_pairs(boxes, pairs);
+			REQUIRE(sorted(pairs) == brute_force(boxes));
+		}
+
+		vector<Sphere> spheres(300);
+		for (Sphere& s : spheres) {
+			s.center = Vec3f(random_float(seed), random_float(seed), random_float(seed)) * 15.0f;
+			s.radius = 0.2f + random_float(seed);
+		}
+		vector<AABB> sphere_boxes;
+		for (const Sphere& s : spheres) sphere_boxes.push_back(BoundingBox(s));
+		grid.find_pairs(spheres, pairs);
+		CHECK(sorted(pairs) == brute_force(sphere_boxes));
+	}
+}
+
+TEST_SUITE("Narrow Phase") {
+	array<Point, 8> corners(const AABB& box) {
+		array<Point, 8> points;
+		for (size_t i = 0; i < 8; ++i) {
+			for (size_t a = 0; a < 3; ++a) {
+				points[i][a] = box.center[a] + ((i >> a) & 1 ? box.halfwidths[a] : -box.halfwidths[a]);
+			}
+		}
+		return points;
+	}
+
+	float box_distance(const AABB& a, const AABB& b) {
+		float sq = 0.0f;
+		for (size_t i = 0; i < 3; ++i) {
+			float gap = std::max(0.0f, std::fabs(b.center[i] - a.center[i]) - a.halfwidths[i] - b.halfwidths[i]);
+			sq += gap * gap;
+		}
+		return std::sqrt(sq);
+	}
+
+	TEST_CASE("Segment closest points") {
+		Point on_a, on_b;
+		ClosestPoints({ Vec3f(-1.0f, 0.0f, 0.0f), Vec3f(1.0f, 0.0f, 0.0f) }, { Vec3f(0.5f, -1.0f, 2.0f), Vec3f(0.5f, 1.0f, 2.0f) }, on_a, on_b);
+		CHECK(nearly_equal(on_a, Vec3f(0.5f, 0.0f, 0.0f)));
+		CHECK(nearly_equal(on_b, Vec3f(0.5f, 0.0f, 2.0f)));
+
+		// Past the end of a
+		ClosestPoints({ Vec3f(0.0f, 0.0f, 0.0f), Vec3f(1.0f, 0.0f, 0.0f) }, { Vec3f(3.0f, -1.0f, 0.0f), Vec3f(3.0f, 1.0f, 0.0f) }, on_a, on_b);
+		CHECK(nearly_equal(on_a, Vec3f(1.0f, 0.0f, 0.0f)));
+		CHECK(nearly_equal(on_b, Vec3f(3.0f, 0.0f, 0.0f)));
+
+		// Parallel and degenerate segments still give a closest pair
+		ClosestPoints({ Vec3f(0.0f, 0.0f, 0.0f), Vec3f(2.0f, 0.0f, 0.0f) }, { Vec3f(1.0f, 1.0f, 0.0f), Vec3f(3.0f, 1.0f, 0.0f) }, on_a, on_b);
+		CHECK((on_b - on_a).length() == doctest::Approx(1.0f));
+		ClosestPoints({ Vec3f(0.0f, 0.0f, 0.0f), Vec3f(2.0f, 0.0f, 0.0f) }, { Vec3f(1.0f, 1.0f, 0.0f), Vec3f(1.0f, 1.0f, 0.0f) }, on_a, on_b);
+		CHECK(nearly_equal(on_a, Vec3f(1.0f, 0.0f, 0.0f)));
+
+		CHECK(nearly_equal(ClosestPoint({ Vec3f(0.0f, 0.0f, 0.0f), Vec3f(2.0f, 0.0f, 0.0f) }, Vec3f(-1.0f, 1.0f, 0.0f)), Vec3f(0.0f, 0.0f, 0.0f)));
+	}
+
+	TEST_CASE("Closed forms") {
+		Contact contact;
+		REQUIRE(Penetration(Sphere { Vec3f(0.0f, 0.0f, 0.0f), 1.0f }, Sphere { Vec3f(1.5f, 0.0f, 0.0f), 1.0f }, contact));
+		CHECK(contact.depth == doctest::Approx(0.5f));
+		CHECK(nearly_equal(contact.normal, Vec3f(1.0f, 0.0f, 0.0f)));
+		CHECK(nearly_equal(contact.on_a, Vec3f(1.0f, 0.0f, 0.0f)));
+		CHECK(nearly_equal(contact.on_b, Vec3f(0.5f, 0.0f, 0.0f)));
+		CHECK_FALSE(Penetration(Sphere { Vec3f(0.0f, 0.0f, 0.0f), 1.0f }, Sphere { Vec3f(2.5f, 0.0f, 0.0f), 1.0f }, contact));
+
+		Capsule lying { { Vec3f(-2.0f, 0.0f, 0.0f), Vec3f(2.0f, 0.0f, 0.0f) }, 0.5f };
+		REQUIRE(Penetration(Sphere { Vec3f(1.0f, 1.0f, 0.0f), 0.75f }, lying, contact));
+		CHECK(contact.depth == doctest::Approx(0.25f));
+		CHECK(nearly_equal(contact.normal, Vec3f(0.0f, -1.0f, 0.0f)));
+
+		Capsule standing { { Vec3f(0.0f, 0.8f, -1.0f), Vec3f(0.0f, 0.8f, 1.0f) }, 0.5f };
+		REQUIRE(Penetration(lying, standing, contact));
+		CHECK(contact.depth == doctest::Approx(0.2f));
+		CHECK(nearly_equal(contact.normal, Vec3f(0.0f, 1.0f, 0.0f)));
+
+		AABB a { Vec3f(0.0f, 0.0f, 0.0f), { 1.0f, 1.0f, 1.0f } };
+		AABB b { Vec3f(1.0f, 0.8f, 0.5f), { 1.0f, 0.5f, 1.0f } };
+		REQUIRE(Penetration(a, b, contact));
+		CHECK(contact.depth == doctest::Approx(0.7f));
+		CHECK(nearly_equal(contact.normal, Vec3f(0.0f, 1.0f, 0.0f)));
+		CHECK(nearly_equal(contact.on_a - contact.on_b, contact.normal * contact.depth));
+		CHECK_FALSE(Penetration(a, AABB { Vec3f(2.5f, 0.0f, 0.0f), { 0.4f, 1.0f, 1.0f } }, contact));
+	}
+
+	TEST_CASE("GJK distance") {
+		uint32_t seed = 3;
+		for (int i = 0; i < 200; ++i) {
+			AABB a { random_centered(seed, 6.0f), { 0.2f + random_float(seed), 0.2f + random_float(seed), 0.2f + random_float(seed) } };
+			AABB b { random_centered(seed, 6.0f), { 0.2f + random_float(seed), 0.2f + random_float(seed), 0.2f + random_float(seed) } };
+			auto points_a = corners(a), points_b = corners(b);
+			ConvexHull hull_a { points_a }, hull_b { points_b };
+
+			float expected = box_distance(a, b);
+			Separation separation;
+			bool separated = GJKDistance(hull_a, hull_b, separation);
+			REQUIRE(separated == (expected > 0.0f));
+			CHECK(GJKIntersect(a, b) == OverlapAABB(a, b));
+			if (separated) {
+				CHECK(separation.distance == doctest::Approx(expected).epsilon(1e-3));
+				CHECK((separation.on_b - separation.on_a).length() == doctest::Approx(expected).epsilon(1e-3));
+			}
+		}
+
+		// Rounded shapes against their closed forms
+		for (int i = 0; i < 200; ++i) {
+			Capsule a { { random_centered(seed, 6.0f), random_centered(seed, 6.0f) }, 0.1f + random_float(seed) };
+			Capsule b { { random_centered(seed, 6.0f), random_centered(seed, 6.0f) }, 0.1f + random_float(seed) };
+			Point on_a, on_b;
+			ClosestPoints(a.axis, b.axis, on_a, on_b);
+			float expected = (on_b - on_a).length() - a.radius - b.radius;
+
+			Separation separation;
+			REQUIRE(GJKDistance(a, b, separation) == (expected > 0.0f));
+			if (expected > 0.0f) CHECK(separation.distance == doctest::Approx(expected).epsilon(1e-3));
+		}
+
+		Cylinder cylinder { { Vec3f(0.0f, 0.0f, 0.0f), Vec3f(0.0f, 2.0f, 0.0f) }, 1.0f };
+		Separation separation;
+		REQUIRE(GJKDistance(cylinder, Sphere { Vec3f(3.0f, 1.0f, 0.0f), 0.5f }, separation));
+		CHECK(separation.distance == doctest::Approx(1.5f).epsilon(1e-3));
+		REQUIRE(GJKDistance(cylinder, Sphere { Vec3f(0.5f, 3.0f, 0.5f), 0.5f }, separation));
+		CHECK(separation.distance == doctest::Approx(0.5f).epsilon(1e-3));
+		CHECK(GJKIntersect(cylinder, AABB { Vec3f(1.2f, 1.0f, 0.0f), { 0.3f, 0.3f, 0.3f } }));
+		CHECK_FALSE(GJKIntersect(cylinder, AABB { Vec3f(1.2f, 1.0f, 1.2f), { 0.3f, 0.3f, 0.3f } }));
+	}
+
+	TEST_CASE("EPA penetration") {
+		uint32_t seed = 11;
+		int overlapping = 0;
+		for (int i = 0; i < 300; ++i) {
+			AABB a { random_centered(seed, 3.0f), { 0.2f + random_float(seed), 0.2f + random_float(seed), 0.2f + random_float(seed) } };
+			AABB b { random_centered(seed, 3.0f), { 0.2f + random_float(seed), 0.2f + random_float(seed), 0.2f + random_float(seed) } };
+			auto points_a = corners(a), points_b = corners(b);
+
+			Contact expected, contact;
+			bool overlap = Penetration(a, b, expected);
+			REQUIRE(Penetration(ConvexHull { points_a }, ConvexHull { points_b }, contact) == overlap);
+			if (!overlap || expected.depth < 1e-3f) continue;
+
+			++overlapping;
+			CHECK(contact.depth == doctest::Approx(expected.depth).epsilon(1e-3));
+			CHECK(contact.normal.dot(expected.normal) > 0.999f);
+			CHECK((contact.on_a - contact.on_b - contact.normal * contact.depth).length() < 1e-3f);
+		}
+		CHECK(overlapping > 50);
+
+		// Sphere centers inside a box: the depth is the radius plus the distance to the nearest face
+		AABB box { Vec3f(1.0f, 2.0f, 3.0f), { 2.0f, 1.0f, 1.5f } };
+		for (int i = 0; i < 100; ++i) {
+			Sphere sphere { box.center + Vec3f(random_float(seed) - 0.5f, random_float(seed) - 0.5f, random_float(seed) - 0.5f), 0.25f + random_float(seed) * 0.5f };
+			float nearest = numeric_limits<float>::infinity();
+			for (size_t a = 0; a < 3; ++a) nearest = std::min(nearest, box.halfwidths[a] - std::fabs(sphere.center[a] - box.center[a]));
+
+			Contact contact;
+			REQUIRE(Penetration(sphere, box, contact));
+			CHECK(contact.depth == doctest::Approx(nearest + sphere.radius).epsilon(1e-3));
+		}
+
+		// Shallow rounded contact: the cores stay apart and the margins decide
+		Contact contact;
+		Point corner[] = { Vec3f(1.0f, 0.0f, 0.0f) };
+		REQUIRE(Penetration(Sphere { Vec3f(0.0f, 0.0f, 0.0f), 1.25f }, ConvexHull { corner }, contact));
+		CHECK(contact.depth == doctest::Approx(0.25f));
+		CHECK(nearly_equal(contact.normal, Vec3f(1.0f, 0.0f, 0.0f)));
+
+		// Mixed rounded pairs go to the closed forms either way round
+		Capsule capsule { { Vec3f(-2.0f, 0.0f, 0.0f), Vec3f(2.0f, 0.0f, 0.0f) }, 0.5f };
+		Sphere sphere { Vec3f(1.0f, 1.0f, 0.0f), 0.75f };
+		REQUIRE(Penetration(ConvexShape(capsule), ConvexShape(sphere), contact));
+		CHECK(contact.depth == doctest::Approx(0.25f));
+		CHECK(nearly_equal(contact.normal, Vec3f(0.0f, 1.0f, 0.0f)));
+	}
+
+	TEST_CASE("Warm starting") {
+		Cylinder cylinder { { Vec3f(0.0f, 0.0f, 0.0f), Vec3f(0.0f, 2.0f, 0.0f) }, 1.0f };
+		AABB box { Vec3f(3.0f, 1.0f, 0.0f), { 0.5f, 0.5f, 0.5f } };
+		GJKCache cache;
+		for (int frame = 0; frame < 100; ++frame) {
+			box.center = Vec3f(3.0f - frame * 0.03f, 1.0f + std::sin(frame * 0.1f), std::cos(frame * 0.1f));
+
+			// Either side of touching the two runs may disagree by rounding
+			Separation cold {}, warm {};
+			bool separated = GJKDistance(cylinder, box, cold);
+			bool warm_separated = GJKDistance(cylinder, box, warm, &cache);
+			CHECK(cache.count > 0);
+			CHECK(std::fabs(warm.distance - cold.distance) < 1e-3f);
+			if (separated == warm_separated) CHECK(GJKIntersect(cylinder, box, &cache) == !separated);
+			else CHECK(std::max(cold.distance, warm.distance) < 1e-4f);
+		}
+	}
+}
+
+TEST_SUITE("Frustum Culling") {
+	Mat4f camera(const Vec3f& eye, const Vec3f& target, float fov) {
+		return look_at(translation(eye), translation(target)) * perspective(fov, 16.0f / 9.0f, 0.5f, 60.0f);
+	}
+
+	bool bit(span<const uint64_t> mask, size_t i) {
+		return mask[i / 64] >> (i % 64) & 1;
+	}
+
+	TEST_CASE("Extraction") {
+		Mat4f view_projection = camera(Vec3f(0.0f, 0.0f, -5.0f), Vec3f(0.0f, 0.0f, 0.0f), (float)pi / 2.0f);
+		Frustum frustum = ExtractFrustum(view_projection);
+
+		for (const Plane& plane : frustum.planes) CHECK(plane.n.length() == doctest::Approx(1.0f));
+		CHECK(std::fabs(HalfSpace3D(Vec3f(0.0f, 0.0f, -4.5f), frustum.planes[Frustum::Near])) < 1e-4f);
+		CHECK(std::fabs(HalfSpace3D(Vec3f(0.0f, 0.0f, 55.0f), frustum.planes[Frustum::Far])) < 1e-3f);
+		CHECK(HalfSpace3D(Vec3f(0.0f, 0.0f, 0.0f), frustum.planes[Frustum::Near]) == doctest::Approx(4.5f));
+
+		// Points agree with the clip space box after projection, away from its faces
+		uint32_t seed = 21;
+		vector<Vec3f> points(2000), projected(2000);
+		for (Vec3f& p : points) p = random_centered(seed, 80.0f);
+		project_points(view_projection, points, projected);
+		for (size_t i = 0; i < points.size(); ++i) {
+			Vec4f clip = Vec4f(points[i][0], points[i][1], points[i][2], 1.0f) * view_projection;
+			if (clip[3] <= 0.0f) {
+				CHECK_FALSE(OverlapFrustumSphere(frustum, Sphere { points[i], 0.0f }));
+				continue;
+			}
+			const Vec3f& ndc = projected[i];
+			float margin = std::min({ 1.0f - std::fabs(ndc[0]), 1.0f - std::fabs(ndc[1]), ndc[2], 1.0f - ndc[2] });
+			if (std::fabs(margin) < 1e-3f) continue;
+			CHECK(OverlapFrustumSphere(frustum, Sphere { points[i], 0.0f }) == (margin > 0.0f));
+		}
+	}
+
+	TEST_CASE("Batch culling matches scalar") {
+		uint32_t seed = 8;
+		const size_t count = 1003;
+		SphereSoA spheres;
+		AABBSoA boxes;
+		for (size_t i = 0; i < count; ++i) {
+			Vec3f center = random_centered(seed, 100.0f);
+			spheres.push_back({ center, random_float(seed) * 4.0f });
+			boxes.push_back({ center, { random_float(seed) * 3.0f, random_float(seed) * 3.0f, random_float(seed) * 3.0f } });
+		}
+
+		const Frustum frustums[] = {
+			ExtractFrustum(camera(Vec3f(0.0f, 2.0f, -40.0f), Vec3f(0.0f, 0.0f, 0.0f), 1.0f)),
+			ExtractFrustum(camera(Vec3f(10.0f, 5.0f, 0.0f), Vec3f(-20.0f, 0.0f, 10.0f), 0.6f)),
+			ExtractFrustum(camera(Vec3f(0.0f, 0.0f, 0.0f), Vec3f(0.0f, -1.0f, 0.5f), 1.4f)),
+		};
+		const size_t words = VisibilityWords(count), groups = PlaneCacheSize(count);
+
+		vector<uint64_t> visible(3 * words, ~uint64_t(0)), box_visible(3 * words, ~uint64_t(0));
+		vector<uint8_t> cache(3 * groups, 0), box_cache(3 * groups, 5);
+		for (int frame = 0; frame < 3; ++frame) {
+			CullSpheres(frustums, spheres, visible, cache);
+			CullAABBs(frustums, boxes, box_visible, box_cache);
+			for (size_t v = 0; v < 3; ++v) {
+				span<const uint64_t> mask(visible.data() + v * words, words), box_mask(box_visible.data() + v * words, words);
+				size_t seen = 0;
+				for (size_t i = 0; i < count; ++i) {
+					REQUIRE(bit(mask, i) == OverlapFrustumSphere(frustums[v], spheres.get(i)));
+					REQUIRE(bit(box_mask, i) == OverlapFrustumAABB(frustums[v], boxes.get(i)));
+					seen += bit(mask, i);
+				}
+				CHECK(seen > 0);
+				CHECK(seen < count);
+
+				// Bits past the last object stay clear
+				CHECK(mask[words - 1] >> (count % 64) == 0);
+			}
+		}
+
+		// Single view, no cache
+		vector<uint64_t> single(words);
+		CullSpheres(frustums[1], spheres, single);
+		CHECK(std::equal(single.begin(), single.end(), visible.begin() + words));
+		CullAABBs(frustums[1], boxes, single);
+		CHECK(std::equal(single.begin(), single.end(), box_visible.begin() + words));
+	}
+}
+
+TEST_SUITE("Instrumentation") {
+	using namespace instrumentation;
+
+	TEST_CASE("Counters") {
+		reset();
+		Mat4f m {
+			2.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 3.0f, 0.5f, 0.0f,
+			0.0f, 0.0f, 4.0f, 0.0f,
+			1.0f, 2.0f, 3.0f, 1.0f,
+		};
+		Matrix<float, 5, 5> big;
+		for (size_t i = 0; i < big.N; ++i) big.arr[i] = float(i % 7) + (i % 6 == 0 ? 5.0f : 0.0f);
+
+		Mat4f inv = m.inverse();
+		inv = inv.inverse();
+		auto big_inv = big.try_inverse();
+		Quaternion q = Slerp(Quaternion(Vec3f(0.0f, 1.0f, 0.0f), 0.2f), Quaternion(Vec3f(1.0f, 0.0f, 0.0f), 1.0f), 0.5f);
+		Xformf rot = q.ToRot();
+
+		// Threads' counts are merged once they exit, too
+		std::thread([&] { Mat4f other = m.inverse(); (void)other; }).join();
+
+		constexpr Mat3f folded = Mat3f { 2.0f, 0.0f, 0.0f, 0.0f, 4.0f, 0.0f, 0.0f, 0.0f, 8.0f }.inverse();
+		static_assert(folded.arr[8] == 0.125f);
+		(void)big_inv;
+		(void)rot;
+
+		if constexpr (enabled) {
+			CHECK(stats(Counter::MatrixInverse).calls == 3);
+			CHECK(stats(Counter::MatrixInverseGeneric).calls == 1);
+			CHECK(stats(Counter::QuaternionSlerp).calls == 1);
+			CHECK(stats(Counter::QuaternionToMatrix).calls >= 1);
+			CHECK(stats(Counter::MatrixInverse).cycles > 0);
+		}
+		else {
+			CHECK(stats(Counter::MatrixInverse).calls == 0);
+			CHECK(stats(Counter::MatrixInverse).cycles == 0);
+		}
+
+		string json = to_json();
+		CHECK(json.find(enabled ? "\"enabled\": true" : "\"enabled\": false") != string::npos);
+		CHECK(json.find("\"MatrixInverseGeneric\": {\"calls\": ") != string::npos);
+		CHECK(string(name(Counter::FrustumCull)) == "FrustumCull");
+
+		reset();
+		CHECK(stats(Counter::MatrixInverse).calls == 0);
+
+		// A reset leaves threads' counts alone and subtracts them, including once the thread has exited
+		std::atomic<bool> counted { false }, was_reset { false };
+		std::thread worker([&] {
+			Mat4f other = m.inverse();
+			(void)other;
+			counted = true;
+			while (!was_reset) std::this_thread::yield();
+			other = other.inverse();
+		});
+		while (!counted) std::this_thread::yield();
+		reset();
+		was_reset = true;
+		worker.join();
+		inv = m.inverse();
+		CHECK(stats(Counter::MatrixInverse).calls == (enabled ? 2 : 0));
+	}
+}
+
+TEST_SUITE("Trig") {
+	// Error in units of the float spacing at the exact result
+	double ulps(float approx, double exact) {
+		float rounded = float(exact);
+		double spacing = std::nextafter(std::fabs(rounded), INFINITY) - std::fabs(rounded);
+		return std::fabs(approx - exact) / spacing;
+	}
+
+	template <class F>
+	void sweep(float lo, float hi, F&& f) {
+		constexpr int Steps = 200000;
+		for (int n = 0; n <= Steps; ++n) f(lo + (hi - lo) * float(n) / float(Steps));
+	}
+
+	TEST_CASE("Precise error bounds") {
+		double sincos_ulps = 0.0, sincos_abs = 0.0, tan_ulps = 0.0, acos_ulps = 0.0;
+		sweep(-(float)pi, (float)pi, [&](float x) {
+			float s, c;
+			trig::Precise::sincos(x, s, c);
+			sincos_ulps = std::max({ sincos_ulps, ulps(s, std::sin(double(x))), ulps(c, std::cos(double(x))) });
+		});
+		sweep(-8192.0f, 8192.0f, [&](float x) {
+			float s, c;
+			trig::Precise::sincos(x, s, c);
+			sincos_abs = std::max({ sincos_abs, std::fabs(s - std::sin(double(x))), std::fabs(c - std::cos(double(x))) });
+		});
+		sweep(-1.5f, 1.5f, [&](float x) { tan_ulps = std::max(tan_ulps, ulps(trig::Precise::tan(x), std::tan(double(x)))); });
+		sweep(-1.0f, 1.0f, [&](float x) { acos_ulps = std::max(acos_ulps, ulps(trig::Precise::acos(x), std::acos(double(x)))); });
+
+		CHECK(sincos_ulps <= 2.0);
+		CHECK(sincos_abs <= 1e-7);
+		CHECK(tan_ulps <= 4.0);
+		CHECK(acos_ulps <= 2.0);
+
+		double atan2_ulps = 0.0;
+		for (int a = 0; a < 720; ++a) {
+			for (float radius : { 1e-3f, 1.0f, 1e3f }) {
+				float angle = float(a) * (float)pi / 360.0f - (float)pi;
+				float y = radius * std::sin(angle), x = radius * std::cos(angle);
+				atan2_ulps = std::max(atan2_ulps, ulps(trig::Precise::atan2(y, x), std::atan2(double(y), double(x))));
+			}
+		}
+		CHECK(atan2_ulps <= 4.0);
+
+		// Past the exact range reduction the result comes from libm
+		CHECK(trig::Precise::sin(1e6f) == std::sin(1e6f));
+		CHECK(trig::Precise::cos(-3e5f) == std::cos(-3e5f));
+	}
+
+	TEST_CASE("Fast error bounds") {
+		double sincos_abs = 0.0, tan_rel = 0.0, acos_abs = 0.0, atan2_abs = 0.0;
+		sweep(-8192.0f, 8192.0f, [&](float x) {
+			float s, c;
+			trig::Fast::sincos(x, s, c);
+			sincos_abs = std::max({ sincos_abs, std::fabs(s - std::sin(double(x))), std::fabs(c - std::cos(double(x))) });
+		});
+		sweep(-1.5f, 1.5f, [&](float x) {
+			double exact = std::tan(double(x));
+			if (exact != 0.0) tan_rel = std::max(tan_rel, std::fabs((trig::Fast::tan(x) - exact) / exact));
+		});
+		sweep(-1.0f, 1.0f, [&](float x) { acos_abs = std::max(acos_abs, std::fabs(trig::Fast::acos(x) - std::acos(double(x)))); });
+		sweep(-(float)pi, (float)pi, [&](float angle) {
+			float y = 3.0f * std::sin(angle), x = 3.0f * std::cos(angle);
+			atan2_abs = std::max(atan2_abs, std::fabs(trig::Fast::atan2(y, x) - std::atan2(double(y), double(x))));
+		});
+
+		CHECK(sincos_abs <= 1.5e-5);
+		CHECK(tan_rel <= 1.5e-5);
+		CHECK(acos_abs <= 4e-5);
+		CHECK(atan2_abs <= 1e-5);
+	}
+
+	TEST_CASE("Special values") {
+		for (float x : { 0.0f, (float)pi / 2.0f, (float)pi, -(float)pi / 2.0f, 100.0f * (float)pi }) {
+			CHECK(std::fabs(trig::Precise::sin(x) - std::sin(x)) < 1e-6f);
+			CHECK(std::fabs(trig::Precise::cos(x) - std::cos(x)) < 1e-6f);
+		}
+		CHECK(trig::Precise::sin(0.0f) == 0.0f);
+		CHECK(trig::Precise::cos(0.0f) == 1.0f);
+		CHECK(std::isnan(trig::Precise::sin(NAN)));
+		CHECK(std::isnan(trig::Fast::cos(INFINITY)));
+
+		CHECK(trig::Precise::acos(1.0f) == 0.0f);
+		CHECK(trig::Precise::acos(-1.0f) == doctest::Approx((float)pi));
+		CHECK(std::isnan(trig::Precise::acos(1.5f)));
+
+		CHECK(trig::Precise::atan2(0.0f, 0.0f) == 0.0f);
+		CHECK(trig::Precise::atan2(0.0f, 1.0f) == 0.0f);
+		CHECK(trig::Precise::atan2(1.0f, 0.0f) == doctest::Approx((float)pi / 2.0f));
+		CHECK(trig::Precise::atan2(0.0f, -1.0f) == doctest::Approx((float)pi));
+		CHECK(trig::Precise::atan2(-1.0f, -1.0f) == doctest::Approx(-3.0f * (float)pi / 4.0f));
+	}
+
+	template <class Trig>
+	void check_lanes() {
+		uint32_t seed = 7;
+		for (int n = 0; n < 1000; ++n) {
+			float x[4], y[4];
+			for (int i = 0; i < 4; ++i) {
+				seed = seed * 1664525u + 1013904223u;
+				x[i] = float(seed >> 8) / float(1 << 24) * 40.0f - 20.0f;
+				seed = seed * 1664525u + 1013904223u;
+				y[i] = float(seed >> 8) / float(1 << 24) * 2.0f - 1.0f;
+			}
+			x[3] = n % 2 ? 1e5f : x[3];
+
+			simd::float4 s, c;
+			Trig::sincos(simd::load(x), s, c);
+			float ss[4], cs[4], ac[4], at[4];
+			simd::store(ss, s);
+			simd::store(cs, c);
+			simd::store(ac, Trig::acos(simd::load(y)));
+			simd::store(at, Trig::atan2(simd::load(y), simd::load(x)));
+			for (int i = 0; i < 4; ++i) {
+				float s1, c1;
+				Trig::sincos(x[i], s1, c1);
+				CHECK(ss[i] == s1);
+				CHECK(cs[i] == c1);
+				CHECK(ac[i] == Trig::acos(y[i]));
+				CHECK(at[i] == Trig::atan2(y[i], x[i]));
+			}
+		}
+	}
+
+	TEST_CASE("Lanes match scalar") {
+		check_lanes<trig::Precise>();
+		check_lanes<trig::Fast>();
+	}
+
+	TEST_CASE("Builders") {
+		Vec3f axis(0.3f, -0.8f, 0.5f);
+		for (float angle : { -2.5f, -0.4f, 0.0f, 1.0f, 3.0f, 7.5f }) {
+			CHECK(nearly_equal(rotation(axis, angle), rotation<trig::Std>(axis, angle)));
+			CHECK(nearly_equal(rotX(angle), rotation(Vec3f(1.0f, 0.0f, 0.0f), angle)));
+			CHECK(nearly_equal(rotY(angle), rotation(Vec3f(0.0f, 1.0f, 0.0f), angle)));
+			CHECK(nearly_equal(rotZ(angle), rotation(Vec3f(0.0f, 0.0f, 1.0f), angle)));
+
+			Xformf fast = rotation<trig::Fast>(axis, angle), precise = rotation(axis, angle);
+			for (size_t i = 0; i < 12; ++i) CHECK(std::fabs(fast.arr[i] - precise.arr[i]) < 1e-4f);
+
+			Quaternion q(axis, angle), q_fast(axis, angle, trig::Fast()), q_std(axis, angle, trig::Std());
+			CHECK(q.nearly_equal(q_std));
+			CHECK(std::fabs(q_fast.Dot(q)) == doctest::Approx(1.0f).epsilon(1e-4));
+			CHECK(nearly_equal(q.ToRot(), precise));
+		}
+
+		Mat4f p = perspective(1.2f, 1.5f, 0.1f, 100.0f), p_std = perspective<trig::Std>(1.2f, 1.5f, 0.1f, 100.0f);
+		CHECK(p[1][1] == doctest::Approx(1.0f / std::tan(0.6f)));
+		CHECK(nearly_equal(p, p_std));
+		CHECK(perspective<trig::Fast>(1.2f, 1.5f, 0.1f, 100.0f)[0][0] == doctest::Approx(p[0][0]).epsilon(1e-4));
+	}
+
+	TEST_CASE("Batch from axis angle") {
+		// 11 elements covers both the four-wide body and the scalar tail
+		Vec3fSoA axes;
+		vector<float> angles;
+		for (int n = 0; n < 11; ++n) {
+			axes.push_back(Vec3f(std::sin(float(n)), std::cos(n * 1.3f), 0.5f) * 2.0f);
+			angles.push_back(n * 0.9f - 4.0f);
+		}
+
+		QuaternionBatch batch, fast;
+		from_axis_angle(axes, angles, batch);
+		from_axis_angle<trig::Fast>(axes, angles, fast);
+		REQUIRE(batch.size() == axes.size());
+		for (size_t n = 0; n < axes.size(); ++n) {
+			Quaternion q(axes.get(n), angles[n]);
+			CHECK(batch.get(n).nearly_equal(q));
+			CHECK(std::fabs(fast.get(n).Dot(q)) == doctest::Approx(1.0f).epsilon(1e-4));
+		}
+	}
+}
+
+TEST_SUITE("TRS Batch") {
+	// 203 elements: several four-wide groups, a scalar tail, and a few mirrored, sheared and flat ones
+	TRSBatch make_batch() {
+		uint32_t seed = 5;
+		TRSBatch trs;
+		for (size_t n = 0; n < 203; ++n) {
+			Vec3f axis(random_float(seed) - 0.5f, random_float(seed) - 0.5f, random_float(seed) + 0.1f);
+			Quaternion q(axis, random_float(seed) * 12.0f - 6.0f);
+			Vec3f t(random_float(seed) * 20.0f - 10.0f, random_float(seed) * 20.0f - 10.0f, random_float(seed) * 20.0f - 10.0f);
+			Vec3f s(random_float(seed) * 3.0f + 0.1f, random_float(seed) * 3.0f + 0.1f, random_float(seed) * 3.0f + 0.1f);
+			if (n % 17 == 3) s[1] = -s[1];
+			if (n == 50) s[2] = 0.0f;
+			trs.push_back(q, t, s);
+		}
+		return trs;
+	}
+
+	TEST_CASE("Compose") {
+		TRSBatch trs = make_batch();
+		vector<Xformf> out(trs.size());
+		compose(trs, out);
+		for (size_t n = 0; n < trs.size(); ++n) {
+			CHECK(nearly_equal(out[n], compose(trs.rotation.get(n), trs.translation.get(n), trs.scale.get(n))));
+		}
+	}
+
+	TEST_CASE("Decompose") {
+		TRSBatch trs = make_batch();
+		vector<Xformf> xforms(trs.size());
+		compose(trs, xforms);
+		xforms[9].data[1][0] += 0.3f;
+		xforms[100].data[2][1] -= 0.5f;
+
+		TRSBatch out;
+		decompose(xforms, out);
+		REQUIRE(out.size() == xforms.size());
+		for (size_t n = 0; n < xforms.size(); ++n) {
+			Quaternion rotation;
+			Vec3f t, s;
+			decompose(xforms[n], rotation, t, s);
+
+			CHECK(out.translation.get(n) == t);
+			CHECK(out.rotation.get(n).r >= 0.0f);
+			CHECK(std::fabs(out.rotation.get(n).Dot(rotation)) == doctest::Approx(1.0f).epsilon(1e-5));
+			Vec3f batch_scale = out.scale.get(n);
+			for (size_t k = 0; k < 3; ++k) CHECK(batch_scale[k] == doctest::Approx(s[k]).epsilon(1e-5));
+		}
+
+		// Unsheared elements round trip through the batch path
+		vector<Xformf> again(out.size());
+		compose(out, again);
+		for (size_t n : { size_t(0), size_t(3), size_t(50), size_t(121), size_t(202) }) {
+			for (size_t k = 0; k < 12; ++k) CHECK(again[n].arr[k] == doctest::Approx(xforms[n].arr[k]).epsilon(1e-4));
+		}
+	}
+}
+
+TEST_SUITE("Dual Quaternions") {
+	bool close(const Vec3f& a, const Vec3f& b, float tolerance = 1e-4f) {
+		for (size_t k = 0; k < 3; ++k) if (std::fabs(a[k] - b[k]) > tolerance) return false;
+		return true;
+	}
+
+	bool close(const Xformf& a, const Xformf& b, float tolerance = 1e-4f) {
+		for (size_t k = 0; k < 12; ++k) if (std::fabs(a.arr[k] - b.arr[k]) > tolerance) return false;
+		return true;
+	}
+
+	const Quaternion RotationA(Vec3f(0.3f, -1.0f, 0.5f), 1.1f);
+	const Quaternion RotationB(Vec3f(1.0f, 0.2f, 0.0f), -2.4f);
+	const Vec3f TranslationA(1.0f, -2.0f, 3.5f);
+	const Vec3f TranslationB(-4.0f, 0.5f, 2.0f);
+
+	TEST_CASE("Construction") {
+		DualQuaternion dq(RotationA, TranslationA);
+		CHECK(close(dq.Translation(), TranslationA));
+		CHECK(close(dq.ToXform(), compose(RotationA, TranslationA, Vec3f(1.0f, 1.0f, 1.0f))));
+
+		DualQuaternion identity(Quaternion(0.0f, 0.0f, 0.0f, 1.0f), Vec3f(0.0f, 0.0f, 0.0f));
+		CHECK(identity.ToXform() == Identity);
+	}
+
+	TEST_CASE("Xformf Round Trip") {
+		Xformf xform = compose(RotationB, TranslationB, Vec3f(1.0f, 1.0f, 1.0f));
+		DualQuaternion dq(xform);
+		CHECK(close(dq.ToXform(), xform));
+
+		// Scale is dropped, rotation and translation are kept
+		DualQuaternion scaled(compose(RotationB, TranslationB, Vec3f(2.0f, 0.5f, 3.0f)));
+		CHECK(close(scaled.ToXform(), xform));
+	}
+
+	TEST_CASE("Composition") {
+		DualQuaternion a(RotationA, TranslationA), b(RotationB, TranslationB);
+		CHECK(close((a * b).ToXform(), a.ToXform() * b.ToXform()));
+		CHECK(close((b * a).ToXform(), b.ToXform() * a.ToXform()));
+
+		// The conjugate inverts a unit dual quaternion
+		DualQuaternion round_trip = a * a.Conjugate();
+		CHECK(close(round_trip.ToXform(), Identity));
+	}
+
+	TEST_CASE("Transform Points") {
+		DualQuaternion dq(RotationA, TranslationA);
+		Xformf xform = dq.ToXform();
+		Vec3f p(0.5f, -1.5f, 2.0f);
+		Vec3f expected[1];
+		transform_points(xform, span<const Vec3f>(&p, 1), expected);
+		CHECK(close(dq.TransformPoint(p), expected[0]));
+		CHECK(close(dq.TransformVector(p), expected[0] - TranslationA));
+
+		// Normalize only rescales
+		CHECK(close((dq * 3.0f).Normalize().ToXform(), xform));
+	}
+}
+
+TEST_SUITE("Skinning") {
+	bool close(const Vec3f& a, const Vec3f& b, float tolerance = 1e-4f) {
+		for (size_t k = 0; k < 3; ++k) if (std::fabs(a[k] - b[k]) > tolerance * std::max(1.0f, std::fabs(b[k]))) return false;
+		return true;
+	}
+
+	constexpr size_t BoneCount = 9;
+
+	vector<DualQuaternion> make_bones() {
+		uint32_t seed = 11;
+		vector<DualQuaternion> bones;
+		for (size_t b = 0; b < BoneCount; ++b) {
+			Vec3f axis(random_float(seed) - 0.5f, random_float(seed) - 0.5f, random_float(seed) + 0.1f);
+			Quaternion q(axis, random_float(seed) * 6.0f - 3.0f);
+			// Odd bones store the antipodal quaternion to exercise the hemisphere flip
+			if (b % 2) q = q * -1.0f;
+			bones.emplace_back(q, Vec3f(random_float(seed) * 4.0f - 2.0f, random_float(seed) * 4.0f - 2.0f, random_float(seed) * 4.0f - 2.0f));
+		}
+		return bones;
+	}
+
+	// 203 vertices: several four-wide groups and a tail, with one to four influences each
+	void make_mesh(Vert3dSoA& mesh, SkinInfluences& influences) {
+		uint32_t seed = 7;
+		for (size_t n = 0; n < 203; ++n) {
+			Vec3f p(random_float(seed) * 2.0f - 1.0f, random_float(seed) * 2.0f - 1.0f, random_float(seed) * 2.0f - 1.0f);
+			Vec3f normal(random_float(seed) - 0.5f, random_float(seed) - 0.5f, random_float(seed) + 0.1f);
+			mesh.pos.push_back(p);
+			mesh.norm.push_back(normal.normalize());
+			mesh.uv.push_back(Vec2f(0.0f, 0.0f));
+
+			array<uint16_t, 4> bones {};
+			array<float, 4> weights {};
+			size_t used = n % 4 + 1;
+			float total = 0.0f;
+			for (size_t k = 0; k < used; ++k) {
+				bones[k] = uint16_t((n + 3 * k) % BoneCount);
+				weights[k] = random_float(seed) + 0.05f;
+				total += weights[k];
+			}
+			for (size_t k = 0; k < used; ++k) weights[k] /= total;
+			influences.push_back(bones, weights);
+		}
+	}
+
+	TEST_CASE("Linear Blend") {
+		vector<DualQuaternion> dqs = make_bones();
+		vector<Xformf> bones;
+		for (const DualQuaternion& dq : dqs) bones.push_back(dq.ToXform());
+		Vert3dSoA mesh;
+		SkinInfluences influences;
+		make_mesh(mesh, influences);
+
+		Vec3fSoA positions, normals;
+		skin_linear(bones, mesh, influences, positions, normals);
+		REQUIRE(positions.size() == mesh.size());
+		REQUIRE(normals.size() == mesh.size());
+
+		for (size_t n = 0; n < mesh.size(); ++n) {
+			Xformf blend;
+			blend.arr.fill(0.0f);
+			for (size_t k = 0; k < SkinInfluences::Slots; ++k) {
+				float w = influences.weights[k][n];
+				for (size_t e = 0; e < 12; ++e) blend.arr[e] += w * bones[influences.bones[k][n]].arr[e];
+			}
+			Vec3f p = mesh.pos.get(n), normal = mesh.norm.get(n);
+			Vec3f expected = Vec3f(blend[0]) * p[0] + Vec3f(blend[1]) * p[1] + Vec3f(blend[2]) * p[2] + Vec3f(blend[3]);
+			Vec3f expected_normal = (Vec3f(blend[0]) * normal[0] + Vec3f(blend[1]) * normal[1] + Vec3f(blend[2]) * normal[2]).normalize();
+			CHECK(close(positions.get(n), expected));
+			CHECK(close(normals.get(n), expected_normal));
+		}
+	}
+
+	TEST_CASE("Dual Quaternion Blend") {
+		vector<DualQuaternion> bones = make_bones();
+		Vert3dSoA mesh;
+		SkinInfluences influences;
+		make_mesh(mesh, influences);
+
+		Vec3fSoA positions, normals;
+		skin_dual_quaternion(bones, mesh, influences, positions, normals);
+		REQUIRE(positions.size() == mesh.size());
+
+		for (size_t n = 0; n < mesh.size(); ++n) {
+			const DualQuaternion& pivot = bones[influences.bones[0][n]];
+			DualQuaternion blend(Quaternion(0.0f, 0.0f, 0.0f, 0.0f), Quaternion(0.0f, 0.0f, 0.0f, 0.0f));
+			for (size_t k = 0; k < SkinInfluences::Slots; ++k) {
+				const DualQuaternion& bone = bones[influences.bones[k][n]];
+				float w = influences.weights[k][n];
+				blend = blend + bone * (bone.real.Dot(pivot.real) < 0.0f ? -w : w);
+			}
+			blend = blend.Normalize();
+			CHECK(close(positions.get(n), blend.TransformPoint(mesh.pos.get(n))));
+			CHECK(close(normals.get(n), blend.TransformVector(mesh.norm.get(n))));
+		}
+	}
+
+	TEST_CASE("Single Rigid Bone") {
+		// With one full-weight bone both methods are the bone's rigid transform
+		vector<DualQuaternion> dqs = make_bones();
+		vector<Xformf> bones;
+		for (const DualQuaternion& dq : dqs) bones.push_back(dq.ToXform());
+		Vert3dSoA mesh;
+		SkinInfluences influences;
+		make_mesh(mesh, influences);
+		for (size_t k = 1; k < SkinInfluences::Slots; ++k) std::fill(influences.weights[k].begin(), influences.weights[k].end(), 0.0f);
+		std::fill(influences.weights[0].begin(), influences.weights[0].end(), 1.0f);
+
+		Vec3fSoA linear_positions, linear_normals, dq_positions, dq_normals;
+		skin_linear(bones, mesh, influences, linear_positions, linear_normals);
+		skin_dual_quaternion(dqs, mesh, influences, dq_positions, dq_normals);
+		for (size_t n = 0; n < mesh.size(); ++n) {
+			CHECK(close(linear_positions.get(n), dq_positions.get(n)));
+			CHECK(close(linear_normals.get(n), dq_normals.get(n)));
+		}
+	}
+}
+
+TEST_SUITE("Mesh") {
+	bool close(const Vec3f& a, const Vec3f& b, float tolerance = 1e-4f) {
+		for (size_t k = 0; k < 3; ++k) if (std::fabs(a[k] - b[k]) > tolerance * std::max(1.0f, std::fabs(b[k]))) return false;
+		return true;
+	}
+
+	// A wavy grid of Side x Side vertices, more than one parallel_for chunk of triangles and vertices, with
+	// uvs stretched and sheared across it. The last vertex is left out of every triangle.
+	constexpr uint32_t Side = 71;
+
+	void make_grid(Vert3dSoA& mesh, vector<uint32_t>& indices) {
+		uint32_t seed = 5;
+		for (uint32_t y = 0; y < Side; ++y) {
+			for (uint32_t x = 0; x < Side; ++x) {
+				float fx = float(x), fy = float(y);
+				mesh.pos.push_back(Vec3f(fx, fy, std::sin(fx * 0.3f) * std::cos(fy * 0.2f) * 2.0f + random_float(seed) * 0.1f));
+				mesh.norm.push_back(Vec3f(0.0f, 0.0f, 1.0f));
+				mesh.uv.push_back(Vec2f(fx * 0.1f + fy * 0.02f, fy * 0.05f));
+			}
+		}
+		mesh.pos.push_back(Vec3f(0.0f, 0.0f, 0.0f));
+		mesh.norm.push_back(Vec3f(0.0f, 0.0f, 1.0f));
+		mesh.uv.push_back(Vec2f(0.0f, 0.0f));
+
+		for (uint32_t y = 0; y + 1 < Side - 1; ++y) {
+			for (uint32_t x = 0; x + 1 < Side; ++x) {
+				uint32_t v = y * Side + x;
+				indices.insert(indices.end(), { v, v + 1, v + Side, v + 1, v + Side + 1, v + Side });
+			}
+		}
+	}
+
+	TEST_CASE("Vertex Triangles") {
+		Vert3dSoA mesh;
+		vector<uint32_t> indices;
+		make_grid(mesh, indices);
+
+		VertexTriangles adjacency;
+		adjacency.build(indices, mesh.size());
+		REQUIRE(adjacency.vertex_count() == mesh.size());
+		CHECK(adjacency.around(mesh.size() - 1).empty());
+
+		size_t corners = 0;
+		for (size_t v = 0; v < mesh.size(); ++v) {
+			span<const uint32_t> around = adjacency.around(v);
+			CHECK(std::is_sorted(around.begin(), around.end()));
+			for (uint32_t t : around) {
+				CHECK((indices[3 * t] == v || indices[3 * t + 1] == v || indices[3 * t + 2] == v));
+			}
+			corners += around.size();
+		}
+		CHECK(corners == indices.size());
+	}
+
+	TEST_CASE("Normals") {
+		Vert3dSoA mesh;
+		vector<uint32_t> indices;
+		make_grid(mesh, indices);
+
+		vector<Vec3f> expected(mesh.size(), Vec3f(0.0f, 0.0f, 0.0f));
+		Vec3fSoA faces;
+		face_normals(mesh.pos, indices, faces);
+		REQUIRE(faces.size() == indices.size() / 3);
+		for (size_t t = 0; t < faces.size(); ++t) {
+			Vec3f p0 = mesh.pos.get(indices[3 * t]), p1 = mesh.pos.get(indices[3 * t + 1]), p2 = mesh.pos.get(indices[3 * t + 2]);
+			Vec3f n = (p1 - p0).cross(p2 - p0);
+			CHECK(close(faces.get(t), n.normalize()));
+			for (size_t c = 0; c < 3; ++c) expected[indices[3 * t + c]] = expected[indices[3 * t + c]] + n;
+		}
+
+		Vec3fSoA normals;
+		vertex_normals(mesh.pos, indices, normals);
+		REQUIRE(normals.size() == mesh.size());
+		for (size_t v = 0; v + 1 < mesh.size(); ++v) {
+			CHECK(close(normals.get(v), expected[v].normalize()));
+		}
+		CHECK(normals.get(mesh.size() - 1) == Vec3f(0.0f, 0.0f, 0.0f));
+
+		// The same sums on one thread and on four
+		for (size_t threads : { 1, 4 }) {
+			JobSystem system(threads);
+			JobSystem::Scope scope(system);
+			Vec3fSoA other;
+			vertex_normals(mesh.pos, indices, other);
+			for (size_t k = 0; k < 3; ++k) CHECK(std::equal(other.streams[k].begin(), other.streams[k].end(), normals.streams[k].begin()));
+		}
+	}
+
+	TEST_CASE("Tangents") {
+		Vert3dSoA mesh;
+		vector<uint32_t> indices;
+		make_grid(mesh, indices);
+		vertex_normals(mesh.pos, indices, mesh.norm);
+
+		// Scalar reference: area-weighted unit directions of +u and +v, then Gram-Schmidt and the handedness
+		vector<Vec3f> sum_u(mesh.size(), Vec3f(0.0f, 0.0f, 0.0f)), sum_v(mesh.size(), Vec3f(0.0f, 0.0f, 0.0f));
+		for (size_t t = 0; t < indices.size() / 3; ++t) {
+			uint32_t i0 = indices[3 * t], i1 = indices[3 * t + 1], i2 = indices[3 * t + 2];
+			Vec3f e1 = mesh.pos.get(i1) - mesh.pos.get(i0), e2 = mesh.pos.get(i2) - mesh.pos.get(i0);
+			Vec2f d1 = mesh.uv.get(i1) - mesh.uv.get(i0), d2 = mesh.uv.get(i2) - mesh.uv.get(i0);
+			float det = d1[0] * d2[1] - d2[0] * d1[1];
+			float area = e1.cross(e2).length();
+			Vec3f u = ((e1 * d2[1] - e2 * d1[1]) * det).normalize() * area;
+			Vec3f v = ((e2 * d1[0] - e1 * d2[0]) * det).normalize() * area;
+			for (uint32_t i : { i0, i1, i2 }) {
+				sum_u[i] = sum_u[i] + u;
+				sum_v[i] = sum_v[i] + v;
+			}
+		}
+
+		Vec4fSoA tangents;
+		vertex_tangents(mesh, indices, tangents);
+		REQUIRE(tangents.size() == mesh.size());
+		for (size_t v = 0; v + 1 < mesh.size(); ++v) {
+			Vec3f n = mesh.norm.get(v);
+			Vec3f expected = (sum_u[v] - n * n.dot(sum_u[v])).normalize();
+			float w = n.cross(expected).dot(sum_v[v]) < 0.0f ? -1.0f : 1.0f;
+			Vec4f tangent = tangents.get(v);
+			Vec3f t(tangent[0], tangent[1], tangent[2]);
+			CHECK(close(t, expected));
+			CHECK(tangent[3] == w);
+			CHECK(std::fabs(t.dot(n)) < 1e-5f);
+		}
+
+		// The unused vertex has a zero normal, so not even the fallback gives it a direction
+		Vec4f unused = tangents.get(mesh.size() - 1);
+		CHECK(Vec3f(unused[0], unused[1], unused[2]) == Vec3f(0.0f, 0.0f, 0.0f));
+	}
+
+	TEST_CASE("Tangent Handedness") {
+		// A flat quad in the xy plane with u along +x: v along +y is right-handed, v along -y mirrored
+		for (float flip : { 1.0f, -1.0f }) {
+			Vert3dSoA mesh;
+			for (Vec2f corner : { Vec2f(0.0f, 0.0f), Vec2f(1.0f, 0.0f), Vec2f(0.0f, 1.0f), Vec2f(1.0f, 1.0f) }) {
+				mesh.pos.push_back(Vec3f(corner[0], corner[1], 0.0f));
+				mesh.norm.push_back(Vec3f(0.0f, 0.0f, 1.0f));
+				mesh.uv.push_back(Vec2f(corner[0] * 0.5f, corner[1] * flip));
+			}
+			// The second triangle has all three uvs on one line and is skipped
+			vector<uint32_t> indices { 0, 1, 2, 1, 3, 2 };
+			mesh.uv.set(3, Vec2f(0.5f, 0.0f));
+			mesh.uv.set(2, Vec2f(0.0f, flip));
+
+			Vec4fSoA tangents;
+			vertex_tangents(mesh, indices, tangents);
+			for (size_t v = 0; v < 3; ++v) {
+				Vec4f t = tangents.get(v);
+				CHECK(close(Vec3f(t[0], t[1], t[2]), Vec3f(1.0f, 0.0f, 0.0f)));
+				CHECK(t[3] == flip);
+			}
+
+			// Vertex 3 is only in the skipped triangle, so it falls back to a tangent perpendicular to z
+			Vec4f fallback = tangents.get(3);
+			CHECK(std::fabs(fallback[2]) < 1e-6f);
+			CHECK(std::fabs(Vec3f(fallback[0], fallback[1], fallback[2]).length() - 1.0f) < 1e-5f);
+		}
+	}
+
+	TEST_CASE("Bounds") {
+		uint32_t seed = 3;
+		Vec3fSoA points;
+		Vec3f center(1e3f, -20.0f, 5.0f);
+		for (size_t n = 0; n < 10007; ++n) {
+			Vec3f d(random_float(seed) - 0.5f, random_float(seed) - 0.5f, random_float(seed) - 0.5f);
+			points.push_back(center + d.normalize() * 8.0f);
+		}
+
+		float lo[3] = { INFINITY, INFINITY, INFINITY }, hi[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for (size_t n = 0; n < points.size(); ++n) {
+			for (size_t k = 0; k < 3; ++k) {
+				lo[k] = std::min(lo[k], points.streams[k][n]);
+				hi[k] = std::max(hi[k], points.streams[k][n]);
+			}
+		}
+		AABB box = bounding_box(points);
+		for (size_t k = 0; k < 3; ++k) {
+			CHECK(box.center[k] - box.halfwidths[k] == doctest::Approx(lo[k]));
+			CHECK(box.center[k] + box.halfwidths[k] == doctest::Approx(hi[k]));
+		}
+
+		// Points on a sphere of radius 8: the bound holds them all and stays close to that sphere
+		Sphere sphere = bounding_sphere(points);
+		for (size_t n = 0; n < points.size(); ++n) {
+			CHECK((points.get(n) - sphere.center).length() <= sphere.radius * 1.00001f);
+		}
+		CHECK(sphere.radius < 8.0f * 1.05f);
+		CHECK((sphere.center - center).length() < 0.5f);
+
+		CHECK(bounding_sphere(Vec3fSoA()).radius == 0.0f);
+		Vec3fSoA single;
+		single.push_back(center);
+		CHECK(bounding_sphere(single).radius == 0.0f);
+		CHECK(bounding_box(single).halfwidths[0] == 0.0f);
+	}
+}
+
+TEST_SUITE("Compression") {
+	Vec3f random_unit(uint32_t& seed) {
+		for (;;) {
+			Vec3f v(random_float(seed) * 2.0f - 1.0f, random_float(seed) * 2.0f - 1.0f, random_float(seed) * 2.0f - 1.0f);
+			if (float l = v.length(); l > 0.1f && l <= 1.0f) return v / l;
+		}
+	}
+
+	Quaternion random_rotation(uint32_t& seed) {
+		return Quaternion(random_unit(seed), random_float(seed) * 6.2f);
+	}
+
+	// q and -q are the same rotation
+	float rotation_error(const Quaternion& a, const Quaternion& b) {
+		float sign = a.Dot(b) < 0.0f ? -1.0f : 1.0f;
+		float error = 0.0f;
+		for (size_t c = 0; c < 4; ++c) error = std::max(error, std::fabs(a.vals[c] * sign - b.vals[c]));
+		return error;
+	}
+
+	static_assert(from_half(to_half(0.5f)) == 0.5f);
+	static_assert(to_half(1.0f) == 0x3C00 && to_half(-2.0f) == 0xC000);
+
+	TEST_CASE("Half Floats") {
+		// Every half survives the trip through float, NaNs as NaNs
+		for (uint32_t h = 0; h < 0x10000; ++h) {
+			float f = from_half(uint16_t(h));
+			if (std::isnan(f)) CHECK((h & 0x7C00) == 0x7C00);
+			else CHECK(to_half(f) == h);
+		}
+
+		// Ties round to even, overflow saturates to infinity, tiny values go subnormal then to zero
+		CHECK(to_half(1.0f + 1.0f / 2048.0f) == 0x3C00);
+		CHECK(to_half(1.0f + 3.0f / 2048.0f) == 0x3C02);
+		CHECK(to_half(65519.0f) == 0x7BFF);
+		CHECK(to_half(65520.0f) == 0x7C00);
+		CHECK(to_half(-INFINITY) == 0xFC00);
+		CHECK(std::isnan(from_half(to_half(NAN))));
+		CHECK(to_half(std::ldexp(1.0f, -24)) == 0x0001);
+		CHECK(to_half(std::ldexp(1.0f, -26)) == 0x0000);
+
+		uint32_t seed = 1;
+		for (size_t n = 0; n < 10000; ++n) {
+			float f = (random_float(seed) * 2.0f - 1.0f) * 1000.0f;
+			CHECK(std::fabs(from_half(to_half(f)) - f) <= std::fabs(f) * (1.0f / 2048.0f));
+		}
+	}
+
+	TEST_CASE("Half UVs") {
+		uint32_t seed = 2;
+		Vec2fSoA uvs;
+		for (size_t n = 0; n < 1003; ++n) uvs.push_back(Vec2f(random_float(seed) * 4.0f - 1.0f, random_float(seed)));
+
+		vector<HalfUV> packed(uvs.size());
+		encode_uvs(uvs, packed);
+		Vec2fSoA decoded;
+		decode_uvs(packed, decoded);
+		REQUIRE(decoded.size() == uvs.size());
+		for (size_t n = 0; n < uvs.size(); ++n) {
+			HalfUV expected(uvs.get(n));
+			CHECK(packed[n].u == expected.u);
+			CHECK(packed[n].v == expected.v);
+			CHECK(decoded.get(n) == expected.decode());
+		}
+	}
+
+	TEST_CASE("Octahedral Normals") {
+		uint32_t seed = 3;
+		Vec3fSoA normals;
+		for (size_t n = 0; n < 1003; ++n) normals.push_back(random_unit(seed));
+		for (float s : { 1.0f, -1.0f }) {
+			normals.push_back(Vec3f(s, 0.0f, 0.0f));
+			normals.push_back(Vec3f(0.0f, s, 0.0f));
+			normals.push_back(Vec3f(0.0f, 0.0f, s));
+		}
+
+		vector<OctNormal32> wide(normals.size());
+		vector<OctNormal16> narrow(normals.size());
+		encode_normals(normals, span<OctNormal32>(wide));
+		encode_normals(normals, span<OctNormal16>(narrow));
+		Vec3fSoA wide_decoded, narrow_decoded;
+		decode_normals(span<const OctNormal32>(wide), wide_decoded);
+		decode_normals(span<const OctNormal16>(narrow), narrow_decoded);
+
+		float wide_error = 0.0f, narrow_error = 0.0f;
+		for (size_t n = 0; n < normals.size(); ++n) {
+			Vec3f normal = normals.get(n);
+			OctNormal32 w(normal);
+			OctNormal16 s(normal);
+			CHECK((wide[n].x == w.x && wide[n].y == w.y));
+			CHECK((narrow[n].x == s.x && narrow[n].y == s.y));
+			CHECK((wide_decoded.get(n) - w.decode()).length() < 1e-6f);
+			CHECK((narrow_decoded.get(n) - s.decode()).length() < 1e-6f);
+			CHECK(std::fabs(wide_decoded.get(n).length() - 1.0f) < 1e-6f);
+
+			wide_error = std::max(wide_error, (wide_decoded.get(n) - normal).length());
+			narrow_error = std::max(narrow_error, (narrow_decoded.get(n) - normal).length());
+		}
+		CHECK(wide_error < 6.5e-5f);
+		CHECK(narrow_error < 1.7e-2f);
+
+		CHECK(OctNormal32(Vec3f(0.0f, 0.0f, 0.0f)).decode()[2] > 0.9999f);
+	}
+
+	TEST_CASE("Quantized Positions") {
+		uint32_t seed = 4;
+		AABB bounds { Vec3f(100.0f, -3.0f, 0.5f), { 50.0f, 2.0f, 0.01f } };
+		Vec3fSoA positions;
+		for (size_t n = 0; n < 1003; ++n) {
+			Vec3f p;
+			for (size_t k = 0; k < 3; ++k) p[k] = bounds.center[k] + (random_float(seed) * 2.0f - 1.0f) * bounds.halfwidths[k];
+			positions.push_back(p);
+		}
+		// Outside the box, clamped onto its corner
+		positions.push_back(Vec3f(1e4f, -1e4f, 1e4f));
+
+		vector<QuantizedPosition> packed(positions.size());
+		quantize_positions(bounds, positions, packed);
+		Vec3fSoA decoded;
+		dequantize_positions(bounds, packed, decoded);
+		for (size_t n = 0; n + 1 < positions.size(); ++n) {
+			QuantizedPosition expected(positions.get(n), bounds);
+			CHECK((packed[n].x == expected.x && packed[n].y == expected.y && packed[n].z == expected.z));
+			for (size_t k = 0; k < 3; ++k) {
+				CHECK(std::fabs(decoded.streams[k][n] - positions.streams[k][n]) <= bounds.halfwidths[k] / 65535.0f + 1e-5f * std::fabs(bounds.center[k]));
+			}
+		}
+		QuantizedPosition corner = packed.back();
+		CHECK((corner.x == 0xFFFF && corner.y == 0 && corner.z == 0xFFFF));
+	}
+
+	TEST_CASE("Smallest Three Quaternions") {
+		uint32_t seed = 5;
+		vector<Quaternion> rotations;
+		for (size_t n = 0; n < 1003; ++n) rotations.push_back(random_rotation(seed));
+		rotations.push_back(Quaternion(0.0f, 0.0f, 0.0f, -1.0f));
+		rotations.push_back(Quaternion(0.5f, -0.5f, 0.5f, -0.5f));
+
+		vector<PackedQuaternion32> small(rotations.size());
+		vector<PackedQuaternion48> large(rotations.size());
+		encode_quaternions(rotations, span<PackedQuaternion32>(small));
+		encode_quaternions(rotations, span<PackedQuaternion48>(large));
+		vector<Quaternion> small_decoded(rotations.size()), large_decoded(rotations.size());
+		decode_quaternions(span<const PackedQuaternion32>(small), small_decoded);
+		decode_quaternions(span<const PackedQuaternion48>(large), large_decoded);
+
+		float small_error = 0.0f, large_error = 0.0f;
+		for (size_t n = 0; n < rotations.size(); ++n) {
+			CHECK(small[n].bits == PackedQuaternion32(rotations[n]).bits);
+			CHECK(std::equal(large[n].bits, large[n].bits + 3, PackedQuaternion48(rotations[n]).bits));
+			small_error = std::max(small_error, rotation_error(rotations[n], small_decoded[n]));
+			large_error = std::max(large_error, rotation_error(rotations[n], large_decoded[n]));
+			CHECK(std::fabs(large_decoded[n].Mag() - 1.0f) < 1e-4f);
+		}
+		CHECK(small_error < 1.9e-3f);
+		CHECK(large_error < 6.1e-5f);
+	}
+
+	TEST_CASE("Packed TRS") {
+		uint32_t seed = 6;
+		vector<Xformf> xforms;
+		for (size_t n = 0; n < 203; ++n) {
+			Vec3f t(random_float(seed) * 200.0f - 100.0f, random_float(seed) * 200.0f - 100.0f, random_float(seed) * 200.0f - 100.0f);
+			Vec3f s(random_float(seed) + 0.5f, random_float(seed) + 0.5f, random_float(seed) + 0.5f);
+			xforms.push_back(compose(random_rotation(seed), t, s));
+		}
+
+		vector<PackedTRS> packed(xforms.size());
+		encode_transforms(xforms, packed);
+		vector<Xformf> decoded(xforms.size());
+		decode_transforms(packed, decoded);
+		for (size_t n = 0; n < xforms.size(); ++n) {
+			CHECK(std::equal(packed[n].scale, packed[n].scale + 3, PackedTRS(xforms[n]).scale));
+			// Translation is kept exactly; the linear part is within the rotation and half scale error
+			for (size_t e = 0; e < 12; ++e) {
+				CHECK(std::fabs(decoded[n].arr[e] - xforms[n].arr[e]) < (e < 9 ? 2e-3f : 1e-5f * 100.0f));
+			}
+		}
+	}
+}
+
+TEST_SUITE("Animation") {
+	bool close(const Vec3f& a, const Vec3f& b, float tolerance = 1e-4f) {
+		for (size_t k = 0; k < 3; ++k) if (std::fabs(a[k] - b[k]) > tolerance * std::max(1.0f, std::fabs(b[k]))) return false;
+		return true;
+	}
+
+	// q and -q are the same rotation
+	bool close(const Quaternion& a, const Quaternion& b, float tolerance = 1e-4f) {
+		float sign = a.Dot(b) < 0.0f ? -1.0f : 1.0f;
+		for (size_t c = 0; c < 4; ++c) if (std::fabs(a.vals[c] * sign - b.vals[c]) > tolerance) return false;
+		return true;
+	}
+
+	Quaternion stored(const float* p) { return Quaternion(p[0], p[1], p[2], p[3]); }
+
+	Quaternion random_rotation(uint32_t& seed) {
+		Vec3f axis(random_float(seed) * 2.0f - 1.0f, random_float(seed) * 2.0f - 1.0f, random_float(seed) * 2.0f + 0.1f);
+		return Quaternion(axis, random_float(seed) * 6.0f - 3.0f);
+	}
+
+	// Unevenly spaced key times starting at zero
+	vector<float> key_times(uint32_t& seed, size_t count) {
+		vector<float> times;
+		float t = 0.0f;
+		for (size_t k = 0; k < count; ++k) {
+			times.push_back(t);
+			t += 0.05f + random_float(seed) * 0.2f;
+		}
+		return times;
+	}
+
+	// A clip over joints joints cycling through every channel, mode and key count, with some joints left
+	// without a track in each channel
+	AnimationClip make_clip(size_t joints, uint32_t seed) {
+		AnimationClip clip(joints);
+		constexpr Interpolation Modes[] = { Interpolation::Step, Interpolation::Linear, Interpolation::Cubic };
+		for (size_t j = 0; j < joints; ++j) {
+			vector<float> times = key_times(seed, 1 + j % 7);
+			vector<Vec3f> points;
+			vector<Quaternion> rotations;
+			for (size_t k = 0; k < times.size(); ++k) {
+				points.push_back(Vec3f(random_float(seed) * 4.0f - 2.0f, random_float(seed) * 4.0f - 2.0f, random_float(seed) + 0.5f));
+				rotations.push_back(random_rotation(seed));
+			}
+			if (j % 5 != 1) clip.add_translation(j, times, points, Modes[j % 3]);
+			if (j % 5 != 2) clip.add_rotation(j, times, rotations, Modes[(j + 1) % 3]);
+			if (j % 5 != 3) clip.add_scale(j, times, points, Modes[(j + 2) % 3]);
+		}
+		return clip;
+	}
+
+	TEST_CASE("Vector Tracks") {
+		AnimationClip clip(3);
+		vector<float> times = { 0.0f, 0.5f, 1.5f, 2.0f };
+		vector<Vec3f> points = { Vec3f(0.0f, 0.0f, 0.0f), Vec3f(1.0f, 2.0f, 0.0f), Vec3f(3.0f, -1.0f, 1.0f), Vec3f(2.0f, 0.0f, 4.0f) };
+
+		// p(t) = (t^3, t^2 - t, 2t) and its derivative, which a Hermite spline reproduces exactly
+		vector<Vec3f> cubic, tangents;
+		for (float t : times) {
+			cubic.push_back(Vec3f(t * t * t, t * t - t, 2.0f * t));
+			tangents.push_back(Vec3f(3.0f * t * t, 2.0f * t - 1.0f, 2.0f));
+		}
+		clip.add_translation(0, times, points, Interpolation::Linear);
+		clip.add_translation(1, times, points, Interpolation::Step);
+		clip.add_translation(2, times, cubic, Interpolation::Cubic, tangents);
+		clip.add_scale(0, times, points, Interpolation::Cubic);
+		CHECK(clip.duration() == 2.0f);
+
+		AnimationSampler sampler;
+		TRSBatch out;
+		for (float t = -0.25f; t <= 2.25f; t += 0.0625f) {
+			sampler.sample(clip, t, out);
+			REQUIRE(out.size() == 3);
+
+			size_t k = 0;
+			while (k + 1 < times.size() && times[k + 1] <= t) ++k;
+			float s = k + 1 < times.size() ? std::clamp((t - times[k]) / (times[k + 1] - times[k]), 0.0f, 1.0f) : 0.0f;
+			Vec3f next = points[std::min(k + 1, times.size() - 1)];
+			CHECK(close(out.translation.get(0), points[k] * (1.0f - s) + next * s));
+			CHECK(out.translation.get(1) == points[k]);
+
+			float clamped = std::clamp(t, 0.0f, 2.0f);
+			CHECK(close(out.translation.get(2), Vec3f(clamped * clamped * clamped, clamped * clamped - clamped, 2.0f * clamped)));
+
+			// Catmull-Rom: Hermite with tangents from the neighbouring keys
+			size_t a = k > 0 ? k - 1 : k, b = std::min(k + 1, times.size() - 1), c = std::min(k + 2, times.size() - 1);
+			Vec3f m0 = (points[b] - points[a]) / (times[b] - times[a]);
+			Vec3f m1 = (points[c] - points[k]) / (times[c] - times[k]);
+			float dt = times[b] - times[k];
+			float h01 = 3.0f * s * s - 2.0f * s * s * s, h10 = s * s * s - 2.0f * s * s + s, h11 = s * s * s - s * s;
+			CHECK(close(out.scale.get(0), points[k] * (1.0f - h01) + points[b] * h01 + m0 * (h10 * dt) + m1 * (h11 * dt)));
+
+			// Untracked channels sample as the identity
+			CHECK(out.scale.get(1) == Vec3f(1.0f, 1.0f, 1.0f));
+			CHECK(out.rotation.get(2) == Quaternion(0.0f, 0.0f, 0.0f, 1.0f));
+		}
+
+		// Keys are hit exactly
+		for (size_t k = 0; k < times.size(); ++k) {
+			sampler.sample(clip, times[k], out);
+			CHECK(out.translation.get(0) == points[k]);
+			CHECK(out.scale.get(0) == points[k]);
+		}
+	}
+
+	TEST_CASE("Rotation Tracks") {
+		uint32_t seed = 3;
+		vector<float> times = key_times(seed, 9);
+		vector<Quaternion> keys;
+		for (size_t k = 0; k < times.size(); ++k) keys.push_back(random_rotation(seed));
+
+		AnimationClip clip(3);
+		clip.add_rotation(0, times, keys, Interpolation::Linear);
+		clip.add_rotation(1, times, keys, Interpolation::Step);
+		clip.add_rotation(2, times, keys, Interpolation::Cubic);
+
+		// The stored keys are the inputs, up to sign, and the cubic track's end keys are their own control points
+		for (size_t k = 0; k < times.size(); ++k) CHECK(close(stored(clip.rotations.value(k)), keys[k], 1e-6f));
+		size_t first = clip.rotations.offsets[2], last = clip.rotations.offsets[3] - 1;
+		CHECK(stored(clip.rotations.tangent(first)) == stored(clip.rotations.value(first)));
+		CHECK(stored(clip.rotations.tangent(last)) == stored(clip.rotations.value(last)));
+
+		AnimationSampler sampler;
+		TRSBatch out;
+		for (float t = 0.0f; t <= clip.duration(); t += 0.01f) {
+			sampler.sample(clip, t, out);
+			size_t k = 0;
+			while (k + 1 < times.size() && times[k + 1] <= t) ++k;
+			size_t next = std::min(k + 1, times.size() - 1);
+			float s = next > k ? (t - times[k]) / (times[next] - times[k]) : 0.0f;
+
+			CHECK(close(out.rotation.get(0), Slerp(keys[k], keys[next], s)));
+			CHECK(close(out.rotation.get(1), keys[k], 1e-6f));
+
+			Quaternion q0 = stored(clip.rotations.value(first + k)), q1 = stored(clip.rotations.value(first + next));
+			Quaternion c0 = stored(clip.rotations.tangent(first + k)), c1 = stored(clip.rotations.tangent(first + next));
+			Quaternion squad = Slerp(Slerp(q0, q1, s), Slerp(c0, c1, s), 2.0f * s * (1.0f - s));
+			Quaternion q = out.rotation.get(2);
+			CHECK(close(q, squad, 2e-4f));
+			CHECK(std::fabs(q.Mag() - 1.0f) < 1e-4f);
+		}
+
+		// Squad is continuous across keys
+		TRSBatch before, after;
+		for (size_t k = 1; k + 1 < times.size(); ++k) {
+			sampler.sample(clip, times[k] - 1e-4f, before);
+			sampler.sample(clip, times[k] + 1e-4f, after);
+			CHECK(close(before.rotation.get(2), after.rotation.get(2), 1e-2f));
+		}
+	}
+
+	TEST_CASE("Cached Keys") {
+		AnimationClip clip = make_clip(37, 11);
+		AnimationSampler playing, jumping;
+		TRSBatch played, expected;
+
+		// Forward playback, a loop back to the start, random seeks, and a sampler last used on another clip
+		uint32_t seed = 4;
+		vector<float> times;
+		for (float t = -0.1f; t < clip.duration() + 0.1f; t += 1.0f / 60.0f) times.push_back(t);
+		for (float t = 0.0f; t < 0.5f; t += 1.0f / 30.0f) times.push_back(t);
+		for (size_t n = 0; n < 50; ++n) times.push_back(random_float(seed) * clip.duration());
+
+		AnimationClip other = make_clip(80, 12);
+		playing.sample(other, other.duration(), played);
+		for (float t : times) {
+			playing.sample(clip, t, played);
+			AnimationSampler fresh;
+			fresh.sample(clip, t, expected);
+			for (size_t j = 0; j < clip.joint_count; ++j) {
+				CHECK(played.translation.get(j) == expected.translation.get(j));
+				CHECK(played.rotation.get(j) == expected.rotation.get(j));
+				CHECK(played.scale.get(j) == expected.scale.get(j));
+			}
+		}
+	}
+
+	TEST_CASE("Many Characters") {
+		// More tracks than one parallel_for chunk, with a tail group
+		AnimationClip large = make_clip(2503, 21), small = make_clip(61, 22);
+		constexpr size_t Characters = 40;
+		vector<AnimationSampler> samplers(Characters);
+		vector<TRSBatch> outputs(Characters);
+		vector<AnimationJob> jobs;
+		for (size_t n = 0; n < Characters; ++n) {
+			const AnimationClip& clip = n % 8 == 0 ? large : small;
+			jobs.push_back({ &clip, &samplers[n], clip.duration() * float(n) / float(Characters), &outputs[n] });
+		}
+
+		for (size_t frame = 0; frame < 3; ++frame) {
+			for (auto& job : jobs) job.time += 0.02f;
+			sample_animations(jobs);
+			for (const auto& job : jobs) {
+				AnimationSampler fresh;
+				TRSBatch expected;
+				fresh.sample(*job.clip, job.time, expected);
+				REQUIRE(job.out->size() == job.clip->joint_count);
+				bool same = true;
+				for (size_t j = 0; j < expected.size(); ++j) {
+					same = same && job.out->translation.get(j) == expected.translation.get(j)
+						&& job.out->rotation.get(j) == expected.rotation.get(j) && job.out->scale.get(j) == expected.scale.get(j);
+				}
+				CHECK(same);
+			}
+		}
+	}
+}
+
+TEST_SUITE("Binary Format") {
+	std::string temp_path(const char* name) {
+		return (std::filesystem::temp_directory_path() / name).string();
+	}
+
+	template <class T>
+	bool same_bytes(span<const T> a, span<const T> b) {
+		return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size_bytes()) == 0);
+	}
+
+	bool aligned(const void* p, size_t alignment) {
+		return reinterpret_cast<uintptr_t>(p) % alignment == 0;
+	}
+
+	struct Scene {
+		vector<Xformf> transforms;
+		vector<Vert3d> vertices;
+		vector<AABB> bounds;
+		vector<uint32_t> indices;
+		Vec3fSoA positions;
+	};
+
+	Scene make_scene(uint32_t seed) {
+		Scene scene;
+		for (size_t n = 0; n < 1000; ++n) {
+			Xformf x;
+			for (auto& v : x.arr) v = random_float(seed);
+			scene.transforms.push_back(x);
+		}
+		for (size_t n = 0; n < 777; ++n) {
+			scene.vertices.push_back({ Vec3f(random_float(seed), random_float(seed), random_float(seed)),
+				Vec3f(0.0f, 1.0f, 0.0f), Vec2f(random_float(seed), random_float(seed)) });
+		}
+		for (size_t n = 0; n < 5; ++n) scene.bounds.push_back({ Vec3f(float(n), 0.0f, 0.0f), { 1.0f, 2.0f, 3.0f } });
+		for (uint32_t n = 0; n < 3001; ++n) scene.indices.push_back(n * 7 % 777);
+		for (size_t n = 0; n < 13; ++n) scene.positions.push_back(Vec3f(random_float(seed), random_float(seed), random_float(seed)));
+		return scene;
+	}
+
+	// The indices go in pieces through begin / append / end, the rest through add
+	bool write_scene(const std::string& path, const Scene& scene) {
+		BinaryWriter writer;
+		bool ok = writer.open(path.c_str());
+		ok = ok && writer.add<Xformf>("transforms", scene.transforms);
+		ok = ok && writer.add<Vert3d>("vertices", scene.vertices);
+		ok = ok && writer.add<AABB>("bounds", scene.bounds);
+		ok = ok && writer.add<float>("empty", {});
+		ok = ok && writer.begin<uint32_t>("indices");
+		span<const uint32_t> indices = scene.indices;
+		for (size_t i = 0; i < indices.size(); i += 1000) ok = ok && writer.append(indices.subspan(i, std::min<size_t>(1000, indices.size() - i)));
+		ok = ok && writer.end();
+		ok = ok && writer.add("positions", scene.positions);
+		return ok && writer.finish();
+	}
+
+	// A copy of a file in an aligned buffer, to corrupt
+	aligned_vector<byte> read_bytes(const std::string& path) {
+		MappedFile file;
+		REQUIRE(file.open(path.c_str()));
+		return aligned_vector<byte>(file.bytes().begin(), file.bytes().end());
+	}
+
+	template <class T>
+	T& field(aligned_vector<byte>& bytes, size_t offset) {
+		return *reinterpret_cast<T*>(bytes.data() + offset);
+	}
+
+	TEST_CASE("Round Trip") {
+		Scene scene = make_scene(1);
+		std::string path = temp_path("math3d_round_trip.m3db");
+		REQUIRE(write_scene(path, scene));
+
+		BinaryFile file;
+		REQUIRE(file.open(path.c_str()) == FormatError::None);
+		CHECK(file.sections().size() == 6);
+
+		span<const Xformf> transforms = file.get<Xformf>("transforms");
+		span<const Vert3d> vertices = file.get<Vert3d>("vertices");
+		span<const uint32_t> indices = file.get<uint32_t>("indices");
+		CHECK(same_bytes(transforms, span<const Xformf>(scene.transforms)));
+		CHECK(same_bytes(vertices, span<const Vert3d>(scene.vertices)));
+		CHECK(same_bytes(file.get<AABB>("bounds"), span<const AABB>(scene.bounds)));
+		CHECK(same_bytes(indices, span<const uint32_t>(scene.indices)));
+		CHECK(file.find("empty") != nullptr);
+		CHECK(file.get<float>("empty").empty());
+		CHECK(aligned(transforms.data(), 64));
+		CHECK(aligned(vertices.data(), 64));
+		CHECK(aligned(indices.data(), 64));
+
+		SoAView<3> positions = file.get_soa<3>("positions");
+		REQUIRE(positions.size() == scene.positions.size());
+		for (size_t k = 0; k < 3; ++k) {
+			CHECK(aligned(positions.stream(k).data(), 64));
+			CHECK(same_bytes(positions.stream(k), std::as_const(scene.positions).stream(k)));
+		}
+
+		// Missing names, other element types and other widths come back empty
+		CHECK(file.get<Xformf>("missing").empty());
+		CHECK(file.get<Vec3f>("transforms").empty());
+		CHECK(file.get<float>("positions").empty());
+		CHECK(file.get_soa<2>("positions").size() == 0);
+		CHECK(file.get_soa<3>("empty").size() == 0);
+
+		// The mapping moves with the file
+		BinaryFile moved = std::move(file);
+		CHECK(same_bytes(moved.get<Xformf>("transforms"), span<const Xformf>(scene.transforms)));
+		std::filesystem::remove(path);
+	}
+
+	TEST_CASE("Writer Errors") {
+		std::string path = temp_path("math3d_writer_errors.m3db");
+		vector<Vec3f> points(10, Vec3f(1.0f, 2.0f, 3.0f));
+
+		BinaryWriter writer;
+		CHECK(!writer.add<Vec3f>("points", points));
+		REQUIRE(writer.open(path.c_str()));
+		CHECK(writer.add<Vec3f>("points", points));
+		CHECK(!writer.add<Vec3f>("points", points));
+		CHECK(!writer.add<Vec3f>("", points));
+		CHECK(!writer.add<Vec3f>("a name that is far too long for a section", points));
+		CHECK(writer.begin<Vec3f>("more points"));
+		CHECK(!writer.append(span<const float>(&points[0][0], 3)));
+		CHECK(!writer.begin<Vec3f>("nested"));
+		CHECK(!writer.finish());
+		CHECK(writer.end());
+		CHECK(!writer.end());
+		CHECK(writer.finish());
+
+		BinaryFile file;
+		REQUIRE(file.open(path.c_str()) == FormatError::None);
+		CHECK(file.get<Vec3f>("points").size() == 10);
+		CHECK(file.get<Vec3f>("more points").empty());
+
+		// An unfinished file has no magic
+		{
+			BinaryWriter unfinished;
+			REQUIRE(unfinished.open(path.c_str()));
+			CHECK(unfinished.add<Vec3f>("points", points));
+		}
+		CHECK(file.open(path.c_str()) == FormatError::Magic);
+		CHECK(file.sections().empty());
+		CHECK(file.open(temp_path("math3d_missing.m3db").c_str()) == FormatError::Open);
+		std::filesystem::remove(path);
+	}
+
+	TEST_CASE("Validation") {
+		std::string path = temp_path("math3d_validation.m3db");
+		REQUIRE(write_scene(path, make_scene(2)));
+		aligned_vector<byte> original = read_bytes(path);
+		std::filesystem::remove(path);
+
+		BinaryFile file;
+		CHECK(file.view(original) == FormatError::None);
+		uint64_t table = field<uint64_t>(original, offsetof(FileHeader, table_offset));
+
+		auto corrupted = [&](auto&& change) {
+			aligned_vector<byte> bytes = original;
+			change(bytes);
+			BinaryFile corrupt;
+			FormatError error = corrupt.view(bytes);
+			CHECK(corrupt.sections().empty() == (error != FormatError::None));
+			return error;
+		};
+
+		CHECK(corrupted([](auto& b) { b[0] = byte('X'); }) == FormatError::Magic);
+		CHECK(corrupted([](auto& b) { field<uint32_t>(b, offsetof(FileHeader, byte_order)) = 0x04030201u; }) == FormatError::ByteOrder);
+		CHECK(corrupted([](auto& b) { field<uint32_t>(b, offsetof(FileHeader, version)) = FormatVersion + 1; }) == FormatError::Version);
+		CHECK(corrupted([](auto& b) { b.resize(b.size() - 1); }) == FormatError::Truncated);
+		CHECK(corrupted([](auto& b) { b.resize(40); }) == FormatError::Truncated);
+		CHECK(corrupted([](auto& b) { field<uint32_t>(b, offsetof(FileHeader, section_count)) += 1; }) == FormatError::Truncated);
+		CHECK(corrupted([&](auto& b) { field<uint64_t>(b, table + offsetof(SectionEntry, count)) = ~uint64_t(0) / 2; }) == FormatError::Truncated);
+		CHECK(corrupted([&](auto& b) { field<uint64_t>(b, table + offsetof(SectionEntry, offset)) += 4; }) == FormatError::Layout);
+		CHECK(corrupted([&](auto& b) { field<uint32_t>(b, table + offsetof(SectionEntry, element_size)) = 32; }) == FormatError::Layout);
+		CHECK(corrupted([&](auto& b) { field<ElementType>(b, table + offsetof(SectionEntry, type)) = ElementType(99); }) == FormatError::Layout);
+		CHECK(corrupted([&](auto& b) { std::memset(b.data() + table, 'a', 32); }) == FormatError::Layout);
+
+		// Sections must start on their alignment in memory, not just in the file
+		aligned_vector<byte> shifted(original.size() + 4);
+		std::memcpy(shifted.data() + 4, original.data(), original.size());
+		CHECK(file.view(span<const byte>(shifted).subspan(4)) == FormatError::Layout);
+	}
+}
+
+TEST_SUITE("Job System") {
+	bool covered_once(const vector<std::atomic<int>>& hits) {
+		return std::all_of(hits.begin(), hits.end(), [](const std::atomic<int>& h) { return h.load() == 1; });
+	}
+
+	TEST_CASE("parallel_for covers every range once") {
+		JobSystem system(4);
+		CHECK(system.thread_count() == 4);
+		for (size_t count : { 0, 1, 7, 64, 1000, 100003 }) {
+			for (size_t grain : { 0, 1, 3, 64, 5000 }) {
+				vector<std::atomic<int>> hits(count);
+				std::atomic<size_t> calls { 0 }, empty { 0 };
+				parallel_for(system, count, grain, [&](size_t begin, size_t end) {
+					if (begin >= end) empty.fetch_add(1);
+					for (size_t n = begin; n < end; ++n) hits[n].fetch_add(1);
+					calls.fetch_add(1);
+				});
+				CHECK(covered_once(hits));
+				CHECK(empty.load() == 0);
+				size_t g = std::max<size_t>(grain, 1);
+				CHECK(calls.load() == (count + g - 1) / g);
+			}
+		}
+	}
+
+	TEST_CASE("Nested parallel_for") {
+		JobSystem system(4);
+		constexpr size_t Rows = 37, Columns = 1001;
+		vector<std::atomic<int>> hits(Rows * Columns);
+		std::atomic<bool> same_system { true };
+		parallel_for(system, Rows, 1, [&](size_t r0, size_t r1) {
+			for (size_t r = r0; r < r1; ++r) {
+				// The inner loops run on the same system, which the workers report as current
+				if (&JobSystem::current() != &system) same_system = false;
+				parallel_for(Columns, 16, [&](size_t c0, size_t c1) {
+					for (size_t c = c0; c < c1; ++c) hits[r * Columns + c].fetch_add(1);
+				});
+			}
+		});
+		CHECK(covered_once(hits));
+		CHECK(same_system.load());
+	}
+
+	TEST_CASE("Task groups") {
+		JobSystem system(4);
+		std::atomic<size_t> sum { 0 };
+		{
+			TaskGroup group(system);
+			for (size_t n = 1; n <= 1000; ++n) group.run([&sum, n] { sum.fetch_add(n); });
+			group.wait();
+			CHECK(sum.load() == 500500);
+
+			// A group can be reused after wait(), and the destructor waits
+			group.run([&] { sum.fetch_add(1); });
+		}
+		CHECK(sum.load() == 500501);
+
+		// Tasks that spawn and wait for their own groups
+		struct Fib {
+			static size_t run(JobSystem& system, size_t n) {
+				if (n < 2) return n;
+				size_t a = 0, b = 0;
+				TaskGroup group(system);
+				group.run([&] { a = run(system, n - 1); });
+				b = run(system, n - 2);
+				group.wait();
+				return a + b;
+			}
+		};
+		CHECK(Fib::run(system, 20) == 6765);
+	}
+
+	TEST_CASE("Scopes and outside threads") {
+		JobSystem single(1), four(4);
+		{
+			JobSystem::Scope scope(single);
+			CHECK(&JobSystem::current() == &single);
+			CHECK(parallel_thread_count() == 1);
+			{
+				JobSystem::Scope inner(four);
+				CHECK(parallel_thread_count() == 4);
+			}
+			CHECK(&JobSystem::current() == &single);
+		}
+		CHECK(&JobSystem::current() == &JobSystem::shared());
+
+		// Threads outside the pool call into the same system at once, more of them than it has deques for
+		vector<std::atomic<int>> hits(12 * 10000);
+		vector<std::thread> threads;
+		for (size_t t = 0; t < 12; ++t) {
+			threads.emplace_back([&, t] {
+				for (size_t round = 0; round < 10; ++round) {
+					parallel_for(four, 1000, 10, [&](size_t begin, size_t end) {
+						for (size_t n = begin; n < end; ++n) hits[t * 10000 + round * 1000 + n].fetch_add(1);
+					});
+				}
+			});
+		}
+		for (auto& thread : threads) thread.join();
+		CHECK(covered_once(hits));
+	}
+
+	TEST_CASE("Task groups outside the pool") {
+		JobSystem four(4);
+
+		// Groups on one thread may be waited out of order
+		std::atomic<int> done { 0 };
+		{
+			TaskGroup a(four), b(four);
+			for (int n = 0; n < 100; ++n) {
+				a.run([&] { done.fetch_add(1); });
+				b.run([&] { done.fetch_add(1); });
+			}
+			a.wait();
+			b.run([&] { done.fetch_add(1); });
+			b.wait();
+		}
+		CHECK(done.load() == 201);
+
+		// An open group doesn't hold up other threads calling into the same system
+		vector<std::atomic<int>> hits(10000);
+		TaskGroup open(four);
+		open.run([&] { done.fetch_add(1); });
+		std::thread other([&] {
+			parallel_for(four, hits.size(), 100, [&](size_t begin, size_t end) {
+				for (size_t n = begin; n < end; ++n) hits[n].fetch_add(1);
+			});
+		});
+		other.join();
+		open.wait();
+		CHECK(covered_once(hits));
+		CHECK(done.load() == 202);
+
+		// A group that found every outside deque taken runs its tasks inline, even after the thread gets a
+		// deque through another group
+		std::atomic<int> holding { 0 };
+		std::atomic<bool> release { false };
+		vector<std::thread> holders;
+		for (int t = 0; t < 8; ++t) {
+			holders.emplace_back([&] {
+				TaskGroup held(four);
+				held.run([] {});
+				holding.fetch_add(1);
+				while (!release) std::this_thread::yield();
+			});
+		}
+		while (holding.load() < 8) std::this_thread::yield();
+		{
+			TaskGroup unseated(four);
+			unseated.run([&] { done.fetch_add(1); });
+			release = true;
+			for (auto& holder : holders) holder.join();
+
+			TaskGroup seated(four);
+			seated.run([&] { done.fetch_add(1); });
+			unseated.run([&] { done.fetch_add(1); });
+			unseated.wait();
+			CHECK(done.load() == 204);
+			seated.wait();
+		}
+		CHECK(done.load() == 205);
+	}
 }